@@ -52,6 +52,8 @@ struct DryRunCommandRunner : public CommandRunner {
   // Overridden from CommandRunner:
   virtual bool CanRunMore() const;
   virtual bool StartCommand(Edge* edge);
+  virtual bool StartCommand(Edge* edge, const string& command,
+                            SubprocessOutputSink* sink);
   virtual bool WaitForCommand(Result* result);
 
  private:
@@ -67,6 +69,11 @@ bool DryRunCommandRunner::StartCommand(Edge* edge) {
   return true;
 }
 
+bool DryRunCommandRunner::StartCommand(Edge* edge, const string& command,
+                                       SubprocessOutputSink* sink) {
+  return StartCommand(edge);
+}
+
 bool DryRunCommandRunner::WaitForCommand(Result* result) {
    if (finished_.empty())
      return false;
@@ -319,13 +326,17 @@ Plan::Plan(Builder* builder)
   : builder_(builder)
   , command_edges_(0)
   , remote_edges_(0)
+  , preprocess_edges_(0)
   , wanted_edges_(0)
 {}
 
 void Plan::Reset() {
   command_edges_ = 0;
+  preprocess_edges_ = 0;
   wanted_edges_ = 0;
   ready_.clear();
+  ready_remote_.clear();
+  ready_preprocess_.clear();
   want_.clear();
 }
 
@@ -391,29 +402,51 @@ void Plan::EdgeWanted(const Edge* edge) {
     ++remote_edges_;
     remote_rules_.insert(edge->rule_);
   }
+  if (edge->is_preprocess_)
+    ++preprocess_edges_;
 }
 
-Edge* Plan::FindWork(bool onlyRemote) {
-  if (onlyRemote) {
-    if (ready_remote_.empty())
-      return nullptr;
-    auto e = ready_remote_.begin();
-    Edge* edge = *e;
-    ready_remote_.erase(e);
-    auto re = ready_.find(edge);
-    if (re != ready_.end())
-      ready_.erase(re);
-    return edge;
+Edge* Plan::FindWork(WorkKind kind) {
+  switch (kind) {
+    case kAnyWork:
+      return ready_.empty() ? NULL : TakeReady(*ready_.begin());
+    case kRemoteWork:
+      return ready_remote_.empty() ? NULL : TakeReady(*ready_remote_.begin());
+    case kPreprocessWork:
+      return ready_preprocess_.empty() ? NULL : TakeReady(*ready_preprocess_.begin());
+    case kOtherWork:
+      if (ready_.size() == ready_preprocess_.size())
+        return NULL;
+      for (set<Edge*>::iterator e = ready_.begin(); e != ready_.end(); ++e) {
+        if (!(*e)->is_preprocess_)
+          return TakeReady(*e);
+      }
+      return NULL;
+    case kLocalWork:
+      if (ready_.size() == ready_remote_.size())
+        return NULL;
+      for (set<Edge*>::iterator e = ready_.begin(); e != ready_.end(); ++e) {
+        if (!(*e)->is_remote_)
+          return TakeReady(*e);
+      }
+      return NULL;
   }
+  return NULL;
+}
+
+void Plan::AddReady(Edge* edge) {
+  ready_.insert(edge);
+  if (edge->is_remote_)
+    ready_remote_.insert(edge);
+  if (edge->is_preprocess_)
+    ready_preprocess_.insert(edge);
+}
 
-  if (ready_.empty())
-    return nullptr;
-  auto e = ready_.begin();
-  Edge* edge = *e;
-  ready_.erase(e);
-  auto re = ready_remote_.find(edge);
-  if (re != ready_remote_.end())
-    ready_remote_.erase(re);
+Edge* Plan::TakeReady(Edge* edge) {
+  ready_.erase(edge);
+  ready_remote_.erase(edge);
+  if (ready_preprocess_.erase(edge))
+    --preprocess_edges_;
   return edge;
 }
 
@@ -434,15 +467,11 @@ void Plan::ScheduleWork(map<Edge*, Want>::iterator want_e) {
     pool->DelayEdge(edge);
     set<Edge*> ready;
     pool->RetrieveReadyEdges(&ready);
-    ready_.insert(ready.begin(), ready.end());
     for (Edge * redge : ready)
-        if (redge->is_remote_)
-            ready_remote_.insert(redge);
+      AddReady(redge);
   } else {
     pool->EdgeScheduled(*edge);
-    ready_.insert(edge);
-    if (edge->is_remote_)
-        ready_remote_.insert(edge);
+    AddReady(edge);
   }
 }
 
@@ -454,7 +483,10 @@ bool Plan::EdgeFinished(Edge* edge, EdgeResult result, string* err) {
   // See if this job frees up any delayed jobs.
   if (directly_wanted)
     edge->pool()->EdgeFinished(*edge);
-  edge->pool()->RetrieveReadyEdges(&ready_);
+  set<Edge*> ready;
+  edge->pool()->RetrieveReadyEdges(&ready);
+  for (Edge * redge : ready)
+    AddReady(redge);
 
   // The rest of this function only applies to successful commands.
   if (result != kEdgeSucceeded)
@@ -565,6 +597,8 @@ bool Plan::CleanNode(DependencyScan* scan, Node* node, string* err) {
           --command_edges_;
         if ((*oe)->is_remote_)
             --remote_edges_;
+        if ((*oe)->is_preprocess_)
+            --preprocess_edges_;
       }
     }
   }
@@ -708,6 +742,8 @@ struct RealCommandRunner : public CommandRunner {
   virtual ~RealCommandRunner() {}
   virtual bool CanRunMore() const;
   virtual bool StartCommand(Edge* edge);
+  virtual bool StartCommand(Edge* edge, const string& command,
+                            SubprocessOutputSink* sink);
   virtual bool WaitForCommand(Result* result);
   virtual vector<Edge*> GetActiveEdges();
   virtual void Abort();
@@ -747,12 +783,29 @@ bool RealCommandRunner::StartCommand(Edge* edge) {
   return true;
 }
 
+bool RealCommandRunner::StartCommand(Edge* edge, const string& command,
+                                     SubprocessOutputSink* sink) {
+  Subprocess* subproc = subprocs_->Add(command, false, vector<string>(),
+                                       string(), sink);
+  if (!subproc)
+    return false;
+  subproc_to_edge_.insert(make_pair(subproc, edge));
+
+  return true;
+}
+
 bool RealCommandRunner::WaitForCommand(Result* result) {
   Subprocess* subproc;
   while ((subproc = subprocs_->NextFinished()) == NULL) {
     bool interrupted = subprocs_->DoWork();
     if (interrupted)
       return false;
+    if (subprocs_->IsWoken()) {
+      // Not a local command; caller should check remote results.
+      result->edge = NULL;
+      result->status = ExitSuccess;
+      return true;
+    }
   }
 
   result->status = subproc->Finish();
@@ -850,6 +903,7 @@ bool Builder::Build(string* err) {
   status_->PlanHasTotalEdges(plan_.command_edge_count());
   int remote_commands = plan_.remote_edges_count();
   int pending_commands = 0;
+  int pending_preprocess = 0;
   int pending_remote = 0;
   int failures_allowed = config_.failures_allowed;
   std::set<std::string> toolIdsSet;
@@ -877,6 +931,16 @@ bool Builder::Build(string* err) {
   if (minimal_remote_tasks != -1 && remote_commands > minimal_remote_tasks)
       remote_runner_->RunIfNeeded(toolIds, subprocessSet);
 
+  // Remote completions interrupt waiting for local commands, so both are
+  // reaped in one place as soon as they are ready.
+  const bool remote_wakeup = subprocessSet && remote_runner_->GetWakeupFd() >= 0;
+  if (remote_wakeup)
+      subprocessSet->SetWakeupFd(remote_runner_->GetWakeupFd());
+
+  // Streamed remote edges first run preprocessor in local slot, and take
+  // remote thread only when it is finished.
+  const bool stream_preprocess = remote_runner_->IsPreprocessStreamed();
+  set<Edge*> streamed_preprocess;
 
   // This main loop runs the entire build process.
   // It is structured like this:
@@ -886,8 +950,10 @@ bool Builder::Build(string* err) {
   IRemoteExecutor::Result remoteResult;
   while (plan_.more_to_do()) {
 
-    if (failures_allowed && remote_runner_->CanRunMore()  ) {
-        if (Edge* edge = plan_.FindWork(true)) {
+    if (failures_allowed && remote_runner_->CanRunMore()
+        && (!stream_preprocess || (command_runner_->CanRunMore()
+            && remote_runner_->GetFreeRemoteThreads() > (int)streamed_preprocess.size()))) {
+        if (Edge* edge = plan_.FindWork(Plan::kRemoteWork)) {
 
             if (!StartEdge(edge, err, true)) {
               Cleanup();
@@ -897,6 +963,11 @@ bool Builder::Build(string* err) {
 
             if (edge->is_phony())
               plan_.EdgeFinished(edge, Plan::kEdgeSucceeded, err);
+            else if (edge->stream_preprocess_) {
+              streamed_preprocess.insert(edge);
+              ++pending_commands;
+              ++pending_preprocess;
+            }
             else
                 pending_remote++;
 
@@ -933,7 +1004,7 @@ bool Builder::Build(string* err) {
 
     // See if we can start any more commands.
     if (failures_allowed && command_runner_->CanRunMore()) {
-      if (Edge* edge = plan_.FindWork()) {
+      if (Edge* edge = FindLocalWork(pending_preprocess, pending_commands - pending_preprocess)) {
         if (edge->is_remote_ && config_.verbosity == BuildConfig::VERBOSE )
         {
             status_->GetLinePrinter().Print("Task could run on remote, but it still run locally.", LinePrinter::FULL);
@@ -952,6 +1023,8 @@ bool Builder::Build(string* err) {
           }
         } else {
           ++pending_commands;
+          if (edge->is_preprocess_)
+            ++pending_preprocess;
         }
 
         // We made some progress; go back to the main loop.
@@ -960,7 +1033,7 @@ bool Builder::Build(string* err) {
     }
 
     // See if we can reap any finished commands.
-    if (pending_commands) {
+    if (pending_commands || (failures_allowed && pending_remote && remote_wakeup)) {
       CommandRunner::Result result;
       if (!command_runner_->WaitForCommand(&result) ||
           result.status == ExitInterrupted) {
@@ -969,8 +1042,27 @@ bool Builder::Build(string* err) {
         *err = "interrupted by user";
         return false;
       }
+      if (!result.edge) // woken up by remote executor.
+        continue;
 
       --pending_commands;
+      if (result.edge->is_preprocess_)
+        --pending_preprocess;
+      if (streamed_preprocess.erase(result.edge)) {
+        --pending_preprocess;
+        if (result.success()) {
+          // Preprocessed data is already collected, send it with preprocessor diagnostics.
+          if (!remote_runner_->StartCommand(result.edge, result.edge->GetBinding("cc_command"), result.output)) {
+            err->assign("command '" + result.edge->GetBinding("cc_command") + "' failed.");
+            Cleanup();
+            status_->BuildFinished();
+            return false;
+          }
+          pending_remote++;
+          continue;
+        }
+        remote_runner_->ReleasePreprocessSink(result.edge);
+      }
       if (!FinishCommand(&result, err, false, !failures_allowed)) {
         Cleanup();
         status_->BuildFinished();
@@ -988,7 +1080,7 @@ bool Builder::Build(string* err) {
 
     if (failures_allowed && pending_remote)
     {
-        remote_runner_->SleepSome();
+        remote_runner_->WaitForWakeup();
         continue;
     }
 
@@ -1011,6 +1103,32 @@ bool Builder::Build(string* err) {
   return true;
 }
 
+Edge* Builder::FindLocalWork(int pending_preprocess, int pending_other) {
+  // Streamed remote edges are all ready at once; local slots are needed for
+  // their preprocessing, so they are compiled locally only if nothing else is left.
+  if (remote_runner_->IsPreprocessStreamed() && remote_runner_->GetFreeRemoteThreads() > 0) {
+    if (Edge* edge = plan_.FindWork(Plan::kLocalWork))
+      return edge;
+  }
+  // Remote threads which will be idle after all ready and preprocessing
+  // remote edges are sent.
+  const int headroom = remote_runner_->GetFreeRemoteThreads()
+      - plan_.get_ready_remote_count() - pending_preprocess;
+  if (headroom <= 0 || plan_.preprocess_edges_count() == 0)
+    return plan_.FindWork();
+
+  if (Edge* edge = plan_.FindWork(Plan::kPreprocessWork))
+    return edge;
+
+  // Keep some local slots free for preprocessing which is not ready yet,
+  // but never more than half, as other work may be what it waits for.
+  const int reserved = min(min(headroom, plan_.preprocess_edges_count()),
+                           config_.parallelism / 2);
+  if (pending_other >= config_.parallelism - reserved)
+    return NULL;
+  return plan_.FindWork(Plan::kOtherWork);
+}
+
 bool Builder::StartEdge(Edge* edge, string* err, bool remote) {
   METRIC_RECORD("StartEdge");
   if (edge->is_phony())
@@ -1035,7 +1153,11 @@ bool Builder::StartEdge(Edge* edge, string* err, bool remote) {
       return false;
   }
 
-  bool status = remote ? remote_runner_->StartCommand(edge, edge->EvaluateCommand()) : command_runner_->StartCommand(edge);
+  bool status;
+  if (remote && edge->stream_preprocess_)
+    status = command_runner_->StartCommand(edge, edge->GetBinding("pp_command"), remote_runner_->CreatePreprocessSink(edge));
+  else
+    status = remote ? remote_runner_->StartCommand(edge, edge->EvaluateCommand()) : command_runner_->StartCommand(edge);
   // start command computing and run it
   if (!status) {
     err->assign("command '" + edge->EvaluateCommand() + "' failed.");
@@ -37,6 +37,7 @@ struct DiskInterface;
 struct Edge;
 struct Node;
 struct State;
+struct SubprocessOutputSink;
 
 /// Plan stores the state of a build plan: what we intend to build,
 /// which steps we're ready to execute.
@@ -48,9 +49,21 @@ struct Plan {
   /// fill in |err| with an error message if there's a problem.
   bool AddTarget(const Node* node, string* err);
 
+  enum WorkKind {
+    kAnyWork,
+    /// Edges which may run remotely.
+    kRemoteWork,
+    /// Local edges which produce input for remote ones.
+    kPreprocessWork,
+    /// Anything except preprocessing.
+    kOtherWork,
+    /// Edges which can not run remotely.
+    kLocalWork
+  };
+
   // Pop a ready edge off the queue of edges to build.
-  // Returns NULL if there's no work to do.
-  Edge* FindWork(bool onlyRemote = false);
+  // Returns NULL if there's no work of that kind to do.
+  Edge* FindWork(WorkKind kind = kAnyWork);
 
   /// Returns true if there's more work to be done.
   bool more_to_do() const { return wanted_edges_ > 0 && command_edges_ > 0; }
@@ -79,6 +92,8 @@ struct Plan {
   std::set<const Rule*> remote_rules() const { return remote_rules_; }
   int get_ready_count() const { return ready_.size(); }
   int get_ready_remote_count() const { return ready_remote_.size(); }
+  /// Number of wanted preprocess edges which are not started yet.
+  int preprocess_edges_count() const { return preprocess_edges_; }
 
   /// Reset state.  Clears want and ready sets.
   void Reset();
@@ -119,6 +134,8 @@ private:
   /// The edge may be delayed from running, for example if it's a member of a
   /// currently-full pool.
   void ScheduleWork(map<Edge*, Want>::iterator want_e);
+  void AddReady(Edge* edge);
+  Edge* TakeReady(Edge* edge);
 
   /// Keep track of which edges we want to build in this plan.  If this map does
   /// not contain an entry for an edge, we do not want to build the entry or its
@@ -128,6 +145,7 @@ private:
 
   set<Edge*> ready_;
   set<Edge*> ready_remote_;
+  set<Edge*> ready_preprocess_;
 
   Builder* builder_;
 
@@ -138,6 +156,8 @@ private:
   int remote_edges_;
   std::set<const Rule*> remote_rules_;
 
+  int preprocess_edges_;
+
   /// Total remaining number of wanted edges.
   int wanted_edges_;
 };
@@ -149,6 +169,9 @@ struct CommandRunner {
   virtual ~CommandRunner() {}
   virtual bool CanRunMore() const = 0;
   virtual bool StartCommand(Edge* edge) = 0;
+  /// Runs command instead of edge's own, passing its stdout to sink.
+  virtual bool StartCommand(Edge* edge, const string& command,
+                            SubprocessOutputSink* sink) { return false; }
 
   /// The result of waiting for a command.
   struct Result {
@@ -223,6 +246,9 @@ struct Builder {
   /// Load the dyndep information provided by the given node.
   bool LoadDyndeps(Node* node, string* err);
 
+  /// Pick ready edge to run locally, preferring preprocessing while remote threads are starving.
+  Edge* FindLocalWork(int pending_preprocess, int pending_other);
+
   State* state_;
   const BuildConfig& config_;
   Plan plan_;
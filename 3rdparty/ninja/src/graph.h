@@ -188,6 +188,8 @@ struct Edge {
   bool deps_loaded_;
   bool deps_missing_;
   bool is_remote_ = false;
+  bool is_preprocess_ = false; // local edge which feeds remote one.
+  bool stream_preprocess_ = false; // remote edge which runs pp_command locally with output piped to cc_command request.
   bool use_temporary_inputs_ = false;
 
   const Rule& rule() const { return *rule_; }
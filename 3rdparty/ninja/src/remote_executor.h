@@ -19,6 +19,7 @@
 
 struct Edge;
 struct SubprocessSet;
+struct SubprocessOutputSink;
 
 class IRemoteExecutor
 {
@@ -32,6 +33,8 @@ public:
                                 std::vector<std::string> & compileRule) const = 0;
 
     virtual std::string GetPreprocessedPath(const std::string & sourcePath, const std::string & objectPath) const = 0;
+    /// Preprocessor output goes directly to remote request; preprocess rule then writes to stdout.
+    virtual bool IsPreprocessStreamed() const = 0;
 
     virtual bool CheckRemotePossibleForFlags(const std::string & toolId, const std::string & flags) const = 0;
     virtual std::string FilterPreprocessorFlags(const std::string & toolId, const std::string & flags) const = 0;
@@ -39,11 +42,22 @@ public:
 
     virtual void RunIfNeeded(const std::vector<std::string> & toolIds, const std::shared_ptr<SubprocessSet> & subprocessSet) = 0;
     virtual int GetMinimalRemoteTasks() const = 0;
-    virtual void SleepSome() const = 0;
+    /// Readable when remote command finished or remote threads became available; -1 if not supported.
+    virtual int GetWakeupFd() const = 0;
+    /// Blocks until wakeup fd is signaled, for use without SubprocessSet.
+    virtual void WaitForWakeup() const = 0;
 
     virtual bool CanRunMore() = 0;
+    /// Number of remote threads not busy with tasks of this build, may be negative.
+    virtual int GetFreeRemoteThreads() const = 0;
     virtual bool StartCommand(Edge* userData, const std::string & command) = 0;
 
+    /// Sink for stdout of local preprocessor, collecting data for StartCommand with preprocessOutput.
+    virtual SubprocessOutputSink* CreatePreprocessSink(Edge* userData) = 0;
+    virtual void ReleasePreprocessSink(Edge* userData) = 0;
+    /// Starts remote compilation of data collected by sink; preprocessOutput is prepended to result output.
+    virtual bool StartCommand(Edge* userData, const std::string & command, const std::string & preprocessOutput) = 0;
+
     /// The result of waiting for a command.
     struct Result {
       Result() = default;
@@ -13,6 +13,12 @@
 
 #include "remote_executor_impl.h"
 
+#ifndef _WIN32
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#endif
+
 using namespace Wuild;
 
 RemoteExecutor::RemoteExecutor(ConfiguredApplication &app) : m_app(app)
@@ -28,6 +34,22 @@ RemoteExecutor::RemoteExecutor(ConfiguredApplication &app) : m_app(app)
 
     m_minimalRemoteTasks = m_remoteToolConfig.m_minimalRemoteTasks;
 
+#ifndef _WIN32
+    if (pipe(m_wakeupPipe) == 0)
+    {
+        for (int fd : m_wakeupPipe)
+        {
+            fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+            fcntl(fd, F_SETFD, FD_CLOEXEC);
+        }
+    }
+    else
+    {
+        Syslogger(Syslogger::Warning) << "Failed to create wakeup pipe, remote results will be polled.";
+        m_wakeupPipe[0] = m_wakeupPipe[1] = -1;
+    }
+#endif
+
     m_invocationRewriter = InvocationRewriter::Create(compilerConfig);
 
 
@@ -95,6 +117,8 @@ bool RemoteExecutor::PreprocessCode(const std::vector<std::string> &originalRule
     original.m_ignoredArgs = ignoredArgs;
     if (!m_invocationRewriter->SplitInvocation(original, pp, cc, &toolId))
         return false;
+    if (IsPreprocessStreamed())
+        pp.SetOutput("-");
 
     preprocessRule.push_back(srcExecutable + "  ");
     preprocessRule.insert(preprocessRule.end(), pp.m_args.begin(), pp.m_args.end());
@@ -105,6 +129,16 @@ bool RemoteExecutor::PreprocessCode(const std::vector<std::string> &originalRule
     return true;
 }
 
+bool RemoteExecutor::IsPreprocessStreamed() const
+{
+#ifdef _WIN32
+    return false;
+#else
+    // agent gets requests without input data.
+    return m_remoteEnabled && m_remoteToolConfig.m_streamPreprocessed && m_app.m_toolProxyServerConfig.m_listenSocket.empty();
+#endif
+}
+
 bool RemoteExecutor::CheckRemotePossibleForFlags(const std::string & toolId, const std::string & flags) const
 {
     if (!m_remoteEnabled)
@@ -137,29 +171,82 @@ std::string RemoteExecutor::FilterCompilerFlags(const std::string &toolId, const
     return m_invocationRewriter->FilterFlags(ToolInvocation(flags, ToolInvocation::InvokeType::Compile).SetId(toolId)).GetArgsString(false);
 }
 
-void RemoteExecutor::RunIfNeeded(const std::vector<std::string> &toolIds, const std::shared_ptr<SubprocessSet> & subprocessSet)
+void RemoteExecutor::RunIfNeeded(const std::vector<std::string> &toolIds, const std::shared_ptr<SubprocessSet> &)
 {
     if (!m_remoteEnabled || m_hasStart)
         return;
 
     m_hasStart = true;
-    if (!m_remoteService)
+    if (!m_app.m_toolProxyServerConfig.m_listenSocket.empty())
     {
-		auto localExecutor = LocalExecutor::Create(m_invocationRewriter, m_app.m_tempDir, subprocessSet);
-		auto toolsVersions = VersionChecker::Create(localExecutor, m_invocationRewriter)->DetermineToolVersions(toolIds);
-		m_remoteService.reset(new RemoteToolClient(m_invocationRewriter, toolsVersions));
-        if (!m_remoteService->SetConfig(m_remoteToolConfig))
+        m_agent.reset(new ToolProxyClient());
+        if (m_agent->SetConfig(m_app.m_toolProxyServerConfig) && m_agent->Start())
+        {
+            m_agent->SubscribeStatus([this]{
+                std::lock_guard<std::mutex> lock(m_resultsMutex);
+                Wakeup();
+            });
+            m_buildStart = TimePoint(true);
             return;
+        }
+        Syslogger(Syslogger::Warning) << "Failed to connect to Wuild agent, using own connection.";
+        m_agent.reset();
     }
-    m_remoteService->Start(toolIds);
+    // versions are checked in background, build meanwhile starts local commands; checker runs tools on own, not in build subprocess set.
+    m_toolIds = toolIds;
+    m_versionChecker = VersionChecker::Create(LocalExecutor::Create(m_invocationRewriter, m_app.m_tempDir), m_invocationRewriter);
+    m_toolVersions = m_versionChecker->DetermineToolVersionsAsync(toolIds, [this]{
+        std::lock_guard<std::mutex> lock(m_resultsMutex);
+        Wakeup();
+    });
+    m_buildStart = TimePoint(true);
 #ifdef  TEST_CLIENT
     m_toolServer->Start();
 #endif
 }
 
-void RemoteExecutor::SleepSome() const
+bool RemoteExecutor::StartRemoteService(bool wait)
+{
+    if (m_remoteService)
+        return true;
+    if (!m_toolVersions.valid())
+        return false;
+    if (!wait && m_toolVersions.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+        return false;
+
+    const auto toolsVersions = m_toolVersions.get();
+    m_toolVersions = {};
+    m_versionChecker.reset();
+    m_remoteService.reset(new RemoteToolClient(m_invocationRewriter, toolsVersions));
+    if (!m_remoteService->SetConfig(m_remoteToolConfig))
+    {
+        m_remoteService.reset();
+        return false;
+    }
+    m_remoteService->SetRemoteAvailableCallback([this]{
+        std::lock_guard<std::mutex> lock(m_resultsMutex);
+        Wakeup();
+    });
+    m_remoteService->Start(m_toolIds);
+    return true;
+}
+
+int RemoteExecutor::GetWakeupFd() const
+{
+    return m_wakeupPipe[0];
+}
+
+void RemoteExecutor::WaitForWakeup() const
 {
-    usleep(1000);
+#ifndef _WIN32
+    if (m_wakeupPipe[0] >= 0)
+    {
+        pollfd pfd = { m_wakeupPipe[0], POLLIN, 0 };
+        poll(&pfd, 1, 1000);
+        return;
+    }
+#endif
+    Wuild::usleep(1000);
 }
 
 int RemoteExecutor::GetMinimalRemoteTasks() const
@@ -172,15 +259,62 @@ int RemoteExecutor::GetMinimalRemoteTasks() const
 
 bool RemoteExecutor::CanRunMore()
 {
-    if (!m_remoteEnabled || !m_hasStart)
+    if (!m_remoteEnabled || !m_hasStart || (!m_agent && !StartRemoteService(false)))
         return false;
 
-    return m_remoteService->GetFreeRemoteThreads() > 0;
+    return GetFreeRemoteThreads() > 0;
 }
 
-bool RemoteExecutor::StartCommand(Edge *userData, const std::string &command)
+int RemoteExecutor::GetFreeRemoteThreads() const
 {
     if (!m_remoteEnabled || !m_hasStart)
+        return 0;
+
+    if (m_agent)
+        return m_agent->GetFreeRemoteThreads();
+    return m_remoteService ? m_remoteService->GetFreeRemoteThreads() : 0;
+}
+
+bool RemoteExecutor::StartCommand(Edge *userData, const std::string &command)
+{
+    return StartRemote(userData, command, nullptr, std::string());
+}
+
+SubprocessOutputSink *RemoteExecutor::CreatePreprocessSink(Edge *userData)
+{
+    auto & sink = m_preprocessSinks[userData];
+    sink.reset(new CompressingOutputSink(m_remoteToolConfig.m_compression));
+    return sink.get();
+}
+
+void RemoteExecutor::ReleasePreprocessSink(Edge *userData)
+{
+    m_preprocessSinks.erase(userData);
+}
+
+bool RemoteExecutor::StartCommand(Edge *userData, const std::string &command, const std::string &preprocessOutput)
+{
+    auto sinkIt = m_preprocessSinks.find(userData);
+    if (sinkIt == m_preprocessSinks.end())
+        return false;
+
+    ByteArrayHolder inputData;
+    std::string err;
+    const bool compressed = sinkIt->second->Finish(inputData, err);
+    m_preprocessSinks.erase(sinkIt);
+    if (!compressed)
+    {
+        std::lock_guard<std::mutex> lock(m_resultsMutex);
+        m_results.emplace_back(Result(userData, false, preprocessOutput + err), TimePoint(true));
+        Wakeup();
+        return true;
+    }
+    return StartRemote(userData, command, &inputData, preprocessOutput);
+}
+
+bool RemoteExecutor::StartRemote(Edge *userData, const std::string &command, const ByteArrayHolder *inputData, const std::string &preprocessOutput)
+{
+    if (!m_remoteEnabled || !m_hasStart || (!m_agent && !StartRemoteService(true)))
         return false;
 
     const auto space = command.find(' ');
@@ -190,12 +324,13 @@ bool RemoteExecutor::StartCommand(Edge *userData, const std::string &command)
     invocation = m_invocationRewriter->CompleteInvocation(invocation);
 
     auto outputFilename = invocation.GetOutput();
-    auto callback = [this, userData, outputFilename]( const RemoteToolClient::TaskExecutionInfo & info)
+    auto callback = [this, userData, outputFilename, preprocessOutput]( const RemoteToolClient::TaskExecutionInfo & info)
     {
         bool result = info.m_result;
         Syslogger() << outputFilename<< " -> " << result << ", " <<  info.GetProfilingStr() ;
         std::lock_guard<std::mutex> lock(m_resultsMutex);
-        m_results.emplace_back(userData, result, info.m_stdOutput);
+        m_results.emplace_back(Result(userData, result, preprocessOutput + info.m_stdOutput), TimePoint(true));
+        Wakeup();
         if (m_hasStart)
         {
             auto it = m_activeEdges.find(userData);
@@ -203,8 +338,21 @@ bool RemoteExecutor::StartCommand(Edge *userData, const std::string &command)
                 m_activeEdges.erase(it);
         }
     };
-    m_activeEdges.insert(userData);
-    m_remoteService->InvokeTool(invocation, callback);
+    {
+        std::lock_guard<std::mutex> lock(m_resultsMutex);
+        SampleUtilization();
+        m_activeEdges.insert(userData);
+    }
+    if (m_agent)
+        m_agent->InvokeRemote(invocation, [callback](bool result, const std::string & stdOut){
+            RemoteToolClient::TaskExecutionInfo info(stdOut);
+            info.m_result = result;
+            callback(info);
+        });
+    else if (inputData)
+        m_remoteService->InvokeTool(invocation, *inputData, callback);
+    else
+        m_remoteService->InvokeTool(invocation, callback);
 
     return true;
 }
@@ -215,12 +363,24 @@ bool RemoteExecutor::WaitForCommand(IRemoteExecutor::Result *result)
         return false;
 
     std::lock_guard<std::mutex> lock(m_resultsMutex);
+    SampleUtilization();
     if (!m_results.empty())
     {
-        *result = std::move(m_results[0]);
+        // time while result waits for main loop is time remote slot is idle.
+        const TimePoint delay = m_results[0].second.GetElapsedTime();
+        m_totalReapDelay += delay;
+        m_maxReapDelay = std::max(m_maxReapDelay, delay);
+        m_reapedCount++;
+        *result = std::move(m_results[0].first);
         m_results.pop_front();
         return true;
     }
+#ifndef _WIN32
+    // everything reaped, so pending wakeups are stale.
+    char buffer[64];
+    if (m_wakeupPipe[0] >= 0)
+        while (read(m_wakeupPipe[0], buffer, sizeof(buffer)) > 0) {}
+#endif
     return false;
 }
 
@@ -230,9 +390,19 @@ void RemoteExecutor::Abort()
     {
         m_remoteService->FinishSession();
         Syslogger(Syslogger::Notice) <<  m_remoteService->GetSessionInformation();
+        if (m_reapedCount)
+            Syslogger(Syslogger::Notice) << "Remote results reaped after: avg=" << (m_totalReapDelay.GetUS() / m_reapedCount) / 1000.
+                                         << "ms, max=" << m_maxReapDelay.GetUS() / 1000. << "ms";
+        Syslogger(Syslogger::Notice) << GetUtilizationReport();
     }
+    if (m_hasStart && m_agent)
+        Syslogger(Syslogger::Notice) << GetUtilizationReport();
     m_hasStart = false;
+    m_toolVersions = {};
+    m_versionChecker.reset();
+    m_agent.reset();
     m_remoteService.reset();
+    m_preprocessSinks.clear();
 }
 
 std::set<Edge *> RemoteExecutor::GetActiveEdges()
@@ -240,6 +410,71 @@ std::set<Edge *> RemoteExecutor::GetActiveEdges()
     return m_activeEdges;
 }
 
+void RemoteExecutor::SampleUtilization()
+{
+    if (!m_hasStart || (!m_remoteService && !m_agent))
+        return;
+
+    const TimePoint now(true);
+    const int64_t busy = static_cast<int64_t>(m_activeEdges.size());
+    const int64_t total = busy + std::max(0, GetFreeRemoteThreads());
+    // split interval since previous sample by seconds of build.
+    TimePoint from = m_lastSample ? m_lastSample : now;
+    while (from < now)
+    {
+        const size_t second = static_cast<size_t>((from - m_buildStart).GetSeconds());
+        TimePoint to = m_buildStart + TimePoint(static_cast<int>(second + 1));
+        if (now < to)
+            to = now;
+        if (m_utilization.size() <= second)
+            m_utilization.resize(second + 1);
+        const double duration = (to - from).GetUS() / double(TimePoint::ONE_SECOND);
+        m_utilization[second].first  += busy * duration;
+        m_utilization[second].second += total * duration;
+        from = to;
+    }
+    m_lastSample = now;
+}
+
+std::string RemoteExecutor::GetUtilizationReport() const
+{
+    static const size_t s_maxColumns = 60;
+    const size_t step = std::max(size_t(1), (m_utilization.size() + s_maxColumns - 1) / s_maxColumns);
+    double busyTotal = 0, threadsTotal = 0;
+    std::string timeline;
+    for (size_t i = 0; i < m_utilization.size(); i += step)
+    {
+        double busy = 0, threads = 0;
+        for (size_t j = i; j < std::min(i + step, m_utilization.size()); ++j)
+        {
+            busy    += m_utilization[j].first;
+            threads += m_utilization[j].second;
+        }
+        busyTotal += busy;
+        threadsTotal += threads;
+        timeline += " " + std::to_string(threads > 0 ? static_cast<int>(100 * busy / threads) : 0);
+    }
+    return "Remote utilization: avg " + std::to_string(threadsTotal > 0 ? static_cast<int>(100 * busyTotal / threadsTotal) : 0)
+            + "%, per " + std::to_string(step) + "s:" + timeline;
+}
+
+void RemoteExecutor::Wakeup()
+{
+#ifndef _WIN32
+    // pipe may be full only if wakeup is already pending.
+    const char byte = 0;
+    if (m_wakeupPipe[1] >= 0 && write(m_wakeupPipe[1], &byte, 1) < 0) {}
+#endif
+}
+
 RemoteExecutor::~RemoteExecutor()
 {
+    m_toolVersions = {};
+    m_agent.reset();
+    m_remoteService.reset();
+#ifndef _WIN32
+    for (int fd : m_wakeupPipe)
+        if (fd >= 0)
+            close(fd);
+#endif
 }
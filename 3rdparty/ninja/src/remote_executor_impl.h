@@ -18,11 +18,14 @@
 
 #include <ConfiguredApplication.h>
 #include <RemoteToolClient.h>
+#include <ToolProxyClient.h>
 #include <InvocationRewriter.h>
 #include <ThreadUtils.h>
 #include <Syslogger.h>
 #include <LocalExecutor.h>
+#include <CompressingOutputSink.h>
 #include <VersionChecker.h>
+#include <TimePoint.h>
 #include <iostream>
 
 //#define TEST_CLIENT
@@ -36,6 +39,7 @@ class RemoteExecutor: public IRemoteExecutor
     Wuild::IInvocationRewriter::Ptr m_invocationRewriter;
     Wuild::RemoteToolClient::Config m_remoteToolConfig;
     std::shared_ptr<Wuild::RemoteToolClient> m_remoteService;
+    std::unique_ptr<Wuild::ToolProxyClient> m_agent; //!< used instead of m_remoteService if agent is running.
 
 #ifdef TEST_CLIENT
     Wuild::ILocalExecutor::Ptr m_localExecutor;
@@ -47,9 +51,33 @@ class RemoteExecutor: public IRemoteExecutor
     int m_minimalRemoteTasks = 0;
 
     std::set<Edge *> m_activeEdges;
-    std::deque<Result> m_results;
+    std::deque<std::pair<Result, Wuild::TimePoint>> m_results; //!< with time of arrival.
     mutable std::mutex m_resultsMutex;
 
+    int m_wakeupPipe[2] = {-1, -1};
+    Wuild::TimePoint m_totalReapDelay;
+    Wuild::TimePoint m_maxReapDelay;
+    int64_t m_reapedCount = 0;
+
+    /// Remote utilization samples: busy and total thread-seconds per second of build.
+    std::vector<std::pair<double, double>> m_utilization;
+    Wuild::TimePoint m_buildStart;
+    Wuild::TimePoint m_lastSample;
+
+    std::map<Edge *, std::unique_ptr<Wuild::CompressingOutputSink>> m_preprocessSinks;
+
+    Wuild::IVersionChecker::Ptr m_versionChecker;
+    std::shared_future<Wuild::IVersionChecker::VersionMap> m_toolVersions; //!< determined while build runs local commands.
+    std::vector<std::string> m_toolIds;
+
+    /// Called under m_resultsMutex.
+    void Wakeup();
+    /// Creates tool client when tool versions are known; with wait, waits for them.
+    bool StartRemoteService(bool wait);
+    bool StartRemote(Edge* userData, const std::string & command, const Wuild::ByteArrayHolder * inputData, const std::string & preprocessOutput);
+    void SampleUtilization();
+    std::string GetUtilizationReport() const;
+
 
 public:
 
@@ -66,16 +94,22 @@ public:
 
     bool CheckRemotePossibleForFlags(const std::string & toolId, const std::string & flags) const override;
     std::string GetPreprocessedPath(const std::string & sourcePath, const std::string & objectPath) const override;
+    bool IsPreprocessStreamed() const override;
     std::string FilterPreprocessorFlags(const std::string & toolId, const std::string & flags) const override;
 
     std::string FilterCompilerFlags(const std::string & toolId, const std::string & flags) const override;
     void RunIfNeeded(const std::vector<std::string> & toolIds, const std::shared_ptr<SubprocessSet> & subprocessSet) override;
-    void SleepSome() const  override;
+    int GetWakeupFd() const override;
+    void WaitForWakeup() const override;
     int GetMinimalRemoteTasks() const override;
 
     bool CanRunMore() override;
+    int GetFreeRemoteThreads() const override;
 
     bool StartCommand(Edge* userData, const std::string & command)  override;
+    SubprocessOutputSink* CreatePreprocessSink(Edge* userData) override;
+    void ReleasePreprocessSink(Edge* userData) override;
+    bool StartCommand(Edge* userData, const std::string & command, const std::string & preprocessOutput) override;
 
 
     /// return true if has finished result.
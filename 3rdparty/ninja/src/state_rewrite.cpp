@@ -25,6 +25,22 @@ struct RuleReplace
     RuleReplace(const Rule* pp_, const Rule* cc_, std::string id) : pp(pp_), cc(cc_), toolId(id) {}
 };
 
+// pp_command and cc_command share edge environment, so variables which differ between them are renamed.
+static void RenameVariables(EvalString::TokenList & tokens, const std::map<std::string, std::string> & renames)
+{
+    for (auto & token : tokens)
+    {
+        if (token.second != EvalString::SPECIAL)
+            continue;
+        auto it = renames.find(token.first);
+        if (it == renames.end())
+            continue;
+        token.first = it->second;
+        if (it->second.empty())
+            token.second = EvalString::RAW;
+    }
+}
+
 void RewriteStateRules(State *state, IRemoteExecutor * const remoteExecutor)
 {
     Wuild::Syslogger() << "RewriteStateRules";
@@ -45,6 +61,7 @@ void RewriteStateRules(State *state, IRemoteExecutor * const remoteExecutor)
     };
 
     static const std::vector<std::string> s_ignoredArgs {  "$DEFINES", "$INCLUDES", "$FLAGS" };
+    const bool streamed = remoteExecutor->IsPreprocessStreamed();
 
     const auto rules = state->bindings_.GetRules();// we must copy rules container; otherwise we stack in infinite loop.
     std::map<const Rule*,  RuleReplace> ruleReplacement;
@@ -66,7 +83,24 @@ void RewriteStateRules(State *state, IRemoteExecutor * const remoteExecutor)
         }
         std::vector<std::string> preprocessRule, compileRule;
         std::string toolId;
-        if (remoteExecutor->PreprocessCode(originalRule, s_ignoredArgs, toolId, preprocessRule, compileRule))
+        if (streamed && remoteExecutor->PreprocessCode(originalRule, s_ignoredArgs, toolId, preprocessRule, compileRule))
+        {
+            // one edge with original command for local fallback, and commands for both steps.
+            Rule* ruleRemote = rule->Clone(ruleName + "_REMOTE");
+            state->bindings_.AddRule(ruleRemote);
+            ruleRemote->toolId_ = toolId;
+            ruleReplacement[rule] = RuleReplace(ruleRemote, ruleRemote, toolId);
+
+            EvalString ppCommand, ccCommand;
+            stringVectorToBindings(preprocessRule, ppCommand.parsed_);
+            stringVectorToBindings(compileRule, ccCommand.parsed_);
+            RenameVariables(ppCommand.parsed_, { {"FLAGS", "PP_FLAGS"} });
+            RenameVariables(ccCommand.parsed_, { {"FLAGS", "CC_FLAGS"}, {"INCLUDES", "CC_INCLUDES"}, {"in", "PP_PATH"}, {"IN_ABS", "PP_PATH"},
+                                                 {"DEFINES", ""}, {"DEP_FILE", ""} });
+            ruleRemote->AddBinding("pp_command", ppCommand);
+            ruleRemote->AddBinding("cc_command", ccCommand);
+        }
+        else if (!streamed && remoteExecutor->PreprocessCode(originalRule, s_ignoredArgs, toolId, preprocessRule, compileRule))
         {
             Rule* rulePP = rule->Clone(ruleName + "_PP");
             state->bindings_.AddRule(rulePP);
@@ -123,10 +157,28 @@ void RewriteStateRules(State *state, IRemoteExecutor * const remoteExecutor)
             if (!isRemote)
                 continue;
 
+            if (streamed)
+            {
+                // preprocessed file is never written, its path is only name for remote compiler.
+                BindingEnv * env = in_egde->env_->Clone();
+                env->AddBinding("PP_PATH", ppPath);
+                const std::string flags = originalBindings.count("FLAGS") ? originalBindings["FLAGS"] : env->LookupVariable("FLAGS");
+                const std::string includes = originalBindings.count("INCLUDES") ? originalBindings["INCLUDES"] : env->LookupVariable("INCLUDES");
+                env->AddBinding("PP_FLAGS", remoteExecutor->FilterPreprocessorFlags(replacement.toolId, flags));
+                env->AddBinding("CC_FLAGS", remoteExecutor->FilterCompilerFlags(replacement.toolId, flags));
+                env->AddBinding("CC_INCLUDES", remoteExecutor->FilterCompilerFlags(replacement.toolId, includes));
+                in_egde->env_ = env;
+                in_egde->rule_ = replacement.pp;
+                in_egde->is_remote_ = true;
+                in_egde->stream_preprocess_ = true;
+                continue;
+            }
+
             Edge* edge_pp = state->AddEdge(replacement.pp);
             Edge* edge_cc = state->AddEdge(replacement.cc);
 			edge_cc->pp_egde_ = edge_pp;
 
+            edge_pp->is_preprocess_ = true;
             edge_cc->is_remote_ = true; // allow remote excution of compiler.
             edge_cc->use_temporary_inputs_ = true;  // clean preprocessed files on success.
 
@@ -29,19 +29,50 @@ extern char** environ;
 
 #include "util.h"
 
-Subprocess::Subprocess(bool use_console) : fd_(-1), pid_(-1),
+Subprocess::Subprocess(bool use_console) : fd_(-1), sink_fd_(-1), sink_(NULL),
+                                           pid_(-1), launcher_(NULL),
                                            use_console_(use_console) {
 }
 
 Subprocess::~Subprocess() {
   if (fd_ >= 0)
     close(fd_);
+  if (sink_fd_ >= 0)
+    close(sink_fd_);
   // Reap child if forgotten.
   if (pid_ != -1)
     Finish();
 }
 
-bool Subprocess::Start(SubprocessSet* set, const string& command, const vector<string> &) {
+bool Subprocess::Start(SubprocessSet* set, const string& command_line, const vector<string> & environment,
+                       const string& working_dir, SubprocessOutputSink* sink) {
+  // posix_spawn has no portable chdir action, so let the shell do it.
+  string command;
+  if (!working_dir.empty()) {
+    command = "cd ";
+    GetShellEscapedString(working_dir, &command);
+    command += " && ";
+  }
+  command += command_line;
+
+  // launcher provides only one pipe, so sink requires own spawn.
+  if (sink && use_console_)
+    return false;
+  if (set->launcher_ && !use_console_ && !sink) {
+    fd_ = set->launcher_->Launch(command, environment, &pid_);
+    if (fd_ < 0) {
+      pid_ = -1;
+      return false;
+    }
+#if !defined(USE_PPOLL)
+    if (fd_ >= static_cast<int>(FD_SETSIZE))
+      Fatal("pipe: %s", strerror(EMFILE));
+#endif  // !USE_PPOLL
+    SetCloseOnExec(fd_);
+    launcher_ = set->launcher_;
+    return true;
+  }
+
   int output_pipe[2];
   if (pipe(output_pipe) < 0)
     Fatal("pipe: %s", strerror(errno));
@@ -54,6 +85,19 @@ bool Subprocess::Start(SubprocessSet* set, const string& command, const vector<s
 #endif  // !USE_PPOLL
   SetCloseOnExec(fd_);
 
+  int sink_pipe[2] = { -1, -1 };
+  if (sink) {
+    if (pipe(sink_pipe) < 0)
+      Fatal("pipe: %s", strerror(errno));
+    sink_fd_ = sink_pipe[0];
+    sink_ = sink;
+#if !defined(USE_PPOLL)
+    if (sink_fd_ >= static_cast<int>(FD_SETSIZE))
+      Fatal("pipe: %s", strerror(EMFILE));
+#endif  // !USE_PPOLL
+    SetCloseOnExec(sink_fd_);
+  }
+
   posix_spawn_file_actions_t action;
   int err = posix_spawn_file_actions_init(&action);
   if (err != 0)
@@ -62,6 +106,11 @@ bool Subprocess::Start(SubprocessSet* set, const string& command, const vector<s
   err = posix_spawn_file_actions_addclose(&action, output_pipe[0]);
   if (err != 0)
     Fatal("posix_spawn_file_actions_addclose: %s", strerror(err));
+  if (sink) {
+    err = posix_spawn_file_actions_addclose(&action, sink_pipe[0]);
+    if (err != 0)
+      Fatal("posix_spawn_file_actions_addclose: %s", strerror(err));
+  }
 
   posix_spawnattr_t attr;
   err = posix_spawnattr_init(&attr);
@@ -90,7 +139,7 @@ bool Subprocess::Start(SubprocessSet* set, const string& command, const vector<s
       Fatal("posix_spawn_file_actions_addopen: %s", strerror(err));
     }
 
-    err = posix_spawn_file_actions_adddup2(&action, output_pipe[1], 1);
+    err = posix_spawn_file_actions_adddup2(&action, sink ? sink_pipe[1] : output_pipe[1], 1);
     if (err != 0)
       Fatal("posix_spawn_file_actions_adddup2: %s", strerror(err));
     err = posix_spawn_file_actions_adddup2(&action, output_pipe[1], 2);
@@ -99,6 +148,11 @@ bool Subprocess::Start(SubprocessSet* set, const string& command, const vector<s
     err = posix_spawn_file_actions_addclose(&action, output_pipe[1]);
     if (err != 0)
       Fatal("posix_spawn_file_actions_addclose: %s", strerror(err));
+    if (sink) {
+      err = posix_spawn_file_actions_addclose(&action, sink_pipe[1]);
+      if (err != 0)
+        Fatal("posix_spawn_file_actions_addclose: %s", strerror(err));
+    }
     // In the console case, output_pipe is still inherited by the child and
     // closed when the subprocess finishes, which then notifies ninja.
   }
@@ -124,6 +178,8 @@ bool Subprocess::Start(SubprocessSet* set, const string& command, const vector<s
     Fatal("posix_spawn_file_actions_destroy: %s", strerror(err));
 
   close(output_pipe[1]);
+  if (sink)
+    close(sink_pipe[1]);
   return true;
 }
 
@@ -140,10 +196,25 @@ void Subprocess::OnPipeReady() {
   }
 }
 
+void Subprocess::OnSinkPipeReady() {
+  char buf[64 << 10];
+  ssize_t len = read(sink_fd_, buf, sizeof(buf));
+  if (len > 0) {
+    sink_->Append(buf, len);
+  } else {
+    if (len < 0)
+      Fatal("read: %s", strerror(errno));
+    close(sink_fd_);
+    sink_fd_ = -1;
+  }
+}
+
 ExitStatus Subprocess::Finish() {
   assert(pid_ != -1);
   int status;
-  if (waitpid(pid_, &status, 0) < 0)
+  if (launcher_)
+    status = launcher_->Wait(pid_);
+  else if (waitpid(pid_, &status, 0) < 0)
     Fatal("waitpid(%d): %s", pid_, strerror(errno));
   pid_ = -1;
 
@@ -160,7 +231,7 @@ ExitStatus Subprocess::Finish() {
 }
 
 bool Subprocess::Done() const {
-  return fd_ == -1;
+  return fd_ == -1 && sink_fd_ == -1;
 }
 
 const string& Subprocess::GetOutput() const {
@@ -189,7 +260,8 @@ void SubprocessSet::HandlePendingInterruption() {
 }
 
 SubprocessSet::SubprocessSet(bool setupSignalHandlers)
-    : setupSignalHandlers_(setupSignalHandlers) {
+    : wakeup_fd_(-1), woken_(false), launcher_(NULL),
+      setupSignalHandlers_(setupSignalHandlers) {
     if (!setupSignalHandlers_)
         return;
 
@@ -227,9 +299,10 @@ SubprocessSet::~SubprocessSet() {
     Fatal("sigprocmask: %s", strerror(errno));
 }
 
-Subprocess *SubprocessSet::Add(const string& command, bool use_console, const vector<string> & environment) {
+Subprocess *SubprocessSet::Add(const string& command, bool use_console, const vector<string> & environment,
+                               const string& working_dir, SubprocessOutputSink* sink) {
   Subprocess *subprocess = new Subprocess(use_console);
-  if (!subprocess->Start(this, command, environment)) {
+  if (!subprocess->Start(this, command, environment, working_dir, sink)) {
     delete subprocess;
     return 0;
   }
@@ -244,14 +317,22 @@ bool SubprocessSet::DoWork() {
 
   for (vector<Subprocess*>::iterator i = running_.begin();
        i != running_.end(); ++i) {
-    int fd = (*i)->fd_;
-    if (fd < 0)
-      continue;
-    pollfd pfd = { fd, POLLIN | POLLPRI, 0 };
+    int fds_of_subproc[2] = { (*i)->fd_, (*i)->sink_fd_ };
+    for (int fd : fds_of_subproc) {
+      if (fd < 0)
+        continue;
+      pollfd pfd = { fd, POLLIN | POLLPRI, 0 };
+      fds.push_back(pfd);
+      ++nfds;
+    }
+  }
+  if (wakeup_fd_ >= 0) {
+    pollfd pfd = { wakeup_fd_, POLLIN, 0 };
     fds.push_back(pfd);
     ++nfds;
   }
 
+  woken_ = false;
   interrupted_ = 0;
   int ret = ppoll(&fds.front(), nfds, NULL, &old_mask_);
   if (ret == -1) {
@@ -266,21 +347,34 @@ bool SubprocessSet::DoWork() {
   if (IsInterrupted())
     return true;
 
+  if (wakeup_fd_ >= 0 && fds.back().revents)
+    woken_ = true;
+
   nfds_t cur_nfd = 0;
   for (vector<Subprocess*>::iterator i = running_.begin();
        i != running_.end(); ) {
+    bool ready = false;
     int fd = (*i)->fd_;
-    if (fd < 0)
-      continue;
-    assert(fd == fds[cur_nfd].fd);
-    if (fds[cur_nfd++].revents) {
-      (*i)->OnPipeReady();
-      if ((*i)->Done()) {
-        finished_.push(*i);
-        i = running_.erase(i);
-        continue;
+    int sink_fd = (*i)->sink_fd_;
+    if (fd >= 0) {
+      assert(fd == fds[cur_nfd].fd);
+      if (fds[cur_nfd++].revents) {
+        (*i)->OnPipeReady();
+        ready = true;
       }
     }
+    if (sink_fd >= 0) {
+      assert(sink_fd == fds[cur_nfd].fd);
+      if (fds[cur_nfd++].revents) {
+        (*i)->OnSinkPipeReady();
+        ready = true;
+      }
+    }
+    if (ready && (*i)->Done()) {
+      finished_.push(*i);
+      i = running_.erase(i);
+      continue;
+    }
     ++i;
   }
 
@@ -295,14 +389,22 @@ bool SubprocessSet::DoWork() {
 
   for (vector<Subprocess*>::iterator i = running_.begin();
        i != running_.end(); ++i) {
-    int fd = (*i)->fd_;
-    if (fd >= 0) {
-      FD_SET(fd, &set);
-      if (nfds < fd+1)
-        nfds = fd+1;
+    int fds_of_subproc[2] = { (*i)->fd_, (*i)->sink_fd_ };
+    for (int fd : fds_of_subproc) {
+      if (fd >= 0) {
+        FD_SET(fd, &set);
+        if (nfds < fd+1)
+          nfds = fd+1;
+      }
     }
   }
+  if (wakeup_fd_ >= 0) {
+    FD_SET(wakeup_fd_, &set);
+    if (nfds < wakeup_fd_+1)
+      nfds = wakeup_fd_+1;
+  }
 
+  woken_ = false;
   interrupted_ = 0;
   int ret = pselect(nfds, &set, 0, 0, 0, &old_mask_);
   if (ret == -1) {
@@ -317,16 +419,26 @@ bool SubprocessSet::DoWork() {
   if (IsInterrupted())
     return true;
 
+  if (wakeup_fd_ >= 0 && FD_ISSET(wakeup_fd_, &set))
+    woken_ = true;
+
   for (vector<Subprocess*>::iterator i = running_.begin();
        i != running_.end(); ) {
+    bool ready = false;
     int fd = (*i)->fd_;
     if (fd >= 0 && FD_ISSET(fd, &set)) {
       (*i)->OnPipeReady();
-      if ((*i)->Done()) {
-        finished_.push(*i);
-        i = running_.erase(i);
-        continue;
-      }
+      ready = true;
+    }
+    int sink_fd = (*i)->sink_fd_;
+    if (sink_fd >= 0 && FD_ISSET(sink_fd, &set)) {
+      (*i)->OnSinkPipeReady();
+      ready = true;
+    }
+    if (ready && (*i)->Done()) {
+      finished_.push(*i);
+      i = running_.erase(i);
+      continue;
     }
     ++i;
   }
@@ -72,7 +72,10 @@ HANDLE Subprocess::SetupPipe(HANDLE ioport) {
   return output_write_child;
 }
 
-bool Subprocess::Start(SubprocessSet* set, const string& command, const vector<string> & environment) {
+bool Subprocess::Start(SubprocessSet* set, const string& command, const vector<string> & environment,
+                       const string& working_dir, SubprocessOutputSink* sink) {
+  if (sink) // separate stdout is not implemented.
+    return false;
   HANDLE child_pipe = SetupPipe(set->ioport_);
 
   SECURITY_ATTRIBUTES security_attributes;
@@ -119,7 +122,7 @@ bool Subprocess::Start(SubprocessSet* set, const string& command, const vector<s
   // lines greater than 8,191 chars.
   if (!CreateProcessA(NULL, (char*)command.c_str(), NULL, NULL,
                       /* inherit handles */ TRUE, process_flags,
-					  lpEnvironment, NULL,
+					  lpEnvironment, working_dir.empty() ? NULL : working_dir.c_str(),
                       &startup_info, &process_info)) {
     DWORD error = GetLastError();
     if (error == ERROR_FILE_NOT_FOUND) {
@@ -214,7 +217,7 @@ const string& Subprocess::GetOutput() const {
 HANDLE SubprocessSet::ioport_;
 
 SubprocessSet::SubprocessSet(bool setupSignalHandlers)
-    : setupSignalHandlers_(setupSignalHandlers) {
+    : wakeup_fd_(-1), woken_(false), setupSignalHandlers_(setupSignalHandlers) {
   ioport_ = ::CreateIoCompletionPort(INVALID_HANDLE_VALUE, NULL, 0, 1);
   if (!ioport_)
     Win32Fatal("CreateIoCompletionPort");
@@ -242,9 +245,10 @@ BOOL WINAPI SubprocessSet::NotifyInterrupted(DWORD dwCtrlType) {
   return FALSE;
 }
 
-Subprocess *SubprocessSet::Add(const string& command, bool use_console, const vector<string> & environment) {
+Subprocess *SubprocessSet::Add(const string& command, bool use_console, const vector<string> & environment,
+                               const string& working_dir, SubprocessOutputSink* sink) {
   Subprocess *subprocess = new Subprocess(use_console);
-  if (!subprocess->Start(this, command, environment)) {
+  if (!subprocess->Start(this, command, environment, working_dir, sink)) {
     delete subprocess;
     return 0;
   }
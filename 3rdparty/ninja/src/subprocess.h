@@ -36,6 +36,27 @@ using namespace std;
 
 #include "exit_status.h"
 
+#ifndef _WIN32
+/// Launches processes on behalf of SubprocessSet, e.g. from a small helper
+/// process, so the (possibly large) caller process never forks itself.
+struct SubprocessLauncher {
+  virtual ~SubprocessLauncher() {}
+  /// Starts |command| with stdout/stderr redirected to a pipe; returns read
+  /// end of that pipe and child pid in |pid|, or -1 on failure.
+  virtual int Launch(const string& command, const vector<string>& environment,
+                     pid_t* pid) = 0;
+  /// Blocks until child |pid| exits and returns its waitpid() status.
+  virtual int Wait(pid_t pid) = 0;
+};
+#endif
+
+/// Receives stdout of subprocess as it is produced, e.g. to compress it
+/// without temporary file. Only supported on POSIX.
+struct SubprocessOutputSink {
+  virtual ~SubprocessOutputSink() {}
+  virtual void Append(const char* data, size_t size) = 0;
+};
+
 /// Subprocess wraps a single async subprocess.  It is entirely
 /// passive: it expects the caller to notify it when its fds are ready
 /// for reading, as well as call Finish() to reap the child once done()
@@ -53,8 +74,12 @@ struct Subprocess {
 
  private:
   Subprocess(bool use_console);
-  bool Start(struct SubprocessSet* set, const string& command, const vector<string> & environment = {});
+  bool Start(struct SubprocessSet* set, const string& command, const vector<string> & environment = {},
+             const string& working_dir = string(), SubprocessOutputSink* sink = NULL);
   void OnPipeReady();
+#ifndef _WIN32
+  void OnSinkPipeReady();
+#endif
 
   string buf_;
 
@@ -70,7 +95,10 @@ struct Subprocess {
   bool is_reading_;
 #else
   int fd_;
+  int sink_fd_;  ///< stdout pipe when sink_ is set; then fd_ gets only stderr.
+  SubprocessOutputSink* sink_;
   pid_t pid_;
+  SubprocessLauncher* launcher_;
 #endif
   bool use_console_;
 
@@ -84,13 +112,25 @@ struct SubprocessSet {
   SubprocessSet(bool setupSignalHandlers = true);
   ~SubprocessSet();
 
-  Subprocess* Add(const string& command, bool use_console = false, const vector<string> & environment = {});
+  /// If |working_dir| is not empty, command is started in that directory.
+  /// If |sink| is set, stdout is passed to it and GetOutput() has only stderr.
+  Subprocess* Add(const string& command, bool use_console = false, const vector<string> & environment = {},
+                  const string& working_dir = string(), SubprocessOutputSink* sink = NULL);
   bool DoWork();
   Subprocess* NextFinished();
   void Clear();
 
+  /// Additional fd which makes DoWork() return when it becomes readable
+  /// (e.g. remote command finished); owner of fd is responsible for draining it.
+  /// Only supported on POSIX; -1 if not used.
+  void SetWakeupFd(int fd) { wakeup_fd_ = fd; }
+  /// True if last DoWork() returned because of wakeup fd.
+  bool IsWoken() const { return woken_; }
+
   vector<Subprocess*> running_;
   queue<Subprocess*> finished_;
+  int wakeup_fd_;
+  bool woken_;
 
 #ifdef _WIN32
   static BOOL WINAPI NotifyInterrupted(DWORD dwCtrlType);
@@ -104,6 +144,10 @@ struct SubprocessSet {
 
   static bool IsInterrupted() { return interrupted_ != 0; }
 
+  /// Use external launcher for non-console subprocesses (not owned).
+  void SetLauncher(SubprocessLauncher* launcher) { launcher_ = launcher; }
+  SubprocessLauncher* launcher_;
+
   struct sigaction old_int_act_;
   struct sigaction old_term_act_;
   struct sigaction old_hup_act_;
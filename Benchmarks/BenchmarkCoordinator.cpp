@@ -0,0 +1,205 @@
+/*
+ * Copyright (C) 2018 Smirnov Vladimir mapron1@gmail.com
+ * Source code licensed under the Apache License, Version 2.0 (the "License");
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at http://www.apache.org/licenses/LICENSE-2.0 or in file COPYING-APACHE-2.0.txt
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.h
+ */
+#include "BenchmarkUtils.h"
+
+#include <CoordinatorClient.h>
+#include <CoordinatorFrames.h>
+#include <CoordinatorServer.h>
+
+#include <random>
+#include <thread>
+
+namespace
+{
+const int s_coordinatorPort = 12450;
+const uint16_t s_toolServerThreads = 8;
+
+size_t GetFrameSize(const Wuild::SocketFrame & frame)
+{
+	Wuild::ByteOrderBuffer buf;
+	Wuild::ByteOrderDataStreamWriter writer(buf);
+	frame.Write(writer);
+	return buf.GetSize();
+}
+
+/// Peer which only listens coordinator broadcasts, like tool client.
+struct Listener
+{
+	Wuild::SocketFrameHandler::Ptr m_handler;
+	Wuild::CoordinatorInfo m_info;
+	uint64_t m_sequence = 0;
+	size_t m_bytes = 0;
+	size_t m_fullListBytes = 0;
+	int m_snapshots = 0;
+	int m_deltas = 0;
+	int m_resyncs = 0;
+	std::mutex m_mutex;
+};
+}
+
+/// Coordinator load simulator: starts coordinator, tool servers with changing load and listening peers.
+/// Measures bytes per second each peer receives, and how much it would be if every change was sent as full list.
+/// Arguments: [toolServers=40] [listeners=10] [seconds=5] [broadcastIntervalMS=200]
+int main(int argc, char** argv)
+{
+	using namespace Wuild;
+	ConfiguredApplication app(argc, argv, "BenchmarkCoordinator");
+	auto args = app.GetRemainArgs();
+	const int toolServerCount = args.size() > 0 ? std::stoi(args[0]) : 40;
+	const int listenerCount   = args.size() > 1 ? std::stoi(args[1]) : 10;
+	const int seconds         = args.size() > 2 ? std::stoi(args[2]) : 5;
+	const int broadcastMS     = args.size() > 3 ? std::stoi(args[3]) : 200;
+
+	CoordinatorServer::Config serverConfig;
+	serverConfig.m_listenPort = s_coordinatorPort;
+	serverConfig.m_broadcastInterval = TimePoint(broadcastMS / 1000.);
+	CoordinatorServer server;
+	if (!server.SetConfig(serverConfig))
+		return 1;
+	server.Start();
+
+	CoordinatorClient::Config clientConfig;
+	clientConfig.m_coordinatorHost = StringVector{"localhost"};
+	clientConfig.m_coordinatorPort = s_coordinatorPort;
+	clientConfig.m_sendInfoInterval = TimePoint(0.1);
+
+	std::vector<std::unique_ptr<CoordinatorClient>> toolServers;
+	std::vector<ToolServerInfo> toolServerInfos;
+	for (int i = 0; i < toolServerCount; ++i)
+	{
+		ToolServerInfo info;
+		info.m_toolServerId   = "server" + std::to_string(i);
+		info.m_connectionHost = "host" + std::to_string(i);
+		info.m_connectionPort = 7765;
+		info.m_toolIds        = StringVector{"gcc_cpp", "gcc_c", "clang_cpp", "clang_c"};
+		info.m_totalThreads   = s_toolServerThreads;
+		info.m_connectedClients.resize(2);
+		for (size_t c = 0; c < info.m_connectedClients.size(); ++c)
+		{
+			info.m_connectedClients[c].m_clientId = "client" + std::to_string(c);
+			info.m_connectedClients[c].m_sessionId = c + 1;
+		}
+		toolServers.emplace_back(new CoordinatorClient());
+		if (!toolServers.back()->SetConfig(clientConfig))
+			return 1;
+		toolServers.back()->SetToolServerInfo(info);
+		toolServers.back()->Start();
+		toolServerInfos.push_back(info);
+	}
+
+	SocketFrameHandlerSettings settings;
+	settings.m_channelProtocolVersion   = CoordinatorListRequest::s_version
+										+ CoordinatorListResponse::s_version
+										+ CoordinatorToolServerStatus::s_version
+										+ CoordinatorToolServerSession::s_version
+										+ CoordinatorListDelta::s_version
+										+ CoordinatorLeaseRequest::s_version
+										+ CoordinatorLeaseResponse::s_version
+										+ CoordinatorToolServerHealth::s_version
+										+ CoordinatorSiteStatus::s_version
+										;
+	std::vector<std::unique_ptr<Listener>> listeners;
+	for (int i = 0; i < listenerCount; ++i)
+	{
+		listeners.emplace_back(new Listener());
+		Listener * listener = listeners.back().get();
+		listener->m_handler.reset(new SocketFrameHandler(settings));
+		listener->m_handler->RegisterFrameReader(SocketFrameReaderTemplate<CoordinatorListResponse>::Create([listener](const CoordinatorListResponse& inputMessage, SocketFrameHandler::OutputCallback){
+			std::lock_guard<std::mutex> lock(listener->m_mutex);
+			const size_t size = GetFrameSize(inputMessage);
+			listener->m_bytes += size;
+			listener->m_fullListBytes += size;
+			listener->m_snapshots++;
+			listener->m_sequence = inputMessage.m_sequence;
+			listener->m_info = inputMessage.m_info;
+		}));
+		listener->m_handler->RegisterFrameReader(SocketFrameReaderTemplate<CoordinatorListDelta>::Create([listener](const CoordinatorListDelta& inputMessage, SocketFrameHandler::OutputCallback outputCallback){
+			std::lock_guard<std::mutex> lock(listener->m_mutex);
+			listener->m_bytes += GetFrameSize(inputMessage);
+			listener->m_deltas++;
+			if (inputMessage.m_sequence <= listener->m_sequence)
+				return;
+			if (inputMessage.m_baseSequence != listener->m_sequence)
+			{
+				listener->m_resyncs++;
+				outputCallback(std::make_shared<CoordinatorListRequest>());
+				return;
+			}
+			listener->m_sequence = inputMessage.m_sequence;
+			listener->m_info.Update(inputMessage.m_changedToolServers);
+			for (const auto & removed : inputMessage.m_removedToolServers)
+				listener->m_info.Remove(removed);
+
+			// previous protocol sent full list to everyone for each status change.
+			CoordinatorListResponse fullList;
+			fullList.m_info = listener->m_info;
+			listener->m_fullListBytes += GetFrameSize(fullList) * inputMessage.m_changedToolServers.size();
+		}));
+		listener->m_handler->SetTcpChannel("localhost", s_coordinatorPort);
+		listener->m_handler->Start();
+	}
+
+	// let everyone connect and receive initial snapshot, it is not counted.
+	std::this_thread::sleep_for(std::chrono::seconds(1));
+	for (auto & listener : listeners)
+	{
+		std::lock_guard<std::mutex> lock(listener->m_mutex);
+		listener->m_bytes = listener->m_fullListBytes = 0;
+		listener->m_snapshots = listener->m_deltas = listener->m_resyncs = 0;
+	}
+
+	std::mt19937 random(1);
+	int statusChanges = 0;
+	TimePoint start(true);
+	while (start.GetElapsedTime() < TimePoint(double(seconds)))
+	{
+		std::this_thread::sleep_for(std::chrono::milliseconds(20));
+		for (int i = 0; i < toolServerCount; ++i)
+		{
+			if (random() % 4)
+				continue;
+			ToolServerInfo & info = toolServerInfos[i];
+			for (auto & client : info.m_connectedClients)
+				client.m_usedThreads = random() % (s_toolServerThreads / 2 + 1);
+			toolServers[i]->SetToolServerInfo(info);
+			statusChanges++;
+		}
+	}
+	const auto elapsed = start.GetElapsedTime();
+
+	size_t bytes = 0, fullListBytes = 0;
+	int snapshots = 0, deltas = 0, resyncs = 0;
+	for (auto & listener : listeners)
+	{
+		std::lock_guard<std::mutex> lock(listener->m_mutex);
+		bytes += listener->m_bytes;
+		fullListBytes += listener->m_fullListBytes;
+		snapshots += listener->m_snapshots;
+		deltas += listener->m_deltas;
+		resyncs += listener->m_resyncs;
+	}
+	for (auto & listener : listeners)
+		listener->m_handler->Stop();
+
+	const int64_t perPeerBytesPerSec = bytes * TimePoint::ONE_SECOND / std::max(int64_t(1), elapsed.GetUS()) / std::max(1, listenerCount);
+	const int64_t perPeerFullPerSec  = fullListBytes * TimePoint::ONE_SECOND / std::max(int64_t(1), elapsed.GetUS()) / std::max(1, listenerCount);
+	const int peers = toolServerCount + listenerCount;
+	Syslogger(Syslogger::Notice) << "toolServers=" << toolServerCount << " listeners=" << listenerCount
+								 << " broadcastInterval=" << broadcastMS << "ms"
+								 << " status changes/sec=" << (statusChanges * TimePoint::ONE_SECOND / std::max(int64_t(1), elapsed.GetUS()))
+								 << " deltas=" << deltas << " snapshots=" << snapshots << " resyncs=" << resyncs;
+	Syslogger(Syslogger::Notice) << "per peer: incremental=" << perPeerBytesPerSec / 1024 << " KiB/sec"
+								 << ", full list on every change=" << perPeerFullPerSec / 1024 << " KiB/sec;"
+								 << " coordinator output for " << peers << " peers=" << perPeerBytesPerSec * peers / 1024 << " KiB/sec";
+	return 0;
+}
@@ -0,0 +1,79 @@
+/*
+ * Copyright (C) 2018 Smirnov Vladimir mapron1@gmail.com
+ * Source code licensed under the Apache License, Version 2.0 (the "License");
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at http://www.apache.org/licenses/LICENSE-2.0 or in file COPYING-APACHE-2.0.txt
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.h
+ */
+#include "BenchmarkUtils.h"
+
+#include <LocalExecutor.h>
+
+#include <thread>
+
+/// Measures how many trivial translation units per second LocalExecutor can compile,
+/// including input write, output read and compression - same as tool server does.
+int main(int argc, char** argv)
+{
+	using namespace Wuild;
+	ConfiguredApplication app(argc, argv, "BenchmarkLocalExecutor");
+	auto args = app.GetRemainArgs();
+	const int taskCount = args.size() > 0 ? std::stoi(args[0]) : 200;
+	const int threadCount = args.size() > 1 ? std::stoi(args[1]) : std::max(1u, std::thread::hardware_concurrency());
+	const std::string compiler = args.size() > 2 ? args[2] : "g++";
+
+	IInvocationRewriter::Config config;
+	config.m_toolIds = {"cpp"};
+	config.m_tools.resize(1);
+	config.m_tools[0].m_id = "cpp";
+	config.m_tools[0].m_names = {compiler};
+	auto rewriter = InvocationRewriter::Create(config);
+
+	auto executor = LocalExecutor::Create(rewriter, app.m_tempDir);
+	executor->SetThreadCount(threadCount);
+
+	const std::string source = "int func(int a) { return a * 2; }\n";
+	ByteArrayHolder sourceData;
+	sourceData.ref().assign(source.cbegin(), source.cend());
+	CompressionInfo compression;
+	compression.m_type = CompressionType::LZ4;
+	ByteArrayHolder compressedSource;
+	CompressDataBuffer(sourceData, compressedSource, compression);
+
+	std::mutex finishedMutex;
+	std::condition_variable finishedCond;
+	int finished = 0, failed = 0;
+
+	TimePoint start(true);
+	for (int i = 0; i < taskCount; ++i)
+	{
+		LocalExecutorTask::Ptr task(new LocalExecutorTask());
+		task->m_invocation = ToolInvocation(StringVector{"-c", "bench.cpp", "-o", "bench.o"}).SetId("cpp");
+		task->m_inputData = compressedSource;
+		task->m_compressionInput = task->m_compressionOutput = compression;
+		task->m_callback = [&](LocalExecutorResult::Ptr result) {
+			std::lock_guard<std::mutex> lock(finishedMutex);
+			finished++;
+			if (!result->m_result)
+				failed++;
+			finishedCond.notify_one();
+		};
+		executor->AddTask(task);
+	}
+	{
+		std::unique_lock<std::mutex> lock(finishedMutex);
+		finishedCond.wait(lock, [&]{ return finished == taskCount; });
+	}
+	const auto elapsed = start.GetElapsedTime();
+	Syslogger(Syslogger::Notice) << "tasks=" << taskCount << " threads=" << threadCount
+								 << " failed=" << failed
+								 << " taken=" << elapsed.ToProfilingTime()
+								 << " compiles/sec=" << (taskCount * TimePoint::ONE_SECOND / std::max(int64_t(1), elapsed.GetUS()));
+
+	return failed ? 1 : 0;
+}
@@ -0,0 +1,175 @@
+/*
+ * Copyright (C) 2018 Smirnov Vladimir mapron1@gmail.com
+ * Source code licensed under the Apache License, Version 2.0 (the "License");
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at http://www.apache.org/licenses/LICENSE-2.0 or in file COPYING-APACHE-2.0.txt
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.h
+ */
+#include "BenchmarkUtils.h"
+
+#include <manifest_parser.h>
+#include <state.h>
+#include <graph.h>
+#include <state_rewrite.h>
+#include <remote_executor.h>
+
+#include <sstream>
+
+const int g_rules = 100000;
+
+/// Rewriting part of WuildNinja remote executor, without tool client.
+class RewriteExecutor : public IRemoteExecutor
+{
+	Wuild::IInvocationRewriter::Ptr m_invocationRewriter;
+	bool m_streamed;
+
+public:
+	RewriteExecutor(Wuild::IInvocationRewriter::Ptr invocationRewriter, bool streamed)
+		: m_invocationRewriter(std::move(invocationRewriter)), m_streamed(streamed) {}
+
+	bool PreprocessCode(const std::vector<std::string> & originalRule, const std::vector<std::string> & ignoredArgs, std::string & toolId,
+						std::vector<std::string> & preprocessRule, std::vector<std::string> & compileRule) const override
+	{
+		std::vector<std::string> args = originalRule;
+		std::string srcExecutable = Wuild::StringUtils::Trim(args[0]);
+		args.erase(args.begin());
+		auto space = srcExecutable.find(' ');
+		if (space != std::string::npos)
+		{
+			args.insert(args.begin(), srcExecutable.substr(space + 1));
+			srcExecutable = srcExecutable.substr(0, space);
+		}
+		Wuild::ToolInvocation original, pp, cc;
+		original.m_id.m_toolExecutable = srcExecutable;
+		original.m_args = args;
+		original.m_ignoredArgs = ignoredArgs;
+		if (!m_invocationRewriter->SplitInvocation(original, pp, cc, &toolId))
+			return false;
+		if (m_streamed)
+			pp.SetOutput("-");
+		preprocessRule.push_back(srcExecutable + "  ");
+		preprocessRule.insert(preprocessRule.end(), pp.m_args.begin(), pp.m_args.end());
+		compileRule.push_back(srcExecutable + "  ");
+		compileRule.insert(compileRule.end(), cc.m_args.begin(), cc.m_args.end());
+		return true;
+	}
+	std::string GetPreprocessedPath(const std::string & sourcePath, const std::string & objectPath) const override
+	{
+		return m_invocationRewriter->GetPreprocessedPath(sourcePath, objectPath);
+	}
+	bool IsPreprocessStreamed() const override { return m_streamed; }
+	bool CheckRemotePossibleForFlags(const std::string & toolId, const std::string & flags) const override
+	{
+		return m_invocationRewriter->CheckRemotePossibleForFlags(Wuild::ToolInvocation(flags, Wuild::ToolInvocation::InvokeType::Preprocess).SetId(toolId));
+	}
+	std::string FilterPreprocessorFlags(const std::string & toolId, const std::string & flags) const override
+	{
+		return m_invocationRewriter->FilterFlags(Wuild::ToolInvocation(flags, Wuild::ToolInvocation::InvokeType::Preprocess).SetId(toolId)).GetArgsString(false);
+	}
+	std::string FilterCompilerFlags(const std::string & toolId, const std::string & flags) const override
+	{
+		return m_invocationRewriter->FilterFlags(Wuild::ToolInvocation(flags, Wuild::ToolInvocation::InvokeType::Compile).SetId(toolId)).GetArgsString(false);
+	}
+
+	void RunIfNeeded(const std::vector<std::string> &, const std::shared_ptr<SubprocessSet> &) override {}
+	int GetMinimalRemoteTasks() const override { return 0; }
+	int GetWakeupFd() const override { return -1; }
+	void WaitForWakeup() const override {}
+	bool CanRunMore() override { return false; }
+	int GetFreeRemoteThreads() const override { return 0; }
+	bool StartCommand(Edge*, const std::string &) override { return false; }
+	SubprocessOutputSink* CreatePreprocessSink(Edge*) override { return nullptr; }
+	void ReleasePreprocessSink(Edge*) override {}
+	bool StartCommand(Edge*, const std::string &, const std::string &) override { return false; }
+	bool WaitForCommand(Result*) override { return false; }
+	void Abort() override {}
+	std::set<Edge*> GetActiveEdges() override { return {}; }
+};
+
+/// Manifest like CMake generates, with rule per target; half of rules use compiler from PATH.
+std::string GenerateManifest(int rules)
+{
+	std::ostringstream os;
+	for (int i = 0; i < rules; ++i)
+	{
+		os << "rule CXX_COMPILER__t" << i << "\n"
+		   << "  command = " << (i % 2 ? "g++" : Wuild::FileInfo::LocatePath("g++")) << " $DEFINES $INCLUDES $FLAGS -MD -MT $out -MF $DEP_FILE -o $out -c $in\n"
+		   << "  description = Building CXX object $out\n"
+		   << "  depfile = $DEP_FILE\n"
+		   << "  deps = gcc\n"
+		   << "build obj/t" << i << "/f.cpp.o: CXX_COMPILER__t" << i << " src/t" << i << "/f.cpp\n"
+		   << "  DEFINES = -DTARGET_" << (i % 100) << " -DNDEBUG\n"
+		   << "  INCLUDES = -Iinclude -Isrc/t" << (i % 100) << "\n"
+		   << "  FLAGS = -O2 -g -std=c++14 -fPIC\n"
+		   << "  DEP_FILE = obj/t" << i << "/f.cpp.o.d\n";
+	}
+	return os.str();
+}
+
+/// Measures WuildNinja manifest load on huge graph: parsing, rewriting rules to preprocess and compile steps,
+/// and normalizing remote commands as they are started. Arguments not required.
+int main(int argc, char** argv)
+{
+	using namespace Wuild;
+	ConfiguredApplication app(argc, argv, "BenchmarkManifestRewrite");
+
+	IInvocationRewriter::Config config;
+	IInvocationRewriter::Config::Tool tool;
+	tool.m_id = "gcc_cpp";
+	tool.m_names = {FileInfo::LocatePath("g++")};
+	config.m_tools = {tool};
+	config.m_toolIds = {tool.m_id};
+
+	TimePoint start(true);
+	const std::string manifest = GenerateManifest(g_rules);
+	Syslogger(Syslogger::Notice) << "generated " << g_rules << " rules, " << manifest.size() / 1024 << " KiB in " << start.GetElapsedTime().ToProfilingTime();
+
+	for (bool streamed : {false, true})
+	{
+		auto invocationRewriter = InvocationRewriter::Create(config);
+		RewriteExecutor executor(invocationRewriter, streamed);
+		::State state;
+		ManifestParser parser(&state, nullptr);
+		std::string err;
+		start = TimePoint(true);
+		if (!parser.ParseTest(manifest, &err))
+		{
+			Syslogger(Syslogger::Err) << err;
+			return 1;
+		}
+		const TimePoint parseTime = start.GetElapsedTime();
+
+		start = TimePoint(true);
+		RewriteStateRules(&state, &executor);
+		const TimePoint rewriteTime = start.GetElapsedTime();
+
+		// each remote edge command is normalized once more when it is started.
+		start = TimePoint(true);
+		size_t remoteEdges = 0;
+		for (Edge * edge : state.edges_)
+		{
+			if (!edge->is_remote_)
+				continue;
+			const std::string command = edge->stream_preprocess_ ? edge->GetBinding("cc_command") : edge->EvaluateCommand();
+			const auto space = command.find(' ');
+			ToolInvocation invocation(command.substr(space + 1));
+			invocation.SetExecutable(command.substr(0, space));
+			if (!invocationRewriter->CompleteInvocation(invocation).GetOutput().empty())
+				remoteEdges++;
+		}
+		const TimePoint startTime = start.GetElapsedTime();
+
+		Syslogger(Syslogger::Notice) << (streamed ? "streamed" : "files") << ": parse=" << parseTime.ToProfilingTime()
+									 << ", rewrite=" << rewriteTime.ToProfilingTime()
+									 << ", start commands=" << startTime.ToProfilingTime()
+									 << ", remote edges=" << remoteEdges;
+		if (remoteEdges != size_t(g_rules))
+			return 1;
+	}
+	return 0;
+}
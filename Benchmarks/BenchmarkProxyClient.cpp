@@ -0,0 +1,107 @@
+/*
+ * Copyright (C) 2018 Smirnov Vladimir mapron1@gmail.com
+ * Source code licensed under the Apache License, Version 2.0 (the "License");
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at http://www.apache.org/licenses/LICENSE-2.0 or in file COPYING-APACHE-2.0.txt
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.h
+ */
+#include "BenchmarkUtils.h"
+
+#include <ToolProxyFrames.h>
+#include <TcpSocket.h>
+
+#include <thread>
+
+using namespace Wuild;
+
+const int g_invocationsPerClient = 20;
+
+/// Invocation as WuildProxyClient did it before: handler with own thread, connect, request, reply.
+bool InvokeThroughHandler(const std::string & host)
+{
+	SocketFrameHandlerSettings settings;
+	SocketFrameHandler handler(settings);
+	handler.RegisterFrameReader(SocketFrameReaderTemplate<ToolProxyResponse>::Create());
+	handler.SetTcpChannel(host, 0);
+
+	std::mutex mutex;
+	std::condition_variable cond;
+	bool done = false, result = false;
+	handler.QueueFrame(std::make_shared<ToolProxyRequest>(), [&](SocketFrame::Ptr, SocketFrameHandler::ReplyState state, const std::string &){
+		std::lock_guard<std::mutex> lock(mutex);
+		done = true;
+		result = state == SocketFrameHandler::ReplyState::Success;
+		cond.notify_one();
+	}, TimePoint(10.0));
+	handler.Start();
+	std::unique_lock<std::mutex> lock(mutex);
+	cond.wait_for(lock, std::chrono::seconds(10), [&done]{ return done; });
+	lock.unlock();
+	handler.Stop();
+	return result;
+}
+
+/// Fast path of WuildProxyClient: blocking exchange on calling thread.
+bool InvokeSync(const std::string & host)
+{
+	TcpConnectionParams params;
+	params.m_endPoint.SetPoint(0, host);
+	params.m_readTimeout = TimePoint(0.1);
+	params.m_connectTimeout = TimePoint(10.0); // service accepts one connection per quant, -j200 queues up.
+	TcpSocket channel(params);
+	if (!channel.Connect())
+		return false;
+	return !!SocketFrameHandler::SyncExchange(channel, SocketFrameHandlerSettings(), ToolProxyRequest(),
+											  SocketFrameReaderTemplate<ToolProxyResponse>(), TimePoint(10.0));
+}
+
+/// Runs clients in parallel, each doing sequential invocations; outputs average invocation time.
+bool RunClients(const std::string & name, int clients, const std::function<bool()> & invoke)
+{
+	std::atomic_int failed {0};
+	std::vector<std::thread> threads;
+	TimePoint start(true);
+	for (int i = 0; i < clients; ++i)
+		threads.emplace_back([&invoke, &failed]{
+			for (int j = 0; j < g_invocationsPerClient; ++j)
+				if (!invoke())
+					failed++;
+		});
+	for (auto & thread : threads)
+		thread.join();
+	const TimePoint elapsed = start.GetElapsedTime();
+	TimePoint perInvocation;
+	perInvocation.SetUS(elapsed.GetUS() / g_invocationsPerClient);
+	Syslogger(Syslogger::Notice) << name << " -j" << clients << ": total=" << elapsed.ToProfilingTime()
+								 << ", per invocation=" << perInvocation.ToProfilingTime() << ", failed=" << failed;
+	return failed == 0;
+}
+
+/// Measures overhead of proxy client connection and request without tool execution:
+/// proxy emulator on Unix domain socket replies at once. Arguments not required.
+int main(int argc, char** argv)
+{
+	ConfiguredApplication app(argc, argv, "BenchmarkProxyClient");
+
+	const std::string socketPath = app.m_tempDir + "/BenchmarkProxyClient.sock";
+	const std::string host = "unix:" + socketPath;
+	SocketFrameService server;
+	server.RegisterFrameReader(SocketFrameReaderTemplate<ToolProxyRequest>::Create([](const ToolProxyRequest&, SocketFrameHandler::OutputCallback outputCallback){
+		outputCallback(std::make_shared<ToolProxyResponse>("", true));
+	}));
+	server.AddTcpListener(0, host);
+	server.Start();
+
+	bool result = true;
+	for (int clients : {1, 50, 200})
+	{
+		result = RunClients("handler", clients, [&host]{ return InvokeThroughHandler(host); }) && result;
+		result = RunClients("sync", clients, [&host]{ return InvokeSync(host); }) && result;
+	}
+	return result ? 0 : 1;
+}
@@ -0,0 +1,217 @@
+/*
+ * Copyright (C) 2018 Smirnov Vladimir mapron1@gmail.com
+ * Source code licensed under the Apache License, Version 2.0 (the "License");
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at http://www.apache.org/licenses/LICENSE-2.0 or in file COPYING-APACHE-2.0.txt
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.h
+ */
+#include "BenchmarkUtils.h"
+
+#include <RemoteToolClient.h>
+#include <RemoteToolServer.h>
+
+#include <atomic>
+#include <cstdlib>
+#include <deque>
+#include <new>
+#include <thread>
+
+using namespace Wuild;
+
+const int g_queuedTasks = 100000;
+const int g_executedTasks = 5000;
+const int g_serverThreads = 8;
+const int g_serverPort = 12420;
+const std::string g_toolId = "gcc_cpp";
+
+static std::atomic<int64_t> g_allocations {0};
+
+void* operator new(size_t size)
+{
+	g_allocations++;
+	if (void * ptr = std::malloc(size ? size : 1))
+		return ptr;
+	throw std::bad_alloc();
+}
+void operator delete(void* ptr) noexcept { std::free(ptr); }
+void operator delete(void* ptr, size_t) noexcept { std::free(ptr); }
+
+/// Tool server side: every task succeeds at once.
+class InstantExecutor : public ILocalExecutor
+{
+public:
+	InstantExecutor() : m_worker(&InstantExecutor::Work, this) {}
+	~InstantExecutor()
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_stop = true;
+		}
+		m_cond.notify_all();
+		m_worker.join();
+	}
+	void AddTask(LocalExecutorTask::Ptr task) override
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_queue.push_back(task);
+		m_cond.notify_one();
+	}
+	void SyncExecTask(LocalExecutorTask::Ptr) override {}
+	TaskPair SplitTask(LocalExecutorTask::Ptr, std::string &) override { return TaskPair(); }
+	StringVector GetToolIds() const override { return StringVector({g_toolId}); }
+	void SetThreadCount(int) override {}
+	void SetToolThreadCount(const std::string &, int) override {}
+	size_t GetQueueSize() const override
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		return m_queue.size();
+	}
+
+private:
+	void Work()
+	{
+		while (true)
+		{
+			LocalExecutorTask::Ptr task;
+			{
+				std::unique_lock<std::mutex> lock(m_mutex);
+				m_cond.wait(lock, [this]{ return m_stop || !m_queue.empty(); });
+				if (m_stop)
+					return;
+				task = m_queue.front();
+				m_queue.pop_front();
+			}
+			task->m_callback(LocalExecutorResult::Ptr(new LocalExecutorResult("", true)));
+		}
+	}
+
+	mutable std::mutex m_mutex;
+	std::condition_variable m_cond;
+	std::deque<LocalExecutorTask::Ptr> m_queue;
+	bool m_stop = false;
+	std::thread m_worker;
+};
+
+/// Counts finished tasks.
+struct Completion
+{
+	std::mutex m_mutex;
+	std::condition_variable m_cond;
+	int m_done = 0;
+	int m_failed = 0;
+
+	void Wait(int count)
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_cond.wait_for(lock, std::chrono::seconds(120), [this, count]{ return m_done >= count; });
+	}
+};
+
+void Report(const std::string & name, int tasks, int64_t allocations, const TimePoint & elapsed)
+{
+	TimePoint perTask;
+	perTask.SetUS(elapsed.GetUS() * 1000 / tasks);
+	Syslogger(Syslogger::Notice) << name << ": tasks=" << tasks << ", allocations per task=" << double(allocations) / tasks
+								 << ", total=" << elapsed.ToProfilingTime() << ", per 1000 tasks=" << perTask.ToProfilingTime();
+}
+
+/// Measures cost of request lifecycle in build client: heap allocations and time per task,
+/// for tasks queued while no server is available, and for tasks run through in-process tool server. Arguments not required.
+int main(int argc, char** argv)
+{
+	ConfiguredApplication app(argc, argv, "BenchmarkRemoteToolClient");
+
+	IInvocationRewriter::Config rewriterConfig;
+	IInvocationRewriter::Config::Tool tool;
+	tool.m_id = g_toolId;
+	tool.m_names = {FileInfo::LocatePath("g++")};
+	rewriterConfig.m_tools = {tool};
+	rewriterConfig.m_toolIds = {tool.m_id};
+	auto invocationRewriter = InvocationRewriter::Create(rewriterConfig);
+
+	const ByteArrayHolder inputData;
+	const std::string outputDir = app.m_tempDir + "/BenchmarkRemoteToolClient/";
+	FileInfo(outputDir).Mkdirs();
+	std::vector<ToolInvocation> invocations;
+	for (int i = 0; i < g_queuedTasks; ++i)
+	{
+		const std::string name = "src/module" + std::to_string(i % 100) + "/file" + std::to_string(i);
+		invocations.push_back(ToolInvocation("-c pp_" + name + ".cpp -o " + outputDir + std::to_string(i % 100) + ".o -O2 -g -std=c++14 -fPIC").SetId(g_toolId));
+	}
+
+	Completion completion;
+	auto callback = [&completion](const RemoteToolClient::TaskExecutionInfo & info) {
+		std::lock_guard<std::mutex> lock(completion.m_mutex);
+		completion.m_done++;
+		if (!info.m_result)
+			completion.m_failed++;
+		completion.m_cond.notify_all();
+	};
+
+	RemoteToolClient::Config clientConfig;
+	clientConfig.m_coordinator.m_enabled = false;
+	clientConfig.m_usePullScheduling = true;
+	clientConfig.m_queueTimeout = TimePoint(600.0);
+
+	// no servers: every task stays in queue.
+	{
+		RemoteToolClient client(invocationRewriter, {});
+		if (!client.SetConfig(clientConfig))
+			return 1;
+		const int64_t allocations = g_allocations;
+		TimePoint start(true);
+		for (const auto & invocation : invocations)
+			client.InvokeTool(invocation, inputData, callback);
+		Report("queued", g_queuedTasks, g_allocations - allocations, start.GetElapsedTime());
+	}
+
+	ToolServerInfo serverInfo;
+	serverInfo.m_toolServerId = "server";
+	serverInfo.m_connectionHost = "localhost";
+	serverInfo.m_connectionPort = g_serverPort;
+	serverInfo.m_totalThreads = g_serverThreads;
+	serverInfo.m_toolIds = {g_toolId};
+
+	RemoteToolServer::Config serverConfig;
+	serverConfig.m_coordinator.m_enabled = false;
+	serverConfig.m_listenHost = serverInfo.m_connectionHost;
+	serverConfig.m_listenPort = g_serverPort;
+	serverConfig.m_threadCount = g_serverThreads;
+	serverConfig.m_serverName = serverInfo.m_toolServerId;
+	RemoteToolServer server(ILocalExecutor::Ptr(new InstantExecutor()), {});
+	if (!server.SetConfig(serverConfig))
+		return 1;
+	server.Start();
+
+	RemoteToolClient client(invocationRewriter, {});
+	if (!client.SetConfig(clientConfig))
+		return 1;
+	client.AddClient(serverInfo);
+	client.Start({g_toolId});
+	TimePoint connectStart(true);
+	while (client.GetFreeRemoteThreads() <= 0 && connectStart.GetElapsedTime() < TimePoint(5.0))
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+
+	completion.m_done = 0;
+	const int64_t allocations = g_allocations;
+	TimePoint start(true);
+	for (int i = 0; i < g_executedTasks; ++i)
+		client.InvokeTool(invocations[i], inputData, callback);
+	completion.Wait(g_executedTasks);
+	const TimePoint elapsed = start.GetElapsedTime();
+	const int64_t executedAllocations = g_allocations - allocations;
+	Report("executed", g_executedTasks, executedAllocations, elapsed);
+	client.FinishSession();
+
+	if (completion.m_done != g_executedTasks || completion.m_failed)
+	{
+		Syslogger(Syslogger::Err) << "Finished tasks: " << completion.m_done << ", failed: " << completion.m_failed;
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,87 @@
+/*
+ * Copyright (C) 2018 Smirnov Vladimir mapron1@gmail.com
+ * Source code licensed under the Apache License, Version 2.0 (the "License");
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at http://www.apache.org/licenses/LICENSE-2.0 or in file COPYING-APACHE-2.0.txt
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.h
+ */
+#include "BenchmarkUtils.h"
+
+#include <SpawnLauncher.h>
+#include <subprocess.h>
+
+#include <cstring>
+
+namespace
+{
+const int s_rounds = 20;
+}
+
+/// Measures latency of spawning trivial command from SubprocessSet, with 1, 16 and 64 concurrent spawns.
+/// Optional argument is size of memory ballast in MB, to emulate big tool server process.
+int main(int argc, char** argv)
+{
+	using namespace Wuild;
+	ConfiguredApplication app(argc, argv, "BenchmarkSpawn");
+	auto args = app.GetRemainArgs();
+	const size_t ballastSize = args.empty() ? 0 : std::stoul(args[0]) * 1024 * 1024;
+
+	// launcher should be forked before process grows.
+	auto launcher = SpawnLauncher::Create();
+
+	std::vector<char> ballast(ballastSize);
+	memset(ballast.data(), 1, ballast.size());
+
+	for (bool useLauncher : {false, true})
+	{
+		if (useLauncher && !launcher)
+			break;
+
+		for (size_t concurrent : {1, 16, 64})
+		{
+			SubprocessSet subprocs(false);
+#ifndef _WIN32
+			if (useLauncher)
+				subprocs.SetLauncher(launcher.get());
+#endif
+			TimePoint spawnTime, totalTime;
+			for (int round = 0; round < s_rounds; ++round)
+			{
+				TimePoint start(true);
+				for (size_t i = 0; i < concurrent; ++i)
+				{
+					if (!subprocs.Add("true"))
+					{
+						Syslogger(Syslogger::Err) << "Failed to spawn.";
+						return 1;
+					}
+				}
+				spawnTime += start.GetElapsedTime();
+
+				size_t finished = 0;
+				while (finished < concurrent)
+				{
+					Subprocess* subproc;
+					while ((subproc = subprocs.NextFinished()) == nullptr)
+						subprocs.DoWork();
+					subproc->Finish();
+					delete subproc;
+					finished++;
+				}
+				totalTime += start.GetElapsedTime();
+			}
+			const int64_t spawns = s_rounds * concurrent;
+			Syslogger(Syslogger::Notice) << (useLauncher ? "launcher   " : "posix_spawn")
+										 << " concurrent=" << concurrent
+										 << " spawn latency=" << (spawnTime / spawns).ToProfilingTime()
+										 << " spawn+exit=" << (totalTime / spawns).ToProfilingTime();
+		}
+	}
+
+	return 0;
+}
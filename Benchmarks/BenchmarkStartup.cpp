@@ -0,0 +1,68 @@
+/*
+ * Copyright (C) 2018 Smirnov Vladimir mapron1@gmail.com
+ * Source code licensed under the Apache License, Version 2.0 (the "License");
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at http://www.apache.org/licenses/LICENSE-2.0 or in file COPYING-APACHE-2.0.txt
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.h
+ */
+#include "BenchmarkUtils.h"
+
+#include <LocalExecutor.h>
+#include <RemoteToolClient.h>
+#include <VersionChecker.h>
+
+#include <thread>
+
+/// Measures startup of build client with tools from configuration: from start to tool versions known,
+/// and to first task which could be dispatched to tool servers (coordinator or initial servers are required for that).
+/// Startup is measured without version cache, with empty cache and with filled one.
+int main(int argc, char** argv)
+{
+	using namespace Wuild;
+	ConfiguredApplication app(argc, argv, "BenchmarkStartup", "toolClient");
+
+	IInvocationRewriter::Config iconfig;
+	if (!app.GetInvocationRewriterConfig(iconfig))
+		return 1;
+
+	RemoteToolClient::Config clientConfig;
+	if (!app.GetRemoteToolClientConfig(clientConfig))
+		return 1;
+	const bool hasServers = clientConfig.m_coordinator.m_enabled || !clientConfig.m_initialToolServers.m_hosts.empty();
+
+	const std::string cacheFile = app.m_tempDir + "/BenchmarkStartupVersions.txt";
+	FileInfo(cacheFile).Remove();
+
+	for (const std::string mode : {"no cache", "empty cache", "filled cache"})
+	{
+		TimePoint start(true);
+		iconfig.m_versionCacheFile = mode == "no cache" ? std::string() : cacheFile;
+		auto invocationRewriter = InvocationRewriter::Create(iconfig);
+		auto localExecutor = LocalExecutor::Create(invocationRewriter, app.m_tempDir);
+		const auto toolsVersions = VersionChecker::Create(localExecutor, invocationRewriter)->DetermineToolVersions(iconfig.m_toolIds);
+		const TimePoint versionsTime = start.GetElapsedTime();
+
+		TimePoint dispatchTime;
+		if (hasServers)
+		{
+			RemoteToolClient client(invocationRewriter, toolsVersions);
+			if (!client.SetConfig(clientConfig))
+				return 1;
+			client.Start(iconfig.m_toolIds);
+			while (client.GetFreeRemoteThreads() <= 0 && start.GetElapsedTime() < TimePoint(10.0))
+				std::this_thread::sleep_for(std::chrono::milliseconds(1));
+			dispatchTime = start.GetElapsedTime();
+			client.FinishSession();
+		}
+		Syslogger(Syslogger::Notice) << mode << ": versions=" << versionsTime.ToProfilingTime()
+									 << (hasServers ? ", first dispatch=" + dispatchTime.ToProfilingTime() : std::string());
+	}
+	FileInfo(cacheFile).Remove();
+
+	return 0;
+}
@@ -28,6 +28,7 @@ public:
 	StringVector m_coordinatorHost;
 	int m_coordinatorPort = 0;
 	TimePoint m_sendInfoInterval;
+	TimePoint m_sendSessionInterval = 1.0;  //!< session progress updates are coalesced to one per interval. 0 = send every update.
 	Redundance m_redundance = Redundance::All;
 
 	bool Validate(std::ostream * errStream = nullptr) const override;
@@ -26,6 +26,26 @@ bool CoordinatorServerConfig::Validate(std::ostream *errStream) const
 			*errStream << "listenPort should be between 1 and 65535";
 		return false;
 	}
+	if (m_broadcastInterval < TimePoint(0.0))
+	{
+		if (errStream)
+			*errStream << "broadcastInterval should be non-negative";
+		return false;
+	}
+	if (m_leaseDuration <= TimePoint(0.0))
+	{
+		if (errStream)
+			*errStream << "leaseDuration should be positive";
+		return false;
+	}
+	if (IsRelay() && m_siteName.empty())
+	{
+		if (errStream)
+			*errStream << "siteName is required for relay coordinator";
+		return false;
+	}
+	if (IsRelay() && !m_upstream.Validate(errStream))
+		return false;
 	return true;
 }
 
@@ -13,6 +13,9 @@
 
 #pragma once
 #include "IConfig.h"
+#include "CoordinatorClientConfig.h"
+
+#include <TimePoint.h>
 
 namespace Wuild
 {
@@ -21,6 +24,12 @@ class CoordinatorServerConfig : public IConfig
 public:
 	int m_listenPort = 0;
 	int m_lastestSessionsSize = 20;
+	TimePoint m_broadcastInterval = 0.2;  //!< tool server changes are coalesced and sent to peers with this interval. 0 = immediately.
+	TimePoint m_leaseDuration = 10.0;     //!< slot leases not renewed during this time are released.
+	std::string m_siteName;               //!< tool servers registered on this coordinator belong to this site.
+	CoordinatorClientConfig m_upstream;   //!< if enabled, coordinator is relay for its site: sends site summary upstream and gets other sites from there.
+
+	bool IsRelay() const { return m_upstream.m_enabled && !m_upstream.m_coordinatorHost.empty(); }
 	bool Validate(std::ostream * errStream = nullptr) const override;
 };
 }
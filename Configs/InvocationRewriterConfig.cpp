@@ -20,6 +20,15 @@ namespace Wuild
 {
 const std::string InvocationRewriterConfig::VERSION_NO_CHECK = "NO_CHECK";
 
+std::map<std::string, std::string> InvocationRewriterConfig::GetCheckedVersions(const std::map<std::string, std::string> &toolVersions)
+{
+	std::map<std::string, std::string> result;
+	for (const auto & versionPair : toolVersions)
+		if (!versionPair.second.empty() && versionPair.second != VERSION_NO_CHECK)
+			result.insert(versionPair);
+	return result;
+}
+
 std::string InvocationRewriterConfig::GetFirstToolId() const
 {
 	return m_tools.empty() ? "" : m_tools[0].m_id;
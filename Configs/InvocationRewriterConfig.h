@@ -14,12 +14,16 @@
 #pragma once
 #include "IConfig.h"
 
+#include <map>
+
 namespace Wuild
 {
 class InvocationRewriterConfig : public IConfig
 {
 public:
 	static const std::string VERSION_NO_CHECK;
+	/// Leaves only tool versions which should be compared between client and server: non-empty and not VERSION_NO_CHECK.
+	static std::map<std::string, std::string> GetCheckedVersions(const std::map<std::string, std::string> & toolVersions);
 	
 public:
 	enum class ToolchainType { GCC, MSVC, UpdateFile };
@@ -36,6 +40,7 @@ public:
 	};
 	std::vector<Tool> m_tools;
 	StringVector m_toolIds;
+	std::string m_versionCacheFile; //!< Detected tool versions with executable identity, so tools are not run on every start. Empty = disabled.
 	std::string GetFirstToolId() const;
 	std::string GetFirstToolName() const;
 	bool Validate(std::ostream * errStream = nullptr) const override;
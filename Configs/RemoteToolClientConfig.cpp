@@ -32,6 +32,12 @@ bool RemoteToolClientConfig::Validate(std::ostream *errStream) const
 			*errStream << "invocationAttempts should be at least 1.";
 		return false;
 	}
+	if (m_maxConnectedServers < 0)
+	{
+		if (errStream)
+			*errStream << "maxConnectedServers should not be negative.";
+		return false;
+	}
 	return m_coordinator.Validate(errStream);
 }
 
@@ -37,6 +37,14 @@ public:
 	int m_invocationAttempts = 2;
 	int m_minimalRemoteTasks = 10;
 	double m_maxLoadAverage = 0.0;
+	bool m_useSlotLeases = false;         //!< Ask coordinator for slots before sending tasks; without coordinator works as usual.
+	bool m_usePullScheduling = false;     //!< Tool servers request tasks when they have free slot, instead of client pushing them.
+	bool m_streamPreprocessed = false;    //!< Preprocessor output is compressed into request directly, without intermediate file (POSIX only).
+	std::string m_taskHistoryFile;        //!< Remote execution times of previous builds, used to order tasks and set timeouts. Empty = disabled.
+	std::string m_clusterSnapshotFile;    //!< Last tool servers list from coordinator, connected on start before coordinator answers. Empty = disabled.
+	int m_maxConnectedServers = 0;        //!< Size of server working set client is connected to; 0 = connect to all servers.
+	double m_remoteSiteCost = 1.0;        //!< Extra time of task on server from another site, in task durations. Such servers are used only as overflow.
+	TimePoint m_workingSetRefresh = 30.0; //!< How often worst server of working set is replaced by random one.
 	std::string m_clientId;
 	CoordinatorClientConfig m_coordinator;
 	ToolServers m_initialToolServers;
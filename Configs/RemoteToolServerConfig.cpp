@@ -38,6 +38,21 @@ bool RemoteToolServerConfig::Validate(std::ostream *errStream) const
 			*errStream << "threadCount: Number of threads should be greater than zero.";
 		return false;
 	}
+	for (const auto & toolLimit : m_toolThreadCount)
+	{
+		if (toolLimit.second <= 0 || toolLimit.second > m_threadCount)
+		{
+			if (errStream)
+				*errStream << toolLimit.first << "_threadCount: Number of threads should be in range [1, threadCount].";
+			return false;
+		}
+	}
+	if (m_maxQueueSize < 0)
+	{
+		if (errStream)
+			*errStream << "maxQueueSize should not be negative.";
+		return false;
+	}
 
 	return m_coordinator.Validate(errStream);
 }
@@ -17,6 +17,8 @@
 
 #include <FileUtils.h>
 
+#include <map>
+
 namespace Wuild
 {
 class RemoteToolServerConfig : public IConfig
@@ -27,9 +29,14 @@ public:
 	StringVector m_hostsWhiteList; //!< List of hostnames which allowed to connect. If empty, any host allowed.
 	int m_listenPort = 0;
 	int m_threadCount = 1;
+	std::map<std::string, int> m_toolThreadCount; //!< toolId => concurrency limit for that tool; should not exceed m_threadCount.
 	CoordinatorClientConfig m_coordinator;
 	CompressionInfo m_compression;
 	bool m_useClientCompression = true;
+	bool m_usePreforkedLauncher = false; //!< Spawn tools from small helper process, so server itself never forks.
+	int m_maxQueueSize = 0;        //!< Tasks waiting for free thread above this limit are rejected as busy. 0 = unlimited.
+	TimePoint m_maxQueueWait;      //!< Tasks are rejected as busy if estimated queue wait exceeds it. 0 = unlimited.
+	TimePoint m_loadReportInterval = 0.5; //!< How often changed load is sent to connected clients. 0 = only with responses.
 	bool Validate(std::ostream * errStream = nullptr) const override;
 };
 }
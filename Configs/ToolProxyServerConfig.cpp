@@ -20,6 +20,21 @@ namespace Wuild
 
 bool ToolProxyServerConfig::Validate(std::ostream *errStream) const
 {
+	if (!m_listenSocket.empty())
+	{
+#ifdef _WIN32
+		if (errStream)
+			*errStream << "listenSocket is not supported on Windows.";
+		return false;
+#endif
+		if (m_listenPort < 0 || m_listenPort > 0xffff)
+		{
+			if (errStream)
+				*errStream << "listenPort should be between 0 and 65535";
+			return false;
+		}
+		return true;
+	}
 	if (m_listenPort <= 0 || m_listenPort > 0xffff)
 	{
 		if (errStream)
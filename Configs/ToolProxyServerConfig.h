@@ -22,9 +22,11 @@ class ToolProxyServerConfig : public IConfig
 {
 public:
 	int m_listenPort = 0;
-	std::string m_toolId;
+	std::string m_listenSocket;   //!< Unix domain socket path. If set, proxy is per-user agent for all tools and remote tasks of WuildNinja and WuildToolExecutor.
+	std::string m_toolId;         //!< Tool of WuildProxyClient; may be empty for agent.
 	std::string m_startCommand;
 	int m_threadCount = 1;
+	bool m_raceTasks = true;      //!< Run task both locally and remotely when both are idle and estimates are close.
 	TimePoint m_proxyClientTimeout = 240.0;
 	TimePoint m_clientConnectionTimeout = 1.0;
 	TimePoint m_inactiveTimeout = 60.0;
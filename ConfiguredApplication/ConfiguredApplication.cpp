@@ -240,6 +240,8 @@ void ConfiguredApplication::ReadCoordinatorClientConfig(CoordinatorClientConfig
 	config.m_enabled = m_config->GetBool(groupName, "coordinatorEnabled", true);
 	int sendInfoIntervalMS = m_config->GetInt(groupName, "sendInfoIntervalMS", 15000);
 	config.m_sendInfoInterval = TimePoint(sendInfoIntervalMS / 1000.);
+	int sendSessionIntervalMS = m_config->GetInt(groupName, "sendSessionIntervalMS", 1000);
+	config.m_sendSessionInterval = TimePoint(sendSessionIntervalMS / 1000.);
 }
 
 void ConfiguredApplication::ReadLoggingConfig()
@@ -273,6 +275,7 @@ void ConfiguredApplication::ReadInvocationRewriterConfig()
 		Syslogger(Syslogger::Warning) << "Warning: compiler version checks disabled!";
 
 	m_invocationRewriterConfig.m_toolIds = m_config->GetStringList(defaultGroup, "toolIds");
+	m_invocationRewriterConfig.m_versionCacheFile = m_config->GetString(defaultGroup, "versionCacheFile");
 	for (const auto & id : m_invocationRewriterConfig.m_toolIds)
 	{
 		InvocationRewriterConfig::Tool unit;
@@ -326,6 +329,17 @@ void ConfiguredApplication::ReadRemoteToolClientConfig()
 	if (requestTimeoutMS)
 		m_remoteToolClientConfig.m_requestTimeout = TimePoint(requestTimeoutMS / 1000.);
 
+	m_remoteToolClientConfig.m_useSlotLeases = m_config->GetBool(defaultGroup, "useSlotLeases", m_remoteToolClientConfig.m_useSlotLeases);
+	m_remoteToolClientConfig.m_usePullScheduling = m_config->GetBool(defaultGroup, "usePullScheduling", m_remoteToolClientConfig.m_usePullScheduling);
+	m_remoteToolClientConfig.m_streamPreprocessed = m_config->GetBool(defaultGroup, "streamPreprocessed", m_remoteToolClientConfig.m_streamPreprocessed);
+	m_remoteToolClientConfig.m_taskHistoryFile = m_config->GetString(defaultGroup, "taskHistoryFile");
+	m_remoteToolClientConfig.m_clusterSnapshotFile = m_config->GetString(defaultGroup, "clusterSnapshotFile");
+	m_remoteToolClientConfig.m_maxConnectedServers = m_config->GetInt(defaultGroup, "maxConnectedServers", m_remoteToolClientConfig.m_maxConnectedServers);
+	m_remoteToolClientConfig.m_remoteSiteCost = m_config->GetDouble(defaultGroup, "remoteSiteCost", m_remoteToolClientConfig.m_remoteSiteCost);
+	int workingSetRefreshMS = m_config->GetInt(defaultGroup, "workingSetRefreshMS");
+	if (workingSetRefreshMS)
+		m_remoteToolClientConfig.m_workingSetRefresh = TimePoint(workingSetRefreshMS / 1000.);
+
 	ReadCoordinatorClientConfig(m_remoteToolClientConfig.m_coordinator, defaultGroup);
 	m_remoteToolClientConfig.m_coordinator.m_redundance = CoordinatorClientConfig::Redundance::Any;
 	ReadCompressionConfig(m_remoteToolClientConfig.m_compression, defaultGroup);
@@ -342,9 +356,21 @@ void ConfiguredApplication::ReadRemoteToolServerConfig()
 	m_remoteToolServerConfig.m_listenPort           = m_config->GetInt       (defaultGroup, "listenPort");
 	m_remoteToolServerConfig.m_listenHost           = m_config->GetString    (defaultGroup, "listenHost");
 	m_remoteToolServerConfig.m_threadCount          = m_config->GetInt       (defaultGroup, "threadCount", m_remoteToolServerConfig.m_threadCount);
+	for (const auto & id : m_invocationRewriterConfig.m_toolIds)
+	{
+		if (m_config->Exists(defaultGroup, id + "_threadCount"))
+			m_remoteToolServerConfig.m_toolThreadCount[id] = m_config->GetInt(defaultGroup, id + "_threadCount");
+	}
 	m_remoteToolServerConfig.m_serverName           = m_config->GetString    (defaultGroup, "serverName");
 	m_remoteToolServerConfig.m_hostsWhiteList       = m_config->GetStringList(defaultGroup, "hostsWhiteList");
 	m_remoteToolServerConfig.m_useClientCompression = m_config->GetBool      (defaultGroup, "useClientCompression", m_remoteToolServerConfig.m_useClientCompression);
+	m_remoteToolServerConfig.m_usePreforkedLauncher = m_config->GetBool      (defaultGroup, "usePreforkedLauncher", m_remoteToolServerConfig.m_usePreforkedLauncher);
+	m_remoteToolServerConfig.m_maxQueueSize         = m_config->GetInt       (defaultGroup, "maxQueueSize", m_remoteToolServerConfig.m_maxQueueSize);
+	int maxQueueWaitMS = m_config->GetInt(defaultGroup, "maxQueueWaitMS");
+	if (maxQueueWaitMS)
+		m_remoteToolServerConfig.m_maxQueueWait = TimePoint(maxQueueWaitMS / 1000.);
+	int loadReportIntervalMS = m_config->GetInt(defaultGroup, "loadReportIntervalMS", 500);
+	m_remoteToolServerConfig.m_loadReportInterval = TimePoint(loadReportIntervalMS / 1000.);
 	ReadCoordinatorClientConfig(m_remoteToolServerConfig.m_coordinator, defaultGroup);
 	ReadCompressionConfig(m_remoteToolServerConfig.m_compression, defaultGroup);
 }
@@ -353,6 +379,19 @@ void ConfiguredApplication::ReadCoordinatorServerConfig()
 {
 	const std::string defaultGroup("coordinator");
 	m_coordinatorServerConfig.m_listenPort = m_config->GetInt(defaultGroup, "listenPort");
+	int broadcastIntervalMS = m_config->GetInt(defaultGroup, "broadcastIntervalMS", 200);
+	m_coordinatorServerConfig.m_broadcastInterval = TimePoint(broadcastIntervalMS / 1000.);
+	int leaseDurationMS = m_config->GetInt(defaultGroup, "leaseDurationMS", 10000);
+	m_coordinatorServerConfig.m_leaseDuration = TimePoint(leaseDurationMS / 1000.);
+	m_coordinatorServerConfig.m_siteName = m_config->GetString(defaultGroup, "siteName");
+
+	CoordinatorClientConfig & upstream = m_coordinatorServerConfig.m_upstream;
+	upstream.m_coordinatorHost = m_config->GetStringList(defaultGroup, "upstreamHost");
+	upstream.m_coordinatorPort = m_config->GetInt(defaultGroup, "upstreamPort");
+	upstream.m_enabled = !upstream.m_coordinatorHost.empty();
+	int upstreamSendIntervalMS = m_config->GetInt(defaultGroup, "upstreamSendIntervalMS", 1000);
+	upstream.m_sendInfoInterval = TimePoint(upstreamSendIntervalMS / 1000.);
+	upstream.m_logContext = "coordinator:upstream";
 }
 
 void ConfiguredApplication::ReadCompressionConfig(CompressionInfo &compressionInfo, const std::string &groupName)
@@ -375,9 +414,11 @@ void ConfiguredApplication::ReadToolProxyServerConfig()
 {
 	const std::string defaultGroup("proxy");
 	m_toolProxyServerConfig.m_listenPort   = m_config->GetInt   (defaultGroup, "listenPort");
+	m_toolProxyServerConfig.m_listenSocket = m_config->GetString(defaultGroup, "listenSocket");
 	m_toolProxyServerConfig.m_toolId       = m_config->GetString(defaultGroup, "toolId");
 	m_toolProxyServerConfig.m_startCommand = m_config->GetString(defaultGroup, "startCommand", Application::Instance().GetExecutablePath()	+ "WuildProxy");
 	m_toolProxyServerConfig.m_threadCount  = m_config->GetInt   (defaultGroup, "threadCount", m_toolProxyServerConfig.m_threadCount);
+	m_toolProxyServerConfig.m_raceTasks    = m_config->GetBool  (defaultGroup, "raceTasks", m_toolProxyServerConfig.m_raceTasks);
 
 	int proxyClientTimeoutMS = m_config->GetInt(defaultGroup, "proxyClientTimeoutMS");
 	if (proxyClientTimeoutMS)
@@ -61,6 +61,8 @@ void CoordinatorClient::Start()
 		auto worker = std::make_shared<CoordWorker>();
 		worker->m_coordClient = this;
 		worker->SetToolServerInfo(m_lastInfo);
+		if (!m_lastSite.empty())
+			worker->SetSiteStatus(m_lastSite, m_lastSiteToolServers);
 		worker->Start(host, m_config.m_coordinatorPort);
 		m_workers.emplace_back(worker);
 	}
@@ -73,21 +75,64 @@ void CoordinatorClient::SetToolServerInfo(const ToolServerInfo &info)
 		worker->SetToolServerInfo(info);
 }
 
+void CoordinatorClient::SetSiteStatus(const std::string &site, const std::deque<ToolServerInfo> &toolServers)
+{
+	m_lastSite = site;
+	m_lastSiteToolServers = toolServers;
+	for (auto & worker : m_workers)
+		worker->SetSiteStatus(site, toolServers);
+}
+
 void CoordinatorClient::SendToolServerSessionInfo(const ToolServerSessionInfo &sessionInfo, bool isFinished)
 {
 	if (m_workers.empty())
 		return;
 
-	Syslogger(this->m_config.m_logContext) << " sending session " <<  sessionInfo.m_clientId;
+	for (auto & worker : m_workers)
+		worker->SetSessionInfo(sessionInfo, isFinished);
+}
 
+bool CoordinatorClient::RequestLeases(int64_t sessionId, const std::string &clientId, uint16_t slots, uint16_t usedSlots,
+									  const StringVector &toolIds, const ToolVersionMap &toolVersions, LeasesArrivedCallback callback)
+{
 	for (auto & worker : m_workers)
 	{
 		if (!worker->m_clientState)
 			continue;
 
-		CoordinatorToolServerSession::Ptr message(new CoordinatorToolServerSession());
-		message->m_isFinished = isFinished;
-		message->m_session = sessionInfo;
+		CoordinatorLeaseRequest::Ptr message(new CoordinatorLeaseRequest());
+		message->m_sessionId = sessionId;
+		message->m_clientId = clientId;
+		message->m_requestedSlots = slots;
+		message->m_usedSlots = usedSlots;
+		message->m_toolIds = toolIds;
+		message->m_toolVersions = toolVersions;
+		auto replyCallback = [callback](SocketFrame::Ptr responseFrame, SocketFrameHandler::ReplyState state, const std::string & errorInfo)
+		{
+			if (state != SocketFrameHandler::ReplyState::Success)
+			{
+				Syslogger(Syslogger::Warning) << "Lease request failed: " << errorInfo;
+				return;
+			}
+			auto response = std::dynamic_pointer_cast<CoordinatorLeaseResponse>(responseFrame);
+			if (response && callback)
+				callback(response->m_leases, response->m_duration);
+		};
+		worker->m_client->QueueFrame(message, replyCallback, TimePoint(10.0));
+		return true;
+	}
+	return false;
+}
+
+void CoordinatorClient::SendToolServerHealth(const ToolServerHealthReport &report)
+{
+	for (auto & worker : m_workers)
+	{
+		if (!worker->m_clientState)
+			continue;
+
+		CoordinatorToolServerHealth::Ptr message(new CoordinatorToolServerHealth());
+		message->m_report = report;
 		worker->m_client->QueueFrame(message);
 	}
 }
@@ -119,17 +164,72 @@ void CoordinatorClient::CoordWorker::SetToolServerInfo(const ToolServerInfo &inf
 	m_toolServerInfo = info;
 }
 
+void CoordinatorClient::CoordWorker::SetSiteStatus(const std::string &site, const std::deque<ToolServerInfo> &toolServers)
+{
+	std::lock_guard<std::mutex> lock(m_toolServerInfoMutex);
+	if (m_site == site && m_siteToolServers == toolServers)
+		return;
+
+	m_needSendSiteStatus = true;
+	m_site = site;
+	m_siteToolServers = toolServers;
+}
+
+void CoordinatorClient::CoordWorker::SetSessionInfo(const ToolServerSessionInfo &sessionInfo, bool isFinished)
+{
+	std::lock_guard<std::mutex> lock(m_sessionInfoMutex);
+	m_sessionInfo = sessionInfo;
+	m_sessionFinished = isFinished;
+	m_needSendSessionInfo = true;
+	// progress is sent from Quant(); finish is sent right away, so it will not be lost on client shutdown.
+	if (isFinished || !m_coordClient->m_config.m_sendSessionInterval)
+		SendSessionInfo();
+}
+
+void CoordinatorClient::CoordWorker::SendSessionInfo()
+{
+	if (!m_clientState)
+		return;
+
+	Syslogger(m_coordClient->m_config.m_logContext) << " sending session " <<  m_sessionInfo.m_clientId;
+	m_needSendSessionInfo = false;
+	m_lastSessionSend = TimePoint(true);
+	CoordinatorToolServerSession::Ptr message(new CoordinatorToolServerSession());
+	message->m_isFinished = m_sessionFinished;
+	message->m_session = m_sessionInfo;
+	m_client->QueueFrame(message);
+}
+
 void CoordinatorClient::CoordWorker::Quant()
 {
 	if (!m_clientState)
 		return;
 
-	if (m_coordClient->m_config.m_sendInfoInterval && m_needSendToolServerInfo)
+	{
+		std::lock_guard<std::mutex> lock(m_sessionInfoMutex);
+		if (m_needSendSessionInfo && (m_sessionFinished || !m_lastSessionSend || m_lastSessionSend.GetElapsedTime() > m_coordClient->m_config.m_sendSessionInterval))
+			SendSessionInfo();
+	}
+
+	if (m_coordClient->m_config.m_sendInfoInterval && (m_needSendToolServerInfo || m_needSendSiteStatus))
 	{
 		if (!m_lastSend || m_lastSend.GetElapsedTime() > m_coordClient->m_config.m_sendInfoInterval)
 		{
 			m_lastSend = TimePoint(true);
 			m_needSendToolServerInfo = false;
+			if (m_needSendSiteStatus)
+			{
+				m_needSendSiteStatus = false;
+				std::lock_guard<std::mutex> lock(m_toolServerInfoMutex);
+				if (!m_site.empty())
+				{
+					Syslogger(m_coordClient->m_config.m_logContext) << " sending site " <<  m_site;
+					CoordinatorSiteStatus::Ptr message(new CoordinatorSiteStatus());
+					message->m_site = m_site;
+					message->m_toolServers = m_siteToolServers;
+					m_client->QueueFrame(message);
+				}
+			}
 			{
 				std::lock_guard<std::mutex> lock(m_toolServerInfoMutex);
 				if (m_toolServerInfo.m_totalThreads)
@@ -164,6 +264,11 @@ void CoordinatorClient::CoordWorker::Start(const std::string &host, int port)
 										+ CoordinatorListResponse::s_version
 										+ CoordinatorToolServerStatus::s_version
 										+ CoordinatorToolServerSession::s_version
+										+ CoordinatorListDelta::s_version
+										+ CoordinatorLeaseRequest::s_version
+										+ CoordinatorLeaseResponse::s_version
+										+ CoordinatorToolServerHealth::s_version
+										+ CoordinatorSiteStatus::s_version
 										;
 
 	m_client.reset(new SocketFrameHandler( settings ));
@@ -171,6 +276,9 @@ void CoordinatorClient::CoordWorker::Start(const std::string &host, int port)
 		 std::lock_guard<std::mutex> lock(m_coordClient->m_coordMutex);
 		 m_coordClient->StopExtraClients(host);
 		 Syslogger(m_coordClient->m_config.m_logContext) << " list arrived [" << inputMessage.m_info.m_toolServers.size() << "]";
+		 m_sequence = inputMessage.m_sequence;
+		 m_waitingSnapshot = false;
+		 m_coordClient->m_coord.m_site = inputMessage.m_info.m_site;
 		 auto modified = m_coordClient->m_coord.Update(inputMessage.m_info.m_toolServers);
 		 if (!modified.empty())
 		 {
@@ -178,12 +286,39 @@ void CoordinatorClient::CoordWorker::Start(const std::string &host, int port)
 				 m_coordClient->m_infoArrivedCallback(m_coordClient->m_coord);
 		 }
 	}));
+	m_client->RegisterFrameReader(SocketFrameReaderTemplate<CoordinatorListDelta>::Create([this](const CoordinatorListDelta& inputMessage, SocketFrameHandler::OutputCallback){
+		 std::lock_guard<std::mutex> lock(m_coordClient->m_coordMutex);
+		 if (inputMessage.m_sequence <= m_sequence)
+			 return; // already included in snapshot.
+
+		 if (inputMessage.m_baseSequence != m_sequence)
+		 {
+			 if (!m_waitingSnapshot)
+			 {
+				 Syslogger(m_coordClient->m_config.m_logContext) << " missed changes " << m_sequence << "->" << inputMessage.m_baseSequence << ", requesting full list";
+				 m_waitingSnapshot = true;
+				 m_needRequestData = true;
+			 }
+			 return;
+		 }
+		 m_sequence = inputMessage.m_sequence;
+		 bool modified = !m_coordClient->m_coord.Update(inputMessage.m_changedToolServers).empty();
+		 for (const ToolServerInfo & removed : inputMessage.m_removedToolServers)
+			 modified = m_coordClient->m_coord.Remove(removed) || modified;
+
+		 if (modified && m_coordClient->m_infoArrivedCallback)
+			 m_coordClient->m_infoArrivedCallback(m_coordClient->m_coord);
+	}));
+	m_client->RegisterFrameReader(SocketFrameReaderTemplate<CoordinatorLeaseResponse>::Create());
 	m_client->SetChannelNotifier([this](bool state){
 		m_clientState = state;
 		if (!state)
 		{
 			m_needRequestData = true;
 			m_needSendToolServerInfo = true;
+			m_needSendSiteStatus = true;
+			std::lock_guard<std::mutex> lock(m_coordClient->m_coordMutex);
+			m_sequence = 0;
 		}
 	});
 
@@ -31,6 +31,7 @@ class CoordinatorClient
 {
 public:
 	using InfoArrivedCallback = std::function<void(const CoordinatorInfo&)>;
+	using LeasesArrivedCallback = std::function<void(const std::deque<ToolServerLease>&, const TimePoint & duration)>;
 	using Config = CoordinatorClientConfig;
 
 public:
@@ -43,7 +44,15 @@ public:
 	void Start();
 
 	void SetToolServerInfo(const ToolServerInfo & info);
+	/// Used by relay coordinator: all tool servers of its site, sent with same interval as tool server info.
+	void SetSiteStatus(const std::string & site, const std::deque<ToolServerInfo> & toolServers);
 	void SendToolServerSessionInfo(const ToolServerSessionInfo & sessionInfo, bool isFinished);
+	/// Asks connected coordinator for slot leases; callback is not called on failure. Returns false if no coordinator connected.
+	bool RequestLeases(int64_t sessionId, const std::string & clientId, uint16_t slots, uint16_t usedSlots,
+					   const StringVector & toolIds, const ToolVersionMap & toolVersions, LeasesArrivedCallback callback);
+
+	/// Sends circuit breaker state change to all connected coordinators; lost if none connected.
+	void SendToolServerHealth(const ToolServerHealthReport & report);
 
 	void StopExtraClients(const std::string& hostExcept);
 
@@ -65,9 +74,24 @@ protected:
 		std::string m_host;
 
 		ToolServerInfo m_toolServerInfo;
+		std::string m_site;
+		std::deque<ToolServerInfo> m_siteToolServers;
+		std::atomic_bool m_needSendSiteStatus {false};
 		std::mutex m_toolServerInfoMutex;
 
+		ToolServerSessionInfo m_sessionInfo;
+		bool m_sessionFinished = false;
+		bool m_needSendSessionInfo = false;
+		TimePoint m_lastSessionSend;
+		std::mutex m_sessionInfoMutex;
+
+		uint64_t m_sequence = 0;          //!< last applied coordinator change, guarded by m_coordMutex.
+		bool m_waitingSnapshot = false;
+
 		void SetToolServerInfo(const ToolServerInfo & info);
+		void SetSiteStatus(const std::string & site, const std::deque<ToolServerInfo> & toolServers);
+		void SetSessionInfo(const ToolServerSessionInfo & sessionInfo, bool isFinished);
+		void SendSessionInfo();
 
 		void Quant();
 		void Start(const std::string& host, int port);
@@ -79,6 +103,8 @@ protected:
 
 	CoordinatorInfo m_coord;
 	ToolServerInfo m_lastInfo;
+	std::string m_lastSite;
+	std::deque<ToolServerInfo> m_lastSiteToolServers;
 
 	std::mutex m_coordMutex;
 
@@ -40,6 +40,27 @@ inline ByteOrderDataStreamWriter& ByteOrderDataStreamWriter::operator << (const
 	return *this;
 }
 
+template<>
+inline ByteOrderDataStreamReader& ByteOrderDataStreamReader::operator >> (ToolServerInfo::ToolSlots &slots)
+{
+	*this
+		>> slots.m_toolId
+		>> slots.m_totalThreads
+		>> slots.m_runningTasks
+	   ;
+	return *this;
+}
+template<>
+inline ByteOrderDataStreamWriter& ByteOrderDataStreamWriter::operator << (const ToolServerInfo::ToolSlots &slots)
+{
+	*this
+		<< slots.m_toolId
+		<< slots.m_totalThreads
+		<< slots.m_runningTasks
+			;
+	return *this;
+}
+
 template<>
 inline ByteOrderDataStreamReader& ByteOrderDataStreamReader::operator >> (ToolServerInfo &info)
 {
@@ -52,6 +73,11 @@ inline ByteOrderDataStreamReader& ByteOrderDataStreamReader::operator >> (ToolSe
 		>> info.m_queuedTasks
 		>> info.m_runningTasks
 		>> info.m_connectedClients
+		>> info.m_toolSlots
+		>> info.m_speedScore
+		>> info.m_unhealthyReports
+		>> info.m_toolVersions
+		>> info.m_site
 			;
 	return *this;
 }
@@ -67,6 +93,11 @@ inline ByteOrderDataStreamWriter& ByteOrderDataStreamWriter::operator << (const
 		<< info.m_queuedTasks
 		<< info.m_runningTasks
 		<< info.m_connectedClients
+		<< info.m_toolSlots
+		<< info.m_speedScore
+		<< info.m_unhealthyReports
+		<< info.m_toolVersions
+		<< info.m_site
 	   ;
 	return *this;
 }
@@ -96,18 +127,119 @@ inline ByteOrderDataStreamWriter& ByteOrderDataStreamWriter::operator << (const
 		   ;
 	return *this;
 }
+template<>
+inline ByteOrderDataStreamReader& ByteOrderDataStreamReader::operator >> (ToolServerLease &lease)
+{
+	*this
+		>> lease.m_toolServerId
+		>> lease.m_connectionHost
+		>> lease.m_connectionPort
+		>> lease.m_slots
+		   ;
+	return *this;
+}
+template<>
+inline ByteOrderDataStreamWriter& ByteOrderDataStreamWriter::operator << (const ToolServerLease &lease)
+{
+	*this
+		<< lease.m_toolServerId
+		<< lease.m_connectionHost
+		<< lease.m_connectionPort
+		<< lease.m_slots
+		   ;
+	return *this;
+}
 
+template<>
+inline ByteOrderDataStreamReader& ByteOrderDataStreamReader::operator >> (ToolServerHealthReport &report)
+{
+	*this
+		>> report.m_toolServerId
+		>> report.m_connectionHost
+		>> report.m_connectionPort
+		>> report.m_sessionId
+		>> report.m_tripped
+		   ;
+	return *this;
+}
+template<>
+inline ByteOrderDataStreamWriter& ByteOrderDataStreamWriter::operator << (const ToolServerHealthReport &report)
+{
+	*this
+		<< report.m_toolServerId
+		<< report.m_connectionHost
+		<< report.m_connectionPort
+		<< report.m_sessionId
+		<< report.m_tripped
+		   ;
+	return *this;
+}
 
 SocketFrame::State CoordinatorListResponse::ReadInternal(ByteOrderDataStreamReader &stream)
 {
-	stream  >> m_info.m_toolServers >> m_info.m_latestSessions >> m_info.m_activeSessions;
+	stream  >> m_info.m_toolServers >> m_info.m_latestSessions >> m_info.m_activeSessions >> m_sequence >> m_info.m_site;
 
 	return stOk;
 }
 
 SocketFrame::State CoordinatorListResponse::WriteInternal(ByteOrderDataStreamWriter &stream) const
 {
-	stream << m_info.m_toolServers <<  m_info.m_latestSessions << m_info.m_activeSessions;
+	stream << m_info.m_toolServers <<  m_info.m_latestSessions << m_info.m_activeSessions << m_sequence << m_info.m_site;
+	return stOk;
+}
+
+void CoordinatorListDelta::LogTo(std::ostream &os) const
+{
+	os << " DELTA " << m_baseSequence << "->" << m_sequence
+	   << " changed: " << m_changedToolServers.size()
+	   << " removed: " << m_removedToolServers.size();
+}
+
+SocketFrame::State CoordinatorListDelta::ReadInternal(ByteOrderDataStreamReader &stream)
+{
+	stream >> m_baseSequence >> m_sequence >> m_changedToolServers >> m_removedToolServers;
+	return stOk;
+}
+
+SocketFrame::State CoordinatorListDelta::WriteInternal(ByteOrderDataStreamWriter &stream) const
+{
+	stream << m_baseSequence << m_sequence << m_changedToolServers << m_removedToolServers;
+	return stOk;
+}
+
+void CoordinatorLeaseRequest::LogTo(std::ostream &os) const
+{
+	os << " LEASE REQUEST sid=" << m_sessionId << " slots: " << m_requestedSlots << " used: " << m_usedSlots;
+}
+
+SocketFrame::State CoordinatorLeaseRequest::ReadInternal(ByteOrderDataStreamReader &stream)
+{
+	stream >> m_sessionId >> m_clientId >> m_requestedSlots >> m_usedSlots >> m_toolIds >> m_toolVersions;
+	return stOk;
+}
+
+SocketFrame::State CoordinatorLeaseRequest::WriteInternal(ByteOrderDataStreamWriter &stream) const
+{
+	stream << m_sessionId << m_clientId << m_requestedSlots << m_usedSlots << m_toolIds << m_toolVersions;
+	return stOk;
+}
+
+void CoordinatorLeaseResponse::LogTo(std::ostream &os) const
+{
+	os << " LEASES";
+	for (const ToolServerLease & lease : m_leases)
+		os << " " << lease.m_connectionHost << ":" << lease.m_connectionPort << "=" << lease.m_slots;
+}
+
+SocketFrame::State CoordinatorLeaseResponse::ReadInternal(ByteOrderDataStreamReader &stream)
+{
+	stream >> m_leases >> m_duration;
+	return stOk;
+}
+
+SocketFrame::State CoordinatorLeaseResponse::WriteInternal(ByteOrderDataStreamWriter &stream) const
+{
+	stream << m_leases << m_duration;
 	return stOk;
 }
 
@@ -123,6 +255,36 @@ SocketFrame::State CoordinatorToolServerStatus::WriteInternal(ByteOrderDataStrea
 	return stOk;
 }
 
+void CoordinatorToolServerHealth::LogTo(std::ostream &os) const
+{
+	os << " HEALTH sid=" << m_report.m_sessionId << " " << m_report.m_connectionHost << ":" << m_report.m_connectionPort
+	   << (m_report.m_tripped ? " tripped" : " restored");
+}
+
+SocketFrame::State CoordinatorToolServerHealth::ReadInternal(ByteOrderDataStreamReader &stream)
+{
+	stream >> m_report;
+	return stOk;
+}
+
+SocketFrame::State CoordinatorToolServerHealth::WriteInternal(ByteOrderDataStreamWriter &stream) const
+{
+	stream << m_report;
+	return stOk;
+}
+
+SocketFrame::State CoordinatorSiteStatus::ReadInternal(ByteOrderDataStreamReader &stream)
+{
+	stream >> m_site >> m_toolServers;
+	return stOk;
+}
+
+SocketFrame::State CoordinatorSiteStatus::WriteInternal(ByteOrderDataStreamWriter &stream) const
+{
+	stream << m_site << m_toolServers;
+	return stOk;
+}
+
 SocketFrame::State CoordinatorToolServerSession::ReadInternal(ByteOrderDataStreamReader &stream)
 {
 	stream >> m_isFinished >> m_session;
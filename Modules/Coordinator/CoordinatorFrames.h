@@ -34,15 +34,17 @@ public:
 	State               WriteInternal(ByteOrderDataStreamWriter &) const override {return stOk;}
 };
 
+/// Full snapshot of coordinator data.
 class CoordinatorListResponse : public SocketFrameExt
 {
 public:
-	static const uint32_t s_version = 1;
+	static const uint32_t s_version = 7;
 	static const uint8_t s_frameTypeId = s_minimalUserFrameId + 2;
 	using Ptr = std::shared_ptr<CoordinatorListResponse>;
 
 public:
 	CoordinatorInfo              m_info;
+	uint64_t                     m_sequence = 0;   //!< last change included in snapshot.
 
 	void                         LogTo(std::ostream& os) const override { os <<  m_info.ToString(); }
 	uint8_t                      FrameTypeId() const override { return s_frameTypeId;}
@@ -51,10 +53,31 @@ public:
 	State                        WriteInternal(ByteOrderDataStreamWriter &stream) const override;
 };
 
+/// Tool servers changed since m_baseSequence. Peer with another sequence should request full list.
+class CoordinatorListDelta : public SocketFrameExt
+{
+public:
+	static const uint32_t s_version = 4;
+	static const uint8_t s_frameTypeId = s_minimalUserFrameId + 5;
+	using Ptr = std::shared_ptr<CoordinatorListDelta>;
+
+public:
+	uint64_t                     m_baseSequence = 0;
+	uint64_t                     m_sequence = 0;
+	std::deque<ToolServerInfo>   m_changedToolServers;
+	std::deque<ToolServerInfo>   m_removedToolServers;  //!< only id fields are meaningful.
+
+	void                         LogTo(std::ostream& os) const override;
+	uint8_t                      FrameTypeId() const override { return s_frameTypeId;}
+
+	State                        ReadInternal(ByteOrderDataStreamReader &stream) override;
+	State                        WriteInternal(ByteOrderDataStreamWriter &stream) const override;
+};
+
 class CoordinatorToolServerStatus : public SocketFrameExt
 {
 public:
-	static const uint32_t s_version = 1;
+	static const uint32_t s_version = 6;
 	static const uint8_t s_frameTypeId = s_minimalUserFrameId + 3;
 	using Ptr = std::shared_ptr<CoordinatorToolServerStatus>;
 
@@ -68,6 +91,85 @@ public:
 	State               WriteInternal(ByteOrderDataStreamWriter &stream) const override;
 };
 
+/// Session asks coordinator for slots on tool servers. Zero slots releases all leases of session.
+class CoordinatorLeaseRequest : public SocketFrameExt
+{
+public:
+	static const uint32_t s_version = 2;
+	static const uint8_t s_frameTypeId = s_minimalUserFrameId + 6;
+	using Ptr = std::shared_ptr<CoordinatorLeaseRequest>;
+
+public:
+	int64_t             m_sessionId = 0;
+	std::string         m_clientId;
+	uint16_t            m_requestedSlots = 0;
+	uint16_t            m_usedSlots = 0;        //!< tasks session is running now.
+	StringVector        m_toolIds;          //!< only servers having at least one of tools are leased; empty = any.
+	ToolVersionMap      m_toolVersions;     //!< tool versions of client, servers with other versions are not leased.
+
+	void                LogTo(std::ostream& os) const override;
+	uint8_t             FrameTypeId() const override { return s_frameTypeId;}
+
+	State               ReadInternal(ByteOrderDataStreamReader &stream) override;
+	State               WriteInternal(ByteOrderDataStreamWriter &stream) const override;
+};
+
+/// Leases granted to session; they replace previously granted ones.
+class CoordinatorLeaseResponse : public SocketFrameExt
+{
+public:
+	static const uint32_t s_version = 1;
+	static const uint8_t s_frameTypeId = s_minimalUserFrameId + 7;
+	using Ptr = std::shared_ptr<CoordinatorLeaseResponse>;
+
+public:
+	std::deque<ToolServerLease> m_leases;
+	TimePoint                   m_duration;   //!< leases are valid for this time after response was sent.
+
+	void                LogTo(std::ostream& os) const override;
+	uint8_t             FrameTypeId() const override { return s_frameTypeId;}
+
+	State               ReadInternal(ByteOrderDataStreamReader &stream) override;
+	State               WriteInternal(ByteOrderDataStreamWriter &stream) const override;
+};
+
+/// Client reports its circuit breaker state for tool server, so other clients could avoid it too.
+class CoordinatorToolServerHealth : public SocketFrameExt
+{
+public:
+	static const uint32_t s_version = 1;
+	static const uint8_t s_frameTypeId = s_minimalUserFrameId + 8;
+	using Ptr = std::shared_ptr<CoordinatorToolServerHealth>;
+
+public:
+	ToolServerHealthReport m_report;
+
+	void                LogTo(std::ostream& os) const override;
+	uint8_t             FrameTypeId() const override { return s_frameTypeId;}
+
+	State               ReadInternal(ByteOrderDataStreamReader &stream) override;
+	State               WriteInternal(ByteOrderDataStreamWriter &stream) const override;
+};
+
+/// Relay coordinator sends all tool servers of its site to upstream coordinator; servers missing in list are removed.
+class CoordinatorSiteStatus : public SocketFrameExt
+{
+public:
+	static const uint32_t s_version = 1;
+	static const uint8_t s_frameTypeId = s_minimalUserFrameId + 9;
+	using Ptr = std::shared_ptr<CoordinatorSiteStatus>;
+
+public:
+	std::string                  m_site;
+	std::deque<ToolServerInfo>   m_toolServers;
+
+	void                LogTo(std::ostream& os) const override { os << " SITE " << m_site << ": " << m_toolServers.size(); }
+	uint8_t             FrameTypeId() const override { return s_frameTypeId;}
+
+	State               ReadInternal(ByteOrderDataStreamReader &stream) override;
+	State               WriteInternal(ByteOrderDataStreamWriter &stream) const override;
+};
+
 class CoordinatorToolServerSession : public SocketFrameExt
 {
 public:
@@ -14,19 +14,25 @@
 #include "CoordinatorServer.h"
 
 #include "CoordinatorFrames.h"
+#include "CoordinatorClient.h"
 
 #include <SocketFrameService.h>
 #include <ThreadUtils.h>
 
+#include <algorithm>
 #include <memory>
 
 namespace Wuild
 {
+/// Client resends report while breaker is open, so forgotten reports are ones from crashed clients.
+static const TimePoint g_healthReportTTL(120.0);
 
 CoordinatorServer::CoordinatorServer() = default;
 
 CoordinatorServer::~CoordinatorServer()
 {
+	m_upstream.reset();
+	m_broadcastThread.Stop();
 	m_server.reset();
 }
 
@@ -39,6 +45,8 @@ bool CoordinatorServer::SetConfig(const CoordinatorServer::Config &config)
 		return false;
 	}
 	m_config = config;
+	m_info.m_site = m_config.m_siteName;
+	m_leases.SetDuration(m_config.m_leaseDuration);
 	return true;
 }
 
@@ -49,6 +57,11 @@ void CoordinatorServer::Start()
 										+ CoordinatorListResponse::s_version
 										+ CoordinatorToolServerStatus::s_version
 										+ CoordinatorToolServerSession::s_version
+										+ CoordinatorListDelta::s_version
+										+ CoordinatorLeaseRequest::s_version
+										+ CoordinatorLeaseResponse::s_version
+										+ CoordinatorToolServerHealth::s_version
+										+ CoordinatorSiteStatus::s_version
 										;
 	m_server = std::make_unique<SocketFrameService>( settings,  m_config.m_listenPort );
 
@@ -57,12 +70,44 @@ void CoordinatorServer::Start()
 		outputCallback(GetResponse());
 	}));
 
+	m_server->RegisterFrameReader(SocketFrameReaderTemplate<CoordinatorLeaseRequest>::Create([this](const CoordinatorLeaseRequest& inputMessage, SocketFrameHandler::OutputCallback outputCallback){
+		CoordinatorLeaseResponse::Ptr response(new CoordinatorLeaseResponse());
+		{
+			std::lock_guard<std::mutex> lock(m_infoMutex);
+			response->m_leases = m_leases.Acquire(m_info.m_toolServers, inputMessage.m_sessionId, inputMessage.m_requestedSlots, inputMessage.m_usedSlots, inputMessage.m_toolIds, inputMessage.m_toolVersions);
+		}
+		response->m_duration = m_leases.GetDuration();
+		outputCallback(response);
+	}));
+
+	m_server->RegisterFrameReader(SocketFrameReaderTemplate<CoordinatorToolServerHealth>::Create([this](const CoordinatorToolServerHealth& inputMessage, SocketFrameHandler::OutputCallback){
+		{
+			std::lock_guard<std::mutex> lock(m_infoMutex);
+			const ToolServerHealthReport & report = inputMessage.m_report;
+			auto sameIt = std::find_if(m_healthReports.begin(), m_healthReports.end(), [&report](const HealthReport & existing){
+				return existing.m_report.m_sessionId == report.m_sessionId
+					&& existing.m_report.m_toolServerId == report.m_toolServerId
+					&& existing.m_report.m_connectionHost == report.m_connectionHost
+					&& existing.m_report.m_connectionPort == report.m_connectionPort;
+			});
+			if (sameIt != m_healthReports.end())
+				m_healthReports.erase(sameIt);
+			if (report.m_tripped)
+				m_healthReports.push_back(HealthReport{report, TimePoint(true) + g_healthReportTTL});
+
+			UpdateHealthReports();
+		}
+		if (!m_config.m_broadcastInterval)
+			FlushChanges();
+	}));
+
 	m_server->SetHandlerInitCallback([this](SocketFrameHandler * handler){
 
 		handler->RegisterFrameReader(SocketFrameReaderTemplate<CoordinatorToolServerSession>::Create([this](const CoordinatorToolServerSession& inputMessage, SocketFrameHandler::OutputCallback){
 			std::lock_guard<std::mutex> lock(m_infoMutex);
 			if (inputMessage.m_isFinished)
 			{
+				m_leases.Acquire(m_info.m_toolServers, inputMessage.m_session.m_sessionId, 0, 0, {}, {});
 				m_info.m_latestSessions.push_back(inputMessage.m_session);
 				if ((int)m_info.m_latestSessions.size() > m_config.m_lastestSessionsSize)
 					m_info.m_latestSessions.pop_front();
@@ -93,16 +138,30 @@ void CoordinatorServer::Start()
 
 		handler->RegisterFrameReader(SocketFrameReaderTemplate<CoordinatorToolServerStatus>::Create([this, handler](const CoordinatorToolServerStatus& inputMessage, SocketFrameHandler::OutputCallback ){
 
-			std::vector<ToolServerInfo*> modified;
 			{
 				std::lock_guard<std::mutex> lock(m_infoMutex);
-				modified = m_info.Update(inputMessage.m_info);
+				ToolServerInfo info = inputMessage.m_info;
+				info.m_unhealthyReports = CountHealthReports(info);
+				if (info.m_site.empty())
+					info.m_site = m_config.m_siteName;
+				auto modified = m_info.Update(info);
+				if (modified.empty())
+					return;
+
+				modified[0]->m_opaqueFrameHandler = handler;
+				AddChanged(*modified[0], false);
 			}
-			if (!modified.empty())
+			if (!m_config.m_broadcastInterval)
+				FlushChanges();
+		}));
+
+		handler->RegisterFrameReader(SocketFrameReaderTemplate<CoordinatorSiteStatus>::Create([this, handler](const CoordinatorSiteStatus& inputMessage, SocketFrameHandler::OutputCallback ){
 			{
-				modified[0]->m_opaqueFrameHandler = handler;
-				m_server->QueueFrameToAll(handler, GetResponse());
+				std::lock_guard<std::mutex> lock(m_infoMutex);
+				ApplySiteStatus(inputMessage, handler);
 			}
+			if (!m_config.m_broadcastInterval)
+				FlushChanges();
 		}));
 
 		handler->QueueFrame(GetResponse());
@@ -110,13 +169,19 @@ void CoordinatorServer::Start()
 
 	m_server->SetHandlerDestroyCallback([this](SocketFrameHandler * handler){
 		std::lock_guard<std::mutex> lock(m_infoMutex);
+		// relay handler has many tool servers.
+		m_relayHandlers.erase(handler);
 		auto toolServerIt =  m_info.m_toolServers.begin();
-		for (;toolServerIt != m_info.m_toolServers.end(); ++toolServerIt )
+		while (toolServerIt != m_info.m_toolServers.end())
 		{
 		   if ( toolServerIt->m_opaqueFrameHandler == handler)
 		   {
-			   m_info.m_toolServers.erase(toolServerIt);
-			   break;
+			   AddChanged(*toolServerIt, true);
+			   toolServerIt = m_info.m_toolServers.erase(toolServerIt);
+		   }
+		   else
+		   {
+			   ++toolServerIt;
 		   }
 		}
 		auto activeSessionIt =  m_info.m_activeSessions.begin();
@@ -128,9 +193,22 @@ void CoordinatorServer::Start()
 			   break;
 		   }
 		}
-		// do not send info update immediately, no need.
+		// do not send info update immediately, removal will be sent with next changes.
 	});
 	m_server->Start();
+	if (m_config.m_broadcastInterval)
+		m_broadcastThread.Exec(std::bind(&CoordinatorServer::FlushChanges, this), m_config.m_broadcastInterval.GetUS());
+
+	if (m_config.IsRelay())
+	{
+		m_upstream.reset(new CoordinatorClient());
+		if (!m_upstream->SetConfig(m_config.m_upstream))
+			return;
+		m_upstream->SetInfoArrivedCallback([this](const CoordinatorInfo & info){
+			ApplyUpstreamInfo(info);
+		});
+		m_upstream->Start();
+	}
 }
 
 std::shared_ptr<CoordinatorListResponse> CoordinatorServer::GetResponse()
@@ -139,8 +217,177 @@ std::shared_ptr<CoordinatorListResponse> CoordinatorServer::GetResponse()
 	{
 		std::lock_guard<std::mutex> lock(m_infoMutex);
 		infoList->m_info = m_info;
+		infoList->m_sequence = m_sequence;
 	}
 	return infoList;
 }
 
+void CoordinatorServer::AddChanged(const ToolServerInfo &toolServer, bool removed)
+{
+	auto eraseSame = [&toolServer](std::deque<ToolServerInfo> & list) {
+		for (auto it = list.begin(); it != list.end(); ++it)
+		{
+			if (it->EqualIdTo(toolServer))
+			{
+				list.erase(it);
+				return;
+			}
+		}
+	};
+	eraseSame(m_changedToolServers);
+	eraseSame(m_removedToolServers);
+	if (removed)
+	{
+		ToolServerInfo removedId;
+		removedId.m_toolServerId   = toolServer.m_toolServerId;
+		removedId.m_connectionHost = toolServer.m_connectionHost;
+		removedId.m_connectionPort = toolServer.m_connectionPort;
+		m_removedToolServers.push_back(removedId);
+	}
+	else
+	{
+		m_changedToolServers.push_back(toolServer);
+	}
+}
+
+void CoordinatorServer::FlushChanges()
+{
+	// sequence increment and queueing should be atomic, otherwise peers could receive deltas out of order.
+	std::lock_guard<std::mutex> broadcastLock(m_broadcastMutex);
+	CoordinatorListDelta::Ptr delta(new CoordinatorListDelta());
+	std::deque<ToolServerInfo> siteSummary;
+	{
+		std::lock_guard<std::mutex> lock(m_infoMutex);
+		UpdateHealthReports();
+		if (m_changedToolServers.empty() && m_removedToolServers.empty())
+			return;
+
+		delta->m_baseSequence = m_sequence++;
+		delta->m_sequence = m_sequence;
+		delta->m_changedToolServers.swap(m_changedToolServers);
+		delta->m_removedToolServers.swap(m_removedToolServers);
+		if (m_upstream)
+			siteSummary = GetSiteSummary();
+	}
+	m_server->QueueFrameToAll(nullptr, delta);
+	if (m_upstream)
+		m_upstream->SetSiteStatus(m_config.m_siteName, siteSummary);
+}
+
+void CoordinatorServer::UpdateHealthReports()
+{
+	const TimePoint now(true);
+	m_healthReports.erase(std::remove_if(m_healthReports.begin(), m_healthReports.end(), [&now](const HealthReport & report){
+		return report.m_expiration < now;
+	}), m_healthReports.end());
+
+	for (ToolServerInfo & toolServer : m_info.m_toolServers)
+	{
+		// servers of other sites have counters from their coordinator.
+		if (!toolServer.m_opaqueFrameHandler || m_relayHandlers.count(static_cast<SocketFrameHandler*>(toolServer.m_opaqueFrameHandler)))
+			continue;
+		const uint16_t count = CountHealthReports(toolServer);
+		if (toolServer.m_unhealthyReports == count)
+			continue;
+		toolServer.m_unhealthyReports = count;
+		AddChanged(toolServer, false);
+	}
+}
+
+uint16_t CoordinatorServer::CountHealthReports(const ToolServerInfo &toolServer) const
+{
+	uint16_t count = 0;
+	for (const HealthReport & report : m_healthReports)
+		if (report.m_report.IsFor(toolServer))
+			count++;
+	return count;
+}
+
+void CoordinatorServer::ApplySiteStatus(const CoordinatorSiteStatus &siteStatus, SocketFrameHandler *handler)
+{
+	m_relayHandlers.insert(handler);
+	std::deque<ToolServerInfo> toolServers = siteStatus.m_toolServers;
+	for (ToolServerInfo & toolServer : toolServers)
+		toolServer.m_site = siteStatus.m_site;
+
+	for (ToolServerInfo * modified : m_info.Update(toolServers))
+	{
+		modified->m_opaqueFrameHandler = handler;
+		AddChanged(*modified, false);
+	}
+	auto toolServerIt = m_info.m_toolServers.begin();
+	while (toolServerIt != m_info.m_toolServers.end())
+	{
+		const bool exists = std::any_of(toolServers.cbegin(), toolServers.cend(), [&toolServerIt](const ToolServerInfo & toolServer){
+			return toolServer.EqualIdTo(*toolServerIt);
+		});
+		if (toolServerIt->m_opaqueFrameHandler == handler && !exists)
+		{
+			AddChanged(*toolServerIt, true);
+			toolServerIt = m_info.m_toolServers.erase(toolServerIt);
+		}
+		else
+		{
+			++toolServerIt;
+		}
+	}
+}
+
+void CoordinatorServer::ApplyUpstreamInfo(const CoordinatorInfo &upstreamInfo)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_infoMutex);
+		std::deque<ToolServerInfo> remoteServers;
+		for (const ToolServerInfo & toolServer : upstreamInfo.m_toolServers)
+			if (toolServer.m_site != m_config.m_siteName)
+				remoteServers.push_back(toolServer);
+
+		for (ToolServerInfo * modified : m_info.Update(remoteServers))
+		{
+			modified->m_opaqueFrameHandler = nullptr;
+			AddChanged(*modified, false);
+		}
+		auto toolServerIt = m_info.m_toolServers.begin();
+		while (toolServerIt != m_info.m_toolServers.end())
+		{
+			const bool exists = std::any_of(remoteServers.cbegin(), remoteServers.cend(), [&toolServerIt](const ToolServerInfo & toolServer){
+				return toolServer.EqualIdTo(*toolServerIt);
+			});
+			if (!toolServerIt->m_opaqueFrameHandler && !exists)
+			{
+				AddChanged(*toolServerIt, true);
+				toolServerIt = m_info.m_toolServers.erase(toolServerIt);
+			}
+			else
+			{
+				++toolServerIt;
+			}
+		}
+	}
+	if (!m_config.m_broadcastInterval)
+		FlushChanges();
+}
+
+std::deque<ToolServerInfo> CoordinatorServer::GetSiteSummary() const
+{
+	std::deque<ToolServerInfo> result;
+	for (const ToolServerInfo & toolServer : m_info.m_toolServers)
+	{
+		if (toolServer.m_site != m_config.m_siteName || !toolServer.m_opaqueFrameHandler)
+			continue;
+		ToolServerInfo summary = toolServer;
+		// sessions of this site are not interesting for others, only threads they occupy.
+		ToolServerInfo::ConnectedClientInfo siteClients;
+		siteClients.m_clientId = m_config.m_siteName;
+		siteClients.m_sessionId = -1;
+		for (const auto & client : toolServer.m_connectedClients)
+			siteClients.m_usedThreads += client.m_usedThreads;
+		summary.m_connectedClients.clear();
+		if (siteClients.m_usedThreads)
+			summary.m_connectedClients.push_back(siteClients);
+		result.push_back(summary);
+	}
+	return result;
+}
+
 }
@@ -14,17 +14,31 @@
 #pragma once
 
 #include "CoordinatorTypes.h"
+#include "LeaseManager.h"
 
 #include <CoordinatorServerConfig.h>
+#include <ThreadLoop.h>
 
 #include <mutex>
+#include <set>
 
 namespace Wuild
 {
 class SocketFrameService;
+class SocketFrameHandler;
 class CoordinatorListResponse;
+class CoordinatorSiteStatus;
+class CoordinatorClient;
 
 /// Listens port and sends tool server information to all clients.
+///
+/// New peer receives full snapshot; after that only changed tool servers are broadcasted,
+/// coalesced over broadcast interval. Each broadcast increments sequence number, so peer could detect gap and request snapshot again.
+/// Clients could also ask for slot leases, to avoid piling on the same servers, @see LeaseManager.
+/// Clients report tool servers they stopped using because of failures; number of such reports is broadcasted with server info.
+///
+/// Coordinator with upstream configured is relay for its site: it sends summary of site tool servers upstream
+/// (client sessions are collapsed to one per server), and serves servers of other sites got from upstream to its peers.
 class CoordinatorServer
 {
 public:
@@ -40,12 +54,42 @@ public:
 protected:
 
 	std::shared_ptr<CoordinatorListResponse> GetResponse();
+	/// Should be called with m_infoMutex locked.
+	void AddChanged(const ToolServerInfo & toolServer, bool removed);
+	/// Sends accumulated changes to all peers.
+	void FlushChanges();
+	/// Removes outdated health reports and updates report counters of tool servers. Should be called with m_infoMutex locked.
+	void UpdateHealthReports();
+	uint16_t CountHealthReports(const ToolServerInfo & toolServer) const;
+
+	/// Replaces servers of relay site. Should be called with m_infoMutex locked.
+	void ApplySiteStatus(const CoordinatorSiteStatus & siteStatus, SocketFrameHandler * handler);
+	/// Takes servers of other sites from upstream coordinator.
+	void ApplyUpstreamInfo(const CoordinatorInfo & upstreamInfo);
+	/// Servers of own site for upstream. Should be called with m_infoMutex locked.
+	std::deque<ToolServerInfo> GetSiteSummary() const;
+
 	Config m_config;
 	std::unique_ptr<SocketFrameService> m_server;
 	CoordinatorInfo m_info;
+	LeaseManager m_leases;
 	std::mutex m_infoMutex;
-	//ToolServerSessionInfo::List m_latestSessions;
-	//std::mutex m_latestSessionsMutex;
+
+	struct HealthReport
+	{
+		ToolServerHealthReport m_report;
+		TimePoint m_expiration;
+	};
+	std::deque<HealthReport> m_healthReports;
+
+	std::unique_ptr<CoordinatorClient> m_upstream;
+	std::set<SocketFrameHandler*> m_relayHandlers;
+
+	uint64_t m_sequence = 1;
+	std::deque<ToolServerInfo> m_changedToolServers;
+	std::deque<ToolServerInfo> m_removedToolServers;
+	std::mutex m_broadcastMutex;
+	ThreadLoop m_broadcastThread;
 };
 
 }
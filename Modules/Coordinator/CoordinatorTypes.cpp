@@ -12,6 +12,8 @@
  */
 
 #include "CoordinatorTypes.h"
+
+#include <algorithm>
 #include <sstream>
 
 namespace Wuild
@@ -24,12 +26,21 @@ std::string ToolServerInfo::ToString(bool outputTools, bool outputClients) const
 		<< " threads: " << m_totalThreads
 		<< " queue: " << m_queuedTasks
 		<< " running: " << m_runningTasks
+		<< " speed: " << m_speedScore
 		   ;
+	if (m_unhealthyReports)
+		os << " unhealthy: " << m_unhealthyReports;
+	if (!m_site.empty())
+		os << " site: " << m_site;
 	if (outputTools)
 	{
 		os << " Tools: ";
 		  for (const std::string & t : m_toolIds)
 			  os  << t << ", ";
+		for (const ToolSlots & slots : m_toolSlots)
+			os << " " << slots.m_toolId << " running: " << slots.m_runningTasks << "/" << slots.m_totalThreads << ",";
+		for (const auto & versionPair : m_toolVersions)
+			os << " " << versionPair.first << "=" << versionPair.second << ",";
 	}
 	if (outputClients)
 	{
@@ -58,13 +69,92 @@ bool ToolServerInfo::ConnectedClientInfo::operator ==(const ToolServerInfo::Conn
 			;
 }
 
+bool ToolServerInfo::ToolSlots::operator ==(const ToolServerInfo::ToolSlots &rh) const
+{
+	return true
+			&& m_toolId == rh.m_toolId
+			&& m_totalThreads == rh.m_totalThreads
+			&& m_runningTasks == rh.m_runningTasks
+			;
+}
+
+StringVector ToolServerInfo::GetIncompatibleTools(const ToolVersionMap &toolVersions) const
+{
+	StringVector result;
+	for (const auto & versionPair : toolVersions)
+	{
+		auto it = m_toolVersions.find(versionPair.first);
+		if (it != m_toolVersions.cend() && it->second != versionPair.second)
+			result.push_back(versionPair.first);
+	}
+	return result;
+}
+
+bool ToolServerInfo::HasCompatibleTool(const StringVector &toolIds, const ToolVersionMap &toolVersions) const
+{
+	const StringVector incompatible = GetIncompatibleTools(toolVersions);
+	auto isUsable = [this, &incompatible](const std::string & toolId) {
+		const bool exists = m_toolIds.empty() || std::find(m_toolIds.cbegin(), m_toolIds.cend(), toolId) != m_toolIds.cend();
+		return exists && std::find(incompatible.cbegin(), incompatible.cend(), toolId) == incompatible.cend();
+	};
+	if (toolIds.empty())
+		return incompatible.empty() || incompatible.size() < m_toolIds.size();
+	return std::any_of(toolIds.cbegin(), toolIds.cend(), isUsable);
+}
+
+const ToolServerInfo::ToolSlots *ToolServerInfo::FindToolSlots(const std::string &toolId) const
+{
+	for (const ToolSlots & slots : m_toolSlots)
+		if (slots.m_toolId == toolId)
+			return &slots;
+	return nullptr;
+}
+
+ToolServerInfo::ToolSlots *ToolServerInfo::FindToolSlots(const std::string &toolId)
+{
+	return const_cast<ToolSlots *>(static_cast<const ToolServerInfo*>(this)->FindToolSlots(toolId));
+}
+
 bool ToolServerInfo::operator ==(const ToolServerInfo &rh) const
 {
 	return true
 			&& EqualIdTo(rh)
 			&& m_toolIds == rh.m_toolIds
 			&& m_totalThreads == rh.m_totalThreads
+			&& m_speedScore == rh.m_speedScore
+			&& m_unhealthyReports == rh.m_unhealthyReports
+			&& m_toolVersions == rh.m_toolVersions
+			&& m_site == rh.m_site
 			&& m_connectedClients == rh.m_connectedClients
+			&& m_toolSlots == rh.m_toolSlots
+			;
+}
+
+bool ToolServerLoad::operator ==(const ToolServerLoad &rh) const
+{
+	return true
+			&& m_runningTasks == rh.m_runningTasks
+			&& m_queuedTasks == rh.m_queuedTasks
+			&& m_estimatedWait == rh.m_estimatedWait
+			&& m_avgExecutionTime == rh.m_avgExecutionTime
+			;
+}
+
+bool ToolServerLease::IsFor(const ToolServerInfo &toolServer) const
+{
+	return true
+			&& m_toolServerId == toolServer.m_toolServerId
+			&& m_connectionHost == toolServer.m_connectionHost
+			&& m_connectionPort == toolServer.m_connectionPort
+			;
+}
+
+bool ToolServerHealthReport::IsFor(const ToolServerInfo &toolServer) const
+{
+	return true
+			&& m_toolServerId == toolServer.m_toolServerId
+			&& m_connectionHost == toolServer.m_connectionHost
+			&& m_connectionPort == toolServer.m_connectionPort
 			;
 }
 
@@ -105,6 +195,28 @@ std::vector<ToolServerInfo *> CoordinatorInfo::Update(const std::deque<ToolServe
 	return res;
 }
 
+bool CoordinatorInfo::Remove(const ToolServerInfo &toolServer)
+{
+	for (auto toolServerIt = m_toolServers.begin(); toolServerIt != m_toolServers.end(); ++toolServerIt)
+	{
+		if (toolServerIt->EqualIdTo(toolServer))
+		{
+			m_toolServers.erase(toolServerIt);
+			return true;
+		}
+	}
+	return false;
+}
+
+CoordinatorInfo::VersionMatrix CoordinatorInfo::GetVersionMatrix() const
+{
+	VersionMatrix result;
+	for (size_t index = 0; index < m_toolServers.size(); ++index)
+		for (const auto & versionPair : m_toolServers[index].m_toolVersions)
+			result[versionPair.first][versionPair.second].push_back(index);
+	return result;
+}
+
 std::string CoordinatorInfo::ToString(bool outputTools, bool outputClients) const
 {
 	std::ostringstream os;
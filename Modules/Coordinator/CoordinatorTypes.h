@@ -17,9 +17,13 @@
 #include <CommonTypes.h>
 
 #include <deque>
+#include <map>
 
 namespace Wuild
 {
+/// Tool id => version. Tools which versions are not checked are omitted.
+using ToolVersionMap = std::map<std::string, std::string>;
+
 /// Information about remote tool server state.
 struct ToolServerInfo
 {
@@ -30,6 +34,10 @@ struct ToolServerInfo
 	uint16_t m_totalThreads = 0;
 	uint16_t m_queuedTasks = 0;
 	uint16_t m_runningTasks = 0;
+	uint32_t m_speedScore = 0;   //!< Relative speed of one thread, from startup benchmark and observed compile times. 0 = unknown.
+	uint16_t m_unhealthyReports = 0; //!< Number of sessions which recently stopped using server because of failures; set by coordinator.
+	ToolVersionMap m_toolVersions;
+	std::string m_site;          //!< Site of coordinator server registered on; set by coordinator.
 
 	struct ConnectedClientInfo
 	{
@@ -41,6 +49,30 @@ struct ToolServerInfo
 		bool operator !=(const ConnectedClientInfo& rh) const { return !(*this == rh);}
 	};
 	std::vector<ConnectedClientInfo> m_connectedClients;
+
+	/// Concurrency limit for specific tool.
+	struct ToolSlots
+	{
+		std::string m_toolId;
+		uint16_t m_totalThreads = 0;
+		uint16_t m_runningTasks = 0;
+
+		uint16_t GetFreeThreads() const { return m_runningTasks < m_totalThreads ? m_totalThreads - m_runningTasks : 0; }
+
+		bool operator ==(const ToolSlots& rh) const;
+		bool operator !=(const ToolSlots& rh) const { return !(*this == rh);}
+	};
+	std::vector<ToolSlots> m_toolSlots; //!< tools with own limit; other tools are limited only by m_totalThreads.
+
+	/// Tools from toolVersions which server has with another version. Tool with unknown version is considered compatible.
+	StringVector GetIncompatibleTools(const ToolVersionMap & toolVersions) const;
+	/// Server has at least one of toolIds (or toolIds is empty) of compatible version.
+	bool HasCompatibleTool(const StringVector & toolIds, const ToolVersionMap & toolVersions) const;
+
+	/// Returns nullptr if tool has no own limit.
+	const ToolSlots * FindToolSlots(const std::string & toolId) const;
+	ToolSlots * FindToolSlots(const std::string & toolId);
+
 	std::string ToString(bool outputTools = false, bool outputClients = false) const;
 	bool EqualIdTo(const ToolServerInfo & rh) const;
 
@@ -50,6 +82,41 @@ struct ToolServerInfo
 	bool operator !=(const ToolServerInfo& rh) const { return !(*this == rh);}
 };
 
+/// Current tool server load, sent by server directly to its clients; fresher than coordinator info.
+struct ToolServerLoad
+{
+	uint16_t m_runningTasks = 0;   //!< Accepted tasks, including queued ones.
+	uint16_t m_queuedTasks = 0;    //!< Tasks waiting for free thread.
+	TimePoint m_estimatedWait;     //!< Queue wait for new task.
+	TimePoint m_avgExecutionTime;  //!< Moving average of task execution time.
+
+	bool operator ==(const ToolServerLoad& rh) const;
+	bool operator !=(const ToolServerLoad& rh) const { return !(*this == rh);}
+};
+
+/// Slots on tool server granted by coordinator to one session for limited time.
+struct ToolServerLease
+{
+	std::string m_toolServerId;
+	std::string m_connectionHost;
+	int16_t m_connectionPort = 0;
+	uint16_t m_slots = 0;
+
+	bool IsFor(const ToolServerInfo & toolServer) const;
+};
+
+/// Client session stopped (tripped) or resumed using tool server because of its failures.
+struct ToolServerHealthReport
+{
+	std::string m_toolServerId;
+	std::string m_connectionHost;
+	int16_t m_connectionPort = 0;
+	int64_t m_sessionId = 0;
+	bool m_tripped = false;
+
+	bool IsFor(const ToolServerInfo & toolServer) const;
+};
+
 /// Information about finished compilation session (sequence of tool executions)
 struct ToolServerSessionInfo
 {
@@ -75,11 +142,18 @@ struct CoordinatorInfo
 	std::deque<ToolServerInfo>   m_toolServers;
 	ToolServerSessionInfo::List  m_latestSessions;
 	ToolServerSessionInfo::List  m_activeSessions;
+	std::string                  m_site;  //!< Site of coordinator which sent info; tool servers of other sites are remote.
 
 	/// returns list of changed items pointers.
 	std::vector<ToolServerInfo*> Update(const ToolServerInfo & newToolServer);
 	/// returns list of changed items pointers.
 	std::vector<ToolServerInfo*> Update(const std::deque<ToolServerInfo> &newNoolServers);
+	/// returns true if tool server with same id was found.
+	bool Remove(const ToolServerInfo & toolServer);
+
+	/// Tool id => version => indices of tool servers.
+	using VersionMatrix = std::map<std::string, std::map<std::string, std::vector<size_t>>>;
+	VersionMatrix GetVersionMatrix() const;
 
 	std::string ToString(bool outputTools = false, bool outputClients = false) const;
 
@@ -0,0 +1,149 @@
+/*
+ * Copyright (C) 2018 Smirnov Vladimir mapron1@gmail.com
+ * Source code licensed under the Apache License, Version 2.0 (the "License");
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at http://www.apache.org/licenses/LICENSE-2.0 or in file COPYING-APACHE-2.0.txt
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.h
+ */
+
+#include "LeaseManager.h"
+
+#include <algorithm>
+
+namespace Wuild
+{
+
+std::deque<ToolServerLease> LeaseManager::Acquire(const std::deque<ToolServerInfo> &toolServers,
+												  int64_t sessionId,
+												  uint16_t requestedSlots,
+												  uint16_t usedSlots,
+												  const StringVector &toolIds,
+												  const ToolVersionMap &toolVersions,
+												  const TimePoint &now)
+{
+	RemoveExpired(now);
+	Session previous;
+	auto sessionIt = m_sessions.find(sessionId);
+	if (sessionIt != m_sessions.end())
+	{
+		previous = sessionIt->second;
+		m_sessions.erase(sessionIt);
+	}
+	if (!requestedSlots)
+		return {};
+
+	struct ServerSlots
+	{
+		const ToolServerInfo * m_info = nullptr;
+		int m_leasedByOthers = 0;
+		int m_previous = 0;
+		int m_mine = 0;
+		int GetFree() const { return m_info->m_totalThreads - m_leasedByOthers - m_mine; }
+	};
+	std::vector<ServerSlots> servers;
+	int totalSlots = 0;
+	for (const ToolServerInfo & toolServer : toolServers)
+	{
+		if (!toolServer.m_totalThreads)
+			continue;
+		if (!toolServer.HasCompatibleTool(toolIds, toolVersions))
+			continue;
+		ServerSlots server;
+		server.m_info = &toolServer;
+		for (const auto & session : m_sessions)
+			for (const ToolServerLease & lease : session.second.m_leases)
+				if (lease.IsFor(toolServer))
+					server.m_leasedByOthers += lease.m_slots;
+		for (const ToolServerLease & lease : previous.m_leases)
+			if (lease.IsFor(toolServer))
+				server.m_previous = lease.m_slots;
+
+		totalSlots += toolServer.m_totalThreads;
+		servers.push_back(server);
+	}
+	if (servers.empty())
+		return {};
+
+	const int fairShare = std::max(1, totalSlots / static_cast<int>(m_sessions.size() + 1));
+	int reserved = 0;
+	for (const auto & session : m_sessions)
+		reserved += std::max(session.second.m_leasedSlots, std::min(session.second.m_requestedSlots, fairShare));
+	int remain = std::min(int(requestedSlots), std::max(totalSlots - reserved, int(usedSlots)));
+
+	// keep previous placement first, so running tasks stay inside lease.
+	for (ServerSlots & server : servers)
+	{
+		const int take = std::min(remain, server.m_previous);
+		server.m_mine += take;
+		remain -= take;
+	}
+	while (remain > 0)
+	{
+		ServerSlots * best = &servers[0];
+		for (ServerSlots & server : servers)
+			if (server.GetFree() > best->GetFree())
+				best = &server;
+
+		if (best->GetFree() > 0)
+		{
+			const int take = std::min(remain, best->GetFree());
+			best->m_mine += take;
+			remain -= take;
+			continue;
+		}
+		// running tasks are not covered by free slots (e.g. lease expired meanwhile): place them on least loaded server.
+		auto overload = [](const ServerSlots & server) {
+			return double(server.m_leasedByOthers + server.m_mine + 1) / server.m_info->m_totalThreads;
+		};
+		for (ServerSlots & server : servers)
+			if (overload(server) < overload(*best))
+				best = &server;
+		best->m_mine++;
+		remain--;
+	}
+
+	Session & session = m_sessions[sessionId];
+	session.m_expiration = now + m_duration;
+	session.m_requestedSlots = requestedSlots;
+	for (const ServerSlots & server : servers)
+	{
+		if (!server.m_mine)
+			continue;
+		ToolServerLease lease;
+		lease.m_toolServerId   = server.m_info->m_toolServerId;
+		lease.m_connectionHost = server.m_info->m_connectionHost;
+		lease.m_connectionPort = server.m_info->m_connectionPort;
+		lease.m_slots          = static_cast<uint16_t>(server.m_mine);
+		session.m_leases.push_back(lease);
+		session.m_leasedSlots += lease.m_slots;
+	}
+	return session.m_leases;
+}
+
+uint16_t LeaseManager::GetLeasedSlots(const ToolServerInfo &toolServer) const
+{
+	uint16_t result = 0;
+	for (const auto & session : m_sessions)
+		for (const ToolServerLease & lease : session.second.m_leases)
+			if (lease.IsFor(toolServer))
+				result += lease.m_slots;
+	return result;
+}
+
+void LeaseManager::RemoveExpired(const TimePoint &now)
+{
+	for (auto it = m_sessions.begin(); it != m_sessions.end(); )
+	{
+		if (it->second.m_expiration < now)
+			it = m_sessions.erase(it);
+		else
+			++it;
+	}
+}
+
+}
@@ -0,0 +1,66 @@
+/*
+ * Copyright (C) 2018 Smirnov Vladimir mapron1@gmail.com
+ * Source code licensed under the Apache License, Version 2.0 (the "License");
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at http://www.apache.org/licenses/LICENSE-2.0 or in file COPYING-APACHE-2.0.txt
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.h
+ */
+
+#pragma once
+
+#include "CoordinatorTypes.h"
+
+#include <map>
+
+namespace Wuild
+{
+/**
+ * Grants time-limited tool server slots to sessions.
+ *
+ * Free slots are granted to anyone who asks, except slots reserved for other sessions which got less than
+ * their fair share (total slots / sessions). Lease never shrinks below tasks session is running already,
+ * so slots of session above its fair share are passed to waiting sessions as its tasks finish, without oversubscription.
+ * Existing leases are kept on the same servers where possible, new ones go to servers with most free slots.
+ *
+ * Not thread-safe; coordinator calls it under info lock.
+ */
+class LeaseManager
+{
+public:
+	void SetDuration(const TimePoint & duration) { m_duration = duration; }
+	const TimePoint & GetDuration() const { return m_duration; }
+
+	/// Replaces leases of session with new ones for up to requestedSlots; zero slots releases them.
+	/// usedSlots - tasks session is running now. Only servers having one of toolIds of same version as in toolVersions are leased.
+	std::deque<ToolServerLease> Acquire(const std::deque<ToolServerInfo> & toolServers,
+										int64_t sessionId,
+										uint16_t requestedSlots,
+										uint16_t usedSlots,
+										const StringVector & toolIds,
+										const ToolVersionMap & toolVersions,
+										const TimePoint & now = TimePoint(true));
+
+	/// Slots leased on tool server by all sessions.
+	uint16_t GetLeasedSlots(const ToolServerInfo & toolServer) const;
+	size_t GetSessionsCount() const { return m_sessions.size(); }
+
+protected:
+	struct Session
+	{
+		std::deque<ToolServerLease> m_leases;
+		int m_leasedSlots = 0;
+		int m_requestedSlots = 0;
+		TimePoint m_expiration;
+	};
+	void RemoveExpired(const TimePoint & now);
+
+	std::map<int64_t, Session> m_sessions;
+	TimePoint m_duration = 10.0;
+};
+
+}
@@ -29,14 +29,22 @@ namespace Wuild
 
 namespace 
 {
+/// Memoized results for flags and rules; cache is dropped on overflow, when commands are mostly unique.
+const size_t g_cacheLimit = 10000;
 
 bool IsSpace(char c) { return c == ' '  || c == '\t'; }
 bool IsQuote(char c) { return c == '\"' || c == '\''; }
 
 // not a real cmd parser funstion; it just skips quoted strings, doing no unescape.
-StringVector SplitShellCommand(const std::string & str)
+void SplitShellCommand(const std::string & str, StringVector & ret)
 {
-	StringVector ret;
+	// most of arguments are already split.
+	if (std::none_of(str.cbegin(), str.cend(), [](char c) { return IsSpace(c) || IsQuote(c); }))
+	{
+		if (!str.empty())
+			ret.push_back(str);
+		return;
+	}
 #ifndef _WIN32
 	bool escape = false;
 #endif
@@ -81,8 +89,6 @@ StringVector SplitShellCommand(const std::string & str)
 	
 	if (!buffer.empty())
 		ret.emplace_back(buffer);
-	
-	return ret;
 }
 }
 
@@ -91,6 +97,41 @@ InvocationRewriter::InvocationRewriter() = default;
 void InvocationRewriter::SetConfig(const IInvocationRewriter::Config &config)
 {
 	m_config = config;
+	m_tools.clear();
+	m_toolsById.clear();
+	m_toolsByName.clear();
+	for (const Config::Tool & unit : m_config.m_tools)
+	{
+		ToolInfo info;
+		info.m_tool = unit;
+		info.m_id.m_toolId = unit.m_id;
+		if (!unit.m_names.empty())
+			info.m_id.m_toolExecutable = unit.m_names[0];
+		info.m_valid = unit.m_type == Config::ToolchainType::GCC
+					|| unit.m_type == Config::ToolchainType::MSVC
+					|| unit.m_type == Config::ToolchainType::UpdateFile;
+		info.m_remoteId = unit.m_remoteAlias.empty() ? unit.m_id : unit.m_remoteAlias;
+		m_tools.push_back(info);
+	}
+	// first match wins, as with search in tools list.
+	for (size_t i = 0; i < m_tools.size(); ++i)
+	{
+		if (!m_tools[i].m_tool.m_id.empty())
+			m_toolsById.emplace(m_tools[i].m_tool.m_id, i);
+		for (const std::string & name : m_tools[i].m_tool.m_names)
+			m_toolsByName.emplace(name, i);
+	}
+	for (size_t i = 0; i < m_tools.size(); ++i)
+	{
+		if (!m_tools[i].m_tool.m_remoteAlias.empty())
+			m_toolsById.emplace(m_tools[i].m_tool.m_remoteAlias, i);
+	}
+
+	std::lock_guard<std::mutex> lock(m_cacheMutex);
+	m_executableCache.clear();
+	m_splitCache.clear();
+	m_remotePossibleCache.clear();
+	m_filterCache.clear();
 }
 
 const IInvocationRewriter::Config &InvocationRewriter::GetConfig() const
@@ -100,26 +141,47 @@ const IInvocationRewriter::Config &InvocationRewriter::GetConfig() const
 
 bool InvocationRewriter::SplitInvocation(const ToolInvocation & original, ToolInvocation &preprocessor, ToolInvocation &compilation, std::string * remoteToolId)
 {
-	ToolInfo toolInfo = CompileInfoById(original.m_id);
-	if (!toolInfo.m_parser)
+	const ToolInfo * info = FindTool(original.m_id);
+	if (!info || !info->m_valid)
 		return false;
-	ToolInvocation origComplete = CompleteInvocation(original);
 
-	if (origComplete.m_type != ToolInvocation::InvokeType::Compile)
+	const std::string key = GetCacheKey(original);
+	SplitResult result;
+	if (!FindCached(m_splitCache, key, result))
+	{
+		SplitInvocationUncached(original, result);
+		AddCached(m_splitCache, key, result);
+	}
+	if (!result.m_result)
 		return false;
 
 	if (remoteToolId)
-		*remoteToolId = toolInfo.m_remoteId;
-	toolInfo.m_parser->SetToolInvocation(origComplete);
-	toolInfo.m_parser->SetInvokeType(ToolInvocation::InvokeType::Preprocess);
-	toolInfo.m_parser->RemoveLocalFlags();
-	preprocessor = toolInfo.m_parser->GetToolInvocation();
-
-	toolInfo.m_parser->SetToolInvocation(origComplete);
-	toolInfo.m_parser->RemoveLocalFlags();
-	toolInfo.m_parser->RemovePrepocessorFlags();
-	toolInfo.m_parser->RemoveDependencyFiles();
-	compilation = toolInfo.m_parser->GetToolInvocation();
+		*remoteToolId = result.m_remoteToolId;
+	preprocessor = result.m_preprocessor;
+	compilation = result.m_compilation;
+	return true;
+}
+
+bool InvocationRewriter::SplitInvocationUncached(const ToolInvocation & original, SplitResult & result) const
+{
+	const ToolInfo * info = FindTool(original.m_id);
+	auto parser = CreateParser(*info);
+	ToolInvocation origComplete = CompleteInvocation(original, info, parser.get());
+
+	if (origComplete.m_type != ToolInvocation::InvokeType::Compile)
+		return false;
+
+	result.m_remoteToolId = info->m_remoteId;
+	parser->SetToolInvocation(origComplete);
+	parser->SetInvokeType(ToolInvocation::InvokeType::Preprocess);
+	parser->RemoveLocalFlags();
+	ToolInvocation preprocessor = parser->GetToolInvocation();
+
+	parser->SetToolInvocation(origComplete);
+	parser->RemoveLocalFlags();
+	parser->RemovePrepocessorFlags();
+	parser->RemoveDependencyFiles();
+	ToolInvocation compilation = parser->GetToolInvocation();
 
 	const std::string srcFilename = origComplete.GetInput(); // we hope  .cpp is coming after -c flag. It's naive.
 	const std::string objFilename = origComplete.GetOutput();
@@ -131,74 +193,99 @@ bool InvocationRewriter::SplitInvocation(const ToolInvocation & original, ToolIn
 		preprocessor.SetOutput(preprocessedFilename);
 		compilation.SetInput(preprocessedFilename);
 	}
-
+	result.m_preprocessor = std::move(preprocessor);
+	result.m_compilation = std::move(compilation);
+	result.m_result = true;
 	return true;
 }
 
 ToolInvocation InvocationRewriter::CompleteInvocation(const ToolInvocation &original) const
 {
-	ToolInvocation inv = original;
-	inv.m_type = ToolInvocation::InvokeType::Unknown;
-	inv.m_args.clear();
+	const ToolInfo * info = FindTool(original.m_id);
+	ICommandLineParser::Ptr parser;
+	if (info && info->m_valid)
+		parser = CreateParser(*info);
+	return CompleteInvocation(original, info, parser.get());
+}
+
+ToolInvocation InvocationRewriter::CompleteInvocation(const ToolInvocation & original, const ToolInfo * info, ICommandLineParser * parser) const
+{
+	ToolInvocation inv;
+	inv.m_id = original.m_id;
+	inv.m_ignoredArgs = original.m_ignoredArgs;
+	inv.m_inputNameIndex = original.m_inputNameIndex;
+	inv.m_outputNameIndex = original.m_outputNameIndex;
+	inv.m_args.reserve(original.m_args.size());
 	for (const auto& arg : original.m_args)
-	{
-		StringVector argSplit = SplitShellCommand(arg);
-		inv.m_args.insert(inv.m_args.end(), argSplit.begin(), argSplit.end());
-	}
+		SplitShellCommand(arg, inv.m_args);
 
-	ToolInfo info = CompileInfoById(original.m_id);
-	if (info.m_valid)
+	if (info && info->m_valid)
 	{
-		inv.m_id = info.m_id;
+		inv.m_id = info->m_id;
 		inv.m_type = original.m_type;
-		inv = info.m_parser->ProcessToolInvocation(inv);
+		inv = parser->ProcessToolInvocation(inv);
 	}
 	return inv;
 }
 
 ToolInvocation::Id InvocationRewriter::CompleteToolId(const ToolInvocation::Id &original) const
 {
-	ToolInfo info = CompileInfoById(original);
-	if (info.m_valid)
-		return info.m_id;
+	const ToolInfo * info = FindTool(original);
+	if (info && info->m_valid)
+		return info->m_id;
 	
 	return original;
 }
 
 bool InvocationRewriter::CheckRemotePossibleForFlags(const ToolInvocation & original) const
 {
-	ToolInfo info = CompileInfoById(original.m_id);
-	if (info.m_valid)
-	{
-		ToolInvocation flags = CompleteInvocation(original);
-		info.m_parser->SetToolInvocation(flags);
-		return info.m_parser->IsRemotePossible();
-	}
-	return false;
+	const ToolInfo * info = FindTool(original.m_id);
+	if (!info || !info->m_valid)
+		return false;
+
+	const std::string key = GetCacheKey(original);
+	bool result = false;
+	if (FindCached(m_remotePossibleCache, key, result))
+		return result;
+
+	auto parser = CreateParser(*info);
+	ToolInvocation flags = CompleteInvocation(original, info, parser.get());
+	parser->SetToolInvocation(flags);
+	result = parser->IsRemotePossible();
+	AddCached(m_remotePossibleCache, key, result);
+	return result;
 }
 
 ToolInvocation InvocationRewriter::FilterFlags(const ToolInvocation &original) const
 {
-	ToolInfo info = CompileInfoById(original.m_id);
-	if (info.m_valid)
+	const ToolInfo * info = FindTool(original.m_id);
+	if (!info || !info->m_valid)
+		return original;
+
+	const std::string key = GetCacheKey(original);
+	ToolInvocation result;
+	if (FindCached(m_filterCache, key, result))
+		return result;
+
+	auto parser = CreateParser(*info);
+	ToolInvocation flags = CompleteInvocation(original, info, parser.get());
+	result = original;
+	if (flags.m_type == ToolInvocation::InvokeType::Preprocess)
 	{
-		 ToolInvocation flags = CompleteInvocation(original);
-		 if (flags.m_type == ToolInvocation::InvokeType::Preprocess)
-		 {
-			info.m_parser->SetToolInvocation(flags);
-			info.m_parser->RemoveLocalFlags();
-			return info.m_parser->GetToolInvocation();
-		 }
-		 if (flags.m_type == ToolInvocation::InvokeType::Compile)
-		 {
-			info.m_parser->SetToolInvocation(flags);
-			info.m_parser->RemovePrepocessorFlags();
-			info.m_parser->RemoveDependencyFiles();
-			info.m_parser->RemoveLocalFlags();
-			return info.m_parser->GetToolInvocation();
-		 }
+		parser->SetToolInvocation(flags);
+		parser->RemoveLocalFlags();
+		result = parser->GetToolInvocation();
 	}
-	return original;
+	else if (flags.m_type == ToolInvocation::InvokeType::Compile)
+	{
+		parser->SetToolInvocation(flags);
+		parser->RemovePrepocessorFlags();
+		parser->RemoveDependencyFiles();
+		parser->RemoveLocalFlags();
+		result = parser->GetToolInvocation();
+	}
+	AddCached(m_filterCache, key, result);
+	return result;
 }
 
 std::string InvocationRewriter::GetPreprocessedPath(const std::string & sourcePath,
@@ -213,94 +300,112 @@ std::string InvocationRewriter::GetPreprocessedPath(const std::string & sourcePa
 
 ToolInvocation InvocationRewriter::PrepareRemote(const ToolInvocation &original) const
 {
-	ToolInvocation inv = CompleteInvocation(original);
-	ToolInfo info = CompileInfoById(original.m_id);
-	if (info.m_valid)
+	const ToolInfo * info = FindTool(original.m_id);
+	ICommandLineParser::Ptr parser;
+	if (info && info->m_valid)
+		parser = CreateParser(*info);
+	ToolInvocation inv = CompleteInvocation(original, info, parser.get());
+	if (info && info->m_valid)
 	{
-		inv.m_id = info.m_id;
-		inv.m_type = original.m_type;
-		inv = info.m_parser->ProcessToolInvocation(inv);
-		if (!info.m_tool.m_appendRemote.empty())
-			inv.m_args.push_back(info.m_tool.m_appendRemote);
+		if (!info->m_tool.m_appendRemote.empty())
+			inv.m_args.push_back(info->m_tool.m_appendRemote);
 
-		if (!info.m_tool.m_removeRemote.empty())
+		if (!info->m_tool.m_removeRemote.empty())
 		{
 			StringVector newArgs;
 			for (const auto & arg : inv.m_args)
-				if (arg != info.m_tool.m_removeRemote)
+				if (arg != info->m_tool.m_removeRemote)
 					newArgs.push_back(arg);
 			newArgs.swap(inv.m_args);
 		}
-		inv.m_id.m_toolId = info.m_remoteId;
+		inv.m_id.m_toolId = info->m_remoteId;
 	}
 	inv.SetInput (FileInfo(inv.GetInput() ).GetFullname());
 	inv.SetOutput(FileInfo(inv.GetOutput()).GetFullname());
 	return inv;
 }
 
-InvocationRewriter::ToolInfo InvocationRewriter::CompileInfoById(const ToolInvocation::Id &id) const
+const InvocationRewriter::ToolInfo * InvocationRewriter::FindTool(const ToolInvocation::Id &id) const
 {
 	if (id.m_toolId.empty())
-		return CompileInfoByExecutable(id.m_toolExecutable);
+		return FindToolByExecutable(id.m_toolExecutable);
 
-	return CompileInfoByToolId(id.m_toolId);
+	return FindToolByToolId(id.m_toolId);
 }
 
-InvocationRewriter::ToolInfo InvocationRewriter::CompileInfoByExecutable(const std::string &executable) const
+const InvocationRewriter::ToolInfo * InvocationRewriter::FindToolByExecutable(const std::string &executable) const
 {
+	const ToolInfo * info = nullptr;
+	if (FindCached(m_executableCache, executable, info))
+		return info;
+
 	const std::string exec = FileInfo::ToPlatformPath(FileInfo::LocatePath(executable));
-	InvocationRewriter::ToolInfo info;
-	for (const Config::Tool & unit : m_config.m_tools)
-	{
-		if (std::find(unit.m_names.cbegin(), unit.m_names.cend(), exec) != unit.m_names.cend())
-		{
-			return CompileInfoByUnit(unit);
-		}
-	}
+	auto it = m_toolsByName.find(exec);
+	if (it != m_toolsByName.cend())
+		info = &m_tools[it->second];
+	AddCached(m_executableCache, executable, info);
 	return info;
 }
 
-InvocationRewriter::ToolInfo InvocationRewriter::CompileInfoByToolId(const std::string &toolId) const
+const InvocationRewriter::ToolInfo * InvocationRewriter::FindToolByToolId(const std::string &toolId) const
 {
-	InvocationRewriter::ToolInfo info;
-	if (toolId.empty())
-		return info;
+	auto it = m_toolsById.find(toolId);
+	return it == m_toolsById.cend() ? nullptr : &m_tools[it->second];
+}
 
-	for (const Config::Tool & unit : m_config.m_tools)
+ICommandLineParser::Ptr InvocationRewriter::CreateParser(const ToolInfo & info)
+{
+	ICommandLineParser::Ptr parser;
+	if (info.m_tool.m_type == Config::ToolchainType::GCC)
+		parser = std::make_shared<GccCommandLineParser>();
+	else if (info.m_tool.m_type == Config::ToolchainType::MSVC)
+		parser = std::make_shared<MsvcCommandLineParser>();
+	else if (info.m_tool.m_type == Config::ToolchainType::UpdateFile)
+		parser = std::make_shared<UpdateFileCommandParser>();
+	return parser;
+}
+
+std::string InvocationRewriter::GetCacheKey(const ToolInvocation & invocation)
+{
+	std::string key;
+	key.reserve(256);
+	key += invocation.m_id.m_toolId;
+	key += '\0';
+	key += invocation.m_id.m_toolExecutable;
+	key += '\0';
+	key += static_cast<char>('0' + static_cast<int>(invocation.m_type));
+	for (const auto & arg : invocation.m_args)
 	{
-		if (unit.m_id == toolId)
-			return CompileInfoByUnit(unit);
+		key += '\0';
+		key += arg;
 	}
-	for (const Config::Tool & unit : m_config.m_tools)
+	key += '\n';
+	for (const auto & arg : invocation.m_ignoredArgs)
 	{
-		if (unit.m_remoteAlias == toolId)
-			return CompileInfoByUnit(unit);
+		key += '\0';
+		key += arg;
 	}
-	return info;
+	return key;
 }
 
-InvocationRewriter::ToolInfo InvocationRewriter::CompileInfoByUnit(const IInvocationRewriter::Config::Tool &unit) const
+template<class T>
+bool InvocationRewriter::FindCached(const Cache<T> & cache, const std::string & key, T & value) const
 {
-	ToolInfo info;
-	info.m_tool = unit;
-	info.m_id.m_toolId = unit.m_id;
-	info.m_id.m_toolExecutable = unit.m_names[0];
-	if (unit.m_type == Config::ToolchainType::GCC)
-		info.m_parser.reset(new GccCommandLineParser());
-	else if (unit.m_type == Config::ToolchainType::MSVC)
-		info.m_parser.reset(new MsvcCommandLineParser());
-	else if (unit.m_type == Config::ToolchainType::UpdateFile)
-		info.m_parser.reset(new UpdateFileCommandParser());
-
-	if (info.m_parser)
-		info.m_valid = true;
-	info.m_remoteId = info.m_id.m_toolId;
-	if (!unit.m_remoteAlias.empty())
-	{
-		info.m_remoteId = unit.m_remoteAlias;
-	}
-	return info;
+	std::lock_guard<std::mutex> lock(m_cacheMutex);
+	auto it = cache.find(key);
+	if (it == cache.cend())
+		return false;
+	value = it->second;
+	return true;
 }
 
+template<class T>
+void InvocationRewriter::AddCached(Cache<T> & cache, const std::string & key, const T & value) const
+{
+	std::lock_guard<std::mutex> lock(m_cacheMutex);
+	if (cache.size() >= g_cacheLimit)
+		cache.clear();
+	cache.emplace(key, value);
+}
 
 }
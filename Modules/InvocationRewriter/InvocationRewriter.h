@@ -16,6 +16,9 @@
 #include "IInvocationRewriter.h"
 #include "ICommandLineParser.h"
 
+#include <mutex>
+#include <unordered_map>
+
 namespace Wuild
 {
 
@@ -54,18 +57,46 @@ public:
 private:
 	struct ToolInfo
 	{
-		ICommandLineParser::Ptr m_parser;
 		ToolInvocation::Id m_id;
 		Config::Tool m_tool;
 		std::string m_remoteId;
 		bool m_valid = false;
 	};
-	ToolInfo CompileInfoById(const ToolInvocation::Id & id) const;
-	ToolInfo CompileInfoByExecutable(const std::string & executable) const;
-	ToolInfo CompileInfoByToolId(const std::string & toolId) const;
-	ToolInfo CompileInfoByUnit(const Config::Tool & unit) const;
+	/// Memoized SplitInvocation result.
+	struct SplitResult
+	{
+		bool m_result = false;
+		ToolInvocation m_preprocessor;
+		ToolInvocation m_compilation;
+		std::string m_remoteToolId;
+	};
+	template<class T>
+	using Cache = std::unordered_map<std::string, T>;
+
+	const ToolInfo * FindTool(const ToolInvocation::Id & id) const;
+	const ToolInfo * FindToolByExecutable(const std::string & executable) const;
+	const ToolInfo * FindToolByToolId(const std::string & toolId) const;
+	ToolInvocation CompleteInvocation(const ToolInvocation & original, const ToolInfo * info, ICommandLineParser * parser) const;
+	bool SplitInvocationUncached(const ToolInvocation & original, SplitResult & result) const;
+
+	static ICommandLineParser::Ptr CreateParser(const ToolInfo & info);
+	static std::string GetCacheKey(const ToolInvocation & invocation);
+	template<class T>
+	bool FindCached(const Cache<T> & cache, const std::string & key, T & value) const;
+	template<class T>
+	void AddCached(Cache<T> & cache, const std::string & key, const T & value) const;
 
 	Config m_config;
+	std::vector<ToolInfo> m_tools;
+	std::unordered_map<std::string, size_t> m_toolsById;    //!< tool ids first, then remote aliases.
+	std::unordered_map<std::string, size_t> m_toolsByName;  //!< platform paths from tool names.
+
+	// ninja manifest has rule per target and edge per source, but they share few distinct commands and flags.
+	mutable std::mutex m_cacheMutex;
+	mutable Cache<const ToolInfo*> m_executableCache;       //!< executable as invoked, before PATH lookup.
+	mutable Cache<SplitResult> m_splitCache;
+	mutable Cache<bool> m_remotePossibleCache;
+	mutable Cache<ToolInvocation> m_filterCache;
 };
 
 }
@@ -0,0 +1,72 @@
+/*
+ * Copyright (C) 2017 Smirnov Vladimir mapron1@gmail.com
+ * Source code licensed under the Apache License, Version 2.0 (the "License");
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at http://www.apache.org/licenses/LICENSE-2.0 or in file COPYING-APACHE-2.0.txt
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.h
+ */
+
+#pragma once
+
+#include <Compression.h>
+
+#include <subprocess.h>
+
+#include <stdexcept>
+
+namespace Wuild
+{
+
+/// Compresses stdout of subprocess while it is running, so output does not need temporary file.
+class CompressingOutputSink : public SubprocessOutputSink
+{
+public:
+	CompressingOutputSink(CompressionInfo compressionInfo) : m_compressor(m_data, compressionInfo) {}
+
+	void Append(const char * data, size_t size) override
+	{
+		if (!m_error.empty())
+			return;
+		try
+		{
+			m_compressor.Append(reinterpret_cast<const uint8_t*>(data), size);
+		}
+		catch (std::exception & e)
+		{
+			m_error = e.what();
+		}
+	}
+
+	/// Returns compressed output; on failure returns false and fills error.
+	bool Finish(ByteArrayHolder & data, std::string & error)
+	{
+		if (m_error.empty())
+		{
+			try
+			{
+				m_compressor.Finish();
+			}
+			catch (std::exception & e)
+			{
+				m_error = e.what();
+			}
+		}
+		error = m_error.empty() ? std::string() : "Failed to compress output: " + m_error;
+		data = m_data;
+		return m_error.empty();
+	}
+
+	size_t GetInputSize() const { return m_compressor.GetInputSize(); }
+
+private:
+	ByteArrayHolder m_data;
+	StreamCompressor m_compressor;
+	std::string m_error;
+};
+
+}
@@ -13,12 +13,15 @@
 
 #include "LocalExecutor.h"
 
+#include "CompressingOutputSink.h"
 #include "MsvcEnvironment.h"
+#include "SpawnLauncher.h"
 
 #include <subprocess.h>
 #include <Syslogger.h>
 #include <ThreadUtils.h>
 
+#include <algorithm>
 #include <cassert>
 #include <utility>
 #include <memory>
@@ -26,9 +29,10 @@
 namespace Wuild
 {
 
-LocalExecutor::LocalExecutor(IInvocationRewriter::Ptr invocationRewriter, std::string tempPath, const std::shared_ptr<SubprocessSet> & subprocessSet)
+LocalExecutor::LocalExecutor(IInvocationRewriter::Ptr invocationRewriter, std::string tempPath, const std::shared_ptr<SubprocessSet> & subprocessSet, std::shared_ptr<SpawnLauncher> spawnLauncher)
 	: m_invocationRewriter(std::move(std::move(invocationRewriter)))
 	, m_tempPath(std::move(tempPath))
+	, m_spawnLauncher(std::move(spawnLauncher))
 	, m_subprocs(subprocessSet)
 {
 }
@@ -38,14 +42,33 @@ void LocalExecutor::Start()
 	m_thread.Exec(std::bind(&LocalExecutor::Quant, this));
 }
 
+void LocalExecutor::StartPostProcessThreads()
+{
+	// reading and compressing output is much cheaper than tool execution, so pool is smaller than process limit.
+	const size_t required = std::max(size_t(1), std::min(m_maxSubProcesses / 4, size_t(16)));
+	while (m_postProcessThreads.size() < required)
+	{
+		m_postProcessThreads.emplace_back();
+		m_postProcessThreads.back().Exec(std::bind(&LocalExecutor::PostProcessQuant, this), 0);
+	}
+}
+
 void LocalExecutor::AddTask(LocalExecutorTask::Ptr task)
 {
-	Guard guard(m_queueMutex);
+	std::unique_lock<std::mutex> lock(m_queueMutex);
+	if (m_stopping)
+	{
+		// task callbacks run during destruction may add more tasks.
+		lock.unlock();
+		task->m_callback(LocalExecutorResult::Ptr(new LocalExecutorResult("Local executor is stopped.", false)));
+		return;
+	}
 
 	if (!m_thread.IsRunning())
 		Start();
+	StartPostProcessThreads();
 
-	m_taskQueue.push(task);
+	m_taskQueue.push_back(task);
 }
 
 void LocalExecutor::SyncExecTask(LocalExecutorTask::Ptr task)
@@ -86,6 +109,7 @@ ILocalExecutor::TaskPair LocalExecutor::SplitTask(LocalExecutorTask::Ptr task, s
 	LocalExecutorTask::Ptr taskCC(new LocalExecutorTask());
 	taskPP->m_writeInput = taskCC->m_writeInput = task->m_writeInput;
 	taskPP->m_readOutput = taskCC->m_readOutput = task->m_readOutput;
+	taskPP->m_cwd = taskCC->m_cwd = task->m_cwd;
 	taskPP->m_invocation = pp;
 	taskCC->m_invocation = cc;
 
@@ -102,18 +126,53 @@ void LocalExecutor::SetThreadCount(int threads)
 	m_maxSubProcesses = threads;
 }
 
+void LocalExecutor::SetToolThreadCount(const std::string &toolId, int threads)
+{
+	Guard guard(m_queueMutex);
+	m_toolThreadLimits[toolId] = threads;
+}
+
 size_t LocalExecutor::GetQueueSize() const
 {
 	Guard guard(m_queueMutex);
 	return m_taskQueue.size();
 }
 
-LocalExecutor::~LocalExecutor() = default;
+LocalExecutor::~LocalExecutor()
+{
+	{
+		Guard guard(m_queueMutex);
+		m_stopping = true;
+	}
+	// no more processes are reaped, so no more post-processing jobs are queued.
+	m_thread.Stop();
+
+	// finish queued jobs, so every task callback is called.
+	while (true)
+	{
+		PostProcessJob job;
+		{
+			std::lock_guard<std::mutex> lock(m_postProcessMutex);
+			if (m_postProcessQueue.empty())
+				break;
+			job = std::move(m_postProcessQueue.front());
+			m_postProcessQueue.pop_front();
+		}
+		PostProcess(job.first, job.second);
+	}
+	for (ThreadLoop & thread : m_postProcessThreads)
+		thread.Stop();
+}
 
 void LocalExecutor::CheckSubprocs()
 {
 	if (!m_subprocs)
+	{
 		m_subprocs = std::make_shared<SubprocessSet>(false);
+#ifndef _WIN32
+		m_subprocs->SetLauncher(m_spawnLauncher.get());
+#endif
+	}
 }
 
 
@@ -122,10 +181,19 @@ LocalExecutorTask::Ptr LocalExecutor::GetNextTask()
 	LocalExecutorTask::Ptr task;
 	{
 		Guard guard(m_queueMutex);
-		if (!m_taskQueue.empty())
+		for (auto it = m_taskQueue.begin(); it != m_taskQueue.end(); ++it)
 		{
-			task = m_taskQueue.front();
-			m_taskQueue.pop();
+			if (!m_toolThreadLimits.empty())
+			{
+				// skip tasks for tools which reached own limit, so they do not block other tools.
+				const auto toolId = m_invocationRewriter->CompleteToolId((*it)->m_invocation.m_id).m_toolId;
+				auto limitIt = m_toolThreadLimits.find(toolId);
+				if (limitIt != m_toolThreadLimits.end() && m_toolRunning[toolId] >= limitIt->second)
+					continue;
+			}
+			task = *it;
+			m_taskQueue.erase(it);
+			break;
 		}
 	}
 	return task;
@@ -179,13 +247,19 @@ void LocalExecutor::Quant()
 				}
 				task->m_invocation = inv;
 				task->m_executionStart = TimePoint(true);
-				Subprocess * addsubproc = m_subprocs->Add(cmd, false, env);
+				std::unique_ptr<CompressingOutputSink> sink;
+				if (task->m_streamOutput)
+					sink.reset(new CompressingOutputSink(task->m_compressionOutput));
+				Subprocess * addsubproc = m_subprocs->Add(cmd, false, env, task->m_cwd, sink.get());
 				if (!addsubproc)
 				{
 					task->ErrorResult("Failed to execute: " + cmd );
 					break;
 				}
 				m_subprocToTask[addsubproc] = task;
+				if (sink)
+					m_subprocToSink[addsubproc] = std::move(sink);
+				m_toolRunning[inv.m_id.m_toolId]++;
 			} while(false);
 		}
 		else
@@ -203,40 +277,78 @@ void LocalExecutor::Quant()
 			return;
 		}
 
-		LocalExecutorResult::Ptr result(new LocalExecutorResult());
-		result->m_result = subproc->Finish() == ExitSuccess;
-		result->m_stdOut = subproc->GetOutput();
-
-		auto taskIter = m_subprocToTask.find(subproc);
-		assert(taskIter != m_subprocToTask.end());
-		LocalExecutorTask::Ptr task = taskIter->second;
-		m_subprocToTask.erase(taskIter);
-		delete subproc;
-
-		result->m_executionTime = task->m_executionStart.GetElapsedTime();
-		const auto & executableName = task->m_invocation.m_id.m_toolExecutable;
-		if (result->m_stdOut.size() < 1000
-				&& result->m_stdOut.find_first_of('\n') == result->m_stdOut.size()-1
-				&& executableName.find("cl.exe") != std::string::npos)
-		{   // cl.exe always outputs input name to stderr.
-			result->m_stdOut.clear();
-		}
-
-		std::ostringstream compressionInfo;
-		if (result->m_result && task->m_readOutput)
+		do
 		{
-			result->m_result = task->m_outputFile.ReadCompressed(result->m_outputData, task->m_compressionOutput);
-			compressionInfo << " [" << task->m_outputFile.GetFileSize() << " / " << result->m_outputData.size() << "]";
+			LocalExecutorResult::Ptr result(new LocalExecutorResult());
+			result->m_result = subproc->Finish() == ExitSuccess;
+			result->m_stdOut = subproc->GetOutput();
+
+			auto taskIter = m_subprocToTask.find(subproc);
+			assert(taskIter != m_subprocToTask.end());
+			LocalExecutorTask::Ptr task = taskIter->second;
+			m_subprocToTask.erase(taskIter);
+			auto sinkIter = m_subprocToSink.find(subproc);
+			if (sinkIter != m_subprocToSink.end())
+			{
+				std::string err;
+				if (!sinkIter->second->Finish(result->m_outputData, err) && result->m_result)
+				{
+					result->m_result = false;
+					result->m_stdOut += err;
+				}
+				m_subprocToSink.erase(sinkIter);
+			}
+			delete subproc;
+			m_toolRunning[task->m_invocation.m_id.m_toolId]--;
 
-			if (!result->m_result)
-				result->m_stdOut = "Failed to read file " + task->m_outputFile.GetPath();
-		}
-		if (!task->m_outputFile.GetPath().empty())
-			Syslogger(Syslogger::Notice) << task->GetShortErrorInfo() << " -> " << task->m_outputFile.GetPath() << compressionInfo.str();
+			result->m_executionTime = task->m_executionStart.GetElapsedTime();
+			{
+				std::lock_guard<std::mutex> lock(m_postProcessMutex);
+				m_postProcessQueue.emplace_back(task, result);
+			}
+			m_postProcessCond.notify_one();
+		} while ((subproc = m_subprocs->NextFinished()) != nullptr);
+	}
+}
+
+void LocalExecutor::PostProcessQuant()
+{
+	PostProcessJob job;
+	{
+		std::unique_lock<std::mutex> lock(m_postProcessMutex);
+		if (!m_postProcessCond.wait_for(lock, std::chrono::milliseconds(50), [this]{ return !m_postProcessQueue.empty(); }))
+			return;
+
+		job = std::move(m_postProcessQueue.front());
+		m_postProcessQueue.pop_front();
+	}
+	PostProcess(job.first, job.second);
+}
 
-		assert(bool(task->m_callback));
-		task->m_callback(result);
+void LocalExecutor::PostProcess(LocalExecutorTask::Ptr task, LocalExecutorResult::Ptr result)
+{
+	const auto & executableName = task->m_invocation.m_id.m_toolExecutable;
+	if (result->m_stdOut.size() < 1000
+			&& result->m_stdOut.find_first_of('\n') == result->m_stdOut.size()-1
+			&& executableName.find("cl.exe") != std::string::npos)
+	{   // cl.exe always outputs input name to stderr.
+		result->m_stdOut.clear();
+	}
+
+	std::ostringstream compressionInfo;
+	if (result->m_result && task->m_readOutput)
+	{
+		result->m_result = task->m_outputFile.ReadCompressed(result->m_outputData, task->m_compressionOutput);
+		compressionInfo << " [" << task->m_outputFile.GetFileSize() << " / " << result->m_outputData.size() << "]";
+
+		if (!result->m_result)
+			result->m_stdOut = "Failed to read file " + task->m_outputFile.GetPath();
 	}
+	if (!task->m_outputFile.GetPath().empty())
+		Syslogger(Syslogger::Notice) << task->GetShortErrorInfo() << " -> " << task->m_outputFile.GetPath() << compressionInfo.str();
+
+	assert(bool(task->m_callback));
+	task->m_callback(result);
 }
 
 const StringVector & LocalExecutor::GetToolIdEnvironment(const std::string & toolId)
@@ -16,7 +16,7 @@
 #include <IInvocationRewriter.h>
 #include <ThreadLoop.h>
 
-#include <queue>
+#include <deque>
 #include <map>
 #include <atomic>
 #include <mutex>
@@ -28,15 +28,20 @@ struct SubprocessSet;
 
 namespace Wuild
 {
+class SpawnLauncher;
+class CompressingOutputSink;
+
 /// Executes command on local host and notifies caller when task finished.
 ///
-/// Uses ninja's SubprocessSet.
+/// Uses ninja's SubprocessSet. One thread spawns and reaps processes; reading and compressing outputs
+/// and calling task callbacks is done by pool of post-processing threads. If spawnLauncher is set, processes are started from pre-forked launcher instead of current process.
 class LocalExecutor : public ILocalExecutor
 {
-	LocalExecutor(IInvocationRewriter::Ptr invocationRewriter, std::string tempPath, const std::shared_ptr<SubprocessSet> & subprocessSet);
+	LocalExecutor(IInvocationRewriter::Ptr invocationRewriter, std::string tempPath, const std::shared_ptr<SubprocessSet> & subprocessSet, std::shared_ptr<SpawnLauncher> spawnLauncher);
 public:
-	static Ptr Create(IInvocationRewriter::Ptr invocationRewriter, std::string tempPath, const std::shared_ptr<SubprocessSet> & subprocessSet = nullptr)
-	{ return Ptr(new LocalExecutor(invocationRewriter, std::move(tempPath), subprocessSet)); }
+	static Ptr Create(IInvocationRewriter::Ptr invocationRewriter, std::string tempPath, const std::shared_ptr<SubprocessSet> & subprocessSet = nullptr,
+					  std::shared_ptr<SpawnLauncher> spawnLauncher = nullptr)
+	{ return Ptr(new LocalExecutor(invocationRewriter, std::move(tempPath), subprocessSet, std::move(spawnLauncher))); }
 
 public:
 	void AddTask(LocalExecutorTask::Ptr task) override;
@@ -44,28 +49,43 @@ public:
 	TaskPair SplitTask(LocalExecutorTask::Ptr task, std::string & err) override;
 	StringVector GetToolIds() const override;
 	void SetThreadCount(int threads) override;
+	void SetToolThreadCount(const std::string & toolId, int threads) override;
 	size_t GetQueueSize() const override;
 
 	~LocalExecutor();
 
 private:
 	void Start();
+	void StartPostProcessThreads();
 	void CheckSubprocs();
 	LocalExecutorTask::Ptr GetNextTask();
 	void Quant();
+	void PostProcessQuant();
+	void PostProcess(LocalExecutorTask::Ptr task, LocalExecutorResult::Ptr result);
 	const StringVector & GetToolIdEnvironment(const std::string & toolId);
 
 	size_t m_maxSubProcesses = 1;
 	size_t m_taskId = 0;
+	bool m_stopping = false;           //!< destructor is running, new tasks are failed.
 	mutable std::mutex m_queueMutex;
 	using Guard = std::lock_guard<std::mutex>;
-	std::queue<LocalExecutorTask::Ptr> m_taskQueue;
+	std::deque<LocalExecutorTask::Ptr> m_taskQueue;
+	std::map<std::string, size_t> m_toolThreadLimits;
+	std::map<std::string, size_t> m_toolRunning;
 
 	std::shared_ptr<IInvocationRewriter> m_invocationRewriter;
 	std::map<std::string, StringVector> m_toolIdEnvironment;
 	std::string m_tempPath;
+	std::shared_ptr<SpawnLauncher> m_spawnLauncher; // should outlive m_subprocs.
 	std::shared_ptr<SubprocessSet> m_subprocs;
 	std::map<Subprocess*, LocalExecutorTask::Ptr> m_subprocToTask;
+	std::map<Subprocess*, std::unique_ptr<CompressingOutputSink>> m_subprocToSink;
+
+	using PostProcessJob = std::pair<LocalExecutorTask::Ptr, LocalExecutorResult::Ptr>;
+	std::mutex m_postProcessMutex;
+	std::condition_variable m_postProcessCond;
+	std::deque<PostProcessJob> m_postProcessQueue;
+	std::deque<ThreadLoop> m_postProcessThreads; // deque does not move running loops on grow.
 	ThreadLoop m_thread;
 };
 
@@ -0,0 +1,387 @@
+/*
+ * Copyright (C) 2017 Smirnov Vladimir mapron1@gmail.com
+ * Source code licensed under the Apache License, Version 2.0 (the "License");
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at http://www.apache.org/licenses/LICENSE-2.0 or in file COPYING-APACHE-2.0.txt
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.h
+ */
+
+#include "SpawnLauncher.h"
+
+#ifndef _WIN32
+
+#include <Syslogger.h>
+
+#include <cerrno>
+#include <cstring>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <spawn.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+extern char** environ;
+
+namespace Wuild
+{
+namespace
+{
+const int s_failedStatus = 1 << 8; // exit code 1 in waitpid() encoding.
+int s_childSignalPipe[2] = {-1, -1};
+
+void SetCloseOnExec(int fd)
+{
+	fcntl(fd, F_SETFD, fcntl(fd, F_GETFD) | FD_CLOEXEC);
+}
+
+bool WriteAll(int fd, const char * data, size_t size)
+{
+	while (size > 0)
+	{
+		ssize_t written = send(fd, data, size, MSG_NOSIGNAL);
+		if (written < 0 && errno == EINTR)
+			continue;
+		if (written <= 0)
+			return false;
+		data += written;
+		size -= written;
+	}
+	return true;
+}
+
+bool ReadAll(int fd, char * data, size_t size)
+{
+	while (size > 0)
+	{
+		ssize_t received = read(fd, data, size);
+		if (received < 0 && errno == EINTR)
+			continue;
+		if (received <= 0)
+			return false;
+		data += received;
+		size -= received;
+	}
+	return true;
+}
+
+bool SendReply(int sock, const SpawnLauncher::Reply & reply, int fd)
+{
+	iovec iov;
+	iov.iov_base = const_cast<SpawnLauncher::Reply*>(&reply);
+	iov.iov_len = sizeof(reply);
+	msghdr msg;
+	memset(&msg, 0, sizeof(msg));
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+	char control[CMSG_SPACE(sizeof(int))];
+	if (fd >= 0)
+	{
+		memset(control, 0, sizeof(control));
+		msg.msg_control = control;
+		msg.msg_controllen = sizeof(control);
+		cmsghdr * cmsg = CMSG_FIRSTHDR(&msg);
+		cmsg->cmsg_level = SOL_SOCKET;
+		cmsg->cmsg_type = SCM_RIGHTS;
+		cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+		memcpy(CMSG_DATA(cmsg), &fd, sizeof(int));
+	}
+	ssize_t written;
+	do
+	{
+		written = sendmsg(sock, &msg, MSG_NOSIGNAL);
+	} while (written < 0 && errno == EINTR);
+	return written == static_cast<ssize_t>(sizeof(reply));
+}
+
+void OnChildExited(int)
+{
+	const int savedErrno = errno;
+	const char c = 0;
+	if (write(s_childSignalPipe[1], &c, 1) < 0) {} // pipe is full, helper will wake up anyway.
+	errno = savedErrno;
+}
+
+/// Spawns command with output redirected to pipe. Returns pipe read end or -1.
+int SpawnChild(const std::vector<std::string> & request, pid_t & pid, int & err)
+{
+	int outputPipe[2];
+	if (pipe(outputPipe) < 0)
+	{
+		err = errno;
+		return -1;
+	}
+	SetCloseOnExec(outputPipe[0]);
+	SetCloseOnExec(outputPipe[1]);
+
+	posix_spawn_file_actions_t action;
+	posix_spawn_file_actions_init(&action);
+	posix_spawn_file_actions_addopen(&action, 0, "/dev/null", O_RDONLY, 0);
+	posix_spawn_file_actions_adddup2(&action, outputPipe[1], 1);
+	posix_spawn_file_actions_adddup2(&action, outputPipe[1], 2);
+
+	posix_spawnattr_t attr;
+	posix_spawnattr_init(&attr);
+	sigset_t emptyMask, defaultSignals;
+	sigemptyset(&emptyMask);
+	sigemptyset(&defaultSignals);
+	sigaddset(&defaultSignals, SIGINT);
+	sigaddset(&defaultSignals, SIGPIPE);
+	posix_spawnattr_setsigmask(&attr, &emptyMask);
+	posix_spawnattr_setsigdefault(&attr, &defaultSignals);
+	short flags = POSIX_SPAWN_SETPGROUP | POSIX_SPAWN_SETSIGMASK | POSIX_SPAWN_SETSIGDEF;
+#ifdef POSIX_SPAWN_USEVFORK
+	flags |= POSIX_SPAWN_USEVFORK;
+#endif
+	posix_spawnattr_setflags(&attr, flags);
+
+	std::vector<char*> envp;
+	for (size_t i = 1; i < request.size(); ++i)
+		envp.push_back(const_cast<char*>(request[i].c_str()));
+	envp.push_back(nullptr);
+
+	const char* args[] = { "/bin/sh", "-c", request[0].c_str(), nullptr };
+	err = posix_spawn(&pid, "/bin/sh", &action, &attr, const_cast<char**>(args), request.size() > 1 ? envp.data() : environ);
+
+	posix_spawnattr_destroy(&attr);
+	posix_spawn_file_actions_destroy(&action);
+	close(outputPipe[1]);
+	if (err != 0)
+	{
+		close(outputPipe[0]);
+		return -1;
+	}
+	return outputPipe[0];
+}
+
+/// Helper process main loop: reads spawn requests and reports children exit statuses.
+void HelperMain(int sock)
+{
+	SetCloseOnExec(sock);
+	signal(SIGINT, SIG_IGN); // parent decides when to stop; helper exits when socket is closed.
+	signal(SIGPIPE, SIG_IGN);
+	if (pipe(s_childSignalPipe) < 0)
+		_exit(1);
+	for (int fd : s_childSignalPipe)
+	{
+		SetCloseOnExec(fd);
+		fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+	}
+	struct sigaction act;
+	memset(&act, 0, sizeof(act));
+	act.sa_handler = OnChildExited;
+	act.sa_flags = SA_RESTART | SA_NOCLDSTOP;
+	sigaction(SIGCHLD, &act, nullptr);
+	sigset_t emptyMask;
+	sigemptyset(&emptyMask);
+	sigprocmask(SIG_SETMASK, &emptyMask, nullptr);
+
+	pollfd fds[2] = { { sock, POLLIN, 0 }, { s_childSignalPipe[0], POLLIN, 0 } };
+	while (true)
+	{
+		fds[0].revents = fds[1].revents = 0;
+		if (poll(fds, 2, -1) < 0 && errno != EINTR)
+			break;
+
+		if (fds[1].revents)
+		{
+			char drain[64];
+			while (read(s_childSignalPipe[0], drain, sizeof(drain)) > 0) {}
+			int status = 0;
+			pid_t pid;
+			while ((pid = waitpid(-1, &status, WNOHANG)) > 0)
+			{
+				SpawnLauncher::Reply reply;
+				reply.m_type = SpawnLauncher::Reply::Exited;
+				reply.m_pid = pid;
+				reply.m_value = status;
+				if (!SendReply(sock, reply, -1))
+					_exit(0);
+			}
+		}
+		if (fds[0].revents)
+		{
+			uint32_t size = 0;
+			if (!ReadAll(sock, reinterpret_cast<char*>(&size), sizeof(size)))
+				break;
+			std::string payload(size, '\0');
+			if (!ReadAll(sock, &payload[0], size))
+				break;
+
+			std::vector<std::string> request;
+			for (size_t pos = 0; pos < payload.size(); )
+			{
+				const size_t end = payload.find('\0', pos);
+				request.emplace_back(payload.substr(pos, end - pos));
+				pos = end + 1;
+			}
+			if (request.empty())
+				break;
+
+			SpawnLauncher::Reply reply;
+			reply.m_type = SpawnLauncher::Reply::Spawned;
+			pid_t pid = -1;
+			int err = 0;
+			const int fd = SpawnChild(request, pid, err);
+			reply.m_pid = pid;
+			reply.m_value = err;
+			const bool sent = SendReply(sock, reply, fd);
+			if (fd >= 0)
+				close(fd);
+			if (!sent)
+				break;
+		}
+	}
+	_exit(0);
+}
+
+}
+
+SpawnLauncher::Ptr SpawnLauncher::Create()
+{
+	int sockets[2];
+	if (socketpair(AF_UNIX, SOCK_STREAM, 0, sockets) != 0)
+	{
+		Syslogger(Syslogger::Err) << "Failed to create launcher socketpair: " << strerror(errno);
+		return nullptr;
+	}
+	const pid_t pid = fork();
+	if (pid < 0)
+	{
+		Syslogger(Syslogger::Err) << "Failed to fork launcher: " << strerror(errno);
+		close(sockets[0]);
+		close(sockets[1]);
+		return nullptr;
+	}
+	if (pid == 0)
+	{
+		close(sockets[0]);
+		HelperMain(sockets[1]);
+	}
+	close(sockets[1]);
+	SetCloseOnExec(sockets[0]);
+
+	Ptr launcher(new SpawnLauncher());
+	launcher->m_socket = sockets[0];
+	launcher->m_helperPid = pid;
+	Syslogger(Syslogger::Info) << "Started spawn launcher, pid=" << pid;
+	return launcher;
+}
+
+SpawnLauncher::~SpawnLauncher()
+{
+	close(m_socket);
+	waitpid(m_helperPid, nullptr, 0);
+}
+
+int SpawnLauncher::Launch(const std::string &command, const std::vector<std::string> &environment, pid_t *pid)
+{
+	std::string payload = command;
+	payload += '\0';
+	for (const auto & var : environment)
+	{
+		payload += var;
+		payload += '\0';
+	}
+	const uint32_t size = payload.size();
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	if (!WriteAll(m_socket, reinterpret_cast<const char*>(&size), sizeof(size)) || !WriteAll(m_socket, payload.data(), payload.size()))
+	{
+		Syslogger(Syslogger::Err) << "Spawn launcher is not available.";
+		return -1;
+	}
+	Reply reply;
+	int fd = -1;
+	while (ReadReply(reply, fd))
+	{
+		if (reply.m_type == Reply::Exited)
+		{
+			m_exitStatuses[reply.m_pid] = reply.m_value;
+			continue;
+		}
+		if (fd < 0)
+		{
+			Syslogger(Syslogger::Err) << "Spawn launcher failed to start '" << command << "': " << strerror(reply.m_value);
+			return -1;
+		}
+		*pid = reply.m_pid;
+		return fd;
+	}
+	Syslogger(Syslogger::Err) << "Spawn launcher is not available.";
+	return -1;
+}
+
+int SpawnLauncher::Wait(pid_t pid)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	Reply reply;
+	int fd = -1;
+	while (true)
+	{
+		auto it = m_exitStatuses.find(pid);
+		if (it != m_exitStatuses.end())
+		{
+			const int status = it->second;
+			m_exitStatuses.erase(it);
+			return status;
+		}
+		if (!ReadReply(reply, fd))
+			return s_failedStatus;
+
+		if (fd >= 0)
+			close(fd); // unexpected spawn reply, should not happen.
+		if (reply.m_type == Reply::Exited)
+			m_exitStatuses[reply.m_pid] = reply.m_value;
+	}
+}
+
+bool SpawnLauncher::ReadReply(Reply &reply, int &fd)
+{
+	fd = -1;
+	char * data = reinterpret_cast<char*>(&reply);
+	size_t received = 0;
+	while (received < sizeof(reply))
+	{
+		iovec iov;
+		iov.iov_base = data + received;
+		iov.iov_len = sizeof(reply) - received;
+		char control[CMSG_SPACE(sizeof(int))];
+		msghdr msg;
+		memset(&msg, 0, sizeof(msg));
+		msg.msg_iov = &iov;
+		msg.msg_iovlen = 1;
+		msg.msg_control = control;
+		msg.msg_controllen = sizeof(control);
+
+		const ssize_t len = recvmsg(m_socket, &msg, 0);
+		if (len < 0 && errno == EINTR)
+			continue;
+		if (len <= 0)
+			return false;
+
+		for (cmsghdr * cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg))
+		{
+			if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS)
+				memcpy(&fd, CMSG_DATA(cmsg), sizeof(int));
+		}
+		received += len;
+	}
+	return true;
+}
+
+}
+
+#endif
@@ -0,0 +1,70 @@
+/*
+ * Copyright (C) 2017 Smirnov Vladimir mapron1@gmail.com
+ * Source code licensed under the Apache License, Version 2.0 (the "License");
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at http://www.apache.org/licenses/LICENSE-2.0 or in file COPYING-APACHE-2.0.txt
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.h
+ */
+
+#pragma once
+
+#include <subprocess.h>
+
+#include <map>
+#include <memory>
+#include <mutex>
+
+namespace Wuild
+{
+#ifndef _WIN32
+/// Pre-forked helper process which spawns commands on behalf of the caller.
+///
+/// Helper is forked once while the process is still small and single-threaded;
+/// after that spawn requests are sent over socketpair, child output pipe is passed back with SCM_RIGHTS.
+class SpawnLauncher : public SubprocessLauncher
+{
+	SpawnLauncher() = default;
+public:
+	using Ptr = std::shared_ptr<SpawnLauncher>;
+
+	/// Forks helper process. Returns nullptr on failure.
+	static Ptr Create();
+
+	~SpawnLauncher();
+
+	int Launch(const std::string & command, const std::vector<std::string> & environment, pid_t * pid) override;
+	int Wait(pid_t pid) override;
+
+public:
+	/// Reply from helper process.
+	struct Reply
+	{
+		enum Type : int32_t { Spawned = 1, Exited = 2 };
+		int32_t m_type  = 0;
+		int32_t m_pid   = -1;
+		int32_t m_value = 0;  //!< errno for Spawned, waitpid() status for Exited.
+	};
+
+private:
+	bool ReadReply(Reply & reply, int & fd);
+
+	int   m_socket    = -1;
+	pid_t m_helperPid = -1;
+	std::mutex m_mutex;
+	std::map<pid_t, int> m_exitStatuses;
+};
+#else
+/// Pre-forked launcher is not supported on Windows.
+class SpawnLauncher
+{
+public:
+	using Ptr = std::shared_ptr<SpawnLauncher>;
+	static Ptr Create() { return nullptr; }
+};
+#endif
+}
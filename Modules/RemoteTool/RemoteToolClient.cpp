@@ -15,8 +15,11 @@
 
 #include "RemoteToolFrames.h"
 #include "ToolBalancer.h"
+#include "TaskHistory.h"
 
 #include <CoordinatorClient.h>
+#include <CoordinatorFrames.h>
+#include <ByteOrderStream.h>
 #include <SocketFrameService.h>
 #include <ThreadUtils.h>
 #include <FileUtils.h>
@@ -26,25 +29,90 @@
 #include <functional>
 #include <fstream>
 #include <algorithm>
+#include <map>
 #include <utility>
 
 namespace Wuild
 {
 static const size_t g_recommendedBufferSize = 64 * 1024;
-
-
+static const TimePoint g_minBusyPenalty(0.05);
+static const TimePoint g_maxBusyPenalty(1.0);
+static const TimePoint g_minLeaseRequestInterval(0.2);
+static const TimePoint g_defaultLeaseDuration(10.0);
+static const int64_t g_predictedTimeoutFactor = 4;
+static const TimePoint g_minPredictedTimeout(10.0);
+static const int64_t g_stragglerFactor = 3;
+static const TimePoint g_stragglerSlack(1.0);
+static const TimePoint g_stragglerCheckInterval(0.1);
+
+
+/// Queued or running task; it is never copied, only referenced by handle from queue and from frame callback.
 class RemoteToolRequestWrap
 {
 public:
+	RemoteToolRequestWrap() = default;
+	RemoteToolRequestWrap(RemoteToolRequestWrap &&) = default;
+	RemoteToolRequestWrap & operator=(RemoteToolRequestWrap &&) = default;
+	RemoteToolRequestWrap(const RemoteToolRequestWrap &) = delete;
+	RemoteToolRequestWrap & operator=(const RemoteToolRequestWrap &) = delete;
+
+	const std::string & GetToolId() const { return m_toolRequest->m_invocation.m_id.m_toolId; }
+
 	TimePoint m_start;
 	int64_t m_taskIndex = 0;
-	ToolInvocation m_invocation;
+	size_t m_clientIndex = 0;           //!< where task is sent.
 	std::string m_originalFilename;
-	RemoteToolRequest::Ptr m_toolRequest;
+	std::string m_resultFilename;
+	RemoteToolRequest::Ptr m_toolRequest; //!< holds the only copy of invocation; not changed after queueing.
 	RemoteToolClient::InvokeCallback m_callback;
 	TimePoint m_expirationMoment;
 	TimePoint m_requestTimeout;
 	int m_attemptsRemain = 1;
+	std::string m_historyKey;
+	TimePoint m_predictedTime;  //!< zero if task history is not used.
+	bool m_predictionKnown = false;
+};
+
+/// Owns task objects and reuses them, so steady flow of tasks does not allocate them. Handle is stable pointer to task.
+class RemoteToolTaskPool
+{
+public:
+	using Handle = RemoteToolRequestWrap*;
+
+	Handle Acquire()
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if (m_free.empty())
+		{
+			m_tasks.emplace_back(new RemoteToolRequestWrap());
+			return m_tasks.back().get();
+		}
+		Handle task = m_free.back();
+		m_free.pop_back();
+		return task;
+	}
+
+	void Release(Handle task)
+	{
+		*task = RemoteToolRequestWrap(); // request data and callback captures are freed at once.
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_free.push_back(task);
+	}
+
+private:
+	std::mutex m_mutex;
+	std::vector<std::unique_ptr<RemoteToolRequestWrap>> m_tasks;
+	std::vector<Handle> m_free;
+};
+
+/// Task sent to server, watched for being much slower than predicted.
+struct RunningTask
+{
+	TimePoint m_start;
+	TimePoint m_predictedTime;
+	size_t m_clientIndex = 0;
+	std::string m_outputFilename;
+	bool m_reported = false;
 };
 
 class RemoteToolClientImpl
@@ -55,40 +123,165 @@ public:
 	std::mutex m_clientsMutex;
 	std::deque<SocketFrameHandler::Ptr> m_clients;
 	std::mutex m_requestsMutex;
-	std::deque<RemoteToolRequestWrap> m_requests;
+	RemoteToolTaskPool m_taskPool;
+	std::deque<RemoteToolTaskPool::Handle> m_requests; //!< longest predicted first.
 	std::unique_ptr<SocketFrameService> m_server;
 	CoordinatorClient m_coordinator;
 	size_t m_clientIndex = 0;
 	std::atomic_int m_pendingTasks {0};
+	std::vector<uint32_t> m_reportedQueues; //!< last queue length sent to each server in pull mode.
+	TaskHistory m_history;
+	bool m_historyEnabled = false;
+	std::mutex m_runningMutex;
+	std::map<int64_t, RunningTask> m_running;
+	TimePoint m_lastStragglerCheck;
+	std::mutex m_snapshotMutex;
+	std::deque<ToolServerInfo> m_snapshotServers; //!< loaded from snapshot and not confirmed by coordinator yet.
+	CoordinatorInfo m_savedSnapshot;
+
+	/// Servers list without load information, which is outdated at next start anyway.
+	static CoordinatorInfo MakeSnapshot(const CoordinatorInfo & info)
+	{
+		CoordinatorInfo snapshot;
+		snapshot.m_site = info.m_site;
+		snapshot.m_toolServers = info.m_toolServers;
+		for (ToolServerInfo & toolServer : snapshot.m_toolServers)
+		{
+			toolServer.m_queuedTasks = toolServer.m_runningTasks = toolServer.m_unhealthyReports = 0;
+			toolServer.m_connectedClients.clear();
+			for (ToolServerInfo::ToolSlots & slots : toolServer.m_toolSlots)
+				slots.m_runningTasks = 0;
+		}
+		return snapshot;
+	}
+
+	static bool LoadSnapshot(const std::string & filename, CoordinatorInfo & info)
+	{
+		ByteArrayHolder data;
+		if (!FileInfo(filename).ReadFile(data))
+			return false;
+
+		ByteOrderBuffer buffer(data);
+		ByteOrderDataStreamReader stream(buffer);
+		CoordinatorListResponse snapshot;
+		if (stream.ReadScalar<uint32_t>() != CoordinatorListResponse::s_version
+			|| snapshot.Read(stream) != SocketFrame::stOk || buffer.EofRead())
+		{
+			Syslogger(Syslogger::Warning) << "Cluster snapshot " << filename << " is invalid, ignored.";
+			return false;
+		}
+		info = snapshot.m_info;
+		return true;
+	}
+
+	static void SaveSnapshot(const std::string & filename, const CoordinatorInfo & info)
+	{
+		CoordinatorListResponse snapshot;
+		snapshot.m_info = info;
+		ByteOrderBuffer buffer;
+		ByteOrderDataStreamWriter stream(buffer);
+		stream << uint32_t(CoordinatorListResponse::s_version);
+		snapshot.Write(stream);
+
+		ByteArrayHolder data;
+		data.ref().assign(buffer.begin(), buffer.end());
+		FileInfo file(filename);
+		FileInfo(file.GetDir()).Mkdirs();
+		if (!file.WriteFile(data))
+			Syslogger(Syslogger::Warning) << "Failed to write cluster snapshot " << filename;
+	}
 
-	void QueueTask(const RemoteToolRequestWrap & task)
+	void QueueTask(RemoteToolTaskPool::Handle task)
 	{
 		std::lock_guard<std::mutex> lock(m_requestsMutex);
-		m_requests.push_back(task);
+		InsertRequest(task);
 		m_pendingTasks++;
 	}
 
+	/// Puts task to queue without counting it as new one; m_requestsMutex should be locked.
+	void InsertRequest(RemoteToolTaskPool::Handle task)
+	{
+		// longest processing time first: long tasks started late make the build tail.
+		auto position = std::upper_bound(m_requests.begin(), m_requests.end(), task, [](RemoteToolTaskPool::Handle task, RemoteToolTaskPool::Handle request){
+			return request->m_predictedTime < task->m_predictedTime;
+		});
+		m_requests.insert(position, task);
+	}
+
+	/// Updates server health; when its breaker changes state, other clients are notified through coordinator.
+	void ReportOutcome(size_t clientIndex, ToolBalancer::TaskOutcome outcome)
+	{
+		if (!m_balancer.ReportTaskOutcome(clientIndex, outcome))
+			return;
+		const ToolServerInfo toolServer = m_balancer.GetToolServer(clientIndex);
+		ToolServerHealthReport report;
+		report.m_toolServerId = toolServer.m_toolServerId;
+		report.m_connectionHost = toolServer.m_connectionHost;
+		report.m_connectionPort = toolServer.m_connectionPort;
+		report.m_sessionId = m_parent->m_sessionId;
+		report.m_tripped = m_balancer.IsClientTripped(clientIndex);
+		m_coordinator.SendToolServerHealth(report);
+	}
+
+	void CheckStragglers()
+	{
+		if (m_lastStragglerCheck.GetElapsedTime() < g_stragglerCheckInterval)
+			return;
+		m_lastStragglerCheck = TimePoint(true);
+		std::lock_guard<std::mutex> lock(m_runningMutex);
+		for (auto & runningPair : m_running)
+		{
+			RunningTask & running = runningPair.second;
+			if (running.m_reported || !running.m_predictedTime)
+				continue;
+			const TimePoint elapsed = running.m_start.GetElapsedTime();
+			if (elapsed < running.m_predictedTime * g_stragglerFactor + g_stragglerSlack)
+				continue;
+			running.m_reported = true;
+			const auto host = m_balancer.GetToolServer(running.m_clientIndex).m_connectionHost;
+			Syslogger(Syslogger::Warning) << "Straggler [" << runningPair.first << "] " << running.m_outputFilename << " on " << host
+										  << ": running " << elapsed.ToProfilingTime() << ", predicted " << running.m_predictedTime.ToProfilingTime();
+			// server is slower than it should be; do not give it more work for a while.
+			m_balancer.SetClientBusy(running.m_clientIndex, std::min(elapsed - running.m_predictedTime, g_maxBusyPenalty));
+			ReportOutcome(running.m_clientIndex, ToolBalancer::TaskOutcome::Slow);
+		}
+	}
+
 	void ProcessTasks()
 	{
-		RemoteToolRequestWrap task;
+		if (m_parent->m_config.m_maxConnectedServers && m_parent->m_lastWorkingSetUpdate.GetElapsedTime() > m_parent->m_config.m_workingSetRefresh)
+		{
+			m_parent->m_lastWorkingSetUpdate = TimePoint(true);
+			m_parent->UpdateWorkingSet(true, true);
+		}
+		if (m_parent->m_config.m_useSlotLeases)
+			m_parent->UpdateLeases();
+		if (m_historyEnabled)
+			CheckStragglers();
+
+		RemoteToolTaskPool::Handle task = nullptr;
+		size_t taskPosition = 0;
+		size_t clientIndex = std::numeric_limits<size_t>::max();
 		{
 			std::lock_guard<std::mutex> lock(m_requestsMutex);
-			if (m_requests.empty())
+			if (m_requests.empty() && !m_parent->m_config.m_usePullScheduling)
 				return;
 			TimePoint now(true);
 			for (auto it = m_requests.begin(); it != m_requests.end(); )
 			{
-				if (it->m_expirationMoment < now)
+				RemoteToolTaskPool::Handle expired = *it;
+				if (expired->m_expirationMoment < now)
 				{
-					Syslogger(Syslogger::Err) << "Task expired: " << SocketFrame::Ptr(it->m_toolRequest)
-											  << " expiration moment:" << it->m_expirationMoment.ToString() << ", now:" << now.ToString();
-					if (it->m_callback)
+					Syslogger(Syslogger::Err) << "Task expired: " << SocketFrame::Ptr(expired->m_toolRequest)
+											  << " expiration moment:" << expired->m_expirationMoment.ToString() << ", now:" << now.ToString();
+					if (expired->m_callback)
 					{
 						RemoteToolClient::TaskExecutionInfo info;
 						info.m_stdOutput = "Timeout expired.";
-						it->m_callback(info);
+						expired->m_callback(info);
 					}
 					it = m_requests.erase(it);
+					m_taskPool.Release(expired);
 				}
 				else
 				{
@@ -96,86 +289,226 @@ public:
 				}
 			}
 
+			if (m_parent->m_config.m_usePullScheduling)
+			{
+				// servers ask for tasks themselves.
+				ReportQueuedTasks();
+				return;
+			}
+
 			if (m_requests.empty())
 				return;
 
-			task = *m_requests.begin();
+			// first task which has free client; tasks for saturated tools should not block others.
+			for (; taskPosition < m_requests.size(); ++taskPosition)
+			{
+				clientIndex = m_balancer.FindFreeClient(m_requests[taskPosition]->GetToolId());
+				if (clientIndex != std::numeric_limits<size_t>::max())
+					break;
+			}
+			if (taskPosition == m_requests.size())
+				return;
+
+			task = m_requests[taskPosition];
+			m_requests.erase(m_requests.begin() + taskPosition);
 		}
+		if (!SendTask(task, clientIndex))
+		{
+			std::lock_guard<std::mutex> lock(m_requestsMutex);
+			InsertRequest(task);
+		}
+	}
 
-		size_t clientIndex = m_balancer.FindFreeClient(task.m_invocation.m_id.m_toolId);
-		if (clientIndex == std::numeric_limits<size_t>::max())
-			return;
+	/// Pull scheduling: server has free slots for us; m_requestsMutex should be locked.
+	void OnServerReady(size_t clientIndex, uint32_t slots)
+	{
+		{
+			std::lock_guard<std::mutex> lock2(m_clientsMutex);
+			if (!m_clients[clientIndex])
+				return; // removed from working set meanwhile, server releases slots on disconnect.
+		}
+		const StringVector toolIds = m_balancer.GetToolServer(clientIndex).m_toolIds;
+		uint32_t declined = 0;
+		for (uint32_t i = 0; i < slots; ++i)
+		{
+			// queue is ordered by predicted time, longest first (build system order among equal ones), so the first suitable task is the most important one.
+			auto it = std::find_if(m_requests.begin(), m_requests.end(), [&toolIds](RemoteToolTaskPool::Handle request){
+				return toolIds.empty() || std::find(toolIds.cbegin(), toolIds.cend(), request->GetToolId()) != toolIds.cend();
+			});
+			if (it == m_requests.end() || m_balancer.IsCircuitOpen(clientIndex))
+			{
+				declined++;
+				continue;
+			}
+			RemoteToolTaskPool::Handle task = *it;
+			m_requests.erase(it);
+			if (!SendTask(task, clientIndex))
+			{
+				InsertRequest(task);
+				return;
+			}
+		}
+		if (declined)
+			ReportQueuedTasks(clientIndex, declined);
+	}
 
-		SocketFrameHandler::Ptr handler;
+	/// Sends queued task count to servers where it changed; m_requestsMutex should be locked.
+	void ReportQueuedTasks(size_t onlyIndex = std::numeric_limits<size_t>::max(), uint32_t declined = 0)
+	{
+		std::deque<SocketFrameHandler::Ptr> clients;
 		{
 			std::lock_guard<std::mutex> lock2(m_clientsMutex);
-			handler = m_clients[clientIndex];
+			clients = m_clients;
 		}
-		auto frameCallback = [this, task, clientIndex](SocketFrame::Ptr responseFrame, SocketFrameHandler::ReplyState state, const std::string & errorInfo)
+		std::map<std::string, uint32_t> queuedByTool;
+		for (RemoteToolTaskPool::Handle request : m_requests)
+			queuedByTool[request->GetToolId()]++;
+
+		m_reportedQueues.resize(clients.size(), std::numeric_limits<uint32_t>::max());
+		for (size_t index = 0; index < clients.size(); ++index)
 		{
-			m_balancer.FinishTask(clientIndex);
-			const std::string outputFilename =  task.m_originalFilename;
-			Syslogger(Syslogger::Info) << "RECIEVING [" << task.m_taskIndex << "]:" << outputFilename;
+			if (!clients[index] || !clients[index]->IsActive() || (onlyIndex != std::numeric_limits<size_t>::max() && index != onlyIndex))
+				continue;
+			const StringVector toolIds = m_balancer.GetToolServer(index).m_toolIds;
+			uint32_t queued = toolIds.empty() ? static_cast<uint32_t>(m_requests.size()) : 0;
+			for (const auto & toolId : toolIds)
+			{
+				auto it = queuedByTool.find(toolId);
+				if (it != queuedByTool.end())
+					queued += it->second;
+			}
+			if (m_balancer.IsCircuitOpen(index))
+				queued = 0;
+			if (queued == m_reportedQueues[index] && !declined)
+				continue;
+			m_reportedQueues[index] = queued;
+			RemoteToolPullRequest::Ptr report(new RemoteToolPullRequest());
+			report->m_sessionId = m_parent->m_sessionId;
+			report->m_queuedTasks = queued;
+			report->m_declinedSlots = declined;
+			clients[index]->QueueFrame(report);
+		}
+	}
+
+	/// Server connection was reset, it has to recieve our queue again.
+	void ResetQueueReport(size_t clientIndex)
+	{
+		std::lock_guard<std::mutex> lock(m_requestsMutex);
+		if (clientIndex < m_reportedQueues.size())
+			m_reportedQueues[clientIndex] = std::numeric_limits<uint32_t>::max();
+	}
+
+	/// Returns false if server was removed from working set meanwhile (coordinator thread does it), task is not sent then.
+	bool SendTask(RemoteToolTaskPool::Handle task, size_t clientIndex)
+	{
+		// held until frame is queued: server removed later fails pending replies, and task is retried.
+		std::lock_guard<std::mutex> lock2(m_clientsMutex);
+		SocketFrameHandler::Ptr handler = m_clients[clientIndex];
+		if (!handler)
+			return false;
+		task->m_clientIndex = clientIndex;
+		auto frameCallback = [this, task](SocketFrame::Ptr responseFrame, SocketFrameHandler::ReplyState state, const std::string & errorInfo)
+		{
+			const size_t clientIndex = task->m_clientIndex;
+			m_balancer.FinishTask(clientIndex, task->GetToolId());
+			if (m_historyEnabled)
+			{
+				std::lock_guard<std::mutex> lock(m_runningMutex);
+				m_running.erase(task->m_taskIndex);
+			}
+			const std::string & outputFilename = task->m_originalFilename;
+			Syslogger(Syslogger::Info) << "RECIEVING [" << task->m_taskIndex << "]:" << outputFilename;
 			RemoteToolClient::TaskExecutionInfo info;
 			bool retry = false;
 			if (state == SocketFrameHandler::ReplyState::Timeout)
 			{
-				info.m_stdOutput = "Timeout expired:" + outputFilename + ", start:" + task.m_start.ToString()
-						+ " exp:" + task.m_expirationMoment.ToString() + ", remain:" + std::to_string(task.m_attemptsRemain)
+				info.m_stdOutput = "Timeout expired:" + outputFilename + ", start:" + task->m_start.ToString()
+						+ " exp:" + task->m_expirationMoment.ToString() + ", remain:" + std::to_string(task->m_attemptsRemain)
 						+ ", balancer.free:" + std::to_string(m_balancer.GetFreeThreads()) + ", extraInfo:" + errorInfo;
 				retry = true;
+				ReportOutcome(clientIndex, ToolBalancer::TaskOutcome::Timeout);
 			}
 			else if (state == SocketFrameHandler::ReplyState::Error)
 			{
 				info.m_stdOutput = "Internal error. " + errorInfo;
 				retry = true;
+				ReportOutcome(clientIndex, ToolBalancer::TaskOutcome::Error);
 			}
 			else
 			{
 				RemoteToolResponse::Ptr result = std::dynamic_pointer_cast<RemoteToolResponse>(responseFrame);
+				m_balancer.SetServerLoad(clientIndex, result->m_serverLoad);
+				if (result->m_serverBusy)
+				{
+					// server did not start the task, so it is not an attempt.
+					const TimePoint penalty = std::min(std::max(result->m_serverLoad.m_estimatedWait, g_minBusyPenalty), g_maxBusyPenalty);
+					Syslogger(Syslogger::Info) << "Server busy [" << task->m_taskIndex << "], queue:" << result->m_serverLoad.m_queuedTasks << ", requeue.";
+					m_balancer.SetClientBusy(clientIndex, penalty);
+					task->m_expirationMoment = TimePoint(true) + m_parent->m_config.m_queueTimeout;
+					this->QueueTask(task);
+					return;
+				}
+				if (!m_balancer.IsToolCompatible(clientIndex, task->GetToolId()))
+				{
+					// version check finished after task was sent; result could differ from local tool.
+					Syslogger(Syslogger::Info) << "Tool version mismatch [" << task->m_taskIndex << "], requeue.";
+					this->QueueTask(task);
+					return;
+				}
+				// failed compilation is still healthy server.
+				ReportOutcome(clientIndex, ToolBalancer::TaskOutcome::Success);
 				info.m_toolExecutionTime = result->m_executionTime;
-				info.m_networkRequestTime = task.m_start.GetElapsedTime();
+				if (result->m_result)
+				{
+					m_balancer.UpdateObservedSpeed(clientIndex, task->m_toolRequest->m_fileData.size(), result->m_executionTime);
+					if (m_historyEnabled)
+						m_history.Add(task->m_historyKey, task->m_toolRequest->m_fileData.size(), result->m_executionTime, m_balancer.GetToolServer(clientIndex).m_speedScore);
+				}
+				info.m_networkRequestTime = task->m_start.GetElapsedTime();
 
 				info.m_result = result->m_result;
 				info.m_stdOutput = result->m_stdOut;
 				std::replace(info.m_stdOutput.begin(), info.m_stdOutput.end(), '\r', ' ');
 
-				if (info.m_result && !outputFilename.empty())
+				if (info.m_result && !task->m_resultFilename.empty())
 				{
 					this->m_parent->m_recievedBytes += result->m_fileData.size();
 					TimePoint start(true);
-					info.m_result = FileInfo(outputFilename).WriteCompressed(result->m_fileData, result->m_compression);
+					info.m_result = FileInfo(task->m_resultFilename).WriteCompressed(result->m_fileData, result->m_compression);
 					this->m_parent->m_totalCompressionTime += start.GetElapsedTime();
 				}
 			}
 			m_parent->UpdateSessionInfo(info);
-			if (task.m_attemptsRemain > 0 && retry)
+			if (task->m_attemptsRemain > 0 && retry)
 			{
-				Syslogger(Syslogger::Warning) << info.m_stdOutput << " Retrying (" << task.m_attemptsRemain << " attempts remain), args:" << task.m_invocation.GetArgsString(false);
-				auto taskCopy = task;
-				taskCopy.m_attemptsRemain--;
-				taskCopy.m_taskIndex = this->m_parent->m_taskIndex++;
-				taskCopy.m_expirationMoment = TimePoint(true) + m_parent->m_config.m_queueTimeout;
-				this->QueueTask(taskCopy);
+				Syslogger(Syslogger::Warning) << info.m_stdOutput << " Retrying (" << task->m_attemptsRemain << " attempts remain), args:" << task->m_toolRequest->m_invocation.GetArgsString(false);
+				task->m_attemptsRemain--;
+				task->m_taskIndex = this->m_parent->m_taskIndex++;
+				task->m_expirationMoment = TimePoint(true) + m_parent->m_config.m_queueTimeout;
+				this->QueueTask(task);
 			}
 			else
 			{
-				if (!this->m_parent->m_compilerVersionSuitable)
-				{
-					info.m_result = false;
-					info.m_stdOutput = "Invalid compiler configurations. Search log for details.\n";
-				}
-
-				task.m_callback(info);
+				// task slot may be reused by tasks queued from callback.
+				RemoteToolClient::InvokeCallback callback = std::move(task->m_callback);
+				m_taskPool.Release(task);
+				callback(info);
 			}
 		};
-		m_balancer.StartTask(clientIndex);
+		m_balancer.StartTask(clientIndex, task->GetToolId());
 		m_pendingTasks--;
-		handler->QueueFrame(task.m_toolRequest, frameCallback, task.m_requestTimeout);
+		if (m_historyEnabled)
 		{
-			std::lock_guard<std::mutex> lock(m_requestsMutex);
-			m_requests.pop_front();
+			RunningTask running;
+			running.m_start = TimePoint(true);
+			running.m_predictedTime = task->m_predictionKnown ? task->m_predictedTime : TimePoint();
+			running.m_clientIndex = clientIndex;
+			running.m_outputFilename = task->m_originalFilename;
+			std::lock_guard<std::mutex> lock(m_runningMutex);
+			m_running[task->m_taskIndex] = running;
 		}
+		handler->QueueFrame(task->m_toolRequest, frameCallback, task->m_requestTimeout);
+		return true;
 	}
 };
 
@@ -187,8 +520,7 @@ RemoteToolClient::RemoteToolClient(IInvocationRewriter::Ptr invocationRewriter,
 {
 	m_impl->m_parent = this;
 	m_impl->m_coordinator.SetInfoArrivedCallback([this](const CoordinatorInfo& info){
-		for (const auto & client : info.m_toolServers)
-			this->AddClient(client, true);
+		this->OnCoordinatorInfo(info);
 	});
 }
 
@@ -198,7 +530,8 @@ RemoteToolClient::~RemoteToolClient()
 	m_thread.Stop();
 
 	for (auto & client : m_impl->m_clients)
-		client->Stop();
+		if (client)
+			client->Stop();
 }
 
 bool RemoteToolClient::SetConfig(const RemoteToolClient::Config &config)
@@ -210,6 +543,11 @@ bool RemoteToolClient::SetConfig(const RemoteToolClient::Config &config)
 		return false;
 	}
 	m_config = config;
+	m_impl->m_balancer.SetWorkingSetSize(static_cast<size_t>(m_config.m_maxConnectedServers));
+	m_impl->m_balancer.SetRemoteSiteCost(m_config.m_remoteSiteCost);
+	m_impl->m_historyEnabled = !m_config.m_taskHistoryFile.empty();
+	if (m_impl->m_historyEnabled)
+		m_impl->m_history.Open(m_config.m_taskHistoryFile);
 	return true;
 }
 
@@ -218,6 +556,37 @@ int RemoteToolClient::GetFreeRemoteThreads() const
 	return static_cast<int>(m_impl->m_balancer.GetFreeThreads()) - m_impl->m_pendingTasks; // may be negative.
 }
 
+TimePoint RemoteToolClient::GetExpectedQueueWait()
+{
+	const int freeThreads = GetFreeRemoteThreads();
+	if (freeThreads > 0)
+		return TimePoint();
+	const int totalThreads = static_cast<int>(m_impl->m_balancer.GetTotalThreads());
+	if (!totalThreads)
+		return m_config.m_queueTimeout;
+
+	TimePoint averageTask;
+	{
+		std::lock_guard<std::mutex> lock(m_sessionInfoMutex);
+		if (m_sessionInfo.m_tasksCount)
+			averageTask.SetUS(m_sessionInfo.m_totalExecutionTime.GetUS() / m_sessionInfo.m_tasksCount);
+	}
+	// busy threads free up evenly, one per average task time divided by threads; queued tasks are ahead of us.
+	TimePoint wait;
+	wait.SetUS(averageTask.GetUS() * (1 - freeThreads) / totalThreads);
+	return wait;
+}
+
+TimePoint RemoteToolClient::PredictExecutionTime(const ToolInvocation & invocation) const
+{
+	if (!m_impl->m_historyEnabled)
+		return TimePoint();
+	bool known = false;
+	const std::string key = m_invocationRewriter->PrepareRemote(invocation).m_id.m_toolId + " " + invocation.GetOutput();
+	const TimePoint predicted = m_impl->m_history.Predict(key, 0, &known);
+	return known ? predicted : TimePoint();
+}
+
 void RemoteToolClient::Start(const StringVector & requiredToolIds)
 {
 	m_started = true;
@@ -226,7 +595,11 @@ void RemoteToolClient::Start(const StringVector & requiredToolIds)
 	m_sessionInfo.m_sessionId = m_sessionId = m_start.GetUS();
 	m_sessionInfo.m_clientId = m_config.m_clientId;
 	m_impl->m_balancer.SetRequiredTools(requiredToolIds);
+	m_impl->m_balancer.SetToolVersions(InvocationRewriterConfig::GetCheckedVersions(m_toolVersionMap));
 	m_impl->m_balancer.SetSessionId(m_sessionId);
+	m_lastWorkingSetUpdate = m_start;
+	m_lastLeaseRequest = m_lastLeaseGrant = TimePoint();
+	m_leaseDuration = g_defaultLeaseDuration;
 	m_requiredToolIds = requiredToolIds;
 
 	const auto & initialToolServers = m_config.m_initialToolServers;
@@ -239,8 +612,20 @@ void RemoteToolClient::Start(const StringVector & requiredToolIds)
 		AddClient(info);
 	}
 
+	CoordinatorInfo snapshot;
+	if (!m_config.m_clusterSnapshotFile.empty() && RemoteToolClientImpl::LoadSnapshot(m_config.m_clusterSnapshotFile, snapshot))
+	{
+		Syslogger() << "Cluster snapshot: " << snapshot.m_toolServers.size() << " tool servers.";
+		m_impl->m_balancer.SetLocalSite(snapshot.m_site);
+		for (const auto & toolServer : snapshot.m_toolServers)
+			AddClient(toolServer);
+		std::lock_guard<std::mutex> lock(m_impl->m_snapshotMutex);
+		m_impl->m_snapshotServers = snapshot.m_toolServers;
+	}
+
 	for (auto & handler : m_impl->m_clients)
-		handler->Start();
+		if (handler)
+			handler->Start();
 
 	if (!m_impl->m_coordinator.SetConfig(m_config.m_coordinator))
 		return;
@@ -257,6 +642,7 @@ void RemoteToolClient::FinishSession()
 	m_started = false;
 	m_sessionInfo.m_elapsedTime = m_lastFinish - m_start;
 	m_impl->m_coordinator.SendToolServerSessionInfo(m_sessionInfo, true);
+	m_impl->m_balancer.ClearLeases();
 }
 
 void RemoteToolClient::SetRemoteAvailableCallback(RemoteToolClient::RemoteAvailableCallback callback)
@@ -277,10 +663,158 @@ void RemoteToolClient::AddClient(const ToolServerInfo &info, bool start)
 	if (status == ToolBalancer::ClientStatus::Updated)
 		return;
 
+	{
+		std::lock_guard<std::mutex> lock2(m_impl->m_clientsMutex);
+		if (m_impl->m_clients.size() <= index)
+			m_impl->m_clients.resize(index + 1);
+	}
+	if (balancer.IsInWorkingSet(index))
+		ConnectClient(index, info, start);
+	else
+		UpdateWorkingSet(false, start);
+}
+
+void RemoteToolClient::OnCoordinatorInfo(const CoordinatorInfo &info)
+{
+	m_impl->m_balancer.SetLocalSite(info.m_site);
+	for (const auto & client : info.m_toolServers)
+		AddClient(client, true);
+
+	if (m_config.m_clusterSnapshotFile.empty())
+		return;
+
+	std::deque<ToolServerInfo> staleServers;
+	const CoordinatorInfo snapshot = RemoteToolClientImpl::MakeSnapshot(info);
+	bool snapshotChanged = false;
+	{
+		std::lock_guard<std::mutex> lock(m_impl->m_snapshotMutex);
+		for (const auto & toolServer : m_impl->m_snapshotServers)
+		{
+			auto sameServer = [&toolServer](const ToolServerInfo & fresh) { return fresh.EqualIdTo(toolServer); };
+			if (std::none_of(info.m_toolServers.cbegin(), info.m_toolServers.cend(), sameServer))
+				staleServers.push_back(toolServer);
+		}
+		m_impl->m_snapshotServers.clear();
+		snapshotChanged = snapshot != m_impl->m_savedSnapshot;
+		if (snapshotChanged)
+			m_impl->m_savedSnapshot = snapshot;
+	}
+	// saved only when servers changed, not on every load update.
+	if (snapshotChanged)
+		RemoteToolClientImpl::SaveSnapshot(m_config.m_clusterSnapshotFile, snapshot);
+
+	bool removed = false;
+	for (const auto & toolServer : staleServers)
+	{
+		size_t index = 0;
+		if (!m_impl->m_balancer.RemoveClient(toolServer, index))
+			continue;
+		SocketFrameHandler::Ptr handler;
+		{
+			std::lock_guard<std::mutex> lock2(m_impl->m_clientsMutex);
+			handler.swap(m_impl->m_clients[index]);
+		}
+		Syslogger() << "RemoteToolClient: " << toolServer.m_connectionHost << " from snapshot is unknown to coordinator, disconnecting.";
+		if (handler)
+		{
+			handler->Stop();
+			handler->FailPendingReplies();
+		}
+		removed = true;
+	}
+	if (removed)
+		UpdateWorkingSet(false, true);
+}
+
+void RemoteToolClient::UpdateWorkingSet(bool replaceWorst, bool start)
+{
+	std::vector<size_t> added, removed;
+	m_impl->m_balancer.UpdateWorkingSet(replaceWorst, added, removed);
+	for (size_t index : removed)
+	{
+		SocketFrameHandler::Ptr handler;
+		{
+			std::lock_guard<std::mutex> lock2(m_impl->m_clientsMutex);
+			handler.swap(m_impl->m_clients[index]);
+		}
+		Syslogger() << "RemoteToolClient::UpdateWorkingSet disconnecting " << m_impl->m_balancer.GetToolServer(index).m_connectionHost;
+		if (handler)
+		{
+			handler->Stop();
+			handler->FailPendingReplies();
+		}
+	}
+	for (size_t index : added)
+		ConnectClient(index, m_impl->m_balancer.GetToolServer(index), start);
+}
+
+void RemoteToolClient::UpdateLeases()
+{
+	ToolBalancer & balancer = m_impl->m_balancer;
+	TimePoint sinceRequest, leaseDuration;
+	{
+		std::lock_guard<std::mutex> lock(m_leasesMutex);
+		if (balancer.HasLeases() && m_lastLeaseGrant.GetElapsedTime() > m_leaseDuration)
+		{
+			Syslogger(Syslogger::Warning) << "Slot leases expired, sending tasks without leases.";
+			balancer.ClearLeases();
+		}
+		sinceRequest = m_lastLeaseRequest ? m_lastLeaseRequest.GetElapsedTime() : m_leaseDuration;
+		leaseDuration = m_leaseDuration;
+	}
+	if (sinceRequest < g_minLeaseRequestInterval)
+		return;
+
+	const bool hasLeases = balancer.HasLeases();
+	const int leased = balancer.GetLeasedSlots();
+	const int used = balancer.GetUsedThreads();
+	const int demand = used + std::max(0, int(m_impl->m_pendingTasks));
+	const bool saturated = hasLeases && demand >= leased;
+	const bool excessive = hasLeases && leased > 2 * std::max(demand, 1);
+	if (!saturated && !excessive && sinceRequest.GetUS() < leaseDuration.GetUS() / 3)
+		return;
+
+	// ask for more before build system starts running tasks locally; coordinator will trim it to fair share.
+	int wanted = demand;
+	if (!hasLeases)
+		wanted = std::max(demand, int(balancer.GetTotalThreads()));
+	else if (saturated)
+		wanted = std::max(demand, leased * 2);
+	wanted = std::min(std::max(wanted, 1), 0xffff);
+
+	{
+		std::lock_guard<std::mutex> lock(m_leasesMutex);
+		m_lastLeaseRequest = TimePoint(true);
+	}
+	const int64_t sessionId = m_sessionId;
+	m_impl->m_coordinator.RequestLeases(sessionId, m_config.m_clientId, static_cast<uint16_t>(wanted), static_cast<uint16_t>(used), m_requiredToolIds,
+										InvocationRewriterConfig::GetCheckedVersions(m_toolVersionMap),
+										[this, sessionId](const std::deque<ToolServerLease> & leases, const TimePoint & duration)
+	{
+		if (!m_started || sessionId != m_sessionId)
+			return;
+		std::vector<size_t> added;
+		m_impl->m_balancer.SetLeases(leases, added);
+		{
+			std::lock_guard<std::mutex> lock(m_leasesMutex);
+			m_lastLeaseGrant = TimePoint(true);
+			m_leaseDuration = duration;
+		}
+		for (size_t index : added)
+			ConnectClient(index, m_impl->m_balancer.GetToolServer(index), true);
+		AvailableCheck();
+	});
+}
+
+void RemoteToolClient::ConnectClient(size_t index, const ToolServerInfo &info, bool start)
+{
+	ToolBalancer & balancer = m_impl->m_balancer;
 	Syslogger() << "RemoteToolClient::AddClient " << info.m_connectionHost  << ":" <<  info.m_connectionPort;
 
 	SocketFrameHandlerSettings settings;
-	settings.m_channelProtocolVersion       = RemoteToolRequest::s_version + RemoteToolResponse::s_version;
+	settings.m_channelProtocolVersion       = RemoteToolRequest::s_version + RemoteToolResponse::s_version
+											+ RemoteToolServerLoad::s_version
+											+ RemoteToolPullRequest::s_version + RemoteToolReady::s_version;
 	settings.m_recommendedRecieveBufferSize = g_recommendedBufferSize;
 	settings.m_recommendedSendBufferSize    = g_recommendedBufferSize;
 	settings.m_segmentSize = 8192;
@@ -288,9 +822,18 @@ void RemoteToolClient::AddClient(const ToolServerInfo &info, bool start)
 	SocketFrameHandler::Ptr handler(new SocketFrameHandler( settings ));
 	handler->RegisterFrameReader(SocketFrameReaderTemplate<RemoteToolResponse>::Create());
 	handler->RegisterFrameReader(SocketFrameReaderTemplate<ToolsVersionResponse>::Create());
+	handler->RegisterFrameReader(SocketFrameReaderTemplate<RemoteToolServerLoad>::Create([&balancer, index](const RemoteToolServerLoad& inputMessage, SocketFrameHandler::OutputCallback){
+		balancer.SetServerLoad(index, inputMessage.m_load);
+	}));
+	handler->RegisterFrameReader(SocketFrameReaderTemplate<RemoteToolReady>::Create([this, index](const RemoteToolReady& inputMessage, SocketFrameHandler::OutputCallback){
+		std::lock_guard<std::mutex> lock(m_impl->m_requestsMutex);
+		m_impl->OnServerReady(index, inputMessage.m_slots);
+	}));
 	handler->SetTcpChannel(info.m_connectionHost, info.m_connectionPort);
 
 	handler->SetChannelNotifier([&balancer, index, this](bool state){
+		if (state)
+			m_impl->ResetQueueReport(index);
 		balancer.SetClientActive(index, state);
 		AvailableCheck();
 	});
@@ -298,7 +841,7 @@ void RemoteToolClient::AddClient(const ToolServerInfo &info, bool start)
 		balancer.SetServerSideLoad(index, status.uniqueRepliesQueued);
 		AvailableCheck();
 	});
-	auto versionFrameCallback = [this, info](SocketFrame::Ptr responseFrame, SocketFrameHandler::ReplyState state, const std::string & errorInfo)
+	auto versionFrameCallback = [this, info, index](SocketFrame::Ptr responseFrame, SocketFrameHandler::ReplyState state, const std::string & errorInfo)
 	{
 		if (state == SocketFrameHandler::ReplyState::Timeout || state == SocketFrameHandler::ReplyState::Error)
 		{
@@ -307,20 +850,21 @@ void RemoteToolClient::AddClient(const ToolServerInfo &info, bool start)
 		else
 		{
 			ToolsVersionResponse::Ptr result = std::dynamic_pointer_cast<ToolsVersionResponse>(responseFrame);
-			this->CheckRemoteToolVersions(result->m_versions, info.m_connectionHost);
+			m_impl->m_balancer.SetServerToolVersions(index, InvocationRewriterConfig::GetCheckedVersions(result->m_versions));
+			AvailableCheck();
 		}
 	};
 	handler->QueueFrame(ToolsVersionRequest::Ptr(new ToolsVersionRequest()), versionFrameCallback, m_config.m_requestTimeout);
 
 	{
 		std::lock_guard<std::mutex> lock2(m_impl->m_clientsMutex);
-		m_impl->m_clients.push_back(handler);
+		m_impl->m_clients[index] = handler;
 	}
 	if (start)
 	   handler->Start();
 }
 
-void RemoteToolClient::InvokeTool(const ToolInvocation & invocation, const InvokeCallback& callback)
+void RemoteToolClient::InvokeTool(const ToolInvocation & invocation, const InvokeCallback& callback, const std::string & resultFilename)
 {
 	TimePoint start(true);
 	const std::string inputFilename  = invocation.GetInput();
@@ -331,33 +875,61 @@ void RemoteToolClient::InvokeTool(const ToolInvocation & invocation, const Invok
 		return;
 	}
 	m_totalCompressionTime += start.GetElapsedTime();
+	QueueTask(invocation, inputData, callback, start, resultFilename);
+}
+
+void RemoteToolClient::InvokeTool(const ToolInvocation & invocation, const ByteArrayHolder & inputData, const InvokeCallback& callback)
+{
+	QueueTask(invocation, inputData, callback, TimePoint(true));
+}
 
-	RemoteToolRequest::Ptr toolRequest(new RemoteToolRequest());
+void RemoteToolClient::QueueTask(const ToolInvocation & invocation, const ByteArrayHolder & inputData, const InvokeCallback& callback, TimePoint start,
+								 const std::string & resultFilename)
+{
+	auto toolRequest = std::make_shared<RemoteToolRequest>();
 	toolRequest->m_invocation = m_invocationRewriter->PrepareRemote(invocation);
 	toolRequest->m_fileData = inputData;
 	toolRequest->m_compression = m_config.m_compression;
 	toolRequest->m_sessionId = m_sessionId;
 	toolRequest->m_clientId = m_config.m_clientId;
 
-	RemoteToolRequestWrap wrap;
-	wrap.m_start = start;
-	wrap.m_toolRequest = toolRequest;
-	wrap.m_taskIndex = m_taskIndex++;
-	wrap.m_invocation = toolRequest->m_invocation;
-	wrap.m_originalFilename = invocation.GetOutput();
-	wrap.m_callback = callback;
-	wrap.m_expirationMoment = TimePoint(true) + m_config.m_queueTimeout;
-	wrap.m_attemptsRemain = m_config.m_invocationAttempts;
-	wrap.m_requestTimeout = m_config.m_requestTimeout;
+	RemoteToolTaskPool::Handle task = m_impl->m_taskPool.Acquire();
+	task->m_start = start;
+	task->m_taskIndex = m_taskIndex++;
+	task->m_originalFilename = invocation.GetOutput();
+	task->m_resultFilename = resultFilename.empty() ? task->m_originalFilename : resultFilename;
+	task->m_callback = callback;
+	task->m_expirationMoment = TimePoint(true) + m_config.m_queueTimeout;
+	task->m_attemptsRemain = m_config.m_invocationAttempts;
+	task->m_requestTimeout = m_config.m_requestTimeout;
+	if (m_impl->m_historyEnabled)
+	{
+		task->m_historyKey = toolRequest->m_invocation.m_id.m_toolId + " " + task->m_originalFilename;
+		task->m_predictedTime = m_impl->m_history.Predict(task->m_historyKey, inputData.size(), &task->m_predictionKnown);
+		// fail fast on hung server instead of waiting full request timeout.
+		if (task->m_predictionKnown && task->m_predictedTime)
+			task->m_requestTimeout = std::min(m_config.m_requestTimeout, std::max(g_minPredictedTimeout, task->m_predictedTime * g_predictedTimeoutFactor));
+	}
+	task->m_toolRequest = std::move(toolRequest);
 
 	m_sentBytes += inputData.size();
 
-	Syslogger(Syslogger::Info) << "QueueFrame [" << wrap.m_taskIndex << "] -> " << toolRequest->m_invocation.m_id.m_toolId
-							   << " " << toolRequest->m_invocation.GetArgsString(false)
-						<< ", balancerFree:" <<m_impl->m_balancer.GetFreeThreads()
-						<< ", pending:" << m_impl->m_pendingTasks;
+	if (Syslogger::IsLogLevelEnabled(Syslogger::Info))
+		Syslogger(Syslogger::Info) << "QueueFrame [" << task->m_taskIndex << "] -> " << task->GetToolId()
+								   << " " << task->m_toolRequest->m_invocation.GetArgsString(false)
+								   << ", balancerFree:" <<m_impl->m_balancer.GetFreeThreads()
+								   << ", pending:" << m_impl->m_pendingTasks;
+
+	m_impl->QueueTask(task);
+}
 
-	m_impl->QueueTask(wrap);
+bool RemoteToolClient::IsPreprocessStreamed() const
+{
+#ifdef _WIN32
+	return false;
+#else
+	return m_config.m_streamPreprocessed;
+#endif
 }
 
 std::string RemoteToolClient::GetSessionInformation() const
@@ -400,35 +972,6 @@ void RemoteToolClient::AvailableCheck()
 	}
 }
 
-void RemoteToolClient::CheckRemoteToolVersions(const IVersionChecker::VersionMap &versionMap, const std::string & hostname)
-{
-	for (const auto & versionPair : versionMap)
-	{
-		const auto & toolId = versionPair.first;
-		const auto & remoteVersion = versionPair.second;
-		if (std::find(m_requiredToolIds.cbegin(), m_requiredToolIds.cend(), toolId) == m_requiredToolIds.cend())
-			continue; // OK, we do not even need that tool.
-
-		const auto localIt = m_toolVersionMap.find(toolId);
-		if (localIt == m_toolVersionMap.end())
-			continue; // OK, we do not have such a tool locally.
-
-		const auto & localVersion = localIt->second;
-		if (localVersion.empty() && remoteVersion.empty())
-			continue; // OK, it's non-versioned tool
-
-		if (localVersion == remoteVersion)
-			continue; // OK, most common situation
-		
-		if (localVersion == InvocationRewriterConfig::VERSION_NO_CHECK || remoteVersion == InvocationRewriterConfig::VERSION_NO_CHECK)
-			continue;
-
-		Syslogger(Syslogger::Err) << "Tool id=" << toolId << " has local version='" << localVersion
-								  << "' and remote version='" << remoteVersion << "' on '" << hostname  << "'";
-		m_compilerVersionSuitable = false;
-	}
-}
-
 std::string RemoteToolClient::TaskExecutionInfo::GetProfilingStr() const
 {
 	std::ostringstream os;
@@ -34,6 +34,9 @@ class RemoteToolClientImpl;
  *
  * Recieves remote tool servers list from Coordinator; then connects to all servers.
  * After reciving new task through InvokeTool() - distributes them to servers.
+ * With pull scheduling, tasks are kept in client queue until server reports free slot.
+ * With cluster snapshot file, servers from last coordinator info are connected on start, without waiting for coordinator;
+ * ones missing from fresh info are dropped then.
  */
 class RemoteToolClient
 {
@@ -65,21 +68,40 @@ public:
 	void AddClient(const ToolServerInfo & info, bool start = false);
 
 	int GetFreeRemoteThreads() const;
+	/// Expected wait for remote thread of new task, from queued tasks and average execution time; zero when thread is free.
+	TimePoint GetExpectedQueueWait();
+	/// Execution time of task on average server from task history; zero if output was not executed before or history is disabled.
+	TimePoint PredictExecutionTime(const ToolInvocation & invocation) const;
 
 	void Start(const StringVector & requiredToolIds = StringVector());
 	void FinishSession();
 
 	void SetRemoteAvailableCallback(RemoteAvailableCallback callback);
 
-	/// Starts new remote task.
-	void InvokeTool(const ToolInvocation & invocation, const InvokeCallback& callback);
+	/// Starts new remote task. Result is written to resultFilename if set, instead of invocation output.
+	void InvokeTool(const ToolInvocation & invocation, const InvokeCallback& callback, const std::string & resultFilename = std::string());
+	/// Starts new remote task with input data already compressed by GetCompression(), e.g. piped from preprocessor.
+	/// Input file of invocation is used only as name.
+	void InvokeTool(const ToolInvocation & invocation, const ByteArrayHolder & inputData, const InvokeCallback& callback);
+
+	CompressionInfo GetCompression() const { return m_config.m_compression; }
+	/// Whether preprocessor output should be piped into request instead of file; always false on Windows.
+	bool IsPreprocessStreamed() const;
 
 	std::string GetSessionInformation() const;
 
 protected:
+	void QueueTask(const ToolInvocation & invocation, const ByteArrayHolder & inputData, const InvokeCallback& callback, TimePoint start,
+				   const std::string & resultFilename = std::string());
 	void UpdateSessionInfo(const TaskExecutionInfo& executionResult);
 	void AvailableCheck();
-	void CheckRemoteToolVersions(const IVersionChecker::VersionMap & versionMap, const std::string & hostname);
+	/// Adds servers from coordinator, drops snapshot servers it does not know and saves snapshot.
+	void OnCoordinatorInfo(const CoordinatorInfo & info);
+	void ConnectClient(size_t index, const ToolServerInfo & info, bool start);
+	/// Connects servers added to balancer working set and disconnects removed ones.
+	void UpdateWorkingSet(bool replaceWorst, bool start);
+	/// Requests, renews or releases slot leases according to current demand.
+	void UpdateLeases();
 
 	ThreadLoop m_thread;
 
@@ -88,6 +110,11 @@ protected:
 	bool m_started = false;
 	TimePoint m_start;
 	TimePoint m_lastFinish;
+	TimePoint m_lastWorkingSetUpdate;
+	TimePoint m_lastLeaseRequest;
+	TimePoint m_lastLeaseGrant;
+	TimePoint m_leaseDuration;
+	std::mutex m_leasesMutex;
 	int64_t m_sessionId  = 0;
 	int64_t m_taskIndex  = 0;
 	TimePoint m_totalCompressionTime;
@@ -97,7 +124,6 @@ protected:
 	std::mutex m_sessionInfoMutex;
 	std::mutex m_availableCheckMutex;
 
-	bool m_compilerVersionSuitable = true;
 	bool m_remoteIsAvailable = false;
 	RemoteAvailableCallback m_remoteAvailableCallback;
 	Config m_config;
@@ -19,6 +19,35 @@
 namespace Wuild
 {
 
+template<>
+inline ByteOrderDataStreamReader& ByteOrderDataStreamReader::operator >> (ToolServerLoad &load)
+{
+	*this
+		>> load.m_runningTasks
+		>> load.m_queuedTasks
+		>> load.m_estimatedWait
+		>> load.m_avgExecutionTime
+		   ;
+	return *this;
+}
+template<>
+inline ByteOrderDataStreamWriter& ByteOrderDataStreamWriter::operator << (const ToolServerLoad &load)
+{
+	*this
+		<< load.m_runningTasks
+		<< load.m_queuedTasks
+		<< load.m_estimatedWait
+		<< load.m_avgExecutionTime
+		   ;
+	return *this;
+}
+
+static void LogLoad(std::ostream &os, const ToolServerLoad & load)
+{
+	os << " running:" << load.m_runningTasks << " queue:" << load.m_queuedTasks
+	   << " wait:" << load.m_estimatedWait.ToProfilingTime() << " avg:" << load.m_avgExecutionTime.ToProfilingTime();
+}
+
 void RemoteToolRequest::LogTo(std::ostream &os) const
 {
 	SocketFrame::LogTo(os);
@@ -52,10 +81,17 @@ SocketFrame::State RemoteToolRequest::WriteInternal(ByteOrderDataStreamWriter &s
 void RemoteToolResponse::LogTo(std::ostream &os) const
 {
 	SocketFrame::LogTo(os);
+	if (m_serverBusy)
+	{
+		os << " -> BUSY";
+		LogLoad(os, m_serverLoad);
+		return;
+	}
 	os << " -> " << (m_result ? "OK" : "FAIL") << " ["
 	   << m_fileData.size() << ", COMP:" << uint32_t(m_compression.m_type) << "], std["
 	   << m_stdOut.size() << "]"
 		  ;
+	LogLoad(os, m_serverLoad);
 }
 
 SocketFrame::State RemoteToolResponse::ReadInternal(ByteOrderDataStreamReader &stream)
@@ -65,6 +101,8 @@ SocketFrame::State RemoteToolResponse::ReadInternal(ByteOrderDataStreamReader &s
 	stream >> m_stdOut;
 	stream >> m_executionTime;
 	stream >> m_compression;
+	stream >> m_serverBusy;
+	stream >> m_serverLoad;
 	return stOk;
 }
 
@@ -75,6 +113,8 @@ SocketFrame::State RemoteToolResponse::WriteInternal(ByteOrderDataStreamWriter &
 	stream << m_stdOut;
 	stream << m_executionTime;
 	stream << m_compression;
+	stream << m_serverBusy;
+	stream << m_serverLoad;
 	return stOk;
 }
 
@@ -90,4 +130,62 @@ SocketFrame::State ToolsVersionResponse::WriteInternal(ByteOrderDataStreamWriter
 	return stOk;
 }
 
+void RemoteToolServerLoad::LogTo(std::ostream &os) const
+{
+	SocketFrame::LogTo(os);
+	LogLoad(os, m_load);
+}
+
+SocketFrame::State RemoteToolServerLoad::ReadInternal(ByteOrderDataStreamReader &stream)
+{
+	stream >> m_load;
+	return stOk;
+}
+
+SocketFrame::State RemoteToolServerLoad::WriteInternal(ByteOrderDataStreamWriter &stream) const
+{
+	stream << m_load;
+	return stOk;
+}
+
+void RemoteToolPullRequest::LogTo(std::ostream &os) const
+{
+	SocketFrame::LogTo(os);
+	os << " queued:" << m_queuedTasks << " declined:" << m_declinedSlots;
+}
+
+SocketFrame::State RemoteToolPullRequest::ReadInternal(ByteOrderDataStreamReader &stream)
+{
+	stream >> m_sessionId;
+	stream >> m_queuedTasks;
+	stream >> m_declinedSlots;
+	return stOk;
+}
+
+SocketFrame::State RemoteToolPullRequest::WriteInternal(ByteOrderDataStreamWriter &stream) const
+{
+	stream << m_sessionId;
+	stream << m_queuedTasks;
+	stream << m_declinedSlots;
+	return stOk;
+}
+
+void RemoteToolReady::LogTo(std::ostream &os) const
+{
+	SocketFrame::LogTo(os);
+	os << " slots:" << m_slots;
+}
+
+SocketFrame::State RemoteToolReady::ReadInternal(ByteOrderDataStreamReader &stream)
+{
+	stream >> m_slots;
+	return stOk;
+}
+
+SocketFrame::State RemoteToolReady::WriteInternal(ByteOrderDataStreamWriter &stream) const
+{
+	stream << m_slots;
+	return stOk;
+}
+
 }
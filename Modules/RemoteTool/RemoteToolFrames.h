@@ -16,6 +16,7 @@
 #include <ToolInvocation.h>
 #include <TimePoint.h>
 #include <CommonTypes.h>
+#include <CoordinatorTypes.h>
 #include <FileUtils.h>
 
 /// Declaration of channel structures for RemoteToolServer and RemoteToolClient
@@ -46,7 +47,7 @@ public:
 class RemoteToolResponse : public SocketFrameExt
 {
 public:
-	static const uint32_t s_version = 2;
+	static const uint32_t s_version = 4;
 	static const uint8_t s_frameTypeId = s_minimalUserFrameId + 2;
 	using Ptr = std::shared_ptr<RemoteToolResponse>;
 
@@ -55,6 +56,8 @@ public:
 	CompressionInfo		m_compression;
 	std::string         m_stdOut;
 	TimePoint           m_executionTime;
+	bool                m_serverBusy = false;  //!< Task was rejected without execution, client should send it elsewhere.
+	ToolServerLoad      m_serverLoad;          //!< Server load after task finished (or was rejected).
 
 	void                LogTo(std::ostream& os) const override;
 	uint8_t             FrameTypeId() const override { return s_frameTypeId;}
@@ -91,4 +94,57 @@ public:
 	State               WriteInternal(ByteOrderDataStreamWriter &stream) const override;
 };
 
+/// Server load sent periodically to all clients, when it changes.
+class RemoteToolServerLoad : public SocketFrameExt
+{
+public:
+	static const uint32_t s_version = 1;
+	static const uint8_t s_frameTypeId = s_minimalUserFrameId + 7;
+	using Ptr = std::shared_ptr<RemoteToolServerLoad>;
+
+	ToolServerLoad      m_load;
+
+	uint8_t             FrameTypeId() const override { return s_frameTypeId;}
+
+	void                LogTo(std::ostream& os) const override;
+	State               ReadInternal(ByteOrderDataStreamReader &stream) override;
+	State               WriteInternal(ByteOrderDataStreamWriter &stream) const override;
+};
+
+/// Pull scheduling: client reports to server how many queued tasks server could take.
+class RemoteToolPullRequest : public SocketFrameExt
+{
+public:
+	static const uint32_t s_version = 1;
+	static const uint8_t s_frameTypeId = s_minimalUserFrameId + 5;
+	using Ptr = std::shared_ptr<RemoteToolPullRequest>;
+
+	uint64_t            m_sessionId = 0;
+	uint32_t            m_queuedTasks = 0;
+	uint32_t            m_declinedSlots = 0;  //!< Granted slots client had no task for.
+
+	uint8_t             FrameTypeId() const override { return s_frameTypeId;}
+
+	void                LogTo(std::ostream& os) const override;
+	State               ReadInternal(ByteOrderDataStreamReader &stream) override;
+	State               WriteInternal(ByteOrderDataStreamWriter &stream) const override;
+};
+
+/// Pull scheduling: server has free slots reserved for client, client answers with RemoteToolRequest for each.
+class RemoteToolReady : public SocketFrameExt
+{
+public:
+	static const uint32_t s_version = 1;
+	static const uint8_t s_frameTypeId = s_minimalUserFrameId + 6;
+	using Ptr = std::shared_ptr<RemoteToolReady>;
+
+	uint32_t            m_slots = 0;
+
+	uint8_t             FrameTypeId() const override { return s_frameTypeId;}
+
+	void                LogTo(std::ostream& os) const override;
+	State               ReadInternal(ByteOrderDataStreamReader &stream) override;
+	State               WriteInternal(ByteOrderDataStreamWriter &stream) const override;
+};
+
 }
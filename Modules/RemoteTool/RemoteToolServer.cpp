@@ -17,16 +17,45 @@
 
 #include <SocketFrameService.h>
 #include <CoordinatorClient.h>
+#include <InvocationRewriterConfig.h>
 #include <ThreadUtils.h>
 
 #include <algorithm>
+#include <cstdlib>
 #include <utility>
 #include <memory>
+#include <unordered_map>
 
 namespace Wuild
 {
 
 static const size_t g_recommendedBufferSize = 64 * 1024;
+static const TimePoint g_speedBenchmarkTime(0.05);
+static const int g_speedBaselineSamples = 32;
+static const int g_pullPrefetchSlots = 1;
+static const int g_loadResendIntervals = 4; //!< unchanged load is sent again after this number of intervals.
+
+/// Short single-threaded benchmark with compiler-like workload (string hashing and map lookups).
+/// Returns work done per millisecond, so it could be compared between machines.
+static uint32_t MeasureSpeedScore()
+{
+	std::unordered_map<std::string, size_t> symbols;
+	std::string name;
+	size_t checksum = 0;
+	int64_t iterations = 0;
+	TimePoint start(true);
+	while (start.GetElapsedTime() < g_speedBenchmarkTime)
+	{
+		for (int i = 0; i < 1000; ++i, ++iterations)
+		{
+			name = "symbol_" + std::to_string(iterations % 4096);
+			checksum += symbols[name]++;
+		}
+	}
+	const int64_t elapsedUS = std::max(int64_t(1), start.GetElapsedTime().GetUS());
+	Syslogger(Syslogger::Debug) << "Speed benchmark checksum: " << checksum;
+	return static_cast<uint32_t>(std::max(int64_t(1), iterations * 1000 / elapsedUS));
+}
 
 class RemoteToolServerImpl
 {
@@ -38,6 +67,32 @@ public:
 	ILocalExecutor::Ptr m_executor;
 	std::mutex m_sessionsIdsMutex;
 	std::map<SocketFrameHandler*, int64_t> m_sessionsIds;
+	std::mutex m_executionTimeMutex;
+	TimePoint m_avgExecutionTime; //!< moving average, used for queue wait estimation.
+	uint32_t m_benchmarkScore = 0;
+	double m_baselineCost = 0;    //!< average execution time per input KiB of first tasks.
+	double m_currentCost = 0;     //!< moving average of execution time per input KiB.
+	int m_costSamples = 0;
+	ThreadLoop m_loadThread;
+	ToolServerLoad m_lastSentLoad;
+	TimePoint m_lastLoadSent;
+
+	struct PullClient
+	{
+		SocketFrameHandler * m_handler = nullptr;
+		uint32_t m_queuedTasks = 0;  //!< as reported by client, minus tasks recieved since.
+		uint32_t m_grantedSlots = 0; //!< sent in RemoteToolReady, but task not recieved yet.
+	};
+	std::mutex m_pullMutex;
+	std::deque<PullClient> m_pullClients;
+	size_t m_pullPosition = 0;
+	PullClient * FindPullClient(SocketFrameHandler * handler)
+	{
+		for (auto & client : m_pullClients)
+			if (client.m_handler == handler)
+				return &client;
+		return nullptr;
+	}
 };
 
 RemoteToolServer::RemoteToolServer(ILocalExecutor::Ptr executor, const IVersionChecker::VersionMap & versionMap)
@@ -49,6 +104,7 @@ RemoteToolServer::RemoteToolServer(ILocalExecutor::Ptr executor, const IVersionC
 
 RemoteToolServer::~RemoteToolServer()
 {
+	m_impl->m_loadThread.Stop();
 	m_impl->m_server.reset();
 }
 
@@ -72,14 +128,27 @@ void RemoteToolServer::Start()
 	info.m_totalThreads = m_config.m_threadCount;
 	info.m_toolServerId = m_config.m_serverName;
 	info.m_toolIds = m_impl->m_executor->GetToolIds();
+	info.m_toolVersions = InvocationRewriterConfig::GetCheckedVersions(m_toolVersionMap);
+	info.m_speedScore = m_impl->m_benchmarkScore = MeasureSpeedScore();
+	Syslogger(Syslogger::Notice) << "Speed score: " << info.m_speedScore;
 	m_impl->m_executor->SetThreadCount(m_config.m_threadCount);
+	for (const auto & toolLimit : m_config.m_toolThreadCount)
+	{
+		ToolServerInfo::ToolSlots slots;
+		slots.m_toolId = toolLimit.first;
+		slots.m_totalThreads = static_cast<uint16_t>(toolLimit.second);
+		info.m_toolSlots.push_back(slots);
+		m_impl->m_executor->SetToolThreadCount(toolLimit.first, toolLimit.second);
+	}
 
 	m_impl->m_coordinator.SetToolServerInfo(info);
 	if (!m_impl->m_coordinator.SetConfig(m_config.m_coordinator))
 		return;
 
 	SocketFrameHandlerSettings settings;
-	settings.m_channelProtocolVersion       = RemoteToolRequest::s_version + RemoteToolResponse::s_version;
+	settings.m_channelProtocolVersion       = RemoteToolRequest::s_version + RemoteToolResponse::s_version
+											+ RemoteToolServerLoad::s_version
+											+ RemoteToolPullRequest::s_version + RemoteToolReady::s_version;
 	settings.m_recommendedRecieveBufferSize = g_recommendedBufferSize;
 	settings.m_recommendedSendBufferSize    = g_recommendedBufferSize;
 	settings.m_segmentSize = 8192;
@@ -95,21 +164,38 @@ void RemoteToolServer::Start()
 				std::lock_guard<std::mutex> lock(m_impl->m_sessionsIdsMutex);
 				m_impl->m_sessionsIds[handler] = sessionId;
 			}
-			StartTask(inputMessage.m_clientId, sessionId);
+			const auto toolId = inputMessage.m_invocation.m_id.m_toolId;
+			const bool granted = TakeGrantedSlot(handler);
+			const ToolServerLoad load = GetLoad();
+			if (!granted && IsOverloaded(load))
+			{
+				Syslogger(Syslogger::Info) << "Rejecting " << toolId << " task: queue=" << load.m_queuedTasks << ", estimated wait=" << load.m_estimatedWait.ToProfilingTime();
+				RemoteToolResponse::Ptr response(new RemoteToolResponse());
+				response->m_result = false;
+				response->m_serverBusy = true;
+				response->m_serverLoad = load;
+				outputCallback(response);
+				return;
+			}
+			StartTask(inputMessage.m_clientId, sessionId, toolId);
 			LocalExecutorTask::Ptr taskCC(new LocalExecutorTask());
 			taskCC->m_invocation = inputMessage.m_invocation;
 			taskCC->m_inputData = inputMessage.m_fileData;
+			const size_t inputSize = inputMessage.m_fileData.size();
 			taskCC->m_compressionInput = inputMessage.m_compression;
 			auto compressionOut = taskCC->m_compressionOutput = m_config.m_useClientCompression ? inputMessage.m_compression : m_config.m_compression;
-			taskCC->m_callback = [outputCallback, this, sessionId, compressionOut](LocalExecutorResult::Ptr result)
+			taskCC->m_callback = [outputCallback, this, sessionId, compressionOut, toolId, inputSize](LocalExecutorResult::Ptr result)
 			{
-				FinishTask(sessionId, false);
+				FinishTask(sessionId, false, toolId);
+				UpdateExecutionTime(result->m_executionTime, inputSize);
+				GrantSlots();
 				RemoteToolResponse::Ptr response(new RemoteToolResponse());
 				response->m_result = result->m_result;
 				response->m_stdOut = result->m_stdOut;
 				response->m_fileData = result->m_outputData;
 				response->m_compression = compressionOut;
 				response->m_executionTime = result->m_executionTime;
+				response->m_serverLoad = GetLoad();
 				outputCallback(response);
 			};
 			m_impl->m_executor->AddTask(taskCC);
@@ -120,6 +206,23 @@ void RemoteToolServer::Start()
 			response->m_versions = m_toolVersionMap;
 			outputCallback(response);
 		}));
+
+		handler->RegisterFrameReader(SocketFrameReaderTemplate<RemoteToolPullRequest>::Create([this, handler](const RemoteToolPullRequest& inputMessage, SocketFrameHandler::OutputCallback){
+			{
+				std::lock_guard<std::mutex> lock(m_impl->m_pullMutex);
+				auto * client = m_impl->FindPullClient(handler);
+				if (!client)
+				{
+					m_impl->m_pullClients.emplace_back();
+					client = &m_impl->m_pullClients.back();
+					client->m_handler = handler;
+				}
+				client->m_grantedSlots -= std::min(client->m_grantedSlots, inputMessage.m_declinedSlots);
+				// client has not seen grants still in flight, they will take some of reported tasks.
+				client->m_queuedTasks = inputMessage.m_queuedTasks;
+			}
+			GrantSlots();
+		}));
 	});
 
 	m_impl->m_server->SetHandlerDestroyCallback([this](SocketFrameHandler * handler){
@@ -130,10 +233,21 @@ void RemoteToolServer::Start()
 			m_impl->m_sessionsIds.erase(handler);
 		}
 		FinishTask(sessionId, true);
+		{
+			std::lock_guard<std::mutex> lock(m_impl->m_pullMutex);
+			auto & clients = m_impl->m_pullClients;
+			clients.erase(std::remove_if(clients.begin(), clients.end(), [handler](const auto & client){
+				return client.m_handler == handler;
+			}), clients.end());
+		}
+		GrantSlots();
 	});
 
 	m_impl->m_server->Start();
 
+	if (m_config.m_loadReportInterval)
+		m_impl->m_loadThread.Exec(std::bind(&RemoteToolServer::SendLoad, this), m_config.m_loadReportInterval.GetUS());
+
 	m_impl->m_coordinator.Start();
 }
 
@@ -150,17 +264,19 @@ ToolServerInfo::ConnectedClientInfo & GetClientInfo(ToolServerInfo & info, int64
 	return *info.m_connectedClients.rbegin();
 }
 
-void RemoteToolServer::StartTask(const std::string &clientId, int64_t sessionId)
+void RemoteToolServer::StartTask(const std::string &clientId, int64_t sessionId, const std::string & toolId)
 {
 	std::lock_guard<std::mutex> lock(m_impl->m_infoMutex);
 	auto  &client = GetClientInfo(m_impl->m_info, sessionId);
 	client.m_clientId = clientId;
 	client.m_usedThreads ++;
 	m_runningTasks++;
+	if (auto * slots = m_impl->m_info.FindToolSlots(toolId))
+		slots->m_runningTasks++;
 	UpdateInfo();
 }
 
-void RemoteToolServer::FinishTask(int64_t sessionId, bool remove)
+void RemoteToolServer::FinishTask(int64_t sessionId, bool remove, const std::string & toolId)
 {
 	std::lock_guard<std::mutex> lock(m_impl->m_infoMutex);
 	ToolServerInfo & info = m_impl->m_info;
@@ -178,15 +294,142 @@ void RemoteToolServer::FinishTask(int64_t sessionId, bool remove)
 			clientIt->m_usedThreads--;
 		if (m_runningTasks)
 			m_runningTasks--;
+		auto * slots = info.FindToolSlots(toolId);
+		if (slots && slots->m_runningTasks)
+			slots->m_runningTasks--;
+	}
+	UpdateInfo();
+}
+
+ToolServerLoad RemoteToolServer::GetLoad() const
+{
+	ToolServerLoad load;
+	load.m_runningTasks = m_runningTasks;
+	load.m_queuedTasks = static_cast<uint16_t>(m_impl->m_executor->GetQueueSize());
+	std::lock_guard<std::mutex> lock(m_impl->m_executionTimeMutex);
+	load.m_avgExecutionTime = m_impl->m_avgExecutionTime;
+	load.m_estimatedWait.SetUS(m_impl->m_avgExecutionTime.GetUS() * int64_t(load.m_queuedTasks) / int64_t(m_config.m_threadCount));
+	return load;
+}
+
+bool RemoteToolServer::IsOverloaded(const ToolServerLoad & load) const
+{
+	if (m_config.m_maxQueueSize && load.m_queuedTasks >= static_cast<uint32_t>(m_config.m_maxQueueSize))
+		return true;
+
+	return m_config.m_maxQueueWait && load.m_estimatedWait > m_config.m_maxQueueWait;
+}
+
+void RemoteToolServer::SendLoad()
+{
+	const ToolServerLoad load = GetLoad();
+	if (load == m_impl->m_lastSentLoad && m_impl->m_lastLoadSent.GetElapsedTime().GetUS() < m_config.m_loadReportInterval.GetUS() * int64_t(g_loadResendIntervals))
+		return;
+
+	RemoteToolServerLoad::Ptr frame(new RemoteToolServerLoad());
+	frame->m_load = load;
+	m_impl->m_server->QueueFrameToAll(nullptr, frame);
+	m_impl->m_lastSentLoad = load;
+	m_impl->m_lastLoadSent = TimePoint(true);
+}
+
+void RemoteToolServer::UpdateExecutionTime(const TimePoint & executionTime, size_t inputSize)
+{
+	uint32_t speedScore = 0;
+	{
+		std::lock_guard<std::mutex> lock(m_impl->m_executionTimeMutex);
+		if (!m_impl->m_avgExecutionTime)
+			m_impl->m_avgExecutionTime = executionTime;
+		else
+			m_impl->m_avgExecutionTime.SetUS((m_impl->m_avgExecutionTime.GetUS() * int64_t(7) + executionTime.GetUS()) / int64_t(8));
+
+		// benchmark gives initial score; later it follows how compile times change relative to first tasks
+		// (e.g. throttling or other load on the machine).
+		const double cost = executionTime.GetUS() / (1.0 + inputSize / 1024.);
+		if (m_impl->m_costSamples < g_speedBaselineSamples)
+		{
+			m_impl->m_costSamples++;
+			m_impl->m_baselineCost += (cost - m_impl->m_baselineCost) / m_impl->m_costSamples;
+			m_impl->m_currentCost = m_impl->m_baselineCost;
+			return;
+		}
+		m_impl->m_currentCost += (cost - m_impl->m_currentCost) / 16;
+		if (m_impl->m_currentCost <= 0)
+			return;
+		const double ratio = std::min(2.0, std::max(0.25, m_impl->m_baselineCost / m_impl->m_currentCost));
+		speedScore = static_cast<uint32_t>(std::max(1.0, m_impl->m_benchmarkScore * ratio));
 	}
+
+	std::lock_guard<std::mutex> lock(m_impl->m_infoMutex);
+	const uint32_t prevScore = m_impl->m_info.m_speedScore;
+	if (std::abs(int64_t(speedScore) - int64_t(prevScore)) * 20 < int64_t(prevScore)) // less than 5% change
+		return;
+	m_impl->m_info.m_speedScore = speedScore;
 	UpdateInfo();
 }
 
+void RemoteToolServer::GrantSlots()
+{
+	std::lock_guard<std::mutex> lock(m_impl->m_pullMutex);
+	auto & clients = m_impl->m_pullClients;
+	if (clients.empty())
+		return;
+
+	// slot is offered a bit before it is free, so next task arrives while previous finishes.
+	int freeSlots = m_config.m_threadCount + g_pullPrefetchSlots - m_runningTasks;
+	for (const auto & client : clients)
+		freeSlots -= client.m_grantedSlots;
+
+	// one slot at a time to each client with queued tasks, so clients share server fairly.
+	std::vector<uint32_t> grants(clients.size(), 0);
+	size_t idle = 0;
+	while (freeSlots > 0 && idle < clients.size())
+	{
+		const size_t position = m_impl->m_pullPosition++ % clients.size();
+		auto & client = clients[position];
+		if (client.m_queuedTasks <= client.m_grantedSlots + grants[position])
+		{
+			idle++;
+			continue;
+		}
+		idle = 0;
+		grants[position]++;
+		freeSlots--;
+	}
+	for (size_t i = 0; i < clients.size(); ++i)
+	{
+		if (!grants[i])
+			continue;
+		clients[i].m_grantedSlots += grants[i];
+		RemoteToolReady::Ptr ready(new RemoteToolReady());
+		ready->m_slots = grants[i];
+		clients[i].m_handler->QueueFrame(ready);
+	}
+}
+
+bool RemoteToolServer::TakeGrantedSlot(SocketFrameHandler *handler)
+{
+	std::lock_guard<std::mutex> lock(m_impl->m_pullMutex);
+	auto * client = m_impl->FindPullClient(handler);
+	if (!client)
+		return false;
+	if (client->m_queuedTasks)
+		client->m_queuedTasks--;
+	if (!client->m_grantedSlots)
+		return false;
+	client->m_grantedSlots--;
+	return true;
+}
+
 void RemoteToolServer::UpdateInfo()
 {
 	ToolServerInfo & info = m_impl->m_info;
 	if (info.m_connectedClients.empty())
+	{
 		m_runningTasks = 0;
+		for (auto & slots : info.m_toolSlots)
+			slots.m_runningTasks = 0;
+	}
 
 	info.m_runningTasks = m_runningTasks;
 	info.m_queuedTasks = m_impl->m_executor->GetQueueSize();
@@ -25,6 +25,7 @@ namespace Wuild
 {
 class RemoteToolServerImpl;
 /// Listening port for incoming tool execution tasks and transforms it to LocalExecutor.
+/// Clients in pull scheduling mode are offered free slots round-robin, instead of sending tasks at once.
 class RemoteToolServer
 {
 public:
@@ -39,9 +40,19 @@ public:
 	void Start();
 
 protected:
-	void StartTask(const std::string & clientId, int64_t sessionId);
-	void FinishTask(int64_t sessionId, bool remove);
+	void StartTask(const std::string & clientId, int64_t sessionId, const std::string & toolId);
+	void FinishTask(int64_t sessionId, bool remove, const std::string & toolId = std::string());
 	void UpdateInfo();
+	ToolServerLoad GetLoad() const;
+	/// Checks maxQueueSize and maxQueueWait limits.
+	bool IsOverloaded(const ToolServerLoad & load) const;
+	/// Sends load to all clients if it changed since last time.
+	void SendLoad();
+	void UpdateExecutionTime(const TimePoint & executionTime, size_t inputSize);
+	/// Pull scheduling: sends free slots to clients having queued tasks, round-robin.
+	void GrantSlots();
+	/// Returns true if client sent task in reserved slot.
+	bool TakeGrantedSlot(SocketFrameHandler * handler);
 
 	std::unique_ptr<RemoteToolServerImpl> m_impl;
 	std::atomic<uint16_t>       m_runningTasks {0};
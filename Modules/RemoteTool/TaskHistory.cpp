@@ -0,0 +1,241 @@
+/*
+ * Copyright (C) 2018 Smirnov Vladimir mapron1@gmail.com
+ * Source code licensed under the Apache License, Version 2.0 (the "License");
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at http://www.apache.org/licenses/LICENSE-2.0 or in file COPYING-APACHE-2.0.txt
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.h
+ */
+
+#include "TaskHistory.h"
+
+#include <Syslogger.h>
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace Wuild
+{
+static const char g_historyMagic[8] = {'W', 'u', 'i', 'l', 'd', 'T', 'H', '1'};
+static const size_t g_compactMinRecords = 4096;
+static const double g_minSizeRatio = 0.5;
+static const double g_maxSizeRatio = 2.0;
+
+TaskHistory::~TaskHistory()
+{
+	Close();
+}
+
+bool TaskHistory::Open(const std::string &filename)
+{
+	Close();
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_filename = filename;
+	m_index.clear();
+	m_records = 0;
+	m_avgScore = m_avgCostPerKiB = 0;
+	bool partialRecord = false;
+	if (!Load(partialRecord))
+		Syslogger(Syslogger::Warning) << "Task history " << m_filename << " is invalid, starting new one.";
+
+	// appending after incomplete record would misalign all following ones.
+	if (partialRecord || (m_records > g_compactMinRecords && m_records > m_index.size() * 2))
+	{
+		if (!Compact() && partialRecord)
+			m_records = 0;
+	}
+
+	m_file = fopen(m_filename.c_str(), m_records ? "ab" : "wb");
+	if (!m_file)
+	{
+		Syslogger(Syslogger::Err) << "Failed to open task history " << m_filename;
+		return false;
+	}
+	if (!m_records)
+		fwrite(g_historyMagic, sizeof(g_historyMagic), 1, m_file);
+	Syslogger() << "Task history " << m_filename << ": " << m_index.size() << " outputs, " << m_records << " records.";
+	return true;
+}
+
+void TaskHistory::Close()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	if (m_file)
+		fclose(m_file);
+	m_file = nullptr;
+}
+
+TimePoint TaskHistory::Predict(const std::string &key, size_t inputSize, bool *known) const
+{
+	const uint64_t hash = Hash(key);
+	std::lock_guard<std::mutex> lock(m_mutex);
+	const double score = m_avgScore > 0 ? m_avgScore : 1.0;
+	const double inputKiB = 1.0 + inputSize / 1024.;
+	auto it = m_index.find(hash);
+	if (known)
+		*known = it != m_index.cend();
+	double cost = 0;
+	if (it != m_index.cend())
+	{
+		// same output with changed sources: correct only moderately, size is weak predictor.
+		const double sizeRatio = !inputSize ? 1.0 : std::min(g_maxSizeRatio, std::max(g_minSizeRatio, inputKiB / (1.0 + it->second.m_inputSize / 1024.)));
+		cost = it->second.m_cost * sizeRatio;
+	}
+	else
+	{
+		cost = m_avgCostPerKiB * inputKiB;
+	}
+	TimePoint result;
+	result.SetUS(static_cast<int64_t>(cost / score));
+	return result;
+}
+
+void TaskHistory::Add(const std::string &key, size_t inputSize, const TimePoint &executionTime, uint32_t speedScore)
+{
+	Record record;
+	record.m_key = Hash(key);
+	record.m_executionUS = static_cast<uint32_t>(std::min(executionTime.GetUS(), int64_t(UINT32_MAX)));
+	record.m_inputSize = static_cast<uint32_t>(std::min(inputSize, size_t(UINT32_MAX)));
+	record.m_speedScore = speedScore;
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	Apply(record);
+	m_records++;
+	if (m_file)
+	{
+		fwrite(&record, sizeof(record), 1, m_file);
+		fflush(m_file);
+	}
+}
+
+size_t TaskHistory::GetSize() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_index.size();
+}
+
+uint64_t TaskHistory::Hash(const std::string &key)
+{
+	// FNV-1a: same value on every platform and run, unlike std::hash.
+	uint64_t hash = 14695981039346656037ULL;
+	for (unsigned char c : key)
+	{
+		hash ^= c;
+		hash *= 1099511628211ULL;
+	}
+	return hash;
+}
+
+void TaskHistory::Apply(const TaskHistory::Record &record)
+{
+	if (record.m_speedScore)
+		m_avgScore = m_avgScore > 0 ? m_avgScore + (record.m_speedScore - m_avgScore) / 16 : record.m_speedScore;
+
+	const double score = record.m_speedScore ? record.m_speedScore : (m_avgScore > 0 ? m_avgScore : 1.0);
+	const double cost = record.m_executionUS * score;
+	const double costPerKiB = cost / (1.0 + record.m_inputSize / 1024.);
+	m_avgCostPerKiB = m_avgCostPerKiB > 0 ? m_avgCostPerKiB + (costPerKiB - m_avgCostPerKiB) / 16 : costPerKiB;
+
+	auto it = m_index.find(record.m_key);
+	if (it == m_index.end())
+	{
+		m_index[record.m_key] = Entry{cost, record.m_inputSize};
+		return;
+	}
+	// latest builds are more relevant.
+	it->second.m_cost += (cost - it->second.m_cost) / 2;
+	it->second.m_inputSize = record.m_inputSize;
+}
+
+bool TaskHistory::Load(bool & partialRecord)
+{
+#ifdef _WIN32
+	FILE * f = fopen(m_filename.c_str(), "rb");
+	if (!f)
+		return true;
+	std::vector<uint8_t> buffer;
+	fseek(f, 0, SEEK_END);
+	buffer.resize(static_cast<size_t>(std::max(0L, ftell(f))));
+	fseek(f, 0, SEEK_SET);
+	const size_t size = buffer.empty() ? 0 : fread(buffer.data(), 1, buffer.size(), f);
+	fclose(f);
+	const uint8_t * data = buffer.data();
+#else
+	const int fd = open(m_filename.c_str(), O_RDONLY);
+	if (fd < 0)
+		return true;
+	struct stat st;
+	const size_t size = fstat(fd, &st) == 0 ? static_cast<size_t>(st.st_size) : 0;
+	void * mapped = size ? mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+	close(fd);
+	if (mapped == MAP_FAILED)
+		return size == 0;
+	const uint8_t * data = static_cast<const uint8_t*>(mapped);
+#endif
+	bool result = size >= sizeof(g_historyMagic) && memcmp(data, g_historyMagic, sizeof(g_historyMagic)) == 0;
+	if (result)
+	{
+		// incomplete record at the end is possible after crash, it is ignored.
+		const size_t count = (size - sizeof(g_historyMagic)) / sizeof(Record);
+		Record record;
+		for (size_t i = 0; i < count; ++i)
+		{
+			memcpy(&record, data + sizeof(g_historyMagic) + i * sizeof(Record), sizeof(Record));
+			Apply(record);
+		}
+		m_records = count;
+		partialRecord = size != sizeof(g_historyMagic) + count * sizeof(Record);
+	}
+#ifndef _WIN32
+	munmap(mapped, size);
+#endif
+	return result || size == 0;
+}
+
+bool TaskHistory::Compact()
+{
+	const std::string tmpFilename = m_filename + ".tmp";
+	FILE * f = fopen(tmpFilename.c_str(), "wb");
+	if (!f)
+		return false;
+	const uint32_t score = static_cast<uint32_t>(std::max(1.0, m_avgScore));
+	bool result = fwrite(g_historyMagic, sizeof(g_historyMagic), 1, f) == 1;
+	for (const auto & entry : m_index)
+	{
+		Record record;
+		record.m_key = entry.first;
+		record.m_executionUS = static_cast<uint32_t>(std::min(entry.second.m_cost / score, double(UINT32_MAX)));
+		record.m_inputSize = entry.second.m_inputSize;
+		record.m_speedScore = m_avgScore > 0 ? score : 0;
+		result = result && fwrite(&record, sizeof(record), 1, f) == 1;
+	}
+	result = fclose(f) == 0 && result;
+#ifdef _WIN32
+	if (result)
+		std::remove(m_filename.c_str());
+#endif
+	if (!result || std::rename(tmpFilename.c_str(), m_filename.c_str()) != 0)
+	{
+		Syslogger(Syslogger::Warning) << "Failed to compact task history " << m_filename;
+		return false;
+	}
+	Syslogger() << "Task history compacted from " << m_records << " to " << m_index.size() << " records.";
+	m_records = m_index.size();
+	return true;
+}
+
+}
@@ -0,0 +1,87 @@
+/*
+ * Copyright (C) 2018 Smirnov Vladimir mapron1@gmail.com
+ * Source code licensed under the Apache License, Version 2.0 (the "License");
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at http://www.apache.org/licenses/LICENSE-2.0 or in file COPYING-APACHE-2.0.txt
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.h
+ */
+
+#pragma once
+
+#include <TimePoint.h>
+
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+namespace Wuild
+{
+/**
+ * Persistent history of remote execution times, used to predict cost of tasks.
+ *
+ * File is a header followed by fixed-size records (output hash, execution time, input size, server speed score),
+ * so new results are just appended. On open file is memory-mapped and folded into hash index;
+ * when it grows much larger than index, it is rewritten with one record per output.
+ *
+ * Times are normalized by server speed score, prediction is for server of average speed.
+ * Outputs never seen before are predicted from input size. Thread-safe.
+ */
+class TaskHistory
+{
+public:
+	TaskHistory() = default;
+	~TaskHistory();
+	TaskHistory(const TaskHistory &) = delete;
+	TaskHistory & operator =(const TaskHistory &) = delete;
+
+	/// Loads history and opens file for appending; without file history works in memory.
+	bool Open(const std::string & filename);
+	void Close();
+
+	/// Predicted execution time of task; if known is set, tells whether that output was executed before.
+	/// Returns zero if nothing known yet. Zero input size means it is unknown: known output is predicted as is.
+	TimePoint Predict(const std::string & key, size_t inputSize, bool * known = nullptr) const;
+
+	void Add(const std::string & key, size_t inputSize, const TimePoint & executionTime, uint32_t speedScore);
+
+	size_t GetSize() const;
+
+	/// Stable hash used as record key.
+	static uint64_t Hash(const std::string & key);
+
+protected:
+	struct Record
+	{
+		uint64_t m_key = 0;
+		uint32_t m_executionUS = 0;
+		uint32_t m_inputSize = 0;
+		uint32_t m_speedScore = 0;
+		uint32_t m_reserved = 0;
+	};
+	struct Entry
+	{
+		double m_cost = 0;        //!< execution time multiplied by speed score.
+		uint32_t m_inputSize = 0;
+	};
+
+	void Apply(const Record & record);
+	/// partialRecord is set when file ends with incomplete record.
+	bool Load(bool & partialRecord);
+	bool Compact();
+
+	std::unordered_map<uint64_t, Entry> m_index;
+	double m_avgScore = 0;
+	double m_avgCostPerKiB = 0;
+	size_t m_records = 0;
+	std::string m_filename;
+	FILE * m_file = nullptr;
+	mutable std::mutex m_mutex;
+};
+
+}
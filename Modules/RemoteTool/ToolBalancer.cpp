@@ -20,6 +20,12 @@
 
 namespace Wuild
 {
+static const TimePoint g_serverLoadTTL(3.0);
+static const double g_healthThreshold = 0.5;
+static const int g_healthAveraging = 4;
+static const TimePoint g_minTripBackoff(5.0);
+static const TimePoint g_maxTripBackoff(60.0);
+static const TimePoint g_flappingInterval(60.0);
 
 ToolBalancer::ToolBalancer() = default;
 
@@ -27,12 +33,38 @@ ToolBalancer::~ToolBalancer() = default;
 
 void ToolBalancer::SetRequiredTools(const StringVector &requiredToolIds)
 {
+	std::lock_guard<std::mutex> lock(m_clientsMutex);
 	m_requiredToolIds = requiredToolIds;
+	for (ClientInfo & client : m_clients)
+		UpdateCompatibility(client);
+	RecalcAvailable();
+}
+
+void ToolBalancer::SetLocalSite(const std::string &site)
+{
+	std::lock_guard<std::mutex> lock(m_clientsMutex);
+	m_localSite = site;
+}
+
+void ToolBalancer::SetRemoteSiteCost(double cost)
+{
+	std::lock_guard<std::mutex> lock(m_clientsMutex);
+	m_remoteSiteCost = cost;
+}
+
+void ToolBalancer::SetToolVersions(const ToolVersionMap &toolVersions)
+{
+	std::lock_guard<std::mutex> lock(m_clientsMutex);
+	m_toolVersions = toolVersions;
+	for (ClientInfo & client : m_clients)
+		UpdateCompatibility(client);
+	RecalcAvailable();
 }
 
 void ToolBalancer::SetSessionId(int64_t sessionId)
 {
 	m_sessionId = sessionId;
+	m_random.seed(static_cast<std::mt19937::result_type>(sessionId));
 }
 
 ToolBalancer::ClientStatus ToolBalancer::UpdateClient(const ToolServerInfo &toolServer, size_t &index)
@@ -56,35 +88,71 @@ ToolBalancer::ClientStatus ToolBalancer::UpdateClient(const ToolServerInfo &tool
 	}
 
 	std::lock_guard<std::mutex> lock(m_clientsMutex);
-	bool found = false;
-	for (ClientInfo & clientsInfo : m_clients)
+	bool found = false, restored = false;
+	for (size_t i = 0; i < m_clients.size(); ++i)
 	{
+		ClientInfo & clientsInfo = m_clients[i];
 		if (clientsInfo.m_toolServer.EqualIdTo(toolServer))
 		{
+			ToolVersionMap knownVersions = clientsInfo.m_toolServer.m_toolVersions;
 			clientsInfo.m_toolServer = toolServer;
+			if (clientsInfo.m_toolServer.m_toolVersions.empty())
+				clientsInfo.m_toolServer.m_toolVersions = std::move(knownVersions);
+			UpdateCompatibility(clientsInfo);
 			clientsInfo.UpdateLoad(m_sessionId);
+			AcceptRemoteTrip(clientsInfo);
+			if (clientsInfo.m_removed)
+			{
+				clientsInfo.m_removed = false;
+				clientsInfo.m_inWorkingSet = !m_workingSetSize;
+				index = i;
+				restored = true;
+			}
 			found = true;
 		}
 	}
 	if (found)
 	{
 		RecalcAvailable();
-		return ClientStatus::Updated;
+		return restored ? ClientStatus::Added : ClientStatus::Updated;
 	}
 
 	ClientInfo clientInfo;
 	clientInfo.m_toolServer = toolServer;
+	clientInfo.m_inWorkingSet = !m_workingSetSize;
+	UpdateCompatibility(clientInfo);
 	clientInfo.UpdateLoad(m_sessionId);
+	AcceptRemoteTrip(clientInfo);
 	m_clients.push_back(clientInfo);
 	index = m_clients.size() - 1;
 	RecalcAvailable();
 	return ClientStatus::Added;
 }
 
+bool ToolBalancer::RemoveClient(const ToolServerInfo &toolServer, size_t &index)
+{
+	std::lock_guard<std::mutex> lock(m_clientsMutex);
+	for (size_t i = 0; i < m_clients.size(); ++i)
+	{
+		ClientInfo & client = m_clients[i];
+		if (!client.m_toolServer.EqualIdTo(toolServer) || client.m_removed)
+			continue;
+		client.m_removed = true;
+		client.m_inWorkingSet = false;
+		client.m_active = false;
+		index = i;
+		RecalcAvailable();
+		return true;
+	}
+	return false;
+}
+
 void ToolBalancer::SetClientActive(size_t index, bool isActive)
 {
 	std::lock_guard<std::mutex> lock(m_clientsMutex);
 	assert(index < m_clients.size());
+	if (isActive && !m_clients[index].m_inWorkingSet)
+		return; // late notification from disconnected server.
 	m_clients[index].m_active = isActive;
 	RecalcAvailable();
 }
@@ -100,58 +168,229 @@ void ToolBalancer::SetServerSideLoad(size_t index, uint16_t load)
 	RecalcAvailable();
 }
 
+void ToolBalancer::SetServerLoad(size_t index, const ToolServerLoad & load)
+{
+	std::lock_guard<std::mutex> lock(m_clientsMutex);
+	ClientInfo & info = m_clients[index];
+	info.m_serverLoad = load;
+	info.m_serverLoadTime = TimePoint(true);
+	info.UpdateLoad(m_sessionId);
+	RecalcAvailable();
+}
+
+void ToolBalancer::SetServerToolVersions(size_t index, const ToolVersionMap &toolVersions)
+{
+	std::lock_guard<std::mutex> lock(m_clientsMutex);
+	m_clients[index].m_toolServer.m_toolVersions = toolVersions;
+	UpdateCompatibility(m_clients[index]);
+	RecalcAvailable();
+}
+
+bool ToolBalancer::IsToolCompatible(size_t index, const std::string &toolId) const
+{
+	std::lock_guard<std::mutex> lock(m_clientsMutex);
+	const StringVector & incompatible = m_clients[index].m_incompatibleTools;
+	return std::find(incompatible.cbegin(), incompatible.cend(), toolId) == incompatible.cend();
+}
+
+void ToolBalancer::SetClientBusy(size_t index, const TimePoint & penalty)
+{
+	std::lock_guard<std::mutex> lock(m_clientsMutex);
+	m_clients[index].m_busyUntil = TimePoint(true) + penalty;
+}
+
+bool ToolBalancer::ReportTaskOutcome(size_t index, TaskOutcome outcome)
+{
+	std::lock_guard<std::mutex> lock(m_clientsMutex);
+	ClientInfo & client = m_clients[index];
+	const TimePoint now(true);
+	double sample = 0.;
+	switch (outcome)
+	{
+		case TaskOutcome::Success:         sample = 1.0; break;
+		case TaskOutcome::Slow:            sample = 0.5; break;
+		case TaskOutcome::Error:
+		case TaskOutcome::Timeout:         sample = 0.;  break;
+	}
+	client.m_health += (sample - client.m_health) / g_healthAveraging;
+
+	if (client.m_tripped)
+	{
+		if (outcome == TaskOutcome::Slow || client.m_probeAfter > now)
+			return false; // wait for probe result, tasks sent before trip are not counted.
+		if (outcome != TaskOutcome::Success)
+		{
+			// probe failed.
+			client.Trip(now, true);
+			RecalcAvailable();
+			return true;
+		}
+		Syslogger(Syslogger::Notice) << "Circuit closed for " << client.m_toolServer.m_connectionHost << ":" << client.m_toolServer.m_connectionPort;
+		client.m_tripped = false;
+		client.m_health = 1.0;
+		client.m_restoreTime = now;
+		client.m_remoteTripAccepted = true; // own probe is more relevant than reports of others.
+		RecalcAvailable();
+		return true;
+	}
+	if (client.m_health >= g_healthThreshold)
+		return false;
+
+	Syslogger(Syslogger::Warning) << "Circuit opened for " << client.m_toolServer.m_connectionHost << ":" << client.m_toolServer.m_connectionPort
+								  << ", health score " << client.m_health;
+	client.Trip(now, client.m_restoreTime && now - client.m_restoreTime < g_flappingInterval);
+	RecalcAvailable();
+	return true;
+}
+
+bool ToolBalancer::IsClientTripped(size_t index) const
+{
+	std::lock_guard<std::mutex> lock(m_clientsMutex);
+	return m_clients[index].m_tripped;
+}
+
+bool ToolBalancer::IsCircuitOpen(size_t index) const
+{
+	std::lock_guard<std::mutex> lock(m_clientsMutex);
+	return m_clients[index].IsCircuitOpen(TimePoint(true));
+}
+
 size_t ToolBalancer::FindFreeClient(const std::string &toolId) const
 {
 	std::lock_guard<std::mutex> lock(m_clientsMutex);
+	const TimePoint now(true);
+
+	double observedToScoreRatio, defaultScore;
+	GetSpeedNormalization(observedToScoreRatio, defaultScore);
 
-	int64_t minimalLoad = std::numeric_limits<int64_t>::max();
-	size_t freeIndex = std::numeric_limits<size_t>::max();
+	struct Candidate
+	{
+		size_t m_index;
+		double m_expectedTime;
+		int64_t m_load;
+		bool m_remote;
+		bool IsBetter(const Candidate & rh) const
+		{
+			const double epsilon = rh.m_expectedTime * 1e-6;
+			return m_expectedTime < rh.m_expectedTime - epsilon || (m_expectedTime <= rh.m_expectedTime + epsilon && m_load < rh.m_load);
+		}
+	};
+	std::vector<Candidate> candidates;
+	bool hasIdleLocal = false;
 
 	for (size_t index = 0; index < m_clients.size(); ++index)
 	{
 		const ClientInfo & client = m_clients[index];
-		if (client.m_active)
+		if (client.m_active && client.m_inWorkingSet)
 		{
 			const StringVector & toolIds = client.m_toolServer.m_toolIds;
 			const bool toolExists = toolIds.empty() || (std::find(toolIds.cbegin(), toolIds.cend(), toolId) != toolIds.cend());
 			if (!toolExists)
 				continue;
 
-			if (client.m_clientLoad < minimalLoad)
+			const StringVector & incompatible = client.m_incompatibleTools;
+			if (std::find(incompatible.cbegin(), incompatible.cend(), toolId) != incompatible.cend())
+				continue;
+
+			if (client.m_busyUntil > now)
+				continue;
+
+			if (client.IsCircuitOpen(now))
+				continue;
+
+			if (m_leasesActive && client.m_busyMine >= client.m_leasedSlots)
+				continue;
+
+			int64_t load = client.m_clientLoad;
+			if (const auto * slots = client.m_toolServer.FindToolSlots(toolId))
 			{
-				minimalLoad = client.m_clientLoad;
-				freeIndex = index;
+				auto mineIt = client.m_busyMineByTool.find(toolId);
+				const uint16_t busyMine = mineIt != client.m_busyMineByTool.cend() ? mineIt->second : 0;
+				const uint16_t busyTool = std::max(slots->m_runningTasks, busyMine);
+				if (busyTool >= slots->m_totalThreads)
+					continue;
+
+				load = std::max(load, int64_t(busyTool) * client.m_eachTaskWeight / slots->m_totalThreads);
 			}
+
+			// time when task will be finished, in units of reference task duration.
+			const uint16_t totalThreads = std::max(uint16_t(1), client.m_toolServer.m_totalThreads);
+			const int busy = client.m_busyMine + client.m_busyOthers + client.m_busyByNetworkLoad;
+			const int queued = std::max(0, busy + 1 - totalThreads);
+			const bool remote = client.IsRemote(m_localSite);
+			const double expectedTime = (1.0 + double(queued) / totalThreads + (remote ? m_remoteSiteCost : 0.)) / GetClientSpeed(client, observedToScoreRatio, defaultScore);
+			candidates.push_back(Candidate{index, expectedTime, load, remote});
+			hasIdleLocal = hasIdleLocal || (!remote && !queued);
 		}
 	}
+	if (hasIdleLocal)
+	{
+		// other sites are only overflow.
+		candidates.erase(std::remove_if(candidates.begin(), candidates.end(), [](const Candidate & candidate){ return candidate.m_remote; }), candidates.end());
+	}
+	if (candidates.empty())
+		return std::numeric_limits<size_t>::max();
+
+	if (m_workingSetSize && candidates.size() > 2)
+	{
+		// power of two choices: nearly as good as full scan, but does not make all clients rush to the same server.
+		std::uniform_int_distribution<size_t> distribution(0, candidates.size() - 1);
+		const size_t first = distribution(m_random);
+		size_t second = distribution(m_random);
+		if (second == first)
+			second = (first + 1) % candidates.size();
+		return candidates[second].IsBetter(candidates[first]) ? candidates[second].m_index : candidates[first].m_index;
+	}
 
-	return freeIndex;
+	const Candidate * best = &candidates[0];
+	for (const Candidate & candidate : candidates)
+		if (candidate.IsBetter(*best))
+			best = &candidate;
+	return best->m_index;
 }
 
-void ToolBalancer::StartTask(size_t index)
+void ToolBalancer::StartTask(size_t index, const std::string & toolId)
 {
 	std::lock_guard<std::mutex> lock(m_clientsMutex);
 	m_clients[index].m_busyMine ++;
+	if (!toolId.empty())
+		m_clients[index].m_busyMineByTool[toolId]++;
 	m_clients[index].UpdateLoad(m_sessionId);
 	RecalcAvailable();
 }
 
-void ToolBalancer::FinishTask(size_t index)
+void ToolBalancer::FinishTask(size_t index, const std::string & toolId)
 {
 	std::lock_guard<std::mutex> lock(m_clientsMutex);
 	uint16_t & busyMine = m_clients[index].m_busyMine;
 	if (busyMine)
 		--busyMine;
+	if (!toolId.empty())
+	{
+		uint16_t & busyMineTool = m_clients[index].m_busyMineByTool[toolId];
+		if (busyMineTool)
+			--busyMineTool;
+	}
 	m_clients[index].UpdateLoad(m_sessionId);
 	RecalcAvailable();
 }
 
+void ToolBalancer::UpdateObservedSpeed(size_t index, size_t inputSize, const TimePoint &executionTime)
+{
+	if (executionTime.GetUS() <= 0)
+		return;
+	const double speed = (1.0 + inputSize / 1024.) * TimePoint::ONE_SECOND / executionTime.GetUS();
+	std::lock_guard<std::mutex> lock(m_clientsMutex);
+	double & observed = m_clients[index].m_observedSpeed;
+	observed = observed > 0 ? observed + (speed - observed) / 8 : speed;
+}
+
 bool ToolBalancer::IsAllActive() const
 {
 	bool result = true;
 	std::lock_guard<std::mutex> lock(m_clientsMutex);
 	for (const ClientInfo & client : m_clients)
-		if (!client.m_active)
+		if (client.m_inWorkingSet && !client.m_active)
 			result = false;
 	return result;
 }
@@ -164,15 +403,189 @@ std::vector<uint16_t> ToolBalancer::TestGetBusy() const
 	return result;
 }
 
+void ToolBalancer::SetWorkingSetSize(size_t size)
+{
+	std::lock_guard<std::mutex> lock(m_clientsMutex);
+	m_workingSetSize = size;
+	for (ClientInfo & client : m_clients)
+		client.m_inWorkingSet = !size && !client.m_removed;
+	RecalcAvailable();
+}
+
+void ToolBalancer::UpdateWorkingSet(bool replaceWorst, std::vector<size_t> &added, std::vector<size_t> &removed)
+{
+	std::lock_guard<std::mutex> lock(m_clientsMutex);
+	if (!m_workingSetSize)
+		return;
+
+	double observedToScoreRatio, defaultScore;
+	GetSpeedNormalization(observedToScoreRatio, defaultScore);
+	// capacity available for us: threads not used by others, multiplied by relative speed.
+	auto capacity = [this, observedToScoreRatio, defaultScore](const ClientInfo & client) {
+		const int freeThreads = std::max(1, client.m_toolServer.m_totalThreads - client.m_busyOthers);
+		const double siteFactor = client.IsRemote(m_localSite) ? 1. / (1. + m_remoteSiteCost) : 1.;
+		return freeThreads * GetClientSpeed(client, observedToScoreRatio, defaultScore) / defaultScore * siteFactor;
+	};
+
+	size_t inSet = 0;
+	for (const ClientInfo & client : m_clients)
+		inSet += client.m_inWorkingSet;
+
+	size_t excluded = std::numeric_limits<size_t>::max();
+	if (replaceWorst && inSet < m_clients.size())
+	{
+		double worstCapacity = std::numeric_limits<double>::max();
+		for (size_t index = 0; index < m_clients.size(); ++index)
+		{
+			const ClientInfo & client = m_clients[index];
+			if (!client.m_inWorkingSet || client.m_busyMine) // do not drop connection with running tasks.
+				continue;
+			if (m_leasesActive && client.m_leasedSlots)
+				continue;
+			const double clientCapacity = client.m_active ? capacity(client) : 0.;
+			if (clientCapacity < worstCapacity)
+			{
+				worstCapacity = clientCapacity;
+				excluded = index;
+			}
+		}
+		if (excluded != std::numeric_limits<size_t>::max())
+		{
+			m_clients[excluded].m_inWorkingSet = false;
+			m_clients[excluded].m_active = false;
+			removed.push_back(excluded);
+			inSet--;
+		}
+	}
+
+	while (inSet < m_workingSetSize)
+	{
+		std::vector<size_t> indices;
+		std::vector<double> weights;
+		for (size_t index = 0; index < m_clients.size(); ++index)
+		{
+			if (m_clients[index].m_inWorkingSet || m_clients[index].m_removed || index == excluded)
+				continue;
+			indices.push_back(index);
+			weights.push_back(capacity(m_clients[index]));
+		}
+		if (indices.empty())
+			break;
+
+		std::discrete_distribution<size_t> distribution(weights.begin(), weights.end());
+		const size_t index = indices[distribution(m_random)];
+		m_clients[index].m_inWorkingSet = true;
+		added.push_back(index);
+		inSet++;
+	}
+	RecalcAvailable();
+}
+
+bool ToolBalancer::IsInWorkingSet(size_t index) const
+{
+	std::lock_guard<std::mutex> lock(m_clientsMutex);
+	return m_clients[index].m_inWorkingSet;
+}
+
+ToolServerInfo ToolBalancer::GetToolServer(size_t index) const
+{
+	std::lock_guard<std::mutex> lock(m_clientsMutex);
+	return m_clients[index].m_toolServer;
+}
+
+void ToolBalancer::SetLeases(const std::deque<ToolServerLease> &leases, std::vector<size_t> &added)
+{
+	std::lock_guard<std::mutex> lock(m_clientsMutex);
+	m_leasesActive = true;
+	for (size_t index = 0; index < m_clients.size(); ++index)
+	{
+		ClientInfo & client = m_clients[index];
+		client.m_leasedSlots = 0;
+		for (const ToolServerLease & lease : leases)
+			if (lease.IsFor(client.m_toolServer))
+				client.m_leasedSlots = lease.m_slots;
+
+		if (client.m_leasedSlots && !client.m_inWorkingSet)
+		{
+			client.m_inWorkingSet = true;
+			added.push_back(index);
+		}
+	}
+	RecalcAvailable();
+}
+
+void ToolBalancer::ClearLeases()
+{
+	std::lock_guard<std::mutex> lock(m_clientsMutex);
+	m_leasesActive = false;
+	for (ClientInfo & client : m_clients)
+		client.m_leasedSlots = 0;
+	RecalcAvailable();
+}
+
+bool ToolBalancer::HasLeases() const
+{
+	std::lock_guard<std::mutex> lock(m_clientsMutex);
+	return m_leasesActive;
+}
+
+uint16_t ToolBalancer::GetLeasedSlots() const
+{
+	std::lock_guard<std::mutex> lock(m_clientsMutex);
+	uint16_t result = 0;
+	for (const ClientInfo & client : m_clients)
+		result += client.m_leasedSlots;
+	return result;
+}
+
+void ToolBalancer::GetSpeedNormalization(double &observedToScoreRatio, double &defaultScore) const
+{
+	double scoreSum = 0, ratioSum = 0;
+	int scoreCount = 0, ratioCount = 0;
+	for (const ClientInfo & client : m_clients)
+	{
+		if (client.m_toolServer.m_speedScore)
+		{
+			scoreSum += client.m_toolServer.m_speedScore;
+			scoreCount++;
+		}
+	}
+	defaultScore = scoreCount ? scoreSum / scoreCount : 1.0;
+	for (const ClientInfo & client : m_clients)
+	{
+		if (client.m_observedSpeed > 0)
+		{
+			ratioSum += client.m_observedSpeed / (client.m_toolServer.m_speedScore ? client.m_toolServer.m_speedScore : defaultScore);
+			ratioCount++;
+		}
+	}
+	observedToScoreRatio = ratioCount ? ratioSum / ratioCount : 0.0;
+}
+
+double ToolBalancer::GetClientSpeed(const ToolBalancer::ClientInfo &client, double observedToScoreRatio, double defaultScore) const
+{
+	if (client.m_observedSpeed > 0 && observedToScoreRatio > 0)
+		return client.m_observedSpeed / observedToScoreRatio;
+	if (client.m_toolServer.m_speedScore)
+		return client.m_toolServer.m_speedScore;
+	return defaultScore;
+}
+
 void ToolBalancer::RecalcAvailable()
 {
 	uint16_t free = 0, used = 0, total = 0;
+	const TimePoint now(true);
 	for (const ClientInfo & client : m_clients)
 	{
-		if (client.m_active)
+		if (client.m_active && client.m_inWorkingSet && client.m_hasCompatibleTools)
 		{
 			total += client.m_toolServer.m_totalThreads;
-			free += client.m_toolServer.m_totalThreads - client.m_busyTotal;
+			if (client.m_tripped)
+				free += client.IsCircuitOpen(now) ? 0 : 1; // room for probe task.
+			else if (m_leasesActive)
+				free += client.m_leasedSlots > client.m_busyMine ? client.m_leasedSlots - client.m_busyMine : 0;
+			else
+				free += client.m_toolServer.m_totalThreads - client.m_busyTotal;
 			used += client.m_busyMine;
 		}
 	}
@@ -204,10 +617,69 @@ void ToolBalancer::ClientInfo::UpdateLoad(int64_t mySessionId)
 		m_busyByNetworkLoad--;
 	}
 
+	if (m_serverLoadTime && m_serverLoadTime.GetElapsedTime() < g_serverLoadTTL)
+	{
+		// server reported exactly what it runs (including queue), no need to guess.
+		m_busyOthers = m_serverLoad.m_runningTasks > m_busyMine ? m_serverLoad.m_runningTasks - m_busyMine : 0;
+		m_busyByNetworkLoad = 0;
+	}
+
 	m_busyTotal = m_busyOthers + m_busyMine + m_busyByNetworkLoad;
 	m_busyTotal = std::min(m_busyTotal, m_toolServer.m_totalThreads);
 
 	m_clientLoad = m_toolServer.m_totalThreads ? (m_busyTotal * m_eachTaskWeight / m_toolServer.m_totalThreads) : 0;
 }
 
+bool ToolBalancer::ClientInfo::IsCircuitOpen(const TimePoint &now) const
+{
+	// half-open: only one probe task at a time.
+	return m_tripped && (m_probeAfter > now || m_busyMine > 0);
+}
+
+void ToolBalancer::ClientInfo::Trip(const TimePoint &now, bool flapping)
+{
+	m_tripped = true;
+	if (flapping && m_tripBackoff)
+	{
+		TimePoint doubled;
+		doubled.SetUS(m_tripBackoff.GetUS() * 2);
+		m_tripBackoff = std::min(doubled, g_maxTripBackoff);
+	}
+	else
+	{
+		m_tripBackoff = g_minTripBackoff;
+	}
+	m_probeAfter = now + m_tripBackoff;
+}
+
+void ToolBalancer::AcceptRemoteTrip(ToolBalancer::ClientInfo &client)
+{
+	if (!client.m_toolServer.m_unhealthyReports)
+	{
+		client.m_remoteTripAccepted = false;
+		return;
+	}
+	if (client.m_remoteTripAccepted || client.m_tripped)
+		return;
+
+	Syslogger(Syslogger::Notice) << "Circuit opened for " << client.m_toolServer.m_connectionHost << ":" << client.m_toolServer.m_connectionPort
+								 << ", reported by " << client.m_toolServer.m_unhealthyReports << " sessions";
+	client.m_remoteTripAccepted = true;
+	client.Trip(TimePoint(true), false);
+}
+
+void ToolBalancer::UpdateCompatibility(ToolBalancer::ClientInfo &client)
+{
+	StringVector incompatible = client.m_toolServer.GetIncompatibleTools(m_toolVersions);
+	client.m_hasCompatibleTools = client.m_toolServer.HasCompatibleTool(m_requiredToolIds, m_toolVersions);
+	if (incompatible == client.m_incompatibleTools)
+		return;
+
+	client.m_incompatibleTools = std::move(incompatible);
+	for (const auto & toolId : client.m_incompatibleTools)
+		Syslogger(Syslogger::Warning) << "Tool id=" << toolId << " has local version='" << m_toolVersions[toolId]
+									  << "' and remote version='" << client.m_toolServer.m_toolVersions[toolId] << "' on '"
+									  << client.m_toolServer.m_connectionHost << "', server is not used for it.";
+}
+
 }
@@ -14,18 +14,40 @@
 #pragma once
 
 #include <CoordinatorTypes.h>
+#include <TimePoint.h>
 
+#include <map>
 #include <mutex>
 #include <atomic>
+#include <random>
 
 namespace Wuild
 {
 /**
  * Balancer used to split request between several tool servers.
- * Main goal: the request should gone to server with least load at this moment.
+ * Main goal: the request should gone to server which will finish it first, considering server speed
+ * (advertised speed score and own observed execution times) and its load at this moment.
  *
  * To update client information, UpdateClient and SetClientActive is used.
  *
+ * Optionally only working set of limited size is used (and connected by caller): servers are picked with
+ * weighted random choice, UpdateWorkingSet periodically replaces worst of them; then FindFreeClient
+ * uses power-of-two-choices inside the set.
+ *
+ * Server load comes from coordinator info; fresher load sent by server itself overrides it while not outdated.
+ *
+ * When slot leases from coordinator are set, tasks are sent only within leased slots;
+ * without leases (coordinator unreachable or lease expired) balancer works optimistically.
+ *
+ * Each server has health score, moving average of task outcomes (errors, timeouts, too slow tasks).
+ * When it drops below threshold, circuit breaker opens and server is not used; after backoff single probe task
+ * is allowed (half-open), its success closes breaker. Breakers opened by other clients (reported by coordinator) are respected too.
+ *
+ * Tool having another version on server than local one is not sent there; other tools of that server are still used.
+ *
+ * Servers from other sites than coordinator's one are used only when no local server has free thread,
+ * and task there is considered longer by remote site cost.
+ *
  * To recieve balancer most suitable client, call FindFreeClient.
  * StartTask and FinishTask updates load cache.
  * Get*Threads funcation used for overall statistics.
@@ -34,6 +56,7 @@ class ToolBalancer
 {
 public:
 	enum class ClientStatus { Added, Skipped, Updated };
+	enum class TaskOutcome { Success, Error, Timeout, Slow };
 
 public:
 	ToolBalancer();
@@ -41,14 +64,60 @@ public:
 
 	void SetRequiredTools(const StringVector & requiredToolIds);
 	void SetSessionId(int64_t sessionId);
-
+	/// Site of coordinator; when empty, all servers are local.
+	void SetLocalSite(const std::string & site);
+	/// Extra time of task on remote site server, in task durations.
+	void SetRemoteSiteCost(double cost);
+	/// Local tool versions; servers with other versions are not used for these tools.
+	void SetToolVersions(const ToolVersionMap & toolVersions);
+
+	/// Removed server becomes Added again.
 	ClientStatus UpdateClient(const ToolServerInfo & toolServer, size_t & index);
+	/// Server is not used until UpdateClient for it; returns false if unknown.
+	/// Index is kept, caller should disconnect it and fail its running tasks.
+	bool RemoveClient(const ToolServerInfo & toolServer, size_t & index);
 	void SetClientActive(size_t index, bool isActive);
 	void SetServerSideLoad(size_t index, uint16_t load);
-
+	/// Load reported by server itself with responses; while fresh, used instead of coordinator info and queued replies count.
+	void SetServerLoad(size_t index, const ToolServerLoad & load);
+	/// Versions reported by server itself; until then versions from coordinator info are used.
+	void SetServerToolVersions(size_t index, const ToolVersionMap & toolVersions);
+	bool IsToolCompatible(size_t index, const std::string & toolId) const;
+	/// Server rejected task as busy; client is not used until penalty time passes.
+	void SetClientBusy(size_t index, const TimePoint & penalty);
+
+	/// Updates server health. Returns true if breaker was opened or closed by this outcome, or probe failed;
+	/// caller should report IsClientTripped to coordinator then.
+	bool ReportTaskOutcome(size_t index, TaskOutcome outcome);
+	/// Breaker is open, including half-open state.
+	bool IsClientTripped(size_t index) const;
+	/// Breaker is open and probe task is not allowed now.
+	bool IsCircuitOpen(size_t index) const;
+
+	/// Returns index of client having toolId with minimal expected completion time (considering speed and queue);
+	/// on equal time, least loaded. Clients where toolId reached own slot limit, or recently busy, are skipped.
 	size_t FindFreeClient(const std::string & toolId) const;
-	void StartTask(size_t index);
-	void FinishTask(size_t index);
+	/// Task sent by this client finished on server in executionTime; inputSize is request data size.
+	void UpdateObservedSpeed(size_t index, size_t inputSize, const TimePoint & executionTime);
+
+	/// Limits number of servers in use; 0 = all servers are used.
+	void SetWorkingSetSize(size_t size);
+	/// Fills working set up to its size. If replaceWorst is set, idle server with least capacity is replaced.
+	/// Caller should connect added servers and disconnect removed ones.
+	void UpdateWorkingSet(bool replaceWorst, std::vector<size_t> & added, std::vector<size_t> & removed);
+	bool IsInWorkingSet(size_t index) const;
+	ToolServerInfo GetToolServer(size_t index) const;
+
+	/// Replaces current leases. Leased servers are added to working set, caller should connect ones returned in added.
+	void SetLeases(const std::deque<ToolServerLease> & leases, std::vector<size_t> & added);
+	/// Returns to optimistic mode.
+	void ClearLeases();
+	bool HasLeases() const;
+	/// Total leased slots.
+	uint16_t GetLeasedSlots() const;
+
+	void StartTask(size_t index, const std::string & toolId = std::string());
+	void FinishTask(size_t index, const std::string & toolId = std::string());
 
 	uint16_t GetTotalThreads() const { return m_totalRemoteThreads; }
 	uint16_t GetFreeThreads() const { return m_freeRemoteThreads; }
@@ -68,25 +137,59 @@ protected:
 		uint16_t m_serverSideQueuePrev = 0;
 		uint16_t m_serverSideQueueAvg = 0;
 		uint16_t m_busyMine = 0;
+		std::map<std::string, uint16_t> m_busyMineByTool;
 		uint16_t m_busyOthers = 0;
 		uint16_t m_busyTotal = 0;
 		uint16_t m_busyByNetworkLoad = 0;
+		TimePoint m_busyUntil;
 		int64_t m_clientLoad = 0;
 		int m_eachTaskWeight = 32768; //TODO: priority? configaration?
+		double m_observedSpeed = 0;   //!< Moving average of input KiB per execution second for our tasks; 0 = no data.
+		bool m_inWorkingSet = true;
+		bool m_removed = false;            //!< Stale server, not known to coordinator.
+		uint16_t m_leasedSlots = 0;
+		ToolServerLoad m_serverLoad;
+		TimePoint m_serverLoadTime;
+		double m_health = 1.0;             //!< Moving average of task outcomes, 1 = all succeeded.
+		bool m_tripped = false;
+		TimePoint m_probeAfter;
+		TimePoint m_tripBackoff;
+		TimePoint m_restoreTime;
+		bool m_remoteTripAccepted = false; //!< Reports of other clients already were taken into account.
+		StringVector m_incompatibleTools;
+		bool m_hasCompatibleTools = true;  //!< At least one of required tools could be used.
 		void UpdateLoad(int64_t mySessionId);
+		bool IsRemote(const std::string & localSite) const { return !localSite.empty() && m_toolServer.m_site != localSite; }
+		bool IsCircuitOpen(const TimePoint & now) const;
+		void Trip(const TimePoint & now, bool flapping);
 	};
 
+	/// Speed of client thread in server speed score units. Own observations are converted to score units
+	/// with average observed/advertised ratio, so machines slower than they claim are corrected.
+	double GetClientSpeed(const ClientInfo & client, double observedToScoreRatio, double defaultScore) const;
+	/// Average advertised score and observed/advertised ratio, used by GetClientSpeed.
+	void GetSpeedNormalization(double & observedToScoreRatio, double & defaultScore) const;
+
 protected:
 	void RecalcAvailable();
+	/// Opens breaker if other sessions reported server and that was not taken into account yet.
+	void AcceptRemoteTrip(ClientInfo & client);
+	void UpdateCompatibility(ClientInfo & client);
 
 	std::atomic<uint16_t> m_totalRemoteThreads {0};
 	std::atomic<uint16_t> m_freeRemoteThreads {0};
 	std::atomic<uint16_t> m_usedThreads {0};
 
 	int64_t m_sessionId = 0;
+	size_t m_workingSetSize = 0;
+	bool m_leasesActive = false;
+	mutable std::mt19937 m_random;
 
 	std::deque<ClientInfo> m_clients;
 	StringVector m_requiredToolIds;
+	ToolVersionMap m_toolVersions;
+	std::string m_localSite;
+	double m_remoteSiteCost = 1.0;
 	mutable std::mutex m_clientsMutex;
 };
 
@@ -0,0 +1,134 @@
+/*
+ * Copyright (C) 2018 Smirnov Vladimir mapron1@gmail.com
+ * Source code licensed under the Apache License, Version 2.0 (the "License");
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at http://www.apache.org/licenses/LICENSE-2.0 or in file COPYING-APACHE-2.0.txt
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.h
+ */
+
+#include "ExecutionCostModel.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <sstream>
+
+namespace Wuild
+{
+static const double g_raceMaxRatio = 1.5;
+
+namespace
+{
+double Average(double current, double value)
+{
+	return current > 0 ? current + (value - current) / 16 : value;
+}
+
+TimePoint FromUS(double us)
+{
+	TimePoint result;
+	result.SetUS(static_cast<int64_t>(us));
+	return result;
+}
+}
+
+ExecutionCostModel::Decision ExecutionCostModel::Decide(const ExecutionCostModel::Input &input) const
+{
+	Decision decision;
+	decision.m_start = TimePoint(true);
+	decision.m_remoteQueued = input.m_freeRemoteThreads <= 0;
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	const double inputKiB = 1.0 + input.m_inputSize / 1024.;
+	double remoteExec = static_cast<double>(input.m_predictedRemote.GetUS());
+	double localExec = 0;
+	if (remoteExec > 0)
+		localExec = m_localPerKiB > 0 && m_remotePerKiB > 0 ? remoteExec * m_localPerKiB / m_remotePerKiB : 0;
+	else if (input.m_inputSize)
+	{
+		remoteExec = m_remotePerKiB * inputKiB;
+		localExec = m_localPerKiB * inputKiB;
+	}
+	// side not measured yet is expected to be as fast as other one.
+	if (remoteExec <= 0)
+		remoteExec = localExec;
+	if (localExec <= 0)
+		localExec = remoteExec;
+
+	if (remoteExec <= 0)
+	{
+		decision.m_choice = input.m_freeRemoteThreads > 0 ? Choice::Remote : Choice::Local;
+		return decision;
+	}
+
+	const double localWait = input.m_freeLocalThreads > 0 ? 0 : localExec * (1 - input.m_freeLocalThreads) / std::max(1, input.m_localThreads);
+	decision.m_localCost = FromUS(localWait + localExec);
+	decision.m_remoteCost = input.m_remoteQueueWait + FromUS(m_networkOverhead + remoteExec);
+
+	const double localCost = static_cast<double>(decision.m_localCost.GetUS());
+	const double remoteCost = static_cast<double>(decision.m_remoteCost.GetUS());
+	// estimates are too rough to tell which is faster, and racing costs only idle capacity.
+	if (m_allowRace && input.m_freeRemoteThreads > 0 && input.m_freeLocalThreads > 0
+		&& std::max(localCost, remoteCost) < std::min(localCost, remoteCost) * g_raceMaxRatio)
+		decision.m_choice = Choice::Race;
+	else
+		decision.m_choice = remoteCost <= localCost ? Choice::Remote : Choice::Local;
+	return decision;
+}
+
+void ExecutionCostModel::AddLocalResult(size_t inputSize, const TimePoint &executionTime)
+{
+	const double inputKiB = 1.0 + inputSize / 1024.;
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_localPerKiB = Average(m_localPerKiB, executionTime.GetUS() / inputKiB);
+}
+
+void ExecutionCostModel::AddRemoteResult(size_t inputSize, const TimePoint &toolExecutionTime, const TimePoint &requestTime, bool queued)
+{
+	const double inputKiB = 1.0 + inputSize / 1024.;
+	std::lock_guard<std::mutex> lock(m_mutex);
+	if (inputSize)
+		m_remotePerKiB = Average(m_remotePerKiB, toolExecutionTime.GetUS() / inputKiB);
+	if (!queued && requestTime > toolExecutionTime)
+		m_networkOverhead = Average(m_networkOverhead, static_cast<double>((requestTime - toolExecutionTime).GetUS()));
+}
+
+void ExecutionCostModel::AddOutcome(const ExecutionCostModel::Decision &decision, const TimePoint &elapsed, bool local)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	switch (decision.m_choice)
+	{
+		case Choice::Local:  m_localChoices++; break;
+		case Choice::Remote: m_remoteChoices++; break;
+		case Choice::Race:
+			m_raceChoices++;
+			if (local)
+				m_raceLocalWins++;
+			break;
+	}
+	const TimePoint other = local ? decision.m_remoteCost : decision.m_localCost;
+	if (other)
+		m_savedUS += (other - elapsed).GetUS();
+}
+
+std::string ExecutionCostModel::GetStatistics() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	if (!m_localChoices && !m_remoteChoices && !m_raceChoices)
+		return std::string();
+	TimePoint saved;
+	saved.SetUS(std::abs(m_savedUS));
+	std::ostringstream os;
+	os << "decisions: local: " << m_localChoices
+	   << ", remote: " << m_remoteChoices
+	   << ", race: " << m_raceChoices << " (local won: " << m_raceLocalWins << ")"
+	   << ", estimated time " << (m_savedUS >= 0 ? "saved: " : "lost: ") << saved.ToProfilingTime()
+	   << ", network overhead: " << FromUS(m_networkOverhead).ToProfilingTime();
+	return os.str();
+}
+
+}
@@ -0,0 +1,85 @@
+/*
+ * Copyright (C) 2018 Smirnov Vladimir mapron1@gmail.com
+ * Source code licensed under the Apache License, Version 2.0 (the "License");
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at http://www.apache.org/licenses/LICENSE-2.0 or in file COPYING-APACHE-2.0.txt
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.h
+ */
+
+#pragma once
+
+#include <TimePoint.h>
+
+#include <mutex>
+#include <string>
+
+namespace Wuild
+{
+/**
+ * Decides where compilation should run: locally, remotely (queueing for remote thread if needed), or both at once.
+ *
+ * Local and remote execution times per KiB of preprocessed input and network overhead of remote request
+ * are learned from finished tasks. Remote execution time of outputs from task history is used as is,
+ * local one is scaled by local to remote speed ratio.
+ * Race is chosen when both local and remote threads are idle and estimates are close. Thread-safe.
+ */
+class ExecutionCostModel
+{
+public:
+	enum class Choice { Local, Remote, Race };
+
+	/// State at the moment of decision.
+	struct Input
+	{
+		size_t m_inputSize = 0;           //!< Preprocessed input size; zero if not known yet.
+		TimePoint m_predictedRemote;      //!< From task history, zero if output is unknown.
+		int m_freeRemoteThreads = 0;      //!< May be negative, when tasks are queued.
+		TimePoint m_remoteQueueWait;
+		int m_freeLocalThreads = 0;       //!< May be negative, when tasks are queued.
+		int m_localThreads = 1;
+	};
+	struct Decision
+	{
+		Choice m_choice = Choice::Local;
+		TimePoint m_localCost;            //!< Expected time until result of local execution, including wait.
+		TimePoint m_remoteCost;           //!< Expected time until result of remote execution, including wait.
+		bool m_remoteQueued = false;      //!< No free remote thread at decision moment.
+		TimePoint m_start;
+	};
+
+public:
+	explicit ExecutionCostModel(bool allowRace = true) : m_allowRace(allowRace) {}
+
+	Decision Decide(const Input & input) const;
+
+	/// Updates model with finished local compilation.
+	void AddLocalResult(size_t inputSize, const TimePoint & executionTime);
+	/// Updates model with finished remote compilation. Network overhead is learned only from tasks which were not queued.
+	void AddRemoteResult(size_t inputSize, const TimePoint & toolExecutionTime, const TimePoint & requestTime, bool queued);
+
+	/// Records outcome of decision: time until result from decision start and which side gave the result.
+	/// Time saved is estimated against expected cost of other side.
+	void AddOutcome(const Decision & decision, const TimePoint & elapsed, bool local);
+
+	/// Choices counts and estimated time saved.
+	std::string GetStatistics() const;
+
+private:
+	const bool m_allowRace;
+	double m_localPerKiB = 0;     //!< microseconds.
+	double m_remotePerKiB = 0;    //!< microseconds.
+	double m_networkOverhead = 0; //!< microseconds.
+	int m_localChoices = 0;
+	int m_remoteChoices = 0;
+	int m_raceChoices = 0;
+	int m_raceLocalWins = 0;
+	int64_t m_savedUS = 0;
+	mutable std::mutex m_mutex;
+};
+
+}
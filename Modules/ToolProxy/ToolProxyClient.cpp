@@ -19,6 +19,8 @@
 #include <SocketFrameHandler.h>
 #include <Application.h>
 #include <FileUtils.h>
+#include <TcpSocket.h>
+#include <ByteOrderStream.h>
 
 #include <algorithm>
 #include <iostream>
@@ -30,6 +32,20 @@
 
 namespace 
 {
+const uint32_t g_compiledConfigVersion = 1;
+
+std::string GetEnv(const char * name)
+{
+	const char * value = getenv(name);
+	return value ? value : "";
+}
+
+std::string PrepareOutput(std::string stdOut)
+{
+	std::replace(stdOut.begin(), stdOut.end(), '\r', ' ');
+	return stdOut;
+}
+
 void StartDetached(const std::string & command)
 {
 	if (!Wuild::FileInfo(command).Exists())
@@ -74,8 +90,16 @@ bool ToolProxyClient::Start()
 	settings.m_writeFailureLogLevel = Syslogger::Info;
 	m_client = std::make_unique<SocketFrameHandler>( settings );
 	m_client->RegisterFrameReader(SocketFrameReaderTemplate<ToolProxyResponse>::Create());
+	m_client->RegisterFrameReader(SocketFrameReaderTemplate<ToolProxyStatus>::Create([this](const ToolProxyStatus& inputMessage, SocketFrameHandler::OutputCallback){
+		m_freeRemoteThreads = inputMessage.m_freeRemoteThreads;
+		if (m_statusCallback)
+			m_statusCallback();
+	}));
 
-	m_client->SetTcpChannel("localhost", m_config.m_listenPort);
+	if (m_config.m_listenSocket.empty())
+		m_client->SetTcpChannel("localhost", m_config.m_listenPort);
+	else
+		m_client->SetTcpChannel("unix:" + m_config.m_listenSocket, 0);
 	m_client->SetChannelNotifier([this](bool state){
 		std::unique_lock<std::mutex> lock(m_connectionStateMutex);
 		m_connectionState = state;
@@ -127,7 +151,7 @@ void ToolProxyClient::RunTask(const StringVector &args)
 			result = responseFrameProxy->m_result;
 			stdOut = responseFrameProxy->m_stdOut;
 		}
-		std::replace(stdOut.begin(), stdOut.end(), '\r', ' ');
+		stdOut = PrepareOutput(stdOut);
 		if (!stdOut.empty())
 			std::cerr << stdOut << std::endl << std::flush;
 		Application::Interrupt(1 - result);
@@ -139,4 +163,120 @@ void ToolProxyClient::RunTask(const StringVector &args)
 	m_client->QueueFrame(req, frameCallback, m_config.m_proxyClientTimeout);
 }
 
+bool ToolProxyClient::RunTaskSync(const StringVector &args, int &exitCode)
+{
+	TcpConnectionParams params;
+	if (m_config.m_listenSocket.empty())
+		params.m_endPoint.SetPoint(m_config.m_listenPort, "localhost");
+	else
+		params.m_endPoint.SetPoint(0, "unix:" + m_config.m_listenSocket);
+	params.m_connectTimeout = m_config.m_clientConnectionTimeout;
+	params.m_readTimeout = TimePoint(0.1);
+	TcpSocket channel(params);
+	if (!channel.Connect())
+		return false;
+
+	ToolProxyRequest req;
+	req.m_invocation.m_id.m_toolId = m_config.m_toolId;
+	req.m_invocation.m_args = args;
+	req.m_cwd = GetCWD();
+	SocketFrameHandlerSettings settings;
+	settings.m_writeFailureLogLevel = Syslogger::Info;
+	auto reply = SocketFrameHandler::SyncExchange(channel, settings, req, SocketFrameReaderTemplate<ToolProxyResponse>(), m_config.m_proxyClientTimeout);
+	ToolProxyResponse::Ptr response = std::dynamic_pointer_cast<ToolProxyResponse>(reply);
+	if (!response)
+	{
+		// request could be already running, so it is not repeated.
+		std::cerr << "Request to WuildProxy failed." << std::endl;
+		exitCode = 1;
+		return true;
+	}
+
+	const std::string stdOut = PrepareOutput(response->m_stdOut);
+	if (!stdOut.empty())
+		std::cerr << stdOut << std::endl << std::flush;
+	exitCode = 1 - response->m_result;
+	return true;
+}
+
+void ToolProxyClient::InvokeRemote(const ToolInvocation & invocation, std::function<void (bool, const std::string &)> callback)
+{
+	auto frameCallback = [callback](SocketFrame::Ptr responseFrame, SocketFrameHandler::ReplyState state, const std::string & errorInfo)
+	{
+		if (state == SocketFrameHandler::ReplyState::Timeout)
+			callback(false, "Timeout expired:" + errorInfo);
+		else if (state == SocketFrameHandler::ReplyState::Error)
+			callback(false, "Internal error.");
+		else
+		{
+			ToolProxyResponse::Ptr responseFrameProxy = std::dynamic_pointer_cast<ToolProxyResponse>(responseFrame);
+			callback(responseFrameProxy->m_result, responseFrameProxy->m_stdOut);
+		}
+	};
+	// agent status comes later, so count the thread as taken right away.
+	m_freeRemoteThreads--;
+	ToolProxyRemoteRequest::Ptr req(new ToolProxyRemoteRequest());
+	req->m_invocation = invocation;
+	req->m_cwd = GetCWD();
+	m_client->QueueFrame(req, frameCallback, m_config.m_proxyClientTimeout);
+}
+
+void ToolProxyClient::SubscribeStatus(std::function<void()> callback)
+{
+	m_statusCallback = std::move(callback);
+	m_client->QueueFrame(std::make_shared<ToolProxyStatus>());
+}
+
+int ToolProxyClient::GetFreeRemoteThreads() const
+{
+	return m_freeRemoteThreads;
+}
+
+std::string ToolProxyClient::GetCompiledConfigPath()
+{
+	const std::string envPath = GetEnv("WUILD_PROXY_CLIENT_CONFIG");
+	return envPath.empty() ? Application::Instance().GetAppDataDir(false) + "proxyClient.bin" : envPath;
+}
+
+bool ToolProxyClient::SaveCompiledConfig(const std::string &filename, const ToolProxyClient::Config &config)
+{
+	ByteOrderBuffer buffer;
+	ByteOrderDataStreamWriter stream(buffer);
+	stream << g_compiledConfigVersion << GetEnv("WUILD_CONFIG")
+		   << config.m_listenSocket << int32_t(config.m_listenPort) << config.m_toolId
+		   << config.m_proxyClientTimeout.GetUS() << config.m_clientConnectionTimeout.GetUS();
+
+	FileInfo file(filename);
+	FileInfo(file.GetDir()).Mkdirs();
+	if (!file.WriteFile(buffer.GetHolder()))
+	{
+		Syslogger(Syslogger::Warning) << "Failed to write proxy client config " << filename;
+		return false;
+	}
+	return true;
+}
+
+bool ToolProxyClient::LoadCompiledConfig(const std::string &filename, ToolProxyClient::Config &config)
+{
+	ByteArrayHolder data;
+	if (!FileInfo(filename).ReadFile(data))
+		return false;
+
+	ByteOrderBuffer buffer(data);
+	ByteOrderDataStreamReader stream(buffer);
+	std::string configEnv;
+	int32_t listenPort = 0;
+	int64_t proxyClientTimeoutUS = 0, clientConnectionTimeoutUS = 0;
+	if (stream.ReadScalar<uint32_t>() != g_compiledConfigVersion)
+		return false;
+	stream >> configEnv >> config.m_listenSocket >> listenPort >> config.m_toolId >> proxyClientTimeoutUS >> clientConnectionTimeoutUS;
+	if (stream.EofRead() || configEnv != GetEnv("WUILD_CONFIG"))
+		return false;
+
+	config.m_listenPort = listenPort;
+	config.m_proxyClientTimeout.SetUS(proxyClientTimeoutUS);
+	config.m_clientConnectionTimeout.SetUS(clientConnectionTimeoutUS);
+	return true;
+}
+
 }
@@ -14,6 +14,7 @@
 #pragma once
 
 #include <CoordinatorTypes.h>
+#include <ToolInvocation.h>
 #include <ThreadLoop.h>
 #include <ToolProxyServerConfig.h>
 
@@ -47,9 +48,29 @@ public:
 	/// Invoke local compile task. It's not splitted.
 	void RunTask(const StringVector & args);
 
+	/// Same as Start and RunTask, but on calling thread and without reconnects or starting proxy.
+	/// Returns false if proxy could not be connected; otherwise exitCode is set.
+	bool RunTaskSync(const StringVector & args, int & exitCode);
+
+	/// Sends invocation to tool servers through agent. Callback is called from network thread.
+	void InvokeRemote(const ToolInvocation & invocation, std::function<void(bool result, const std::string & stdOut)> callback);
+
+	/// Requests agent to report free remote threads; callback is called on every change.
+	void SubscribeStatus(std::function<void()> callback);
+	int GetFreeRemoteThreads() const;
+
+	/// Config of running proxy written for WuildProxyClient, so it starts without reading ini files.
+	/// Path is WUILD_PROXY_CLIENT_CONFIG environment variable or proxyClient.bin in application data dir.
+	static std::string GetCompiledConfigPath();
+	static bool SaveCompiledConfig(const std::string & filename, const Config & config);
+	/// Fails if proxy was started with another WUILD_CONFIG.
+	static bool LoadCompiledConfig(const std::string & filename, Config & config);
+
 protected:
 	std::unique_ptr<SocketFrameHandler> m_client;
 	Config m_config;
+	std::atomic_int m_freeRemoteThreads {0};
+	std::function<void()> m_statusCallback;
 	std::atomic_bool m_connectionState {false};
 	std::condition_variable m_connectionStateCond;
 	std::mutex m_connectionStateMutex;
@@ -42,6 +42,24 @@ SocketFrame::State ToolProxyRequest::WriteInternal(ByteOrderDataStreamWriter &st
 	return stOk;
 }
 
+void ToolProxyStatus::LogTo(std::ostream &os) const
+{
+	SocketFrame::LogTo(os);
+	os << " free:" << m_freeRemoteThreads;
+}
+
+SocketFrame::State ToolProxyStatus::ReadInternal(ByteOrderDataStreamReader &stream)
+{
+	stream >> m_freeRemoteThreads;
+	return stOk;
+}
+
+SocketFrame::State ToolProxyStatus::WriteInternal(ByteOrderDataStreamWriter &stream) const
+{
+	stream << m_freeRemoteThreads;
+	return stOk;
+}
+
 ToolProxyResponse::ToolProxyResponse(std::string stdOut, bool result)
 	: m_result(result)
 	, m_stdOut(std::move(stdOut))
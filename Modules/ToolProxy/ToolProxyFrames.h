@@ -42,6 +42,38 @@ public:
 
 };
 
+/**
+ * Invocation which is sent to tool servers as is, without splitting and local fallback. Replied with ToolProxyResponse.
+ */
+class ToolProxyRemoteRequest : public ToolProxyRequest
+{
+public:
+	static const uint8_t s_frameTypeId = s_minimalUserFrameId + 3;
+	using Ptr = std::shared_ptr<ToolProxyRemoteRequest>;
+
+public:
+	uint8_t             FrameTypeId() const override { return s_frameTypeId;}
+};
+
+/**
+ * Free remote threads of proxy. Client sends empty one to subscribe, then proxy sends it on every change.
+ */
+class ToolProxyStatus : public SocketFrameExt
+{
+public:
+	static const uint8_t s_frameTypeId = s_minimalUserFrameId + 4;
+	using Ptr = std::shared_ptr<ToolProxyStatus>;
+
+public:
+	int32_t             m_freeRemoteThreads = 0;
+
+	void                LogTo(std::ostream& os) const override;
+	uint8_t             FrameTypeId() const override { return s_frameTypeId;}
+
+	State               ReadInternal(ByteOrderDataStreamReader &stream) override;
+	State               WriteInternal(ByteOrderDataStreamWriter &stream) const override;
+};
+
 /**
  * Tool invocation result: success code and std output.
  */
@@ -14,6 +14,7 @@
 #include "ToolProxyServer.h"
 
 #include <SocketFrameService.h>
+#include <TcpSocket.h>
 #include <FileUtils.h>
 
 #include <utility>
@@ -22,14 +23,18 @@
 namespace Wuild
 {
 
-ToolProxyServer::ToolProxyServer(ILocalExecutor::Ptr executor, RemoteToolClient &rcClient)
-	: m_executor(std::move(std::move(executor))), m_rcClient(rcClient)
+ToolProxyServer::ToolProxyServer(IInvocationRewriter::Ptr invocationRewriter, ILocalExecutor::Ptr executor, RemoteToolClient &rcClient)
+	: m_invocationRewriter(std::move(invocationRewriter)), m_executor(std::move(executor)), m_rcClient(rcClient)
 {
 }
 
 ToolProxyServer::~ToolProxyServer()
 {
 	m_server.reset();
+	m_inactiveChecker.Stop();
+	const auto info = GetSessionInformation();
+	if (!info.empty())
+		Syslogger(Syslogger::Notice) << info;
 }
 
 bool ToolProxyServer::SetConfig(const ToolProxyServer::Config &config)
@@ -41,69 +46,253 @@ bool ToolProxyServer::SetConfig(const ToolProxyServer::Config &config)
 		return false;
 	}
 	m_config = config;
+	m_costModel.reset(new ExecutionCostModel(m_config.m_raceTasks));
 	return true;
 }
 
 
+void ToolProxyServer::StreamPreprocessed(LocalExecutorTask::Ptr taskPP, const CompileJob & job)
+{
+	// preprocessor writes to stdout, which is compressed into request while it runs; no .i file on disk.
+	taskPP->m_invocation.SetOutput("-");
+	taskPP->m_streamOutput = true;
+	taskPP->m_compressionOutput = m_rcClient.GetCompression();
+	taskPP->m_callback = [this, job] ( LocalExecutorResult::Ptr localResult ) {
+		if (!localResult->m_result)
+		{
+			job.m_outputCallback(std::make_shared<ToolProxyResponse>(localResult->m_stdOut));
+			FinishJob(job.m_cwd, false, false);
+			return;
+		}
+		const std::string ppOutput = localResult->m_stdOut;
+		auto remoteCallback = [this, job, ppOutput]( const Wuild::RemoteToolClient::TaskExecutionInfo& info) {
+			if (info.m_result)
+				m_costModel->AddRemoteResult(0, info.m_toolExecutionTime, info.m_networkRequestTime, job.m_decision.m_remoteQueued);
+			m_costModel->AddOutcome(job.m_decision, job.m_decision.m_start.GetElapsedTime(), false);
+			job.m_outputCallback(std::make_shared<ToolProxyResponse>(ppOutput + info.m_stdOutput, info.m_result));
+			FinishJob(job.m_cwd, true, info.m_result);
+		};
+		m_rcClient.InvokeTool(job.m_invocation, localResult->m_outputData, remoteCallback);
+	};
+	m_executor->AddTask(taskPP);
+}
+
+ExecutionCostModel::Decision ToolProxyServer::DecideExecution(const ToolInvocation & invocation, size_t inputSize)
+{
+	ExecutionCostModel::Input input;
+	input.m_inputSize = inputSize;
+	input.m_predictedRemote = m_rcClient.PredictExecutionTime(invocation);
+	input.m_freeRemoteThreads = m_rcClient.GetFreeRemoteThreads();
+	input.m_remoteQueueWait = m_rcClient.GetExpectedQueueWait();
+	input.m_localThreads = m_config.m_threadCount;
+	{
+		std::lock_guard<std::mutex> lock(m_runningMutex);
+		input.m_freeLocalThreads = m_config.m_threadCount - m_localCompiles;
+	}
+	return m_costModel->Decide(input);
+}
+
+void ToolProxyServer::RunLocal(LocalExecutorTask::Ptr taskCC, const CompileJob & job)
+{
+	const std::string inputFilename = job.m_invocation.GetInput();
+	taskCC->m_callback = [this, job, inputFilename]( LocalExecutorResult::Ptr localResult ) {
+		{
+			std::lock_guard<std::mutex> lock(m_runningMutex);
+			m_localCompiles--;
+		}
+		FileInfo(inputFilename).Remove();
+		if (localResult->m_result)
+			m_costModel->AddLocalResult(job.m_inputSize, localResult->m_executionTime);
+		m_costModel->AddOutcome(job.m_decision, job.m_decision.m_start.GetElapsedTime(), true);
+		job.m_outputCallback(std::make_shared<ToolProxyResponse>(localResult->m_stdOut, localResult->m_result));
+		FinishJob(job.m_cwd, false, localResult->m_result);
+	};
+	{
+		std::lock_guard<std::mutex> lock(m_runningMutex);
+		m_localCompiles++;
+	}
+	m_executor->AddTask(taskCC);
+}
+
+void ToolProxyServer::RunRemote(const CompileJob & job)
+{
+	// RemoteToolClient reads and writes files from the proxy process, so paths should not depend on process cwd.
+	const std::string inputFilename = job.m_invocation.GetInput();
+	auto remoteCallback = [this, job, inputFilename]( const Wuild::RemoteToolClient::TaskExecutionInfo& info) {
+		FileInfo(inputFilename).Remove();
+		if (info.m_result)
+			m_costModel->AddRemoteResult(job.m_inputSize, info.m_toolExecutionTime, info.m_networkRequestTime, job.m_decision.m_remoteQueued);
+		m_costModel->AddOutcome(job.m_decision, job.m_decision.m_start.GetElapsedTime(), false);
+		job.m_outputCallback(std::make_shared<ToolProxyResponse>(info.m_stdOutput, info.m_result));
+		FinishJob(job.m_cwd, true, info.m_result);
+	};
+	m_rcClient.InvokeTool(job.m_invocation, remoteCallback);
+}
+
+void ToolProxyServer::RunRace(LocalExecutorTask::Ptr taskCC, const CompileJob & job)
+{
+	struct RaceState
+	{
+		std::mutex m_mutex;
+		int m_finished = 0;
+		bool m_done = false;
+	};
+	auto state = std::make_shared<RaceState>();
+	const std::string inputFilename = job.m_invocation.GetInput();
+	const std::string outputFilename = job.m_invocation.GetOutput();
+	const std::string localOutput = outputFilename + ".wuild-local";
+	const std::string remoteOutput = outputFilename + ".wuild-remote";
+
+	// remote failure may be just network, so only local failure is final before other side finishes.
+	auto finish = [this, job, state, inputFilename, outputFilename](bool local, bool result, const std::string & stdOut, const std::string & resultFilename) {
+		std::lock_guard<std::mutex> lock(state->m_mutex);
+		const bool last = ++state->m_finished == 2;
+		if (!state->m_done && (result || local || last))
+		{
+			state->m_done = true;
+			result = result && FileInfo(resultFilename).Rename(outputFilename);
+			m_costModel->AddOutcome(job.m_decision, job.m_decision.m_start.GetElapsedTime(), local);
+			job.m_outputCallback(std::make_shared<ToolProxyResponse>(stdOut, result));
+			FinishJob(job.m_cwd, !local, result);
+		}
+		else
+		{
+			FileInfo(resultFilename).Remove();
+		}
+		if (last)
+			FileInfo(inputFilename).Remove();
+	};
+
+	taskCC->m_invocation.SetOutput(localOutput);
+	taskCC->m_callback = [this, job, finish, localOutput]( LocalExecutorResult::Ptr localResult ) {
+		{
+			std::lock_guard<std::mutex> lock(m_runningMutex);
+			m_localCompiles--;
+		}
+		if (localResult->m_result)
+			m_costModel->AddLocalResult(job.m_inputSize, localResult->m_executionTime);
+		finish(true, localResult->m_result, localResult->m_stdOut, localOutput);
+	};
+	{
+		std::lock_guard<std::mutex> lock(m_runningMutex);
+		m_localCompiles++;
+	}
+	m_executor->AddTask(taskCC);
+
+	m_rcClient.InvokeTool(job.m_invocation, [this, job, finish, remoteOutput]( const Wuild::RemoteToolClient::TaskExecutionInfo& info) {
+		if (info.m_result)
+			m_costModel->AddRemoteResult(job.m_inputSize, info.m_toolExecutionTime, info.m_networkRequestTime, false);
+		finish(false, info.m_result, info.m_stdOutput, remoteOutput);
+	}, remoteOutput);
+}
+
 void ToolProxyServer::Start(std::function<void()> interruptCallback)
 {
 	m_executor->SetThreadCount(m_config.m_threadCount);
 	m_server = std::make_unique<SocketFrameService>(  );
-	m_server->AddTcpListener(m_config.m_listenPort, "*", {}, interruptCallback);
-	
-	m_server->RegisterFrameReader(SocketFrameReaderTemplate<ToolProxyRequest>::Create([this](const ToolProxyRequest& inputMessage, SocketFrameHandler::OutputCallback outputCallback){
+	if (m_config.m_listenPort > 0)
+		m_server->AddTcpListener(m_config.m_listenPort, "*", {}, interruptCallback);
+	if (!m_config.m_listenSocket.empty())
+	{
+		if (!CheckAgentSocket())
+		{
+			Syslogger(Syslogger::Notice) << "Agent already listens on " << m_config.m_listenSocket;
+			interruptCallback();
+			return;
+		}
+		m_server->AddTcpListener(0, "unix:" + m_config.m_listenSocket, {}, interruptCallback);
+	}
 
-		// TODO: we assume that proxy server is used to build only one working directory at once.
-		if (m_cwd != inputMessage.m_cwd)
+	m_server->SetHandlerInitCallback([this](SocketFrameHandler * handler){
 		{
-			m_cwd = inputMessage.m_cwd;
-			SetCWD(m_cwd);
+			std::lock_guard<std::mutex> lock(m_runningMutex);
+			m_connectedClients++;
 		}
+		handler->RegisterFrameReader(SocketFrameReaderTemplate<ToolProxyStatus>::Create([this, handler](const ToolProxyStatus&, SocketFrameHandler::OutputCallback){
+			ToolProxyStatus::Ptr status(new ToolProxyStatus());
+			status->m_freeRemoteThreads = m_rcClient.GetFreeRemoteThreads();
+			std::lock_guard<std::mutex> lock(m_runningMutex);
+			m_statusSubscribers.insert(handler);
+			handler->QueueFrame(status);
+		}));
+	});
+	m_server->SetHandlerDestroyCallback([this](SocketFrameHandler * handler){
+		std::lock_guard<std::mutex> lock(m_runningMutex);
+		m_connectedClients--;
+		m_statusSubscribers.erase(handler);
+		m_runningJobsUpdate = TimePoint(true);
+	});
+	m_server->RegisterFrameReader(SocketFrameReaderTemplate<ToolProxyRemoteRequest>::Create([this](const ToolProxyRemoteRequest& inputMessage, SocketFrameHandler::OutputCallback outputCallback){
+		// client already decided on remote execution, local fallback is client's business.
+		const std::string cwd = inputMessage.m_cwd;
+		ToolInvocation invocation = m_invocationRewriter->CompleteInvocation(inputMessage.m_invocation);
+		invocation.SetInput(FileInfo::ResolvePath(invocation.GetInput(), cwd));
+		invocation.SetOutput(FileInfo::ResolvePath(invocation.GetOutput(), cwd));
+		StartJob(cwd);
+		m_rcClient.InvokeTool(invocation, [this, outputCallback, cwd]( const Wuild::RemoteToolClient::TaskExecutionInfo& info) {
+			outputCallback(std::make_shared<ToolProxyResponse>(info.m_stdOutput, info.m_result));
+			FinishJob(cwd, true, info.m_result);
+			BroadcastStatus();
+		});
+		BroadcastStatus();
+	}));
+	
+	m_server->RegisterFrameReader(SocketFrameReaderTemplate<ToolProxyRequest>::Create([this](const ToolProxyRequest& inputMessage, SocketFrameHandler::OutputCallback outputCallback){
 
+		// several builds may share one proxy, so working directory is per task, not process-wide.
+		const std::string cwd = inputMessage.m_cwd;
 		LocalExecutorTask::Ptr original(new LocalExecutorTask());
 		original->m_invocation = inputMessage.m_invocation;
-		
+		original->m_cwd = cwd;
+
 		original->m_readOutput = original->m_writeInput = false;
 		std::string err;
 		ILocalExecutor::TaskPair tasks = m_executor->SplitTask(original, err);
-		UpdateRunningJobs(+1);
+		StartJob(cwd);
 		if (tasks.first)
 		{
 			LocalExecutorTask::Ptr taskPP = tasks.first;
-
-			taskPP->m_callback = [this, taskCC=tasks.second, outputCallback] ( LocalExecutorResult::Ptr localResult ) {
-				if (!localResult->m_result)
+			LocalExecutorTask::Ptr taskCC = tasks.second;
+			CompileJob job;
+			job.m_invocation = tasks.second->m_invocation;
+			job.m_invocation.SetInput(FileInfo::ResolvePath(job.m_invocation.GetInput(), cwd));
+			job.m_invocation.SetOutput(FileInfo::ResolvePath(job.m_invocation.GetOutput(), cwd));
+			job.m_outputCallback = outputCallback;
+			job.m_cwd = cwd;
+			if (m_rcClient.IsPreprocessStreamed())
+			{
+				// preprocessed size is not known yet, so decision is made only by task history or free remote thread.
+				job.m_decision = DecideExecution(job.m_invocation, 0);
+				if (job.m_decision.m_choice == ExecutionCostModel::Choice::Remote)
 				{
-					outputCallback(std::make_shared<ToolProxyResponse>(localResult->m_stdOut));
-					UpdateRunningJobs(-1);
+					StreamPreprocessed(taskPP, job);
 					return;
 				}
-				if (m_rcClient.GetFreeRemoteThreads() > 0)
+			}
+
+			taskPP->m_callback = [this, taskCC, job] ( LocalExecutorResult::Ptr localResult ) mutable {
+				if (!localResult->m_result)
 				{
-					auto inputFilename = taskCC->m_invocation.GetInput();
-					auto remoteCallback = [this, outputCallback, inputFilename]( const Wuild::RemoteToolClient::TaskExecutionInfo& info) {
-						FileInfo(inputFilename).Remove();
-						outputCallback(std::make_shared<ToolProxyResponse>(info.m_stdOutput, info.m_result));
-						UpdateRunningJobs(-1);
-					};
-					m_rcClient.InvokeTool(taskCC->m_invocation, remoteCallback);
+					job.m_outputCallback(std::make_shared<ToolProxyResponse>(localResult->m_stdOut));
+					FinishJob(job.m_cwd, false, false);
+					return;
 				}
-				else
+				job.m_inputSize = FileInfo(job.m_invocation.GetInput()).GetFileSize();
+				job.m_decision = DecideExecution(job.m_invocation, job.m_inputSize);
+				switch (job.m_decision.m_choice)
 				{
-					taskCC->m_callback = [this, outputCallback]( LocalExecutorResult::Ptr localResult ) {
-						outputCallback(std::make_shared<ToolProxyResponse>(localResult->m_stdOut, localResult->m_result));
-						UpdateRunningJobs(-1);
-					};
-					m_executor->AddTask(taskCC);
+					case ExecutionCostModel::Choice::Local:  RunLocal(taskCC, job); break;
+					case ExecutionCostModel::Choice::Remote: RunRemote(job); break;
+					case ExecutionCostModel::Choice::Race:   RunRace(taskCC, job); break;
 				}
 			};
 			m_executor->AddTask(taskPP);
 		}
 		else
 		{
-			original->m_callback = [outputCallback, this] ( LocalExecutorResult::Ptr localResult ) {
+			original->m_callback = [outputCallback, this, cwd] ( LocalExecutorResult::Ptr localResult ) {
 				outputCallback(std::make_shared<ToolProxyResponse>(localResult->m_stdOut, localResult->m_result));
-				UpdateRunningJobs(-1);
+				FinishJob(cwd, false, localResult->m_result);
 			};
 			m_executor->AddTask(original);
 		}
@@ -114,16 +303,80 @@ void ToolProxyServer::Start(std::function<void()> interruptCallback)
 	
 	m_inactiveChecker.Exec([this, interruptCallback]
 	{
+		// other clients of tool servers change free threads too.
+		BroadcastStatus(false);
 		std::lock_guard<std::mutex> lock(m_runningMutex);
-		if (m_runningJobs == 0 && m_runningJobsUpdate.GetElapsedTime() > m_config.m_inactiveTimeout)
+		if (m_runningJobs == 0 && m_connectedClients == 0 && m_runningJobsUpdate.GetElapsedTime() > m_config.m_inactiveTimeout)
 			interruptCallback();
 	}, 100000 /*us*/);
 }
 
-void ToolProxyServer::UpdateRunningJobs(int delta)
+std::string ToolProxyServer::GetSessionInformation() const
+{
+	std::lock_guard<std::mutex> lock(m_runningMutex);
+	std::ostringstream os;
+	for (const auto & session : m_sessions)
+	{
+		const SessionStats & stats = session.second;
+		os << "[" << session.first << "] tasks: " << stats.m_tasks
+		   << ", remote: " << stats.m_remoteTasks
+		   << ", failures: " << stats.m_failures
+		   << ", running: " << stats.m_runningJobs
+		   << ", elapsed: " << (stats.m_lastFinish - stats.m_start).ToProfilingTime() << "\n";
+	}
+	const std::string decisions = m_costModel ? m_costModel->GetStatistics() : std::string();
+	if (!decisions.empty())
+		os << decisions << "\n";
+	return os.str();
+}
+
+void ToolProxyServer::BroadcastStatus(bool force)
+{
+	const int freeRemoteThreads = m_rcClient.GetFreeRemoteThreads();
+	std::lock_guard<std::mutex> lock(m_runningMutex);
+	if (!force && freeRemoteThreads == m_lastFreeRemoteThreads)
+		return;
+	m_lastFreeRemoteThreads = freeRemoteThreads;
+	ToolProxyStatus::Ptr status(new ToolProxyStatus());
+	status->m_freeRemoteThreads = freeRemoteThreads;
+	for (SocketFrameHandler * handler : m_statusSubscribers)
+		handler->QueueFrame(status);
+}
+
+bool ToolProxyServer::CheckAgentSocket() const
+{
+	TcpConnectionParams params;
+	params.m_endPoint.SetPoint(0, "unix:" + m_config.m_listenSocket);
+	params.m_connectTimeout = TimePoint(0.1);
+	auto socket = TcpSocket::Create(params);
+	const bool connected = socket->Connect();
+	socket->Disconnect();
+	return !connected;
+}
+
+void ToolProxyServer::StartJob(const std::string & cwd)
+{
+	std::lock_guard<std::mutex> lock(m_runningMutex);
+	m_runningJobsUpdate = TimePoint(true);
+	m_runningJobs++;
+	SessionStats & stats = m_sessions[cwd];
+	if (!stats.m_start)
+		stats.m_start = m_runningJobsUpdate;
+	stats.m_runningJobs++;
+}
+
+void ToolProxyServer::FinishJob(const std::string & cwd, bool remote, bool result)
 {
 	std::lock_guard<std::mutex> lock(m_runningMutex);
 	m_runningJobsUpdate = TimePoint(true);
-	m_runningJobs += delta;
+	m_runningJobs--;
+	SessionStats & stats = m_sessions[cwd];
+	stats.m_lastFinish = m_runningJobsUpdate;
+	stats.m_runningJobs--;
+	stats.m_tasks++;
+	if (remote)
+		stats.m_remoteTasks++;
+	if (!result)
+		stats.m_failures++;
 }
 }
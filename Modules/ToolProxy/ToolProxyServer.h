@@ -14,13 +14,18 @@
 #pragma once
 
 #include "ToolProxyFrames.h"
+#include "ExecutionCostModel.h"
 
 #include <ToolProxyServerConfig.h>
 #include <RemoteToolClient.h>
 #include <ILocalExecutor.h>
+#include <IInvocationRewriter.h>
 #include <ThreadLoop.h>
+#include <SocketFrameHandler.h>
 
+#include <map>
 #include <mutex>
+#include <set>
 
 namespace Wuild
 {
@@ -31,8 +36,13 @@ class SocketFrameService;
  * -listen for local invocations;
  * -communicate with coordinator;
  * -split commands;
+ * -decide by cost model whether preprocessed task runs locally, remotely or both;
  * -send requests to remote servers;
  * -when request is done, result is sent to local proxy client.
+ *
+ * With listenSocket set, proxy also works as per-user agent: build tools keep connection to it,
+ * send remote requests as is and subscribe to free remote threads, so connection to coordinator
+ * and tool servers outlives single build.
  */
 class ToolProxyServer
 {
@@ -40,24 +50,70 @@ public:
 	using Config = ToolProxyServerConfig;
 
 public:
-	ToolProxyServer(ILocalExecutor::Ptr executor, RemoteToolClient & rcClient);
+	ToolProxyServer(IInvocationRewriter::Ptr invocationRewriter, ILocalExecutor::Ptr executor, RemoteToolClient & rcClient);
 	~ToolProxyServer();
 
 	bool SetConfig(const Config & config);
 	void Start(std::function<void()> interruptCallback);
+
+	/// Statistics for each build directory served by proxy.
+	std::string GetSessionInformation() const;
+
 private:
-	void UpdateRunningJobs(int delta);
-	
+	/// Task counters of one build directory.
+	struct SessionStats
+	{
+		int m_tasks = 0;
+		int m_remoteTasks = 0;
+		int m_failures = 0;
+		int m_runningJobs = 0;
+		TimePoint m_start;
+		TimePoint m_lastFinish;
+	};
+
+	/// Compilation of preprocessed file.
+	struct CompileJob
+	{
+		ToolInvocation m_invocation;      //!< with paths resolved against m_cwd.
+		size_t m_inputSize = 0;
+		ExecutionCostModel::Decision m_decision;
+		SocketFrameHandler::OutputCallback m_outputCallback;
+		std::string m_cwd;
+	};
+
+	void StartJob(const std::string & cwd);
+	void FinishJob(const std::string & cwd, bool remote, bool result);
+	/// Runs preprocessor with output piped to remote compilation request.
+	void StreamPreprocessed(LocalExecutorTask::Ptr taskPP, const CompileJob & job);
+	/// Estimates where compilation finishes sooner; input size is zero before preprocessing.
+	ExecutionCostModel::Decision DecideExecution(const ToolInvocation & invocation, size_t inputSize);
+	/// Following ones remove preprocessed file when done.
+	void RunLocal(LocalExecutorTask::Ptr taskCC, const CompileJob & job);
+	void RunRemote(const CompileJob & job);
+	/// Compiles on both sides into temporary outputs; first successful result (or local failure) is taken.
+	void RunRace(LocalExecutorTask::Ptr taskCC, const CompileJob & job);
+	/// Sends free remote threads to subscribed clients. Without force, only if changed.
+	/// Clients count their requests in advance, so after each task status is always sent.
+	void BroadcastStatus(bool force = true);
+	/// Returns false if another agent already listens on socket.
+	bool CheckAgentSocket() const;
+
 private:
+	IInvocationRewriter::Ptr m_invocationRewriter;
 	ILocalExecutor::Ptr m_executor;
 	RemoteToolClient & m_rcClient;
 	Config m_config;
-	std::string m_cwd;
 	std::unique_ptr<SocketFrameService> m_server;
 	ThreadLoop m_inactiveChecker;
 	int m_runningJobs = 0;
+	int m_localCompiles = 0;
+	std::unique_ptr<ExecutionCostModel> m_costModel;
 	TimePoint m_runningJobsUpdate;
-	std::mutex m_runningMutex;
+	std::map<std::string, SessionStats> m_sessions;
+	int m_connectedClients = 0;
+	std::set<SocketFrameHandler*> m_statusSubscribers;
+	int m_lastFreeRemoteThreads = -1;
+	mutable std::mutex m_runningMutex;
 };
 
 }
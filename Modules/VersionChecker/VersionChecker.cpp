@@ -17,6 +17,62 @@
 #include <Syslogger.h>
 
 #include <regex>
+#include <sstream>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+
+namespace
+{
+/// executable => (identity, version)
+using VersionCache = std::map<std::string, std::pair<std::string, std::string>>;
+
+/// Changes when executable is replaced or updated. Empty if file is not found (e.g. path is not full).
+std::string GetExecutableIdentity(const std::string & executable)
+{
+	struct stat st;
+	if (stat(executable.c_str(), &st) != 0)
+		return std::string();
+	std::ostringstream os;
+	os << st.st_ino << " " << st.st_size << " " << static_cast<int64_t>(st.st_mtime);
+	return os.str();
+}
+
+/// Line format: executable, identity and version separated by tabs.
+VersionCache LoadVersionCache(const std::string & filename)
+{
+	VersionCache cache;
+	Wuild::ByteArrayHolder data;
+	if (!Wuild::FileInfo(filename).ReadFile(data))
+		return cache;
+
+	std::istringstream is(std::string(data.data(), data.data() + data.size()));
+	std::string line;
+	while (std::getline(is, line))
+	{
+		std::istringstream lineStream(line);
+		std::string executable, identity, version;
+		if (std::getline(lineStream, executable, '\t') && std::getline(lineStream, identity, '\t') && std::getline(lineStream, version))
+			cache[executable] = std::make_pair(identity, version);
+	}
+	return cache;
+}
+
+void SaveVersionCache(const std::string & filename, const VersionCache & cache)
+{
+	std::ostringstream os;
+	for (const auto & entry : cache)
+		os << entry.first << '\t' << entry.second.first << '\t' << entry.second.second << '\n';
+
+	const std::string str = os.str();
+	Wuild::ByteArrayHolder data;
+	data.ref().assign(str.cbegin(), str.cend());
+	Wuild::FileInfo file(filename);
+	Wuild::FileInfo(file.GetDir()).Mkdirs();
+	if (!file.WriteFile(data))
+		Wuild::Syslogger(Wuild::Syslogger::Warning) << "Failed to write tool version cache " << filename;
+}
+}
 
 namespace Wuild
 {
@@ -53,6 +109,11 @@ IVersionChecker::ToolType VersionChecker::GuessToolType(const ToolInvocation::Id
 IVersionChecker::VersionMap VersionChecker::DetermineToolVersions(const std::vector<std::string> & toolIds) const
 {
 	VersionMap result;
+	const std::string & cacheFile = m_rewriter->GetConfig().m_versionCacheFile;
+	VersionCache cache;
+	if (!cacheFile.empty())
+		cache = LoadVersionCache(cacheFile);
+	bool cacheChanged = false;
 	for (const InvocationRewriterConfig::Tool & tool : m_rewriter->GetConfig().m_tools)
 	{
 		if (!toolIds.empty() && std::find(toolIds.cbegin(), toolIds.cend(), tool.m_id) == toolIds.cend())
@@ -72,10 +133,26 @@ IVersionChecker::VersionMap VersionChecker::DetermineToolVersions(const std::vec
 			continue;
 		}
 
+		const std::string identity = cacheFile.empty() ? std::string() : GetExecutableIdentity(id.m_toolExecutable);
+		auto cacheIt = cache.find(id.m_toolExecutable);
+		if (!identity.empty() && cacheIt != cache.end() && cacheIt->second.first == identity)
+		{
+			result[tool.m_id] = cacheIt->second.second;
+			continue;
+		}
+
 		const auto toolType = GuessToolType(id);
 		const auto version = GetToolVersion(id, toolType);
 		result[tool.m_id] = version;
+		if (!identity.empty() && !version.empty())
+		{
+			cache[id.m_toolExecutable] = std::make_pair(identity, version);
+			cacheChanged = true;
+		}
 	}
+	if (cacheChanged)
+		SaveVersionCache(cacheFile, cache);
+
 	return result;
 }
 
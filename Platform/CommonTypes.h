@@ -29,7 +29,7 @@ class ByteArrayHolder
 {
 	std::shared_ptr<ByteArray> p;
 public:
-	ByteArrayHolder() : p(new ByteArray()) {}
+	ByteArrayHolder() : p(std::make_shared<ByteArray>()) {}
 
 	size_t            size() const        { return p.get()->size(); }
 	void              resize(size_t size) { return p.get()->resize(size); }
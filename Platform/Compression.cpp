@@ -289,4 +289,123 @@ void CompressDataBuffer(const ByteArrayHolder & input, ByteArrayHolder & output,
 	}
 }
 
+struct StreamCompressor::Impl
+{
+	ByteArrayHolder m_output;
+	CompressionInfo m_info;
+	ByteArrayHolder m_buffered;
+	bool m_finished = false;
+#ifdef USE_ZLIB
+	z_stream m_strm;
+	bool m_zlibInit = false;
+
+	void Deflate(int flush)
+	{
+		unsigned char out[CHUNK];
+		do {
+			m_strm.avail_out = CHUNK;
+			m_strm.next_out = out;
+			const int ret = deflate(&m_strm, flush);
+			if (ret == Z_STREAM_ERROR)
+				throw std::runtime_error("Gzip deflate failed:"  + std::to_string(ret));
+			m_output.ref().insert(m_output.ref().end(), out, out + (CHUNK - m_strm.avail_out));
+		} while (m_strm.avail_out == 0);
+	}
+#endif
+#ifdef USE_LZ4
+	std::unique_ptr<ByteArrayHolderBufWriter> m_lz4Buffer;
+	std::unique_ptr<std::ostream> m_lz4BufferStream;
+	std::unique_ptr<LZ4OutputStream> m_lz4Stream;
+#endif
+};
+
+StreamCompressor::StreamCompressor(ByteArrayHolder & output, CompressionInfo compressionInfo)
+	: m_impl(new Impl())
+{
+	m_impl->m_output = output;
+	m_impl->m_info = compressionInfo;
+	if (false) {}
+#ifdef USE_ZLIB
+	else if (compressionInfo.m_type == CompressionType::Gzip)
+	{
+		m_impl->m_strm.zalloc = Z_NULL;
+		m_impl->m_strm.zfree = Z_NULL;
+		m_impl->m_strm.opaque = Z_NULL;
+		const int ret = deflateInit(&m_impl->m_strm, compressionInfo.m_level);
+		if (ret != Z_OK)
+			throw std::runtime_error("Gzip deflate failed:"  + std::to_string(ret));
+		m_impl->m_zlibInit = true;
+	}
+#endif
+#ifdef USE_LZ4
+	else if (compressionInfo.m_type == CompressionType::LZ4)
+	{
+		m_impl->m_lz4Buffer.reset(new ByteArrayHolderBufWriter(m_impl->m_output));
+		m_impl->m_lz4BufferStream.reset(new std::ostream(m_impl->m_lz4Buffer.get()));
+		m_impl->m_lz4Stream.reset(new LZ4OutputStream(*m_impl->m_lz4BufferStream));
+	}
+#endif
+}
+
+StreamCompressor::~StreamCompressor()
+{
+#ifdef USE_ZLIB
+	if (m_impl->m_zlibInit)
+		(void)deflateEnd(&m_impl->m_strm);
+#endif
+}
+
+void StreamCompressor::Append(const uint8_t * data, size_t size)
+{
+	m_inputSize += size;
+	if (false) {}
+#ifdef USE_ZLIB
+	else if (m_impl->m_zlibInit)
+	{
+		m_impl->m_strm.next_in = const_cast<uint8_t*>(data);
+		m_impl->m_strm.avail_in = static_cast<uInt>(size);
+		m_impl->Deflate(Z_NO_FLUSH);
+	}
+#endif
+#ifdef USE_LZ4
+	else if (m_impl->m_lz4Stream)
+	{
+		m_impl->m_lz4Stream->write(reinterpret_cast<const char*>(data), size);
+	}
+#endif
+	else
+	{
+		m_impl->m_buffered.ref().insert(m_impl->m_buffered.ref().end(), data, data + size);
+	}
+}
+
+void StreamCompressor::Finish()
+{
+	if (m_impl->m_finished)
+		return;
+	m_impl->m_finished = true;
+	if (false) {}
+#ifdef USE_ZLIB
+	else if (m_impl->m_zlibInit)
+	{
+		m_impl->m_strm.next_in = Z_NULL;
+		m_impl->m_strm.avail_in = 0;
+		m_impl->Deflate(Z_FINISH);
+	}
+#endif
+#ifdef USE_LZ4
+	else if (m_impl->m_lz4Stream)
+	{
+		m_impl->m_lz4Stream->close();
+	}
+#endif
+	else
+	{
+		// holder assignment would detach m_output from caller's holder, so swap contents.
+		ByteArrayHolder compressed;
+		CompressDataBuffer(m_impl->m_buffered, compressed, m_impl->m_info);
+		m_impl->m_output.ref().swap(compressed.ref());
+	}
+}
+
 }
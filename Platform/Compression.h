@@ -15,6 +15,7 @@
 #include "CommonTypes.h"
 
 #include <stdint.h>
+#include <memory>
 #include <vector>
 #include <string>
 
@@ -31,4 +32,25 @@ struct CompressionInfo
 void UncompressDataBuffer(const ByteArrayHolder & input, ByteArrayHolder & output, CompressionInfo compressionInfo);
 void CompressDataBuffer  (const ByteArrayHolder & input, ByteArrayHolder & output, CompressionInfo compressionInfo);
 
+/// Compresses data arriving by chunks, result is same as of CompressDataBuffer for whole data.
+/// Gzip and LZ4 are compressed on the fly; ZStd needs content size in frame header, so its input is buffered.
+/// Methods throw std::runtime_error on failure, same as CompressDataBuffer.
+class StreamCompressor
+{
+public:
+	StreamCompressor(ByteArrayHolder & output, CompressionInfo compressionInfo);
+	~StreamCompressor();
+
+	void Append(const uint8_t * data, size_t size);
+	/// Flushes the rest of output; no Append allowed after.
+	void Finish();
+
+	size_t GetInputSize() const { return m_inputSize; }
+
+private:
+	struct Impl;
+	std::unique_ptr<Impl> m_impl;
+	size_t m_inputSize = 0;
+};
+
 }
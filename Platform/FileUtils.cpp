@@ -101,6 +101,13 @@ std::string FileInfo::ToPlatformPath(std::string path)
    return path;
 }
 
+std::string FileInfo::ResolvePath(const std::string &path, const std::string &baseDir)
+{
+	if (baseDir.empty() || path.empty() || fs::path(path).is_absolute())
+		return path;
+	return (fs::path(baseDir) / path).u8string();
+}
+
 FileInfo::FileInfo(const FileInfo &rh)
 	: m_impl(new FileInfoPrivate(*rh.m_impl))
 {
@@ -338,6 +345,19 @@ void FileInfo::Remove()
 		fs::remove(m_impl->m_path, code);
 }
 
+bool FileInfo::Rename(const std::string & newFilename)
+{
+	fserr code;
+	fs::rename(m_impl->m_path, newFilename, code);
+	if (code)
+	{
+		Syslogger(Syslogger::Err) << "Failed to rename " << GetPath() << " -> " << newFilename;
+		return false;
+	}
+	m_impl->m_path = newFilename;
+	return true;
+}
+
 void FileInfo::Mkdirs()
 {
 	fserr code;
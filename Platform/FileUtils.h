@@ -29,6 +29,8 @@ class FileInfo
 public:
 	static std::string LocatePath(const std::string & path);
 	static std::string ToPlatformPath(std::string path);
+	/// Returns path relative to baseDir as absolute. Absolute path or empty baseDir returns path as is.
+	static std::string ResolvePath(const std::string & path, const std::string & baseDir);
 
 public:
 	FileInfo(const FileInfo& rh);
@@ -78,6 +80,9 @@ public:
 	/// Removes file. No error produced on failure.
 	void Remove();
 
+	/// Moves file to new path, replacing existing one.
+	bool Rename(const std::string & newFilename);
+
 	/// Creates directories recursive
 	void Mkdirs();
 
@@ -173,6 +173,11 @@ void SocketFrameHandler::QueueFrame(const SocketFrame::Ptr& message, const Socke
 	m_framesQueueOutput.push(message);
 }
 
+void SocketFrameHandler::FailPendingReplies()
+{
+	m_replyManager.ClearAndSendError();
+}
+
 void SocketFrameHandler::RegisterFrameReader(const SocketFrameHandler::IFrameReader::Ptr& reader)
 {
 	if (reader->FrameTypeId() < SocketFrame::s_minimalUserFrameId)
@@ -234,19 +239,22 @@ bool SocketFrameHandler::ReadFrames()
 	if (readState == IDataSocket::ReadState::Fail)
 		return false;
 
-	if (readState == IDataSocket::ReadState::TryAgain)
+	// segments of other frame type may be left after previous read, they should not wait for new data.
+	if (readState == IDataSocket::ReadState::TryAgain && !m_readBuffer.GetSize())
 		return true;//nothing to read, it's not a error.
 
-	m_lastTestActivity = m_lastSucceessfulRead = TimePoint(true);
+	if (readState != IDataSocket::ReadState::TryAgain)
+	{
+		m_lastTestActivity = m_lastSucceessfulRead = TimePoint(true);
 
-	const size_t newSize = m_readBuffer.GetHolder().size();
+		const size_t newSize = m_readBuffer.GetHolder().size();
 
-	m_readBuffer.SetSize(newSize);
+		m_readBuffer.SetSize(newSize);
 
-	m_doTestActivity = true;
+		m_doTestActivity = true;
+		m_outputAcknowledgesSize += newSize - currentSize;
+	}
 	m_readBuffer.ResetRead();
-
-	m_outputAcknowledgesSize += newSize - currentSize;
 	bool validInput = true;
 
 	// if some new data arrived, try to extract segments from it:
@@ -640,6 +648,135 @@ void SocketFrameHandler::PreprocessFrame(const SocketFrame::Ptr& incomingMessage
 	}
 }
 
+SocketFrame::Ptr SocketFrameHandler::SyncExchange(IDataSocket &channel, const SocketFrameHandlerSettings &settings,
+												  const SocketFrame &request, const IFrameReader &replyReader, TimePoint timeout)
+{
+	const TimePoint start(true);
+	auto writeAll = [&channel, &settings, &start, &timeout](const ByteArrayHolder & data) {
+		while (start.GetElapsedTime() < timeout)
+		{
+			const auto writeState = channel.Write(data, data.size());
+			if (writeState != IDataSocket::WriteState::TryAgain)
+				return writeState == IDataSocket::WriteState::Success;
+			usleep(settings.m_clientThreadSleep.GetUS());
+		}
+		return false;
+	};
+
+	// connection options and request segments are written at once, as handler would do after connect.
+	ByteOrderBuffer frameBuf;
+	ByteOrderDataStreamWriter frameWriter(frameBuf, settings.m_byteOrder);
+	request.Write(frameWriter);
+	const ByteArrayHolder & frameData = frameBuf.GetHolder();
+
+	ByteOrderBuffer outputBuf;
+	ByteOrderDataStreamWriter outputWriter(outputBuf, settings.m_byteOrder);
+	if (settings.m_hasConnOptions)
+		outputWriter << uint8_t(ServiceMessageType::ConnOptions) << channel.GetRecieveBufferSize() << settings.m_channelProtocolVersion << TimePoint(true).GetUS();
+	for (size_t offset = 0; offset < frameData.size(); offset += settings.m_segmentSize)
+	{
+		const size_t length = std::min(settings.m_segmentSize, frameData.size() - offset);
+		if (settings.m_hasChannelTypes)
+			outputWriter << request.FrameTypeId() << uint32_t(length);
+		memcpy(outputWriter.GetBuffer().PosWrite(length), frameData.data() + offset, length);
+		outputWriter.GetBuffer().MarkWrite(length);
+	}
+	if (!writeAll(outputBuf.GetHolder()))
+		return nullptr;
+
+	ByteOrderBuffer input;
+	ByteOrderBuffer replyData;
+	size_t unacknowledged = 0;
+	while (start.GetElapsedTime() < timeout)
+	{
+		const size_t currentSize = input.GetHolder().size();
+		const auto readState = channel.Read(input.GetHolder());
+		if (readState == IDataSocket::ReadState::Fail)
+			return nullptr;
+		if (readState == IDataSocket::ReadState::TryAgain)
+			continue; // paced by channel read timeout.
+
+		input.SetSize(input.GetHolder().size());
+		unacknowledged += input.GetSize() - currentSize;
+
+		// extract whole segments, incomplete one waits for more data.
+		while (input.GetSize())
+		{
+			input.ResetRead();
+			ByteOrderDataStreamReader inputStream(input, settings.m_byteOrder);
+			ServiceMessageType mtype = ServiceMessageType::User;
+			if (settings.m_hasChannelTypes)
+				mtype = ServiceMessageType(inputStream.ReadScalar<uint8_t>());
+
+			if (settings.m_hasAcknowledges && mtype == ServiceMessageType::Ack)
+				inputStream.ReadScalar<uint32_t>();
+			else if (settings.m_hasLineTest && mtype == ServiceMessageType::LineTest) { }
+			else if (settings.m_hasConnOptions && mtype == ServiceMessageType::ConnOptions)
+			{
+				uint32_t bufferSize = 0, version = 0;
+				int64_t timestamp = 0;
+				inputStream >> bufferSize >> version >> timestamp;
+				if (!input.EofRead() && version != settings.m_channelProtocolVersion)
+				{
+					Syslogger(channel.GetLogContext(), Syslogger::Err) << "Remote version is  " << version << ", but mine is " << settings.m_channelProtocolVersion;
+					return nullptr;
+				}
+			}
+			else if (settings.m_hasConnStatus && mtype == ServiceMessageType::ConnStatus)
+				inputStream.ReadScalar<uint16_t>();
+			else
+			{
+				ptrdiff_t length = input.GetRemainRead();
+				if (settings.m_hasChannelTypes)
+					length = inputStream.ReadScalar<uint32_t>();
+				const uint8_t * segment = input.PosRead(length);
+				if (input.EofRead() || !segment)
+					break;
+				input.MarkRead(length);
+				if (uint8_t(mtype) == replyReader.FrameTypeId() || !settings.m_hasChannelTypes)
+				{
+					memcpy(replyData.PosWrite(length), segment, length);
+					replyData.MarkWrite(length);
+				}
+			}
+			if (input.EofRead())
+				break;
+			input.RemoveFromStart(input.GetOffsetRead());
+		}
+
+		while (replyData.GetSize())
+		{
+			replyData.ResetRead();
+			SocketFrame::Ptr reply = replyReader.FrameFactory();
+			try
+			{
+				ByteOrderDataStreamReader replyStream(replyData, settings.m_byteOrder);
+				if (reply->Read(replyStream) != SocketFrame::stOk || replyData.EofRead())
+					break;
+			}
+			catch(std::exception & ex)
+			{
+				Syslogger(channel.GetLogContext(), Syslogger::Err) << "SyncExchange exception: " << ex.what();
+				return nullptr;
+			}
+			if (reply->m_replyToTransactionId == request.m_transactionId)
+				return reply;
+			replyData.RemoveFromStart(replyData.GetOffsetRead());
+		}
+
+		if (settings.m_hasAcknowledges && unacknowledged > settings.m_acknowledgeMinimalReadSize)
+		{
+			ByteOrderBuffer ackBuf;
+			ByteOrderDataStreamWriter ackWriter(ackBuf, settings.m_byteOrder);
+			ackWriter << uint8_t(ServiceMessageType::Ack) << static_cast<uint32_t>(unacknowledged);
+			if (!writeAll(ackBuf.GetHolder()))
+				return nullptr;
+			unacknowledged = 0;
+		}
+	}
+	return nullptr;
+}
+
 SocketFrameHandler::ConnectionStatus SocketFrameHandler::CalculateStatus()
 {
 	std::set<size_t> transactions;
@@ -157,9 +157,18 @@ public:
 	///  Adding new frame to queue. If replyNotifier is set, it will called instead of IFrameReader::ProcessFrame, when reply arrived or failure occurs.
 	void   QueueFrame(const SocketFrame::Ptr& message, const ReplyNotifier& replyNotifier = ReplyNotifier(), TimePoint timeout = TimePoint());
 
+	/// Notifies all awaited replies with error, as on lost connection. For stopped handler which is not used anymore.
+	void   FailPendingReplies();
+
 	/// Register new frame reader. FrameId should start from s_minimalUserFrameId!
 	void   RegisterFrameReader(const IFrameReader::Ptr& reader);
 
+	/// Sends request and waits for its reply on calling thread, without handler and its thread; for short-lived clients.
+	/// Other side is usual handler with same settings. Channel should be connected and have read timeout.
+	/// Frames of other types are skipped. Returns nullptr on failure or timeout.
+	static SocketFrame::Ptr SyncExchange(IDataSocket & channel, const SocketFrameHandlerSettings & settings,
+										 const SocketFrame & request, const IFrameReader & replyReader, TimePoint timeout);
+
 //Logging:
 	void   SetLogContext(const std::string & context);
 	void   UpdateLogContext();
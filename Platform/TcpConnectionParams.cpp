@@ -19,6 +19,7 @@
 
 namespace Wuild
 {
+static const std::string g_localSocketPrefix = "unix:";
 
 TcpEndPoint::TcpEndPoint()
 	: m_impl(new TcpEndPointPrivate())
@@ -45,6 +46,25 @@ bool TcpEndPoint::Resolve()
 	if (m_resolved)
 		return true;
 
+	const std::string localPath = GetLocalSocketPath();
+	if (!localPath.empty())
+	{
+#ifndef _WIN32
+		if (m_impl->SetLocal(localPath))
+		{
+			m_ip = localPath;
+			m_resolved = true;
+			return true;
+		}
+#endif
+		if (!m_errorShown)
+		{
+			m_errorShown = true;
+			Syslogger(Syslogger::Err) << "Unsupported local socket path: " << localPath;
+		}
+		return false;
+	}
+
 	auto host = m_host;
 	bool any = false;
 	if (host == "*")
@@ -92,11 +112,20 @@ bool TcpEndPoint::Resolve()
 
 std::string TcpEndPoint::GetShortInfo() const
 {
+	if (!GetLocalSocketPath().empty())
+		return m_host;
 	std::ostringstream os;
 	os << m_host << ":" << m_port;
 	return os.str();
 }
 
+std::string TcpEndPoint::GetLocalSocketPath() const
+{
+	if (m_host.compare(0, g_localSocketPrefix.size(), g_localSocketPrefix) != 0)
+		return std::string();
+	return m_host.substr(g_localSocketPrefix.size());
+}
+
 bool TcpListenerParams::Resolve()
 {
 	for (auto & point : m_whiteList)
@@ -28,6 +28,7 @@ public:
 	TcpEndPoint(int port, const std::string & host = std::string());
 
 	/// Set host and port information. No resolution performed until Resolve() call.
+	/// Host "unix:<path>" is Unix domain socket, port is ignored then (not supported on Windows).
 	void SetPoint(int port, const std::string & host = std::string());
 
 	/// Creates internal data for host and port. If resolution already made, true returned.
@@ -36,6 +37,9 @@ public:
 	/// Outputs host:port as string.
 	std::string GetShortInfo() const;
 
+	/// Path of Unix domain socket, empty for TCP.
+	std::string GetLocalSocketPath() const;
+
 	int GetPort() const { return m_port; }
 	const std::string& GetHost() const { return m_host; }
 	const std::string& GetIpString() const { return m_ip; }
@@ -15,6 +15,7 @@
 
 #include "Tcp_private.h"
 
+#include <cstring>
 #include <string>
 #include <vector>
 
@@ -24,7 +25,7 @@ namespace Wuild
 	{
 		friend class TcpEndPoint;
 	public:
-		void FreeAddr() { if (ai) freeaddrinfo(ai); ai = nullptr; }
+		void FreeAddr() { if (ai && ai != &localAi) freeaddrinfo(ai); ai = nullptr; }
 		~TcpEndPointPrivate() { FreeAddr(); }
 
 		SOCKET MakeSocket() const
@@ -45,13 +46,40 @@ namespace Wuild
 			const char * str = inet_ntop(AF_INET, sockinaddr, ipinput.data(), INET_ADDRSTRLEN);
 			return str ? str : "";
 		}
+#ifndef _WIN32
+		/// Uses Unix domain socket address instead of getaddrinfo result.
+		bool SetLocal(const std::string & path)
+		{
+			FreeAddr();
+			if (path.empty() || path.size() >= sizeof(localAddr.sun_path))
+				return false;
+			localAddr = sockaddr_un();
+			localAddr.sun_family = AF_UNIX;
+			memcpy(localAddr.sun_path, path.c_str(), path.size());
+			localAi = addrinfo();
+			localAi.ai_family = AF_UNIX;
+			localAi.ai_socktype = SOCK_STREAM;
+			localAi.ai_addr = (sockaddr *)&localAddr;
+			localAi.ai_addrlen = sizeof(localAddr);
+			ai = &localAi;
+			return true;
+		}
+#endif
 		std::string ToString() const
 		{
+#ifndef _WIN32
+			if (ai == &localAi)
+				return localAddr.sun_path;
+#endif
 			sockaddr_in * sockin = (sockaddr_in *)ai->ai_addr;
 			return AddrToString(&sockin->sin_addr);
 		}
 
 	private:
 		addrinfo * ai = nullptr;
+		addrinfo localAi {};
+#ifndef _WIN32
+		sockaddr_un localAddr {};
+#endif
 	};
 }
@@ -21,6 +21,10 @@
 
 #include <utility>
 
+#ifndef _WIN32
+#include <sys/stat.h>
+#endif
+
 namespace Wuild
 {
 
@@ -43,6 +47,11 @@ TcpListener::~TcpListener()
 	{
 		Syslogger(m_logContext) << "disconnecting listener..." ;
 		close( m_impl->m_socket );
+#ifndef _WIN32
+		const std::string localPath = m_params.m_endPoint.GetLocalSocketPath();
+		if (!localPath.empty())
+			unlink(localPath.c_str());
+#endif
 	}
 }
 
@@ -105,6 +114,13 @@ bool TcpListener::StartListen()
 		   #endif
 			   &optval, sizeof optval);
 
+#ifndef _WIN32
+	// socket file is left after crash; caller is responsible for not replacing live one.
+	const std::string localPath = m_params.m_endPoint.GetLocalSocketPath();
+	if (!localPath.empty())
+		unlink(localPath.c_str());
+#endif
+
 	int ret = m_params.m_endPoint.GetImpl().Bind(m_impl->m_socket);
 	if (ret < 0)
 	{
@@ -113,6 +129,11 @@ bool TcpListener::StartListen()
 		m_listenerFailed = true;
 		return false;
 	}
+#ifndef _WIN32
+	// local socket is per-user.
+	if (!localPath.empty())
+		chmod(localPath.c_str(), S_IRUSR | S_IWUSR);
+#endif
 
 	if (listen(m_impl->m_socket, m_params.m_pendingListenConnections))
 	{
@@ -17,6 +17,7 @@
 #include "TcpConnectionParams_private.h"
 #include "TcpListener.h"
 #include "Syslogger.h"
+#include "ThreadUtils.h"
 
 #include <algorithm>
 #include <vector>
@@ -136,6 +137,14 @@ bool TcpSocket::Connect ()
 	}
 
 	int cres = m_params.m_endPoint.GetImpl().Connect(m_impl->m_socket);
+	// Unix domain listener with full backlog refuses at once instead of pending connection; retry until timeout.
+	const TimePoint connectStart(true);
+	while (cres < 0 && SocketRWPending(SocketGetLastError()) && !m_params.m_endPoint.GetLocalSocketPath().empty()
+		   && connectStart.GetElapsedTime() < m_params.m_connectTimeout)
+	{
+		usleep(1000);
+		cres = m_params.m_endPoint.GetImpl().Connect(m_impl->m_socket);
+	}
 	if (cres < 0)
 	{
 		const auto err = SocketGetLastError();
@@ -198,10 +207,7 @@ IDataSocket::ReadState TcpSocket::Read(ByteArrayHolder & buffer)
 	if (!IsConnected())
 		return ReadState::Fail;
 
-	if (!IsSocketReadReady( ))
-		return ReadState::TryAgain;
-
-	if (!SelectRead( m_params.m_readTimeout ))  //Нет данных в порту
+	if (!IsSocketReadReady( ) && !(m_params.m_readTimeout && SelectRead( m_params.m_readTimeout )))  //Нет данных в порту
 		return ReadState::TryAgain;
 
 	size_t bufferInitialSize = buffer.size();(void)bufferInitialSize;
@@ -216,7 +222,14 @@ IDataSocket::ReadState TcpSocket::Read(ByteArrayHolder & buffer)
 			read( m_impl->m_socket, tmpbuffer, sizeof(tmpbuffer) );
 		#endif
 	  if (recieved == 0)
-		  break;
+	  {
+		  if (totalRecieved > 0)
+			  break;
+		  // socket was ready for reading, so it is end of stream.
+		  Syslogger(m_logContext) << "Connection closed by peer.";
+		  Disconnect();
+		  return ReadState::Fail;
+	  }
 
 	  if (recieved < 0)
 	  {
@@ -22,6 +22,7 @@
 	#include <sys/ioctl.h>
 	#include <fcntl.h>
 	#include <sys/types.h>
+	#include <sys/un.h>
 	#include <netdb.h>
 
 	#ifndef INVALID_SOCKET
@@ -0,0 +1,89 @@
+/*
+ * Copyright (C) 2017 Smirnov Vladimir mapron1@gmail.com
+ * Source code licensed under the Apache License, Version 2.0 (the "License");
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at http://www.apache.org/licenses/LICENSE-2.0 or in file COPYING-APACHE-2.0.txt
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.h
+ */
+
+#include "TestCluster.h"
+
+#include <algorithm>
+
+using namespace Wuild;
+
+const int g_taskCount = 100;
+const int g_serverThreads = 4;
+const int64_t g_taskDurationUS = 100000;
+
+/// Runs g_taskCount tasks through two equal servers, while first server is also loaded by another client,
+/// which measured client does not know about. Returns 99th percentile of time task spent not executing.
+bool RunScenario(int basePort, int maxQueueSize, TimePoint & p99)
+{
+	std::vector<std::unique_ptr<RemoteToolServer>> servers;
+	std::vector<ToolServerInfo> infos;
+	for (int i = 0; i < 2; ++i)
+	{
+		ToolServerInfo info;
+		servers.push_back(StartTestServer(basePort + i, g_serverThreads, g_taskDurationUS, maxQueueSize, info));
+		if (!servers.back())
+			return false;
+		infos.push_back(info);
+	}
+
+	RemoteToolClient neighbourClient(TestConfiguration::s_invocationRewriter, {});
+	if (!StartClient(neighbourClient, {infos[0]}))
+		return false;
+	BuildEmulator neighbour(neighbourClient, g_serverThreads * 3);
+	std::thread neighbourThread([&neighbour]{ neighbour.Run(-1); });
+
+	RemoteToolClient client(TestConfiguration::s_invocationRewriter, {});
+	bool started = StartClient(client, infos);
+	BuildEmulator build(client, g_serverThreads * 2);
+	if (started)
+		build.Run(g_taskCount);
+
+	neighbour.Stop();
+	neighbourThread.join();
+	client.FinishSession();
+	neighbourClient.FinishSession();
+	if (!started)
+		return false;
+
+	auto & waitTimes = build.m_waitTimes;
+	if (build.m_failed || waitTimes.empty())
+	{
+		Syslogger(Syslogger::Err) << "Failed tasks: " << build.m_failed;
+		return false;
+	}
+	std::sort(waitTimes.begin(), waitTimes.end());
+	TimePoint p50;
+	p50.SetUS(waitTimes[waitTimes.size() / 2]);
+	p99.SetUS(waitTimes[waitTimes.size() * 99 / 100]);
+	Syslogger(Syslogger::Notice) << "maxQueueSize=" << maxQueueSize << " queue wait p50=" << p50.ToProfilingTime()
+								 << " p99=" << p99.ToProfilingTime();
+	return true;
+}
+
+/*
+ * Compares queue wait with and without server busy replies. Arguments not required.
+ */
+int main(int argc, char** argv)
+{
+	ConfiguredApplication app(argc, argv, "TestBackpressure");
+	if (!CreateInvocationRewriter(app, true))
+		return 1;
+
+	TimePoint unlimitedP99, limitedP99;
+	TEST_ASSERT(RunScenario(12360, 0, unlimitedP99));
+	TEST_ASSERT(RunScenario(12370, 2, limitedP99));
+	TEST_ASSERT(limitedP99 < unlimitedP99);
+
+	std::cout << "OK\n";
+	return 0;
+}
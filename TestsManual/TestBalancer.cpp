@@ -14,11 +14,349 @@
 #include "TestUtils.h"
 
 #include <ToolBalancer.h>
+#include <LeaseManager.h>
 #include <Application.h>
 
+#include <queue>
+
 namespace {
 	const std::string g_tool = "gcc";
+	const std::string g_heavyTool = "clang_lto";
 	const size_t g_noIndex = std::numeric_limits<size_t>::max();
+
+	/// Simulates build on one fast and two slow servers, when build parallelism is lower than remote threads.
+	/// Returns makespan in seconds of simulated time.
+	double SimulateMakespan(bool advertiseSpeed, bool observeSpeed)
+	{
+		using namespace Wuild;
+		const std::vector<double> speeds {4.0, 1.0, 1.0};
+		const int parallelism = 12;
+		const int taskCount = 300;
+
+		ToolBalancer balancer;
+		balancer.SetSessionId(1);
+		for (size_t i = 0; i < speeds.size(); ++i)
+		{
+			ToolServerInfo info;
+			info.m_toolIds = StringVector(1, g_tool);
+			info.m_totalThreads = 8;
+			info.m_toolServerId = "server" + std::to_string(i);
+			info.m_speedScore = advertiseSpeed ? static_cast<uint32_t>(speeds[i] * 1000) : 0;
+			size_t index = 0;
+			balancer.UpdateClient(info, index);
+			balancer.SetClientActive(index, true);
+		}
+
+		struct Finish
+		{
+			double m_time;
+			size_t m_index;
+			double m_duration;
+			bool operator > (const Finish & rh) const { return m_time > rh.m_time; }
+		};
+		using TimeQueue = std::priority_queue<double, std::vector<double>, std::greater<double>>;
+		std::priority_queue<Finish, std::vector<Finish>, std::greater<Finish>> running;
+		std::vector<TimeQueue> threadsFreeTime(speeds.size()); // tasks over thread count wait in server queue.
+		for (auto & threads : threadsFreeTime)
+			for (int i = 0; i < 8; ++i)
+				threads.push(0);
+
+		double now = 0;
+		int started = 0;
+		while (started < taskCount || !running.empty())
+		{
+			while (started < taskCount && static_cast<int>(running.size()) < parallelism)
+			{
+				const size_t index = balancer.FindFreeClient(g_tool);
+				if (index == g_noIndex)
+					return 0;
+				const double duration = (1.0 + (started % 5) * 0.25) / speeds[index];
+				const double start = std::max(now, threadsFreeTime[index].top());
+				threadsFreeTime[index].pop();
+				threadsFreeTime[index].push(start + duration);
+				balancer.StartTask(index, g_tool);
+				running.push(Finish{start + duration, index, duration});
+				started++;
+			}
+			const Finish finished = running.top();
+			running.pop();
+			now = finished.m_time;
+			balancer.FinishTask(finished.m_index, g_tool);
+			if (observeSpeed)
+			{
+				TimePoint executionTime;
+				executionTime.SetUS(static_cast<int64_t>(finished.m_duration * TimePoint::ONE_SECOND) + 1);
+				balancer.UpdateObservedSpeed(finished.m_index, 0, executionTime);
+			}
+		}
+		return now;
+	}
+
+	/// Simulates many clients sharing many servers, coordinator broadcasts server load periodically.
+	/// Each client uses working set of given size (0 = all servers). Returns mean queue wait in task durations.
+	double SimulateFanOut(size_t workingSetSize, size_t & maxConnections)
+	{
+		using namespace Wuild;
+		const size_t serverCount = 40, clientCount = 40;
+		const uint16_t threads = 8;
+		const int parallelism = 6, tasksPerClient = 60;
+		const double broadcastInterval = 0.25, refreshInterval = 5.0;
+
+		std::vector<std::unique_ptr<ToolBalancer>> clients;
+		for (size_t c = 0; c < clientCount; ++c)
+		{
+			clients.emplace_back(new ToolBalancer());
+			ToolBalancer & balancer = *clients.back();
+			balancer.SetSessionId(c + 1);
+			balancer.SetWorkingSetSize(workingSetSize);
+			for (size_t s = 0; s < serverCount; ++s)
+			{
+				ToolServerInfo info;
+				info.m_toolIds = StringVector(1, g_tool);
+				info.m_totalThreads = threads;
+				info.m_toolServerId = "server" + std::to_string(s);
+				size_t index = 0;
+				balancer.UpdateClient(info, index);
+			}
+		}
+		// connects servers in working set: simulated connection is established immediately.
+		maxConnections = 0;
+		auto updateWorkingSets = [&](bool replaceWorst) {
+			size_t connections = 0;
+			for (auto & balancer : clients)
+			{
+				std::vector<size_t> added, removed;
+				balancer->UpdateWorkingSet(replaceWorst, added, removed);
+				for (size_t s = 0; s < serverCount; ++s)
+				{
+					if (balancer->IsInWorkingSet(s))
+					{
+						balancer->SetClientActive(s, true);
+						connections++;
+					}
+				}
+			}
+			maxConnections = std::max(maxConnections, connections);
+		};
+		updateWorkingSets(false);
+
+		struct Finish
+		{
+			double m_time;
+			size_t m_client;
+			size_t m_server;
+			bool operator > (const Finish & rh) const { return m_time > rh.m_time; }
+		};
+		std::priority_queue<Finish, std::vector<Finish>, std::greater<Finish>> running;
+		using TimeQueue = std::priority_queue<double, std::vector<double>, std::greater<double>>;
+		std::vector<TimeQueue> threadsFreeTime(serverCount);
+		for (auto & serverThreads : threadsFreeTime)
+			for (int i = 0; i < threads; ++i)
+				serverThreads.push(0);
+		std::vector<std::vector<uint16_t>> usage(serverCount, std::vector<uint16_t>(clientCount)); // server => client => tasks.
+		std::vector<int> inFlight(clientCount), started(clientCount);
+
+		double now = 0, nextBroadcast = 0, nextRefresh = refreshInterval, totalWait = 0;
+		int totalTasks = 0;
+		while (true)
+		{
+			for (size_t c = 0; c < clientCount; ++c)
+			{
+				while (started[c] < tasksPerClient && inFlight[c] < parallelism)
+				{
+					const size_t s = clients[c]->FindFreeClient(g_tool);
+					if (s == g_noIndex)
+						return -1;
+					const double duration = 1.0 + ((started[c] * 7 + c) % 5) * 0.1;
+					const double start = std::max(now, threadsFreeTime[s].top());
+					threadsFreeTime[s].pop();
+					threadsFreeTime[s].push(start + duration);
+					totalWait += start - now;
+					totalTasks++;
+					clients[c]->StartTask(s, g_tool);
+					usage[s][c]++;
+					running.push(Finish{start + duration, c, s});
+					inFlight[c]++;
+					started[c]++;
+				}
+			}
+			if (running.empty())
+				break;
+
+			if (nextBroadcast <= running.top().m_time)
+			{
+				now = nextBroadcast;
+				nextBroadcast += broadcastInterval;
+				for (size_t s = 0; s < serverCount; ++s)
+				{
+					ToolServerInfo info;
+					info.m_toolIds = StringVector(1, g_tool);
+					info.m_totalThreads = threads;
+					info.m_toolServerId = "server" + std::to_string(s);
+					for (size_t c = 0; c < clientCount; ++c)
+					{
+						if (!usage[s][c])
+							continue;
+						ToolServerInfo::ConnectedClientInfo client;
+						client.m_sessionId = c + 1;
+						client.m_usedThreads = usage[s][c];
+						info.m_connectedClients.push_back(client);
+					}
+					size_t index = 0;
+					for (auto & balancer : clients)
+						balancer->UpdateClient(info, index);
+				}
+				if (workingSetSize && now >= nextRefresh)
+				{
+					nextRefresh += refreshInterval;
+					updateWorkingSets(true);
+				}
+				continue;
+			}
+			const Finish finished = running.top();
+			running.pop();
+			now = finished.m_time;
+			clients[finished.m_client]->FinishTask(finished.m_server, g_tool);
+			usage[finished.m_server][finished.m_client]--;
+			inFlight[finished.m_client]--;
+		}
+		return totalWait / totalTasks;
+	}
+
+	/// Simulates many clients starting build at once on few servers, while coordinator information is stale.
+	/// Task which can not be sent remotely runs locally (slower). With leases, coordinator grants slots to each client.
+	/// Returns mean wait in server queue; makespan is the time when last client finished.
+	double SimulateLeases(bool useLeases, double & makespan)
+	{
+		using namespace Wuild;
+		const size_t serverCount = 4, clientCount = 10;
+		const uint16_t threads = 8;
+		const int parallelism = 8, tasksPerClient = 24;
+		const double remoteDuration = 1.0, localDuration = 1.5;
+		const double broadcastInterval = 0.5, leaseInterval = 0.2;
+
+		std::deque<ToolServerInfo> toolServers;
+		for (size_t s = 0; s < serverCount; ++s)
+		{
+			ToolServerInfo info;
+			info.m_toolIds = StringVector(1, g_tool);
+			info.m_totalThreads = threads;
+			info.m_toolServerId = "server" + std::to_string(s);
+			info.m_connectionHost = "host" + std::to_string(s);
+			toolServers.push_back(info);
+		}
+		std::vector<std::unique_ptr<ToolBalancer>> clients;
+		for (size_t c = 0; c < clientCount; ++c)
+		{
+			clients.emplace_back(new ToolBalancer());
+			clients.back()->SetSessionId(c + 1);
+			for (const auto & info : toolServers)
+			{
+				size_t index = 0;
+				clients.back()->UpdateClient(info, index);
+				clients.back()->SetClientActive(index, true);
+			}
+		}
+		LeaseManager leases;
+
+		struct Finish
+		{
+			double m_time;
+			size_t m_client;
+			size_t m_server;  //!< g_noIndex for local task.
+			bool operator > (const Finish & rh) const { return m_time > rh.m_time; }
+		};
+		std::priority_queue<Finish, std::vector<Finish>, std::greater<Finish>> running;
+		using TimeQueue = std::priority_queue<double, std::vector<double>, std::greater<double>>;
+		std::vector<TimeQueue> threadsFreeTime(serverCount);
+		for (auto & serverThreads : threadsFreeTime)
+			for (int i = 0; i < threads; ++i)
+				serverThreads.push(0);
+		std::vector<std::vector<uint16_t>> usage(serverCount, std::vector<uint16_t>(clientCount));
+		std::vector<int> inFlight(clientCount), started(clientCount), inFlightRemote(clientCount);
+
+		double now = 0, nextBroadcast = broadcastInterval, nextLease = 0, totalWait = 0;
+		int remoteTasks = 0;
+		makespan = 0;
+		while (true)
+		{
+			if (useLeases && nextLease <= now)
+			{
+				nextLease += leaseInterval;
+				for (size_t c = 0; c < clientCount; ++c)
+				{
+					const int demand = std::min(parallelism, tasksPerClient - started[c] + inFlight[c]);
+					std::vector<size_t> added;
+					clients[c]->SetLeases(leases.Acquire(toolServers, c + 1, static_cast<uint16_t>(demand), static_cast<uint16_t>(inFlightRemote[c]), {g_tool}, {}, TimePoint(now)), added);
+				}
+			}
+			for (size_t c = 0; c < clientCount; ++c)
+			{
+				while (started[c] < tasksPerClient && inFlight[c] < parallelism)
+				{
+					const size_t s = clients[c]->GetFreeThreads() > 0 ? clients[c]->FindFreeClient(g_tool) : g_noIndex;
+					if (s == g_noIndex)
+					{
+						running.push(Finish{now + localDuration, c, g_noIndex});
+					}
+					else
+					{
+						const double start = std::max(now, threadsFreeTime[s].top());
+						threadsFreeTime[s].pop();
+						threadsFreeTime[s].push(start + remoteDuration);
+						totalWait += start - now;
+						remoteTasks++;
+						clients[c]->StartTask(s, g_tool);
+						usage[s][c]++;
+						inFlightRemote[c]++;
+						running.push(Finish{start + remoteDuration, c, s});
+					}
+					inFlight[c]++;
+					started[c]++;
+				}
+			}
+			if (running.empty())
+				break;
+
+			const double nextTick = useLeases ? std::min(nextBroadcast, nextLease) : nextBroadcast;
+			if (nextTick <= running.top().m_time)
+			{
+				now = nextTick;
+				if (nextBroadcast > now)
+					continue;
+				nextBroadcast += broadcastInterval;
+				for (size_t s = 0; s < serverCount; ++s)
+				{
+					ToolServerInfo info = toolServers[s];
+					for (size_t c = 0; c < clientCount; ++c)
+					{
+						if (!usage[s][c])
+							continue;
+						ToolServerInfo::ConnectedClientInfo client;
+						client.m_sessionId = c + 1;
+						client.m_usedThreads = usage[s][c];
+						info.m_connectedClients.push_back(client);
+					}
+					size_t index = 0;
+					for (auto & balancer : clients)
+						balancer->UpdateClient(info, index);
+				}
+				continue;
+			}
+			const Finish finished = running.top();
+			running.pop();
+			now = finished.m_time;
+			makespan = std::max(makespan, now);
+			if (finished.m_server != g_noIndex)
+			{
+				clients[finished.m_client]->FinishTask(finished.m_server, g_tool);
+				usage[finished.m_server][finished.m_client]--;
+				inFlightRemote[finished.m_client]--;
+			}
+			inFlight[finished.m_client]--;
+		}
+		return remoteTasks ? totalWait / remoteTasks : 0.;
+	}
 }
 
 /*
@@ -86,6 +424,131 @@ int main(int argc, char ** argv)
 	balancer.StartTask(index);
 	TEST_ASSERT((balancer.TestGetBusy() == LoadVector{3, 3}));
 
+	// per-tool slots: heavy tool is capped, light tool may use whole server.
+	ToolBalancer toolBalancer;
+	toolBalancer.SetSessionId(1);
+	ToolServerInfo limited;
+	limited.m_toolIds = StringVector{g_tool, g_heavyTool};
+	limited.m_totalThreads = 4;
+	limited.m_toolServerId = "limited";
+	limited.m_toolSlots.resize(1);
+	limited.m_toolSlots[0].m_toolId = g_heavyTool;
+	limited.m_toolSlots[0].m_totalThreads = 1;
+	toolBalancer.UpdateClient(limited, index);
+	toolBalancer.SetClientActive(index, true);
+
+	index = toolBalancer.FindFreeClient(g_heavyTool);
+	TEST_ASSERT(index == 0);
+	toolBalancer.StartTask(index, g_heavyTool);
+	TEST_ASSERT(toolBalancer.FindFreeClient(g_heavyTool) == g_noIndex);
+	for (int i = 0; i < 3; ++i)
+	{
+		index = toolBalancer.FindFreeClient(g_tool);
+		TEST_ASSERT(index == 0);
+		toolBalancer.StartTask(index, g_tool);
+	}
+	toolBalancer.FinishTask(0, g_heavyTool);
+	TEST_ASSERT(toolBalancer.FindFreeClient(g_heavyTool) == 0);
+
+	limited.m_toolSlots[0].m_runningTasks = 1; // slot is used by another client.
+	toolBalancer.UpdateClient(limited, index);
+	TEST_ASSERT(toolBalancer.FindFreeClient(g_heavyTool) == g_noIndex);
+
+	// load reported by server itself is used before coordinator knows about it.
+	ToolBalancer loadBalancer;
+	loadBalancer.SetSessionId(1);
+	info1.m_connectedClients.clear();
+	info2.m_connectedClients.clear();
+	loadBalancer.UpdateClient(info1, index);
+	loadBalancer.UpdateClient(info2, index);
+	loadBalancer.SetClientActive(0, true);
+	loadBalancer.SetClientActive(1, true);
+	ToolServerLoad serverLoad;
+	serverLoad.m_runningTasks = 10;
+	serverLoad.m_queuedTasks = 2;
+	loadBalancer.SetServerLoad(0, serverLoad);
+	TEST_ASSERT((loadBalancer.TestGetBusy() == LoadVector{10, 0}));
+	TEST_ASSERT(loadBalancer.GetFreeThreads() == 8);
+	TEST_ASSERT(loadBalancer.FindFreeClient(g_tool) == 1);
+	loadBalancer.SetServerLoad(0, ToolServerLoad());
+	TEST_ASSERT(loadBalancer.GetFreeThreads() == 16);
+
+	// failing server is excluded after few errors; late results of tasks sent before do not restore it.
+	TEST_ASSERT(!loadBalancer.ReportTaskOutcome(0, ToolBalancer::TaskOutcome::Timeout));
+	TEST_ASSERT(!loadBalancer.ReportTaskOutcome(0, ToolBalancer::TaskOutcome::Error));
+	TEST_ASSERT(loadBalancer.ReportTaskOutcome(0, ToolBalancer::TaskOutcome::Timeout));
+	TEST_ASSERT(loadBalancer.IsClientTripped(0) && loadBalancer.IsCircuitOpen(0));
+	TEST_ASSERT(loadBalancer.FindFreeClient(g_tool) == 1);
+	TEST_ASSERT(loadBalancer.GetFreeThreads() == 8);
+	TEST_ASSERT(!loadBalancer.ReportTaskOutcome(0, ToolBalancer::TaskOutcome::Success));
+	TEST_ASSERT(loadBalancer.IsCircuitOpen(0));
+	TEST_ASSERT(!loadBalancer.ReportTaskOutcome(1, ToolBalancer::TaskOutcome::Slow));
+	TEST_ASSERT(!loadBalancer.IsClientTripped(1));
+
+	// server reported by other sessions through coordinator is avoided too.
+	ToolBalancer reportedBalancer;
+	info1.m_unhealthyReports = 1;
+	reportedBalancer.UpdateClient(info1, index);
+	reportedBalancer.UpdateClient(info2, index);
+	reportedBalancer.SetClientActive(0, true);
+	reportedBalancer.SetClientActive(1, true);
+	TEST_ASSERT(reportedBalancer.IsCircuitOpen(0));
+	TEST_ASSERT(reportedBalancer.FindFreeClient(g_tool) == 1);
+	info1.m_unhealthyReports = 0;
+
+	// server with another compiler version is not used for that tool only, and is not leased.
+	ToolBalancer versionBalancer;
+	versionBalancer.SetRequiredTools({g_tool});
+	versionBalancer.SetToolVersions({{g_tool, "7.1"}});
+	info1.m_toolVersions = {{g_tool, "6.3"}};
+	versionBalancer.UpdateClient(info1, index);
+	versionBalancer.UpdateClient(info2, index);
+	versionBalancer.SetClientActive(0, true);
+	versionBalancer.SetClientActive(1, true);
+	TEST_ASSERT(!versionBalancer.IsToolCompatible(0, g_tool));
+	TEST_ASSERT(versionBalancer.FindFreeClient(g_tool) == 1);
+	TEST_ASSERT(versionBalancer.GetFreeThreads() == 8);
+	versionBalancer.SetServerToolVersions(1, {{g_tool, "6.3"}});
+	TEST_ASSERT(versionBalancer.FindFreeClient(g_tool) == g_noIndex);
+	TEST_ASSERT(versionBalancer.GetFreeThreads() == 0);
+	versionBalancer.SetServerToolVersions(0, {{g_tool, "7.1"}});
+	TEST_ASSERT(versionBalancer.FindFreeClient(g_tool) == 0);
+
+	LeaseManager versionLeases;
+	const auto compatibleLeases = versionLeases.Acquire({info1, info2}, 1, 16, 0, {g_tool}, {{g_tool, "7.1"}});
+	TEST_ASSERT(compatibleLeases.size() == 1 && compatibleLeases[0].m_toolServerId == info2.m_toolServerId);
+	TEST_ASSERT(compatibleLeases[0].m_slots == 8);
+	info1.m_toolVersions.clear();
+
+	// heterogeneous servers: fast machine should not be left idle while slow ones hold the tail.
+	const double occupancyMakespan = SimulateMakespan(false, false);
+	const double advertisedMakespan = SimulateMakespan(true, false);
+	const double observedMakespan = SimulateMakespan(false, true);
+	std::cout << "makespan: by occupancy=" << occupancyMakespan << ", by speed score=" << advertisedMakespan
+			  << ", by observed speed=" << observedMakespan << "\n";
+	TEST_ASSERT(occupancyMakespan > 0 && advertisedMakespan > 0 && observedMakespan > 0);
+	TEST_ASSERT(advertisedMakespan < occupancyMakespan);
+	TEST_ASSERT(observedMakespan < occupancyMakespan);
+
+	// bounded working set: balance should stay close to full fan-out with fraction of connections.
+	size_t fullConnections = 0, boundedConnections = 0;
+	const double fullWait = SimulateFanOut(0, fullConnections);
+	const double boundedWait = SimulateFanOut(6, boundedConnections);
+	std::cout << "mean queue wait: all servers=" << fullWait << " (" << fullConnections << " connections), "
+			  << "working set=" << boundedWait << " (" << boundedConnections << " connections)\n";
+	TEST_ASSERT(fullWait >= 0 && boundedWait >= 0);
+	TEST_ASSERT(boundedConnections * 5 < fullConnections);
+	TEST_ASSERT(boundedWait < fullWait + 0.1);
+
+	// simultaneous builds: leases should prevent piling up on servers, without making build longer.
+	double optimisticMakespan = 0, leasesMakespan = 0;
+	const double optimisticWait = SimulateLeases(false, optimisticMakespan);
+	const double leasesWait = SimulateLeases(true, leasesMakespan);
+	std::cout << "server queue wait: optimistic=" << optimisticWait << " (makespan " << optimisticMakespan << "), "
+			  << "leases=" << leasesWait << " (makespan " << leasesMakespan << ")\n";
+	TEST_ASSERT(leasesWait * 2 < optimisticWait);
+	TEST_ASSERT(leasesMakespan <= optimisticMakespan * 1.1);
+
 	std::cout << "OK\n";
 	return 0;
 }
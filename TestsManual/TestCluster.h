@@ -0,0 +1,204 @@
+/*
+ * Copyright (C) 2017 Smirnov Vladimir mapron1@gmail.com
+ * Source code licensed under the Apache License, Version 2.0 (the "License");
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at http://www.apache.org/licenses/LICENSE-2.0 or in file COPYING-APACHE-2.0.txt
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.h
+ */
+
+#pragma once
+#include "TestUtils.h"
+
+#include <RemoteToolServer.h>
+#include <RemoteToolClient.h>
+
+#include <condition_variable>
+#include <deque>
+#include <thread>
+
+/// Helpers for in-process cluster of tool servers and clients, without real tools.
+namespace Wuild
+{
+
+const std::string g_testTool = "testTool";
+
+/// Executor with real worker threads, each task just sleeps.
+class SleepingExecutor : public ILocalExecutor
+{
+public:
+	SleepingExecutor(int workers, int64_t taskDurationUS) : m_taskDurationUS(taskDurationUS)
+	{
+		for (int i = 0; i < workers; ++i)
+			m_workers.emplace_back(&SleepingExecutor::Work, this);
+	}
+	~SleepingExecutor()
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_stop = true;
+		}
+		m_cond.notify_all();
+		for (auto & worker : m_workers)
+			worker.join();
+	}
+	void AddTask(LocalExecutorTask::Ptr task) override
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_queue.push_back(task);
+		m_cond.notify_one();
+	}
+	void SyncExecTask(LocalExecutorTask::Ptr) override
+	{
+		assert(!"Not implemented for test.");
+	}
+	size_t GetQueueSize() const override
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		return m_queue.size();
+	}
+	TaskPair SplitTask(LocalExecutorTask::Ptr , std::string & ) override
+	{
+		return TaskPair();
+	}
+	StringVector GetToolIds() const  override
+	{
+		return StringVector({g_testTool});
+	}
+	void SetThreadCount(int) override {}
+	void SetToolThreadCount(const std::string &, int) override {}
+
+private:
+	void Work()
+	{
+		while (true)
+		{
+			LocalExecutorTask::Ptr task;
+			{
+				std::unique_lock<std::mutex> lock(m_mutex);
+				m_cond.wait(lock, [this]{ return m_stop || !m_queue.empty(); });
+				if (m_stop)
+					return;
+				task = m_queue.front();
+				m_queue.pop_front();
+			}
+			TimePoint start(true);
+			std::this_thread::sleep_for(std::chrono::microseconds(m_taskDurationUS));
+			LocalExecutorResult::Ptr res(new LocalExecutorResult("", true));
+			res->m_executionTime = start.GetElapsedTime();
+			task->m_callback(res);
+		}
+	}
+
+	const int64_t m_taskDurationUS;
+	mutable std::mutex m_mutex;
+	std::condition_variable m_cond;
+	std::deque<LocalExecutorTask::Ptr> m_queue;
+	std::vector<std::thread> m_workers;
+	bool m_stop = false;
+};
+
+/// Emulates build system: keeps up to maxInFlight tasks running through client.
+class BuildEmulator
+{
+public:
+	BuildEmulator(RemoteToolClient & client, int maxInFlight) : m_client(client), m_maxInFlight(maxInFlight) {}
+
+	/// Runs taskCount tasks, or until Stop() if taskCount is negative.
+	void Run(int taskCount)
+	{
+		auto callback = [this](const RemoteToolClient::TaskExecutionInfo & info) {
+			std::lock_guard<std::mutex> lock(m_mutex);
+			if (!info.m_result)
+				m_failed++;
+			m_waitTimes.push_back((info.m_networkRequestTime - info.m_toolExecutionTime).GetUS());
+			m_inFlight--;
+			m_cond.notify_all();
+		};
+		for (int i = 0; taskCount < 0 || i < taskCount; ++i)
+		{
+			{
+				std::unique_lock<std::mutex> lock(m_mutex);
+				m_cond.wait(lock, [this]{ return m_stop || m_inFlight < m_maxInFlight; });
+				if (m_stop)
+					break;
+				m_inFlight++;
+			}
+			m_client.InvokeTool(ToolInvocation().SetId(g_testTool), callback);
+		}
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_cond.wait(lock, [this]{ return m_inFlight == 0; });
+	}
+	void Stop()
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stop = true;
+		m_cond.notify_all();
+	}
+
+	std::vector<int64_t> m_waitTimes;
+	int m_failed = 0;
+
+private:
+	RemoteToolClient & m_client;
+	const int m_maxInFlight;
+	int m_inFlight = 0;
+	bool m_stop = false;
+	std::mutex m_mutex;
+	std::condition_variable m_cond;
+};
+
+/// Starts tool server with SleepingExecutor on localhost, fills info for clients.
+inline std::unique_ptr<RemoteToolServer> StartTestServer(int port, int threads, int64_t taskDurationUS, int maxQueueSize, ToolServerInfo & info)
+{
+	RemoteToolServer::Config config;
+	config.m_coordinator.m_enabled = false;
+	config.m_listenHost = "localhost";
+	config.m_listenPort = port;
+	config.m_threadCount = threads;
+	config.m_maxQueueSize = maxQueueSize;
+	config.m_serverName = "server" + std::to_string(config.m_listenPort);
+
+	std::unique_ptr<RemoteToolServer> server(new RemoteToolServer(ILocalExecutor::Ptr(new SleepingExecutor(threads, taskDurationUS)), {}));
+	if (!server->SetConfig(config))
+		return nullptr;
+	server->Start();
+
+	info.m_toolServerId = config.m_serverName;
+	info.m_connectionHost = config.m_listenHost;
+	info.m_connectionPort = static_cast<int16_t>(config.m_listenPort);
+	info.m_totalThreads = static_cast<uint16_t>(threads);
+	info.m_toolIds = StringVector{g_testTool};
+	return server;
+}
+
+/// Connects client to servers without coordinator and waits until they are available.
+inline bool StartClient(RemoteToolClient & client, const std::vector<ToolServerInfo> & infos, RemoteToolClient::Config clientConfig = RemoteToolClient::Config())
+{
+	clientConfig.m_coordinator.m_enabled = false;
+	clientConfig.m_queueTimeout = TimePoint(10.0);
+	clientConfig.m_requestTimeout = TimePoint(10.0);
+	if (!client.SetConfig(clientConfig))
+		return false;
+	for (const auto & info : infos)
+		client.AddClient(info);
+	client.Start({g_testTool});
+
+	TimePoint connectStart(true);
+	while (client.GetFreeRemoteThreads() <= 0)
+	{
+		if (connectStart.GetElapsedTime() > TimePoint(5.0))
+		{
+			Syslogger(Syslogger::Err) << "Failed to connect to tool servers.";
+			return false;
+		}
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+	}
+	return true;
+}
+
+}
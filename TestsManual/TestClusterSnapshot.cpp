@@ -0,0 +1,181 @@
+/*
+ * Copyright (C) 2018 Smirnov Vladimir mapron1@gmail.com
+ * Source code licensed under the Apache License, Version 2.0 (the "License");
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at http://www.apache.org/licenses/LICENSE-2.0 or in file COPYING-APACHE-2.0.txt
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.h
+ */
+
+#include "TestCluster.h"
+
+#include <CoordinatorServer.h>
+#include <CoordinatorClient.h>
+
+using namespace Wuild;
+
+const int g_coordinatorPort = 12440;
+const int g_serverPort = 12441;
+const int g_bigServerThreads = 4;
+const int g_smallServerThreads = 2;
+
+std::unique_ptr<CoordinatorServer> StartCoordinator()
+{
+	CoordinatorServer::Config config;
+	config.m_listenPort = g_coordinatorPort;
+	std::unique_ptr<CoordinatorServer> server(new CoordinatorServer());
+	if (!server->SetConfig(config))
+		return nullptr;
+	server->Start();
+	return server;
+}
+
+/// Registers tool server on coordinator, as tool server itself does.
+std::unique_ptr<CoordinatorClient> RegisterToolServer(const ToolServerInfo & info)
+{
+	CoordinatorClient::Config config;
+	config.m_coordinatorHost = StringVector{"localhost"};
+	config.m_coordinatorPort = g_coordinatorPort;
+	config.m_sendInfoInterval = TimePoint(0.1);
+
+	std::unique_ptr<CoordinatorClient> client(new CoordinatorClient());
+	if (!client->SetConfig(config))
+		return nullptr;
+	client->SetToolServerInfo(info);
+	client->Start();
+	return client;
+}
+
+/// Starts client using coordinator and snapshot, waits until free threads are expected number.
+bool StartClient(RemoteToolClient & client, const std::string & snapshotFile, int expectedThreads, TimePoint & connectTime)
+{
+	RemoteToolClient::Config clientConfig;
+	clientConfig.m_coordinator.m_coordinatorHost = StringVector{"localhost"};
+	clientConfig.m_coordinator.m_coordinatorPort = g_coordinatorPort;
+	clientConfig.m_coordinator.m_redundance = CoordinatorClientConfig::Redundance::Any;
+	clientConfig.m_clusterSnapshotFile = snapshotFile;
+	clientConfig.m_queueTimeout = TimePoint(10.0);
+	clientConfig.m_requestTimeout = TimePoint(10.0);
+	if (!client.SetConfig(clientConfig))
+		return false;
+
+	TimePoint start(true);
+	client.Start({g_testTool});
+	while (client.GetFreeRemoteThreads() != expectedThreads)
+	{
+		if (start.GetElapsedTime() > TimePoint(5.0))
+		{
+			Syslogger(Syslogger::Err) << "Free threads: " << client.GetFreeRemoteThreads() << ", expected: " << expectedThreads;
+			return false;
+		}
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+	}
+	connectTime = start.GetElapsedTime();
+	return true;
+}
+
+bool RunTasks(RemoteToolClient & client)
+{
+	BuildEmulator build(client, g_bigServerThreads);
+	build.Run(20);
+	client.FinishSession();
+	return build.m_failed == 0;
+}
+
+/*
+ * Autotest for cluster snapshot: client saves servers list from coordinator, then uses it while coordinator is down;
+ * when coordinator answers again, servers it does not know are dropped. Arguments not required.
+ */
+int main(int argc, char** argv)
+{
+	ConfiguredApplication app(argc, argv, "TestClusterSnapshot");
+	if (!CreateInvocationRewriter(app, true))
+		return 1;
+
+	const std::string snapshotFile = app.m_tempDir + "/TestClusterSnapshot.bin";
+	FileInfo(snapshotFile).Remove();
+
+	ToolServerInfo bigInfo, smallInfo;
+	auto bigServer = StartTestServer(g_serverPort, g_bigServerThreads, 10000, 0, bigInfo);
+	auto smallServer = StartTestServer(g_serverPort + 1, g_smallServerThreads, 10000, 0, smallInfo);
+	TEST_ASSERT(bigServer && smallServer);
+
+	TimePoint connectTime;
+	{
+		auto coordinator = StartCoordinator();
+		auto bigRegistration = RegisterToolServer(bigInfo);
+		auto smallRegistration = RegisterToolServer(smallInfo);
+		TEST_ASSERT(coordinator && bigRegistration && smallRegistration);
+
+		RemoteToolClient client(TestConfiguration::s_invocationRewriter, {});
+		TEST_ASSERT(StartClient(client, snapshotFile, g_bigServerThreads + g_smallServerThreads, connectTime));
+		Syslogger(Syslogger::Notice) << "with coordinator: connected in " << connectTime.ToProfilingTime();
+		TEST_ASSERT(RunTasks(client));
+	}
+	TEST_ASSERT(FileInfo(snapshotFile).Exists());
+
+	// coordinator is down: servers are known only from snapshot.
+	{
+		RemoteToolClient client(TestConfiguration::s_invocationRewriter, {});
+		TEST_ASSERT(StartClient(client, snapshotFile, g_bigServerThreads + g_smallServerThreads, connectTime));
+		Syslogger(Syslogger::Notice) << "coordinator is down: connected in " << connectTime.ToProfilingTime();
+		TEST_ASSERT(RunTasks(client));
+	}
+
+	// coordinator appears while build is running and knows only one server; other one is dropped with tasks on it.
+	{
+		const std::string staleSnapshotFile = snapshotFile + ".stale";
+		ByteArrayHolder snapshotData;
+		TEST_ASSERT(FileInfo(snapshotFile).ReadFile(snapshotData) && FileInfo(staleSnapshotFile).WriteFile(snapshotData));
+
+		RemoteToolClient client(TestConfiguration::s_invocationRewriter, {});
+		TEST_ASSERT(StartClient(client, staleSnapshotFile, g_bigServerThreads + g_smallServerThreads, connectTime));
+		BuildEmulator build(client, g_bigServerThreads + g_smallServerThreads);
+		std::thread buildThread([&build]{ build.Run(-1); });
+		std::this_thread::sleep_for(std::chrono::milliseconds(200));
+		auto coordinator = StartCoordinator();
+		auto bigRegistration = RegisterToolServer(bigInfo);
+		// snapshot is saved just before stale server is removed.
+		TimePoint removeStart(true);
+		ByteArrayHolder currentData;
+		while (removeStart.GetElapsedTime() < TimePoint(10.0)
+			   && (!FileInfo(staleSnapshotFile).ReadFile(currentData) || currentData.ref() == snapshotData.ref()))
+			std::this_thread::sleep_for(std::chrono::milliseconds(10));
+		std::this_thread::sleep_for(std::chrono::milliseconds(300));
+		build.Stop();
+		buildThread.join();
+		TimePoint finishStart(true);
+		while (client.GetFreeRemoteThreads() != g_bigServerThreads && finishStart.GetElapsedTime() < TimePoint(5.0))
+			std::this_thread::sleep_for(std::chrono::milliseconds(10));
+		const int freeThreads = client.GetFreeRemoteThreads();
+		Syslogger(Syslogger::Notice) << "stale server dropped during build, free threads: " << freeThreads << ", failed tasks: " << build.m_failed;
+		client.FinishSession();
+		FileInfo(staleSnapshotFile).Remove();
+		TEST_ASSERT(coordinator && bigRegistration);
+		TEST_ASSERT(removeStart.GetElapsedTime() < TimePoint(10.0));
+		TEST_ASSERT(freeThreads == g_bigServerThreads);
+		TEST_ASSERT(build.m_failed == 0);
+	}
+
+	// coordinator knows only one server now; other one from snapshot is dropped.
+	{
+		auto coordinator = StartCoordinator();
+		auto bigRegistration = RegisterToolServer(bigInfo);
+		TEST_ASSERT(coordinator && bigRegistration);
+
+		RemoteToolClient client(TestConfiguration::s_invocationRewriter, {});
+		TEST_ASSERT(StartClient(client, snapshotFile, g_bigServerThreads, connectTime));
+		std::this_thread::sleep_for(std::chrono::seconds(1));
+		TEST_ASSERT(client.GetFreeRemoteThreads() == g_bigServerThreads);
+		Syslogger(Syslogger::Notice) << "reconciled in " << connectTime.ToProfilingTime();
+		TEST_ASSERT(RunTasks(client));
+	}
+
+	FileInfo(snapshotFile).Remove();
+	std::cout << "OK\n";
+	return 0;
+}
@@ -52,6 +52,7 @@ public:
 		return StringVector({g_testTool, g_testTool2});
 	}
 	void SetThreadCount(int) override {}
+	void SetToolThreadCount(const std::string &, int) override {}
 };
 
 const int g_toolsServerTestPort = 12345;
@@ -95,6 +96,10 @@ int main(int argc, char** argv)
 	clientConfig.m_minimalRemoteTasks = 1;
 	clientConfig.m_queueTimeout = TimePoint(2.0);
 	clientConfig.m_requestTimeout = TimePoint(1.0);
+
+	// same scenario is run by client with slot leases, when client without them is finished.
+	RemoteToolClient::Config leaseClientConfig = clientConfig;
+	leaseClientConfig.m_useSlotLeases = true;
 	
 	const auto toolsVersions = VersionChecker::Create(executor, TestConfiguration::s_invocationRewriter)->DetermineToolVersions({});
 
@@ -106,6 +111,10 @@ int main(int argc, char** argv)
 	if (!rcClient.SetConfig(clientConfig))
 		return 1;
 
+	RemoteToolClient rcLeaseClient(TestConfiguration::s_invocationRewriter, toolsVersions);
+	if (!rcLeaseClient.SetConfig(leaseClientConfig))
+		return 1;
+
 	CoordinatorServer coordServer;
 	if (!coordServer.SetConfig(coordServerConfig))
 		return 1;
@@ -115,22 +124,23 @@ int main(int argc, char** argv)
 	coordServer.Start();
 
 	std::atomic_int totalFinished {0}, totalCount {0};
-	auto callback = [&totalFinished, &totalCount]( const RemoteToolClient::TaskExecutionInfo& info){
+	std::function<void(int)> finishRun;
+	auto callback = [&totalFinished, &totalCount, &finishRun]( const RemoteToolClient::TaskExecutionInfo& info){
 		if (!info.m_stdOutput.empty())
 			std::cout << info.m_stdOutput << std::endl << std::flush;
 
 		std::cout << info.GetProfilingStr() << " \n";
 		totalFinished++;
 		if (totalFinished == totalCount)
-		   Application::Interrupt(1 - info.m_result);
+		   finishRun(1 - info.m_result);
 	};
-	auto callbackFail = [&totalFinished, &totalCount]( const RemoteToolClient::TaskExecutionInfo& info){
+	auto callbackFail = [&totalFinished, &totalCount, &finishRun]( const RemoteToolClient::TaskExecutionInfo& info){
 		if (!info.m_stdOutput.empty())
 			std::cout << info.m_stdOutput << std::endl << std::flush;
 
 		totalFinished++;
 		if (totalFinished == totalCount)
-		   Application::Interrupt(0 + info.m_result);
+		   finishRun(0 + info.m_result);
 	};
 
 	TimePoint start(true);
@@ -139,6 +149,25 @@ int main(int argc, char** argv)
 		 totalCount++; rcClient.InvokeTool(ToolInvocation().SetId(g_testTool) , callback);
 		 totalCount++; rcClient.InvokeTool(ToolInvocation().SetId(g_testTool2), callbackFail);
 	});
+	rcLeaseClient.SetRemoteAvailableCallback([&start, &totalCount, &rcLeaseClient, &callback, &callbackFail]() {
+		 Syslogger(Syslogger::Info) <<  "Init lease client taken: " << start.GetElapsedTime().GetUS() << " us.";
+		 totalCount++; rcLeaseClient.InvokeTool(ToolInvocation().SetId(g_testTool) , callback);
+		 totalCount++; rcLeaseClient.InvokeTool(ToolInvocation().SetId(g_testTool2), callbackFail);
+	});
+
+	bool leaseRun = false;
+	finishRun = [&leaseRun, &totalFinished, &totalCount, &start, &rcLeaseClient](int code) {
+		if (code || leaseRun)
+		{
+			Application::Interrupt(code);
+			return;
+		}
+		leaseRun = true;
+		totalFinished = 0;
+		totalCount = 0;
+		start = TimePoint(true);
+		rcLeaseClient.Start();
+	};
 
 
 	return ExecAppLoop(TestConfiguration::ExitHandler);
@@ -0,0 +1,114 @@
+/*
+ * Copyright (C) 2018 Smirnov Vladimir mapron1@gmail.com
+ * Source code licensed under the Apache License, Version 2.0 (the "License");
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at http://www.apache.org/licenses/LICENSE-2.0 or in file COPYING-APACHE-2.0.txt
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.h
+ */
+
+#include "TestUtils.h"
+
+#include <ExecutionCostModel.h>
+
+#include <cmath>
+
+using namespace Wuild;
+using Choice = ExecutionCostModel::Choice;
+
+const size_t g_oneMiB = 1023 * 1024; // 1024 KiB with size correction.
+
+/// Estimate is within 10% of expected seconds.
+bool IsNear(const TimePoint & estimate, double expected)
+{
+	return std::abs(estimate.GetUS() - expected * TimePoint::ONE_SECOND) < expected * TimePoint::ONE_SECOND / 10;
+}
+
+ExecutionCostModel::Input MakeInput(size_t inputSize, int freeRemoteThreads, int freeLocalThreads, int localThreads = 1)
+{
+	ExecutionCostModel::Input input;
+	input.m_inputSize = inputSize;
+	input.m_freeRemoteThreads = freeRemoteThreads;
+	input.m_freeLocalThreads = freeLocalThreads;
+	input.m_localThreads = localThreads;
+	return input;
+}
+
+/*
+ * Autotest for local/remote/race decision of proxy.
+ */
+int main(int argc, char ** argv)
+{
+	ConfiguredApplication app(argc, argv, "TestCostModel");
+
+	// nothing measured yet: free remote thread decides.
+	{
+		ExecutionCostModel model;
+		TEST_ASSERT(model.Decide(MakeInput(g_oneMiB, 1, 1)).m_choice == Choice::Remote);
+		TEST_ASSERT(model.Decide(MakeInput(g_oneMiB, 0, 1)).m_choice == Choice::Local);
+		TEST_ASSERT(model.GetStatistics().empty());
+	}
+
+	// local is two times slower than remote, network overhead is 0.1s.
+	ExecutionCostModel model;
+	model.AddLocalResult(g_oneMiB, TimePoint(2.0));
+	model.AddRemoteResult(g_oneMiB, TimePoint(1.0), TimePoint(1.1), false);
+	model.AddRemoteResult(g_oneMiB, TimePoint(1.0), TimePoint(5.0), true); // queued, overhead is not learned.
+
+	// local is busy.
+	auto decision = model.Decide(MakeInput(g_oneMiB, 1, 0, 2));
+	TEST_ASSERT(decision.m_choice == Choice::Remote);
+	TEST_ASSERT(IsNear(decision.m_localCost, 3.0));
+	TEST_ASSERT(IsNear(decision.m_remoteCost, 1.1));
+	TEST_ASSERT(!decision.m_remoteQueued);
+
+	// tiny input: network overhead dominates, even with free remote thread.
+	TEST_ASSERT(model.Decide(MakeInput(100, 4, 1)).m_choice == Choice::Local);
+
+	// no free remote thread, but short queue is better than long local compilation.
+	auto input = MakeInput(15 * g_oneMiB, -3, 0);
+	input.m_remoteQueueWait = TimePoint(0.05);
+	decision = model.Decide(input);
+	TEST_ASSERT(decision.m_choice == Choice::Remote);
+	TEST_ASSERT(decision.m_remoteQueued);
+
+	// same with long remote queue.
+	input.m_remoteQueueWait = TimePoint(100.0);
+	TEST_ASSERT(model.Decide(input).m_choice == Choice::Local);
+
+	// known output: history prediction is for remote, local is scaled by speed ratio.
+	input = MakeInput(100, 1, 1);
+	input.m_predictedRemote = TimePoint(10.0);
+	decision = model.Decide(input);
+	TEST_ASSERT(decision.m_choice == Choice::Remote);
+	TEST_ASSERT(IsNear(decision.m_localCost, 20.0));
+
+	// both are idle and estimates are close: race, if allowed.
+	{
+		ExecutionCostModel raceModel;
+		raceModel.AddLocalResult(g_oneMiB, TimePoint(1.2));
+		raceModel.AddRemoteResult(g_oneMiB, TimePoint(1.0), TimePoint(1.1), false);
+		decision = raceModel.Decide(MakeInput(g_oneMiB, 1, 1));
+		TEST_ASSERT(decision.m_choice == Choice::Race);
+		TEST_ASSERT(raceModel.Decide(MakeInput(g_oneMiB, 0, 1)).m_choice != Choice::Race);
+		TEST_ASSERT(raceModel.Decide(MakeInput(g_oneMiB, 1, 0)).m_choice != Choice::Race);
+
+		ExecutionCostModel noRaceModel(false);
+		noRaceModel.AddLocalResult(g_oneMiB, TimePoint(1.2));
+		noRaceModel.AddRemoteResult(g_oneMiB, TimePoint(1.0), TimePoint(1.1), false);
+		TEST_ASSERT(noRaceModel.Decide(MakeInput(g_oneMiB, 1, 1)).m_choice == Choice::Remote);
+
+		raceModel.AddOutcome(decision, TimePoint(1.0), false);
+		const std::string stats = raceModel.GetStatistics();
+		Syslogger(Syslogger::Notice) << stats;
+		TEST_ASSERT(stats.find("race: 1 (local won: 0)") != std::string::npos);
+		TEST_ASSERT(stats.find("saved") != std::string::npos);
+	}
+
+	std::cout << "OK\n";
+	return 0;
+}
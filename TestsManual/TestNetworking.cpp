@@ -15,6 +15,8 @@
 
 #include <SocketFrameService.h>
 #include <ByteOrderStream.h>
+#include <TcpListener.h>
+#include <TcpSocket.h>
 #include <ThreadUtils.h>
 
 #include <memory>
@@ -100,6 +102,7 @@ const int segmentSize = 240;
 const int textRepeats = 100000;
 const int bufferSize = 128900;
 const int testServicePort = 12345;
+const int peerClosePort = 12346;
 const std::string testHost = "localhost";
 }
 
@@ -166,6 +169,46 @@ void TestService::start()
 		client->Start();
 }
 
+/// Data sent before close is read, then Read reports failure and socket is disconnected.
+int TestPeerClose()
+{
+	TcpListenerParams listenerParams;
+	listenerParams.m_endPoint.SetPoint(peerClosePort, testHost);
+	auto listener = TcpListener::Create(listenerParams);
+	TEST_ASSERT(listener->StartListen());
+
+	TcpConnectionParams clientParams;
+	clientParams.m_endPoint.SetPoint(peerClosePort, testHost);
+	clientParams.m_readTimeout = TimePoint(0.01);
+	auto client = TcpSocket::Create(clientParams);
+	TEST_ASSERT(client->Connect());
+
+	IDataSocket::Ptr peer;
+	for (int i = 0; i < 100 && !peer; ++i)
+	{
+		peer = listener->GetPendingConnection();
+		usleep(10000);
+	}
+	TEST_ASSERT(peer && peer->Connect());
+
+	ByteArrayHolder data;
+	data.ref() = {1, 2, 3};
+	TEST_ASSERT(peer->Write(data, data.size()) == IDataSocket::WriteState::Success);
+	peer->Disconnect();
+
+	ByteArrayHolder received;
+	IDataSocket::ReadState state = IDataSocket::ReadState::TryAgain;
+	for (int i = 0; i < 100 && state == IDataSocket::ReadState::TryAgain; ++i)
+		state = client->Read(received);
+	TEST_ASSERT(state == IDataSocket::ReadState::Success);
+	TEST_ASSERT(received.ref() == data.ref());
+
+	for (int i = 0; i < 100 && state != IDataSocket::ReadState::Fail; ++i)
+		state = client->Read(received);
+	TEST_ASSERT(state == IDataSocket::ReadState::Fail);
+	TEST_ASSERT(!client->IsConnected());
+	return 0;
+}
 
 /*
  * Test for network communication. Outputs "OK" on success.
@@ -185,6 +228,9 @@ int main(int argc, char** argv)
 	streamReader >> test;
 	assert(test == 42);
 
+	if (TestPeerClose())
+		return 1;
+
 	TestService service;
 	service.setServer(testServicePort);
 	usleep(100000);
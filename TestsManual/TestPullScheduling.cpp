@@ -0,0 +1,84 @@
+/*
+ * Copyright (C) 2017 Smirnov Vladimir mapron1@gmail.com
+ * Source code licensed under the Apache License, Version 2.0 (the "License");
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at http://www.apache.org/licenses/LICENSE-2.0 or in file COPYING-APACHE-2.0.txt
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.h
+ */
+
+#include "TestCluster.h"
+
+using namespace Wuild;
+
+const int g_taskCount = 100;
+const int g_serverThreads = 4;
+const int64_t g_fastTaskDurationUS = 100000;
+const int64_t g_slowTaskDurationUS = 200000;
+
+/// Runs g_taskCount tasks on fast and slow server, while fast server is also loaded by another client with large -j,
+/// which measured client does not know about. Both clients use same scheduling mode. Outputs build time.
+bool RunScenario(int basePort, bool usePull, TimePoint & makespan)
+{
+	std::vector<std::unique_ptr<RemoteToolServer>> servers;
+	std::vector<ToolServerInfo> infos(2);
+	servers.push_back(StartTestServer(basePort, g_serverThreads, g_fastTaskDurationUS, 0, infos[0]));
+	servers.push_back(StartTestServer(basePort + 1, g_serverThreads, g_slowTaskDurationUS, 0, infos[1]));
+	if (!servers[0] || !servers[1])
+		return false;
+
+	RemoteToolClient::Config clientConfig;
+	clientConfig.m_usePullScheduling = usePull;
+
+	RemoteToolClient neighbourClient(TestConfiguration::s_invocationRewriter, {});
+	if (!StartClient(neighbourClient, {infos[0]}, clientConfig))
+		return false;
+	BuildEmulator neighbour(neighbourClient, g_serverThreads * 8);
+	std::thread neighbourThread([&neighbour]{ neighbour.Run(-1); });
+
+	RemoteToolClient client(TestConfiguration::s_invocationRewriter, {});
+	bool started = StartClient(client, infos, clientConfig);
+	BuildEmulator build(client, g_serverThreads * 4);
+	TimePoint start(true);
+	if (started)
+		build.Run(g_taskCount);
+	makespan = start.GetElapsedTime();
+
+	neighbour.Stop();
+	neighbourThread.join();
+	client.FinishSession();
+	neighbourClient.FinishSession();
+	if (!started)
+		return false;
+
+	if (build.m_failed || neighbour.m_failed)
+	{
+		Syslogger(Syslogger::Err) << "Failed tasks: " << build.m_failed << ", neighbour: " << neighbour.m_failed;
+		return false;
+	}
+	Syslogger(Syslogger::Notice) << (usePull ? "pull" : "push") << " scheduling: makespan=" << makespan.GetUS() / 1000 << "ms"
+								 << ", neighbour tasks=" << neighbour.m_waitTimes.size();
+	return true;
+}
+
+/*
+ * Compares build time when tasks are pushed by client balancer and pulled by tool servers. Arguments not required.
+ */
+int main(int argc, char** argv)
+{
+	ConfiguredApplication app(argc, argv, "TestPullScheduling");
+	if (!CreateInvocationRewriter(app, true))
+		return 1;
+
+	TimePoint pushMakespan, pullMakespan;
+	TEST_ASSERT(RunScenario(12380, false, pushMakespan));
+	TEST_ASSERT(RunScenario(12390, true, pullMakespan));
+	TEST_ASSERT(pullMakespan < pushMakespan);
+
+	std::cout << "OK\n";
+	return 0;
+}
@@ -0,0 +1,180 @@
+/*
+ * Copyright (C) 2017 Smirnov Vladimir mapron1@gmail.com
+ * Source code licensed under the Apache License, Version 2.0 (the "License");
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at http://www.apache.org/licenses/LICENSE-2.0 or in file COPYING-APACHE-2.0.txt
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.h
+ */
+
+#include "TestUtils.h"
+
+#include <CoordinatorServer.h>
+#include <CoordinatorClient.h>
+#include <ToolBalancer.h>
+
+#include <thread>
+
+using namespace Wuild;
+
+const int g_rootPort = 12420;
+const int g_relayPortA = 12421;
+const int g_relayPortB = 12422;
+const std::string g_tool = "gcc";
+
+std::unique_ptr<CoordinatorServer> StartCoordinator(int port, const std::string & site, int upstreamPort)
+{
+	CoordinatorServer::Config config;
+	config.m_listenPort = port;
+	config.m_siteName = site;
+	if (upstreamPort)
+	{
+		config.m_upstream.m_coordinatorHost = StringVector{"localhost"};
+		config.m_upstream.m_coordinatorPort = upstreamPort;
+		config.m_upstream.m_sendInfoInterval = TimePoint(0.1);
+		config.m_upstream.m_logContext = "coordinator:" + site;
+	}
+	std::unique_ptr<CoordinatorServer> server(new CoordinatorServer());
+	if (!server->SetConfig(config))
+		return nullptr;
+	server->Start();
+	return server;
+}
+
+/// Emulates tool server registering on coordinator.
+std::unique_ptr<CoordinatorClient> StartToolServer(int coordinatorPort, const std::string & name, uint16_t usedBySession)
+{
+	CoordinatorClient::Config config;
+	config.m_coordinatorHost = StringVector{"localhost"};
+	config.m_coordinatorPort = coordinatorPort;
+	config.m_sendInfoInterval = TimePoint(0.1);
+
+	ToolServerInfo info;
+	info.m_toolServerId   = name;
+	info.m_connectionHost = name;
+	info.m_connectionPort = 7765;
+	info.m_toolIds        = StringVector{g_tool};
+	info.m_totalThreads   = 4;
+	info.m_connectedClients.resize(1);
+	info.m_connectedClients[0].m_clientId = "client_" + name;
+	info.m_connectedClients[0].m_sessionId = 100;
+	info.m_connectedClients[0].m_usedThreads = usedBySession;
+
+	std::unique_ptr<CoordinatorClient> client(new CoordinatorClient());
+	if (!client->SetConfig(config))
+		return nullptr;
+	client->SetToolServerInfo(info);
+	client->Start();
+	return client;
+}
+
+/// Client view of coordinator.
+class Observer
+{
+public:
+	Observer(int port)
+	{
+		CoordinatorClient::Config config;
+		config.m_coordinatorHost = StringVector{"localhost"};
+		config.m_coordinatorPort = port;
+		m_client.SetConfig(config);
+		m_client.SetInfoArrivedCallback([this](const CoordinatorInfo & info){
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_info = info;
+		});
+		m_client.Start();
+	}
+	bool WaitFor(size_t toolServers, CoordinatorInfo & info)
+	{
+		TimePoint start(true);
+		while (start.GetElapsedTime() < TimePoint(10.0))
+		{
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				if (m_info.m_toolServers.size() == toolServers)
+				{
+					info = m_info;
+					return true;
+				}
+			}
+			std::this_thread::sleep_for(std::chrono::milliseconds(20));
+		}
+		return false;
+	}
+
+private:
+	CoordinatorClient m_client;
+	CoordinatorInfo m_info;
+	std::mutex m_mutex;
+};
+
+const ToolServerInfo * FindServer(const CoordinatorInfo & info, const std::string & name)
+{
+	for (const ToolServerInfo & toolServer : info.m_toolServers)
+		if (toolServer.m_toolServerId == name)
+			return &toolServer;
+	return nullptr;
+}
+
+/*
+ * Autotest for relay coordinators of two sites under one upstream coordinator. Arguments not required.
+ */
+int main(int argc, char** argv)
+{
+	ConfiguredApplication app(argc, argv, "TestRelayCoordinator");
+
+	auto root   = StartCoordinator(g_rootPort, "", 0);
+	auto relayA = StartCoordinator(g_relayPortA, "siteA", g_rootPort);
+	auto relayB = StartCoordinator(g_relayPortB, "siteB", g_rootPort);
+	TEST_ASSERT(root && relayA && relayB);
+
+	auto serverA = StartToolServer(g_relayPortA, "serverA", 1);
+	auto serverB = StartToolServer(g_relayPortB, "serverB", 2);
+	TEST_ASSERT(serverA && serverB);
+
+	// client of site A sees both sites; sessions of site B are collapsed.
+	Observer observerA(g_relayPortA);
+	CoordinatorInfo info;
+	TEST_ASSERT(observerA.WaitFor(2, info));
+	TEST_ASSERT(info.m_site == "siteA");
+	const ToolServerInfo * localServer = FindServer(info, "serverA");
+	const ToolServerInfo * remoteServer = FindServer(info, "serverB");
+	TEST_ASSERT(localServer && remoteServer);
+	TEST_ASSERT(localServer->m_site == "siteA" && remoteServer->m_site == "siteB");
+	TEST_ASSERT(localServer->m_connectedClients.size() == 1 && localServer->m_connectedClients[0].m_sessionId == 100);
+	TEST_ASSERT(remoteServer->m_connectedClients.size() == 1 && remoteServer->m_connectedClients[0].m_sessionId != 100);
+	TEST_ASSERT(remoteServer->m_connectedClients[0].m_usedThreads == 2);
+
+	Observer observerRoot(g_rootPort);
+	TEST_ASSERT(observerRoot.WaitFor(2, info));
+
+	// local server is preferred until its queue is longer than remote site cost.
+	ToolBalancer balancer;
+	balancer.SetSessionId(1);
+	balancer.SetLocalSite("siteA");
+	balancer.SetRemoteSiteCost(1.0);
+	size_t index = 0;
+	balancer.UpdateClient(*FindServer(info, "serverA"), index);
+	balancer.UpdateClient(*FindServer(info, "serverB"), index);
+	balancer.SetClientActive(0, true);
+	balancer.SetClientActive(1, true);
+	TEST_ASSERT(balancer.FindFreeClient(g_tool) == 0);
+	for (int i = 0; i < 4; ++i)
+		balancer.StartTask(0, g_tool);
+	TEST_ASSERT(balancer.FindFreeClient(g_tool) == 0);
+	for (int i = 0; i < 4; ++i)
+		balancer.StartTask(0, g_tool);
+	TEST_ASSERT(balancer.FindFreeClient(g_tool) == 1);
+
+	// server leaving site B disappears on site A.
+	serverB.reset();
+	TEST_ASSERT(observerA.WaitFor(1, info));
+	TEST_ASSERT(FindServer(info, "serverA"));
+
+	std::cout << "OK\n";
+	return 0;
+}
@@ -0,0 +1,125 @@
+/*
+ * Copyright (C) 2017 Smirnov Vladimir mapron1@gmail.com
+ * Source code licensed under the Apache License, Version 2.0 (the "License");
+ * You may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at http://www.apache.org/licenses/LICENSE-2.0 or in file COPYING-APACHE-2.0.txt
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.h
+ */
+
+#include "TestUtils.h"
+
+#include <TaskHistory.h>
+
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <vector>
+
+using namespace Wuild;
+
+/// Prediction is within 10% of expected seconds.
+bool IsNear(const TimePoint & predicted, double expected)
+{
+	return std::abs(predicted.GetUS() - expected * TimePoint::ONE_SECOND) < expected * TimePoint::ONE_SECOND / 10;
+}
+
+/*
+ * Autotest for task execution history: prediction, persistence and compaction.
+ */
+int main(int argc, char ** argv)
+{
+	ConfiguredApplication app(argc, argv, "TestTaskHistory");
+	const std::string filename = Application::Instance().GetTempDir() + "/taskHistory.bin";
+	std::remove(filename.c_str());
+
+	{
+		TaskHistory history;
+		TEST_ASSERT(history.Open(filename));
+		bool known = true;
+		TEST_ASSERT(!history.Predict("cl a.obj", 1024, &known));
+		TEST_ASSERT(!known);
+
+		history.Add("cl a.obj", 1024, TimePoint(2.0), 100);
+		history.Add("cl b.obj", 1024, TimePoint(0.5), 100);
+		history.Add("cl c.obj", 1024, TimePoint(1.0), 200); // twice faster server, c is as long as a.
+
+		TEST_ASSERT(IsNear(history.Predict("cl a.obj", 1024, &known), 2.0));
+		TEST_ASSERT(known);
+		TEST_ASSERT(history.Predict("cl b.obj", 1024) < history.Predict("cl a.obj", 1024));
+		TEST_ASSERT(history.Predict("cl c.obj", 1024) > history.Predict("cl b.obj", 1024));
+
+		// unknown output is estimated from input size.
+		TEST_ASSERT(history.Predict("cl d.obj", 100 * 1024, &known) > history.Predict("cl e.obj", 1024));
+		TEST_ASSERT(!known);
+	}
+	{
+		TaskHistory history;
+		TEST_ASSERT(history.Open(filename));
+		TEST_ASSERT(history.GetSize() == 3);
+		TEST_ASSERT(IsNear(history.Predict("cl a.obj", 1024), 2.0));
+		TEST_ASSERT(history.Predict("cl b.obj", 1024) < history.Predict("cl a.obj", 1024));
+		for (int i = 0; i < 5000; ++i)
+			history.Add("cl b.obj", 1024, TimePoint(0.5), 100);
+	}
+	{
+		TaskHistory history;
+		TEST_ASSERT(history.Open(filename));
+		TEST_ASSERT(history.GetSize() == 3);
+		TEST_ASSERT(IsNear(history.Predict("cl b.obj", 1024), 0.5));
+	}
+	{
+		std::ifstream file(filename, std::ios::binary | std::ios::ate);
+		TEST_ASSERT(file.tellg() < 1024); // compacted on last open.
+	}
+	{
+		// crash in the middle of record write: tail is cut off.
+		std::vector<char> data;
+		{
+			std::ifstream file(filename, std::ios::binary);
+			data.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+		}
+		TEST_ASSERT(data.size() > 5);
+		data.resize(data.size() - 5);
+		std::ofstream(filename, std::ios::binary | std::ios::trunc).write(data.data(), static_cast<std::streamsize>(data.size()));
+
+		TaskHistory history;
+		TEST_ASSERT(history.Open(filename));
+		TEST_ASSERT(history.GetSize() == 2);
+		history.Add("cl f.obj", 1024, TimePoint(3.0), 100);
+		history.Add("cl g.obj", 1024, TimePoint(4.0), 100);
+	}
+	{
+		TaskHistory history;
+		TEST_ASSERT(history.Open(filename));
+		TEST_ASSERT(history.GetSize() == 4);
+		bool known = false;
+		TEST_ASSERT(IsNear(history.Predict("cl f.obj", 1024, &known), 3.0));
+		TEST_ASSERT(known);
+		TEST_ASSERT(IsNear(history.Predict("cl g.obj", 1024, &known), 4.0));
+		TEST_ASSERT(known);
+	}
+
+	const int lookups = 100000;
+	TaskHistory history;
+	for (int i = 0; i < lookups; ++i)
+		history.Add("cl " + std::to_string(i) + ".obj", 1024, TimePoint(1.0), 100);
+	std::vector<std::string> keys;
+	for (int i = 0; i < lookups; ++i)
+		keys.push_back("cl " + std::to_string(i) + ".obj");
+	TimePoint start(true);
+	int64_t total = 0;
+	for (const auto & key : keys)
+		total += history.Predict(key, 1024).GetUS();
+	Syslogger(Syslogger::Notice) << lookups << " predictions took " << start.GetElapsedTime().GetUS() / 1000 << "ms";
+	TEST_ASSERT(total > 0);
+
+	std::remove(filename.c_str());
+	std::cout << "OK\n";
+	return 0;
+}
@@ -41,6 +41,9 @@ public:
 	/// Sets maximal process count.
 	virtual void SetThreadCount(int threads) = 0;
 
+	/// Sets maximal process count for specific tool id. Overall limit from SetThreadCount still applies.
+	virtual void SetToolThreadCount(const std::string & toolId, int threads) = 0;
+
 	/// Queued tasks count.
 	virtual size_t GetQueueSize() const = 0;
 };
@@ -15,6 +15,8 @@
 
 #include "ToolInvocation.h"
 
+#include <functional>
+#include <future>
 #include <map>
 
 namespace Wuild
@@ -36,6 +38,18 @@ public:
 
 	/// For each id in toolIds, determine version using GetToolVersion and place key in map.
 	virtual VersionMap DetermineToolVersions(const std::vector<std::string> & toolIds) const = 0;
+
+	/// Runs DetermineToolVersions in background thread; readyCallback is called from it when versions are known.
+	/// Checker should outlive the result.
+	std::shared_future<VersionMap> DetermineToolVersionsAsync(const std::vector<std::string> & toolIds, std::function<void()> readyCallback = std::function<void()>()) const
+	{
+		return std::async(std::launch::async, [this, toolIds, readyCallback]{
+			VersionMap versions = DetermineToolVersions(toolIds);
+			if (readyCallback)
+				readyCallback();
+			return versions;
+		}).share();
+	}
 };
 
 }
@@ -55,6 +55,8 @@ struct LocalExecutorTask
 	bool m_writeInput = true;
 	bool m_readOutput = true;
 	bool m_setEnv = true;
+	bool m_streamOutput = false;            //!< Tool stdout is compressed into result data while tool runs, instead of reading output file.
+	std::string m_cwd;                      //!< Working directory for tool; relative paths are resolved against it. Empty = current.
 	TemporaryFile m_inputFile;              //!< Temporary file used for tool input
 	TemporaryFile m_outputFile;             //!< Temporary file used for tool output
 
@@ -72,6 +72,23 @@ int main(int argc, char** argv)
 		for (const auto & t : toolIds)
 			std::cout << t << ", ";
 		std::cout << "\n";
+
+		const auto versionMatrix = info.GetVersionMatrix();
+		if (!versionMatrix.empty())
+		{
+			std::cout << "\nTool versions:\n";
+			for (const auto & toolPair : versionMatrix)
+			{
+				std::cout << toolPair.first << ":\n";
+				for (const auto & versionPair : toolPair.second)
+				{
+					std::cout << "  " << versionPair.first << ": ";
+					for (size_t index : versionPair.second)
+						std::cout << info.m_toolServers[index].m_connectionHost << ":" << info.m_toolServers[index].m_connectionPort << ", ";
+					std::cout << "\n";
+				}
+			}
+		}
 		Application::Interrupt(0);
 	});
 
@@ -14,6 +14,7 @@
 #include "AppUtils.h"
 
 #include <ToolProxyServer.h>
+#include <ToolProxyClient.h>
 #include <RemoteToolClient.h>
 #include <LocalExecutor.h>
 #include <VersionChecker.h>
@@ -35,21 +36,26 @@ int main(int argc, char** argv)
 	if (!app.GetRemoteToolClientConfig(config))
 		return 1;
 	
+	// agent serves any configured tool.
+	const StringVector toolIds = proxyConfig.m_toolId.empty() ? invocationRewriter->GetConfig().m_toolIds : StringVector{proxyConfig.m_toolId};
 	auto localExecutor = LocalExecutor::Create(invocationRewriter, app.m_tempDir);
-	const auto toolsVersions = VersionChecker::Create(localExecutor, invocationRewriter)->DetermineToolVersions({proxyConfig.m_toolId});
+	const auto toolsVersions = VersionChecker::Create(localExecutor, invocationRewriter)->DetermineToolVersions(toolIds);
 
 	RemoteToolClient rcClient(invocationRewriter, toolsVersions);
 	if (!rcClient.SetConfig(config))
 		return 1;
 
-	ToolProxyServer proxyServer(localExecutor, rcClient);
+	ToolProxyServer proxyServer(invocationRewriter, localExecutor, rcClient);
 	if (!proxyServer.SetConfig(proxyConfig))
 		return 1;
 
-	rcClient.Start();
+	rcClient.Start(toolIds);
 	proxyServer.Start([]{
 		Application::Interrupt(1);
 	});
+	// WuildProxyClient needs toolId, agent without it is not used by fast path.
+	if (!proxyConfig.m_toolId.empty() && !Application::IsInterrupted())
+		ToolProxyClient::SaveCompiledConfig(ToolProxyClient::GetCompiledConfigPath(), proxyConfig);
 
 	return ExecAppLoop();
 }
@@ -18,9 +18,33 @@
 
 #include <iostream>
 
+namespace
+{
+/// Without ini files parsing and network thread; any --wuild- option requires full config.
+bool RunFastPath(int argc, char** argv, int & exitCode)
+{
+	using namespace Wuild;
+	const StringVector args = StringUtils::StringVectorFromArgv(argc, argv);
+	for (const auto & arg : args)
+		if (arg.find("--wuild-") == 0)
+			return false;
+
+	ToolProxyClient::Config proxyConfig;
+	if (!ToolProxyClient::LoadCompiledConfig(ToolProxyClient::GetCompiledConfigPath(), proxyConfig) || proxyConfig.m_toolId.empty())
+		return false;
+
+	ToolProxyClient proxyClient;
+	return proxyClient.SetConfig(proxyConfig) && proxyClient.RunTaskSync(args, exitCode);
+}
+}
+
 int main(int argc, char** argv)
 {
 	using namespace Wuild;
+	int exitCode = 0;
+	if (RunFastPath(argc, argv, exitCode))
+		return exitCode;
+
 	ConfiguredApplication app(argc, argv, "WuildProxyClient", "proxy");
 
 	//app.m_loggerConfig.m_maxLogLevel = Syslogger::Notice;
@@ -30,6 +54,12 @@ int main(int argc, char** argv)
 	if (!app.GetToolProxyServerConfig(proxyConfig))
 		return 1;
 
+	if (proxyConfig.m_toolId.empty())
+	{
+		std::cerr << "toolId is required for WuildProxyClient.\n";
+		return 1;
+	}
+
 	ToolProxyClient proxyClient;
 	if (!proxyClient.SetConfig(proxyConfig))
 		return 1;
@@ -14,6 +14,7 @@
 #include "AppUtils.h"
 
 #include <RemoteToolClient.h>
+#include <ToolProxyClient.h>
 #include <LocalExecutor.h>
 #include <FileUtils.h>
 #include <VersionChecker.h>
@@ -50,6 +51,22 @@ int main(int argc, char** argv)
 	args.erase(args.begin());
 	ToolInvocation invocation = invocationRewriter->CompleteInvocation(ToolInvocation(args).SetId(toolId));
 
+	if (!app.m_toolProxyServerConfig.m_listenSocket.empty())
+	{
+		// agent already keeps connection to tool servers.
+		ToolProxyClient agentClient;
+		if (agentClient.SetConfig(app.m_toolProxyServerConfig) && agentClient.Start())
+		{
+			agentClient.InvokeRemote(invocation, [](bool result, const std::string & stdOut){
+				if (!stdOut.empty())
+					std::cout << stdOut << std::flush;
+				Application::Interrupt(1 - result);
+			});
+			return ExecAppLoop();
+		}
+		Syslogger(Syslogger::Warning) << "Failed to connect to Wuild agent, using own connection.";
+	}
+
 	RemoteToolClient::Config config;
 	if (!app.GetRemoteToolClientConfig(config))
 		return 1;
@@ -15,6 +15,7 @@
 
 #include <RemoteToolServer.h>
 #include <LocalExecutor.h>
+#include <SpawnLauncher.h>
 #include <VersionChecker.h>
 
 int main(int argc, char** argv)
@@ -30,7 +31,11 @@ int main(int argc, char** argv)
 	if (!invocationRewriter)
 		return 1;
 
-	auto localExecutor = LocalExecutor::Create(invocationRewriter, app.m_tempDir);
+	SpawnLauncher::Ptr spawnLauncher;
+	if (toolServerConfig.m_usePreforkedLauncher)
+		spawnLauncher = SpawnLauncher::Create();
+
+	auto localExecutor = LocalExecutor::Create(invocationRewriter, app.m_tempDir, nullptr, spawnLauncher);
 	
 	auto versionChecker = VersionChecker::Create(localExecutor, invocationRewriter);
 	const auto toolsVersions = versionChecker->DetermineToolVersions({});